@@ -0,0 +1,51 @@
+// Copyright Yamaha 2021
+// MIT License
+// https://github.com/yamaha-bps/cbr_utils/blob/master/LICENSE
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <ostream>
+
+#include "cbr_utils/async_logger.hpp"
+#include "cbr_utils/bench.hpp"
+
+using namespace cbr;
+
+int main(int argc, char ** argv)
+{
+  // short runs so that the ring never fills up, otherwise the drop path is measured
+  bench::Options bench_opts;
+  bench_opts.warmup_time = 0.005;
+  bench_opts.sample_time = 0.002;
+  bench_opts.samples     = 20;
+  bench::Suite suite(bench_opts);
+
+  // discard output, only the cost on the logging thread is measured: the background thread only
+  // drains the ring between benchmarks, when flushed
+  std::ostream null_os(nullptr);
+  AsyncLogger::Options opts;
+  opts.ring_size = std::size_t{1} << 26;
+  opts.period    = std::chrono::seconds(10);
+  AsyncLogger logger(null_os, opts);
+
+  // create the ring of this thread and register the formats
+  int64_t i = 0;
+  logger.info("loop iteration");
+  logger.info("value {} {}", i, 0.5);
+  logger.info("name {}", "control_loop");
+  logger.flush();
+
+  suite.run("async_logger/no args", [&] { logger.info("loop iteration"); });
+  logger.flush();
+  suite.run("async_logger/int double", [&] { logger.info("value {} {}", ++i, 0.5); });
+  logger.flush();
+  suite.run("async_logger/string", [&] { logger.info("name {}", "control_loop"); });
+  logger.flush();
+  logger.set_level(LogLevel::info);
+  suite.run("async_logger/filtered", [&] { logger.debug("value {}", ++i); });
+
+  std::cerr << "dropped messages: " << logger.dropped_count() << std::endl;
+
+  return suite.run_main(argc, argv);
+}
@@ -0,0 +1,87 @@
+// Copyright Yamaha 2021
+// MIT License
+// https://github.com/yamaha-bps/cbr_utils/blob/master/LICENSE
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <random>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "cbr_utils/bench.hpp"
+#include "cbr_utils/flat_map.hpp"
+
+using namespace cbr;
+
+namespace {
+
+template<typename M>
+void bench_map(bench::Suite & suite, const std::string & name, const std::size_t n)
+{
+  std::mt19937_64 rng(1);
+  std::vector<uint64_t> keys(n);
+  for (auto & k : keys) { k = rng(); }
+
+  M m;
+  for (const auto k : keys) { m[k] = k; }
+
+  // hits in random order
+  std::size_t i = 0;
+  suite.run(name + "/find_hit/" + std::to_string(n), [&] {
+    auto it = m.find(keys[i++ % n]);
+    bench::do_not_optimize(it);
+  });
+
+  // misses
+  suite.run(name + "/find_miss/" + std::to_string(n), [&] {
+    auto it = m.find(rng());
+    bench::do_not_optimize(it);
+  });
+
+  suite.run(name + "/insert_erase/" + std::to_string(n), [&] {
+    const uint64_t k = rng();
+    m[k]             = k;
+    m.erase(k);
+  });
+}
+
+template<typename M>
+void bench_topics(bench::Suite & suite, const std::string & name)
+{
+  // lookup of topic names received as string views
+  std::vector<std::string> topics;
+  for (int i = 0; i < 64; ++i) { topics.push_back("/robot/sensor_" + std::to_string(i) + "/data"); }
+
+  M m;
+  for (const auto & t : topics) { m[t] = t.size(); }
+
+  std::size_t i = 0;
+  suite.run(name + "/topic_lookup", [&] {
+    const std::string_view t = topics[i++ % topics.size()];
+    auto it                  = m.find(t);
+    bench::do_not_optimize(it);
+  });
+}
+
+}  // namespace
+
+int main(int argc, char ** argv)
+{
+  bench::Suite suite;
+
+  for (const std::size_t n : {64UL, 4096UL, 262144UL}) {
+    bench_map<flat_hash_map<uint64_t, uint64_t>>(suite, "flat_hash_map", n);
+    bench_map<std::unordered_map<uint64_t, uint64_t>>(suite, "unordered_map", n);
+    bench_map<flat_map<uint64_t, uint64_t>>(suite, "flat_map", n);
+    bench_map<std::map<uint64_t, uint64_t>>(suite, "map", n);
+  }
+
+  bench_topics<string_hash_map<std::size_t>>(suite, "string_hash_map");
+  bench_topics<flat_map<std::string, std::size_t, std::less<>>>(suite, "flat_map");
+  bench_topics<std::map<std::string, std::size_t, std::less<>>>(suite, "map");
+
+  return suite.run_main(argc, argv);
+}
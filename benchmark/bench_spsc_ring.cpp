@@ -0,0 +1,99 @@
+// Copyright Yamaha 2021
+// MIT License
+// https://github.com/yamaha-bps/cbr_utils/blob/master/LICENSE
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <string>
+#include <thread>
+
+#include "cbr_utils/bench.hpp"
+#include "cbr_utils/spsc_ring.hpp"
+
+using namespace cbr;
+
+namespace {
+
+// Bounded queue protected by a mutex, as used by ThreadPool
+template<typename T>
+class MutexQueue
+{
+public:
+  explicit MutexQueue(const std::size_t capacity) : m_capacity(capacity) {}
+
+  bool try_push(const T & v)
+  {
+    std::scoped_lock lock(m_mtx);
+    if (m_queue.size() >= m_capacity) { return false; }
+    m_queue.push(v);
+    return true;
+  }
+
+  std::optional<T> try_pop()
+  {
+    std::scoped_lock lock(m_mtx);
+    if (m_queue.empty()) { return std::nullopt; }
+    std::optional<T> res(m_queue.front());
+    m_queue.pop();
+    return res;
+  }
+
+protected:
+  std::size_t m_capacity;
+  std::mutex m_mtx;
+  std::queue<T> m_queue;
+};
+
+template<typename Q>
+void bench_queue(bench::Suite & suite, const std::string & name)
+{
+  // single thread: push and pop one element
+  {
+    Q q(1024);
+    uint64_t i = 0;
+    suite.run(name + "/push_pop", [&] {
+      q.try_push(++i);
+      auto v = q.try_pop();
+      bench::do_not_optimize(v);
+    });
+  }
+
+  // producer measured while a consumer thread drains the queue
+  {
+    Q q(1024);
+    std::atomic<bool> stop{false};
+    std::thread consumer([&q, &stop] {
+      uint64_t sum = 0;
+      while (!stop.load(std::memory_order_relaxed)) {
+        if (auto v = q.try_pop()) {
+          sum += *v;
+        } else {
+          std::this_thread::yield();
+        }
+      }
+      bench::do_not_optimize(sum);
+    });
+
+    uint64_t i = 0;
+    suite.run(name + "/push_with_consumer", [&] {
+      while (!q.try_push(++i)) { std::this_thread::yield(); }
+    });
+    stop = true;
+    consumer.join();
+  }
+}
+
+}  // namespace
+
+int main(int argc, char ** argv)
+{
+  bench::Suite suite;
+
+  bench_queue<SpscRing<uint64_t>>(suite, "spsc_ring");
+  bench_queue<MutexQueue<uint64_t>>(suite, "mutex_queue");
+
+  return suite.run_main(argc, argv);
+}
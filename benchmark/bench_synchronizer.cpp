@@ -0,0 +1,54 @@
+// Copyright Yamaha 2021
+// MIT License
+// https://github.com/yamaha-bps/cbr_utils/blob/master/LICENSE
+
+#include <cstdint>
+
+#include "cbr_utils/bench.hpp"
+#include "cbr_utils/synchronizer.hpp"
+
+using namespace cbr;
+
+int main(int argc, char ** argv)
+{
+  bench::Suite suite;
+
+  {
+    Synchronizer<int64_t, int64_t> sync;
+    sync.set_time_fcn<0>([](const int64_t & i) { return i; });
+    sync.set_time_fcn<1>([](const int64_t & i) { return i; });
+    int64_t n = 0;
+    sync.register_callback([&n](int64_t && i0, int64_t &&) { n += i0; });
+
+    int64_t t = 0;
+    suite.run("synchronizer/2 streams/add_and_search", [&] {
+      sync.add_and_search<0>(t);
+      sync.add_and_search<1>(t + 1);
+      t += 2;
+    });
+    bench::do_not_optimize(n);
+  }
+
+  {
+    Synchronizer<int64_t, int64_t, int64_t, int64_t> sync;
+    sync.set_time_fcn<0>([](const int64_t & i) { return i; });
+    sync.set_time_fcn<1>([](const int64_t & i) { return i; });
+    sync.set_time_fcn<2>([](const int64_t & i) { return i; });
+    sync.set_time_fcn<3>([](const int64_t & i) { return i; });
+    int64_t n = 0;
+    sync.register_callback(
+      [&n](int64_t && i0, int64_t &&, int64_t &&, int64_t &&) { n += i0; });
+
+    int64_t t = 0;
+    suite.run("synchronizer/4 streams/add_and_search", [&] {
+      sync.add_and_search<0>(t);
+      sync.add_and_search<1>(t + 1);
+      sync.add_and_search<2>(t + 2);
+      sync.add_and_search<3>(t + 3);
+      t += 4;
+    });
+    bench::do_not_optimize(n);
+  }
+
+  return suite.run_main(argc, argv);
+}
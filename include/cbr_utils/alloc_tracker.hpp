@@ -0,0 +1,313 @@
+// Copyright Yamaha 2021
+// MIT License
+// https://github.com/yamaha-bps/cbr_utils/blob/master/LICENSE
+
+/** @file */
+
+#ifndef CBR_UTILS__ALLOC_TRACKER_HPP_
+#define CBR_UTILS__ALLOC_TRACKER_HPP_
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace cbr {
+
+/**
+ * @brief Heap allocation statistics of a region.
+ */
+struct AllocStats
+{
+  std::size_t count = 0;  ///< Number of allocations
+  std::size_t bytes = 0;  ///< Number of bytes allocated
+  std::size_t frees = 0;  ///< Number of deallocations
+
+  AllocStats operator-(const AllocStats & o) const noexcept
+  {
+    return {count - o.count, bytes - o.bytes, frees - o.frees};
+  }
+};
+
+/// @cond
+
+namespace detail {
+
+// Per-thread allocation counters, only updated if the hooks are installed
+inline thread_local AllocStats alloc_counters{};
+
+inline void * raw_alloc(const std::size_t n, const std::size_t alignment) noexcept
+{
+  if (alignment <= alignof(std::max_align_t)) { return std::malloc(n); }
+  return std::aligned_alloc(alignment, (n + alignment - 1) / alignment * alignment);
+}
+
+inline void * tracked_alloc(std::size_t n, const std::size_t alignment, const bool nothrow)
+{
+  if (n == 0) { n = 1; }
+  void * p = nullptr;
+  // like the default operator new, give the new handler a chance to free memory
+  while ((p = raw_alloc(n, alignment)) == nullptr) {
+    const auto handler = std::get_new_handler();
+    if (handler == nullptr) {
+      if (nothrow) { return nullptr; }
+      throw std::bad_alloc();
+    }
+    if (nothrow) {
+      try {
+        handler();
+      } catch (const std::bad_alloc &) {
+        return nullptr;
+      }
+    } else {
+      handler();
+    }
+  }
+  auto & c = alloc_counters;
+  ++c.count;
+  c.bytes += n;
+  return p;
+}
+
+inline void tracked_free(void * p) noexcept
+{
+  if (p == nullptr) { return; }
+  ++alloc_counters.frees;
+  std::free(p);
+}
+
+}  // namespace detail
+
+/// @endcond
+
+/**
+ * @brief Install global operator new and delete replacements that count allocations.
+ * @details Must be used exactly once in a program, at global scope in a source file. Without it
+ * AllocTracker reports no allocations, see alloc_tracker_installed() and expect_no_allocations().
+ *
+ * The replacements forward to malloc/aligned_alloc and free, call the new handler on failure like
+ * the default ones, and increment thread local counters.
+ */
+#define CBR_UTILS_INSTALL_ALLOC_TRACKER()                                                        \
+  void * operator new(std::size_t n) { return ::cbr::detail::tracked_alloc(n, 0, false); }     \
+  void * operator new[](std::size_t n) { return ::cbr::detail::tracked_alloc(n, 0, false); }   \
+  void * operator new(std::size_t n, const std::nothrow_t &) noexcept                          \
+  {                                                                                            \
+    return ::cbr::detail::tracked_alloc(n, 0, true);                                           \
+  }                                                                                            \
+  void * operator new[](std::size_t n, const std::nothrow_t &) noexcept                        \
+  {                                                                                            \
+    return ::cbr::detail::tracked_alloc(n, 0, true);                                           \
+  }                                                                                            \
+  void * operator new(std::size_t n, std::align_val_t a)                                       \
+  {                                                                                            \
+    return ::cbr::detail::tracked_alloc(n, static_cast<std::size_t>(a), false);                \
+  }                                                                                            \
+  void * operator new[](std::size_t n, std::align_val_t a)                                     \
+  {                                                                                            \
+    return ::cbr::detail::tracked_alloc(n, static_cast<std::size_t>(a), false);                \
+  }                                                                                            \
+  void * operator new(std::size_t n, std::align_val_t a, const std::nothrow_t &) noexcept      \
+  {                                                                                            \
+    return ::cbr::detail::tracked_alloc(n, static_cast<std::size_t>(a), true);                 \
+  }                                                                                            \
+  void * operator new[](std::size_t n, std::align_val_t a, const std::nothrow_t &) noexcept    \
+  {                                                                                            \
+    return ::cbr::detail::tracked_alloc(n, static_cast<std::size_t>(a), true);                 \
+  }                                                                                            \
+  void operator delete(void * p) noexcept { ::cbr::detail::tracked_free(p); }                  \
+  void operator delete[](void * p) noexcept { ::cbr::detail::tracked_free(p); }                \
+  void operator delete(void * p, std::size_t) noexcept { ::cbr::detail::tracked_free(p); }     \
+  void operator delete[](void * p, std::size_t) noexcept { ::cbr::detail::tracked_free(p); }   \
+  void operator delete(void * p, std::align_val_t) noexcept { ::cbr::detail::tracked_free(p); } \
+  void operator delete[](void * p, std::align_val_t) noexcept                                  \
+  {                                                                                            \
+    ::cbr::detail::tracked_free(p);                                                            \
+  }                                                                                            \
+  void operator delete(void * p, std::size_t, std::align_val_t) noexcept                       \
+  {                                                                                            \
+    ::cbr::detail::tracked_free(p);                                                            \
+  }                                                                                            \
+  void operator delete[](void * p, std::size_t, std::align_val_t) noexcept                     \
+  {                                                                                            \
+    ::cbr::detail::tracked_free(p);                                                            \
+  }                                                                                            \
+  void operator delete(void * p, const std::nothrow_t &) noexcept                              \
+  {                                                                                            \
+    ::cbr::detail::tracked_free(p);                                                            \
+  }                                                                                            \
+  void operator delete[](void * p, const std::nothrow_t &) noexcept                            \
+  {                                                                                            \
+    ::cbr::detail::tracked_free(p);                                                            \
+  }                                                                                            \
+  void operator delete(void * p, std::align_val_t, const std::nothrow_t &) noexcept            \
+  {                                                                                            \
+    ::cbr::detail::tracked_free(p);                                                            \
+  }                                                                                            \
+  void operator delete[](void * p, std::align_val_t, const std::nothrow_t &) noexcept          \
+  {                                                                                            \
+    ::cbr::detail::tracked_free(p);                                                            \
+  }                                                                                            \
+  static_assert(true, "")
+
+/**
+ * @brief Check if the allocation hooks are installed, see CBR_UTILS_INSTALL_ALLOC_TRACKER().
+ */
+inline bool alloc_tracker_installed()
+{
+  const auto before = detail::alloc_counters.count;
+  ::operator delete(::operator new(1));
+  return detail::alloc_counters.count != before;
+}
+
+/**
+ * @brief Count heap allocations of the calling thread in a region.
+ * @details Used like a CyberTimer: tic() starts the region and toc() returns the allocations since
+ * the last tic(). Requires CBR_UTILS_INSTALL_ALLOC_TRACKER(), otherwise always reports zero.
+ *
+ * Example usage:
+ * ```
+ * AllocTracker tracker;
+ * tracker.tic();
+ * hotFunction();
+ * const auto stats = tracker.toc();
+ * std::cout << stats.count << " allocations, " << stats.bytes << " bytes" << std::endl;
+ * ```
+ */
+class AllocTracker
+{
+public:
+  /**
+   * @brief Start the region.
+   */
+  void tic() noexcept
+  {
+    m_start   = detail::alloc_counters;
+    m_running = true;
+  }
+
+  /**
+   * @brief Allocations since the region was started, without stopping it.
+   */
+  AllocStats tac() const noexcept { return detail::alloc_counters - m_start; }
+
+  /**
+   * @brief Stop the region.
+   * @details Returns the latest values if the region is not running.
+   *
+   * @return Allocations since last tic().
+   */
+  const AllocStats & toc() noexcept
+  {
+    if (m_running) {
+      m_running = false;
+      m_latest  = tac();
+    }
+    return m_latest;
+  }
+
+  /**
+   * @brief Get whether or not the region is running.
+   */
+  bool is_running() const noexcept { return m_running; }
+
+  /**
+   * @brief Get allocations between the latest tic() and toc() calls.
+   */
+  const AllocStats & get_latest() const noexcept { return m_latest; }
+
+protected:
+  /// @cond
+  AllocStats m_start{};
+  AllocStats m_latest{};
+  bool m_running = false;
+  /// @endcond
+};
+
+/**
+ * @brief RAII allocation tracking scope.
+ * @details Writes the allocations performed during its lifetime to the provided stats on
+ * destruction.
+ *
+ * Example usage:
+ * ```
+ * AllocStats stats;
+ * {
+ *   AllocScope scope(stats);
+ *   hotFunction();
+ * }
+ * ```
+ */
+class AllocScope
+{
+public:
+  AllocScope(const AllocScope &) = delete;
+  AllocScope(AllocScope &&)      = delete;
+  AllocScope & operator=(const AllocScope &) = delete;
+  AllocScope & operator=(AllocScope &&) = delete;
+
+  /**
+   * @brief Start the scope.
+   *
+   * @param out Stats written when the scope ends.
+   */
+  explicit AllocScope(AllocStats & out) noexcept : m_out(out) { m_tracker.tic(); }
+
+  ~AllocScope() { m_out = m_tracker.toc(); }
+
+protected:
+  /// @cond
+  AllocStats & m_out;
+  AllocTracker m_tracker{};
+  /// @endcond
+};
+
+/**
+ * @brief Count the heap allocations performed by a function.
+ * @details Useful in tests to assert that a hot path does not allocate:
+ * ```
+ * ASSERT_EQ(count_allocations([&] { sync.search(); }).count, 0LU);
+ * ```
+ *
+ * @param f Function called without arguments.
+ * @return Allocations performed by f on the calling thread.
+ */
+template<typename F>
+AllocStats count_allocations(F && f)
+{
+  AllocTracker tracker;
+  tracker.tic();
+  std::forward<F>(f)();
+  return tracker.toc();
+}
+
+/**
+ * @brief Check that a function does not allocate.
+ * @details Unlike count_allocations(), fails loudly if the hooks are not installed instead of
+ * reporting zero allocations:
+ * ```
+ * ASSERT_NO_THROW(expect_no_allocations([&] { sync.search(); }));
+ * ```
+ * Throws std::logic_error if CBR_UTILS_INSTALL_ALLOC_TRACKER() is not used in the program, and
+ * std::runtime_error if f allocates.
+ *
+ * @param f Function called without arguments.
+ */
+template<typename F>
+void expect_no_allocations(F && f)
+{
+  if (!alloc_tracker_installed()) {
+    throw std::logic_error("Allocation tracking requires CBR_UTILS_INSTALL_ALLOC_TRACKER().");
+  }
+  const auto stats = count_allocations(std::forward<F>(f));
+  if (stats.count != 0) {
+    throw std::runtime_error("Unexpected heap allocations: " + std::to_string(stats.count) + " ("
+                             + std::to_string(stats.bytes) + " bytes).");
+  }
+}
+
+}  // namespace cbr
+
+#endif  // CBR_UTILS__ALLOC_TRACKER_HPP_
@@ -0,0 +1,685 @@
+// Copyright Yamaha 2021
+// MIT License
+// https://github.com/yamaha-bps/cbr_utils/blob/master/LICENSE
+
+/** @file */
+
+#ifndef CBR_UTILS__ALLOCATORS_HPP_
+#define CBR_UTILS__ALLOCATORS_HPP_
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <stdexcept>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+namespace cbr {
+
+/**
+ * @brief Fixed capacity pool of objects of type T with a lock-free free list.
+ * @details All the storage is allocated at construction. Free slots are linked in a Treiber stack
+ * whose head holds a slot index and a tag incremented on every update, which prevents the ABA
+ * problem. allocate() and deallocate() can be called concurrently from any thread and never touch
+ * the global heap.
+ *
+ * Example:
+ * ```
+ * ObjectPool<Message> pool(1024);
+ *
+ * auto msg = pool.make_unique(args...);  // std::unique_ptr returning the object to the pool
+ * if (!msg) { ++dropped; }
+ * ```
+ *
+ * @tparam T Object type.
+ */
+template<typename T>
+class ObjectPool
+{
+public:
+  /**
+   * @brief Deleter destroying objects created by the pool.
+   */
+  struct Deleter
+  {
+    ObjectPool * pool = nullptr;
+
+    void operator()(T * p) const noexcept { pool->destroy(p); }
+  };
+
+  using unique_ptr_t = std::unique_ptr<T, Deleter>;
+
+  ObjectPool(const ObjectPool &) = delete;
+  ObjectPool(ObjectPool &&)      = delete;
+  ObjectPool & operator=(const ObjectPool &) = delete;
+  ObjectPool & operator=(ObjectPool &&) = delete;
+
+  /**
+   * @brief Construct a new ObjectPool object.
+   * @details Throws std::invalid_argument if capacity is 0 or does not fit in 32 bits.
+   *
+   * @param capacity Number of objects.
+   */
+  explicit ObjectPool(const std::size_t capacity)
+  {
+    if (capacity == 0 || capacity >= npos) {
+      throw std::invalid_argument("ObjectPool capacity must be positive and less than 2^32 - 1.");
+    }
+    m_capacity = capacity;
+    m_slots    = std::make_unique<Slot[]>(capacity);
+    m_next     = std::make_unique<std::atomic<uint32_t>[]>(capacity);
+    for (std::size_t i = 0; i < capacity; ++i) {
+      m_next[i].store(i + 1 < capacity ? static_cast<uint32_t>(i + 1) : npos);
+    }
+    m_head.store(0);
+  }
+
+  /**
+   * @brief Objects that were not destroyed are not destructed.
+   */
+  ~ObjectPool() = default;
+
+  /**
+   * @brief Take storage for one object.
+   * @details Lock-free.
+   *
+   * @return Uninitialized storage, or nullptr if the pool is exhausted.
+   */
+  T * allocate() noexcept
+  {
+    uint64_t head = m_head.load(std::memory_order_acquire);
+    while (true) {
+      const auto idx = static_cast<uint32_t>(head);
+      if (idx == npos) { return nullptr; }
+      const uint64_t next = m_next[idx].load(std::memory_order_relaxed);
+      if (m_head.compare_exchange_weak(
+            head, next_tag(head) | next, std::memory_order_acq_rel, std::memory_order_acquire)) {
+        return reinterpret_cast<T *>(m_slots[idx].data);
+      }
+    }
+  }
+
+  /**
+   * @brief Return storage to the pool.
+   * @details Lock-free. The object must have been destructed.
+   *
+   * @param p Pointer returned by allocate().
+   */
+  void deallocate(T * p) noexcept
+  {
+    if (p == nullptr) { return; }
+    const auto idx = static_cast<uint32_t>(reinterpret_cast<Slot *>(p) - m_slots.get());
+    uint64_t head  = m_head.load(std::memory_order_relaxed);
+    do {
+      m_next[idx].store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+    } while (!m_head.compare_exchange_weak(
+      head, next_tag(head) | idx, std::memory_order_release, std::memory_order_relaxed));
+  }
+
+  /**
+   * @brief Construct an object in the pool.
+   * @details The storage is returned to the pool if the constructor throws.
+   *
+   * @param args Arguments forwarded to the constructor of T.
+   * @return Pointer to the object, or nullptr if the pool is exhausted.
+   */
+  template<typename... Args>
+  T * create(Args &&... args)
+  {
+    T * p = allocate();
+    if (p == nullptr) { return nullptr; }
+    if constexpr (std::is_nothrow_constructible_v<T, Args...>) {
+      return ::new (static_cast<void *>(p)) T(std::forward<Args>(args)...);
+    } else {
+      try {
+        return ::new (static_cast<void *>(p)) T(std::forward<Args>(args)...);
+      } catch (...) {
+        deallocate(p);
+        throw;
+      }
+    }
+  }
+
+  /**
+   * @brief Destruct an object and return its storage to the pool.
+   *
+   * @param p Pointer returned by create().
+   */
+  void destroy(T * p) noexcept
+  {
+    if (p == nullptr) { return; }
+    p->~T();
+    deallocate(p);
+  }
+
+  /**
+   * @brief Construct an object in the pool, owned by a std::unique_ptr.
+   *
+   * @param args Arguments forwarded to the constructor of T.
+   * @return Owning pointer, empty if the pool is exhausted.
+   */
+  template<typename... Args>
+  unique_ptr_t make_unique(Args &&... args)
+  {
+    return unique_ptr_t(create(std::forward<Args>(args)...), Deleter{this});
+  }
+
+  /**
+   * @brief Check if a pointer points to the storage of the pool.
+   */
+  bool owns(const T * p) const noexcept
+  {
+    const auto * b = reinterpret_cast<const std::byte *>(m_slots.get());
+    const auto * q = reinterpret_cast<const std::byte *>(p);
+    return q >= b && q < b + m_capacity * sizeof(Slot);
+  }
+
+  /**
+   * @brief Number of objects of the pool.
+   */
+  std::size_t capacity() const noexcept { return m_capacity; }
+
+protected:
+  /// @cond
+  static constexpr uint32_t npos = std::numeric_limits<uint32_t>::max();
+
+  struct Slot
+  {
+    alignas(T) std::byte data[sizeof(T)];
+  };
+
+  static uint64_t next_tag(const uint64_t head) noexcept
+  {
+    return ((head >> 32) + 1) << 32;
+  }
+
+  alignas(64) std::atomic<uint64_t> m_head{npos};
+  std::size_t m_capacity = 0;
+  std::unique_ptr<Slot[]> m_slots;
+  std::unique_ptr<std::atomic<uint32_t>[]> m_next;
+  /// @endcond
+};
+
+/**
+ * @brief Monotonic arena memory resource with rewind.
+ * @details Allocations bump a pointer in a fixed buffer and deallocations do nothing. The arena is
+ * emptied at once by rewinding to a mark, typically at the end of each loop iteration, which makes
+ * allocation cost a few instructions and fragmentation impossible.
+ *
+ * Derives from std::pmr::memory_resource, so that it can back std::pmr containers, PmrAdaptor or
+ * a std::pmr::unsynchronized_pool_resource when memory must be reused.
+ *
+ * Example:
+ * ```
+ * MonotonicArena arena(1 << 20);
+ * while (true) {
+ *   timer.wait();
+ *   const auto mark = arena.mark();
+ *   std::pmr::vector<Point> points(&arena);
+ *   compute(points);
+ *   arena.rewind(mark);  // points must not be used past this point
+ * }
+ * ```
+ * Notes:
+ * - Not thread safe.
+ * - Throws std::bad_alloc when exhausted.
+ */
+class MonotonicArena : public std::pmr::memory_resource
+{
+public:
+  using marker_t = std::size_t;
+
+  MonotonicArena(const MonotonicArena &) = delete;
+  MonotonicArena(MonotonicArena &&)      = delete;
+  MonotonicArena & operator=(const MonotonicArena &) = delete;
+  MonotonicArena & operator=(MonotonicArena &&) = delete;
+  ~MonotonicArena() override                    = default;
+
+  /**
+   * @brief Construct an arena owning a buffer.
+   *
+   * @param capacity Size of the buffer in bytes.
+   */
+  explicit MonotonicArena(const std::size_t capacity)
+      : m_owned(new (std::align_val_t{64}) std::byte[capacity]), m_buffer(m_owned.get()),
+        m_capacity(capacity)
+  {}
+
+  /**
+   * @brief Construct an arena using an external buffer.
+   *
+   * @param buffer Buffer, must outlive the arena.
+   * @param size Size of the buffer in bytes.
+   */
+  MonotonicArena(void * buffer, const std::size_t size) noexcept
+      : m_buffer(static_cast<std::byte *>(buffer)), m_capacity(size)
+  {}
+
+  /**
+   * @brief Current position, to be passed to rewind().
+   */
+  marker_t mark() const noexcept { return m_offset; }
+
+  /**
+   * @brief Release all allocations performed since a mark.
+   * @details Throws std::invalid_argument if the mark is after the current position.
+   *
+   * @param m Value returned by mark().
+   */
+  void rewind(const marker_t m)
+  {
+    if (m > m_offset) { throw std::invalid_argument("Arena mark is after the current position."); }
+    m_offset = m;
+  }
+
+  /**
+   * @brief Release all allocations.
+   */
+  void reset() noexcept { m_offset = 0; }
+
+  /**
+   * @brief Number of bytes used, including alignment padding.
+   */
+  std::size_t used() const noexcept { return m_offset; }
+
+  /**
+   * @brief Size of the buffer in bytes.
+   */
+  std::size_t capacity() const noexcept { return m_capacity; }
+
+protected:
+  /// @cond
+  struct AlignedDelete
+  {
+    void operator()(std::byte * p) const noexcept { ::operator delete[](p, std::align_val_t{64}); }
+  };
+
+  void * do_allocate(const std::size_t bytes, const std::size_t alignment) override
+  {
+    const auto base  = reinterpret_cast<std::uintptr_t>(m_buffer);
+    const auto start = (base + m_offset + alignment - 1) & ~(std::uintptr_t{alignment} - 1);
+    const std::size_t offset = start - base;
+    if (offset > m_capacity || bytes > m_capacity - offset) { throw std::bad_alloc(); }
+    m_offset = offset + bytes;
+    return m_buffer + offset;
+  }
+
+  void do_deallocate(void *, std::size_t, std::size_t) override {}
+
+  bool do_is_equal(const std::pmr::memory_resource & other) const noexcept override
+  {
+    return this == &other;
+  }
+
+  std::unique_ptr<std::byte[], AlignedDelete> m_owned{};
+  std::byte * m_buffer   = nullptr;
+  std::size_t m_capacity = 0;
+  std::size_t m_offset   = 0;
+  /// @endcond
+};
+
+/**
+ * @brief Standard allocator forwarding to a std::pmr::memory_resource.
+ * @details Unlike std::pmr::polymorphic_allocator the resource propagates when containers are
+ * copied, moved or swapped, so it can be used as the allocator template parameter of classes that
+ * copy their containers, e.g. SynchronizerAllocPolicy or BasicThreadPool. Default constructed
+ * adaptors use std::pmr::get_default_resource().
+ *
+ * Example:
+ * ```
+ * MonotonicArena arena(1 << 20);
+ * std::pmr::synchronized_pool_resource pool(&arena);
+ *
+ * std::vector<int, PmrAdaptor<int>> v(&pool);
+ * BasicThreadPool<PmrAdaptor<std::byte>> workers(4, &pool);
+ * ```
+ *
+ * @tparam T Value type.
+ */
+template<typename T>
+class PmrAdaptor
+{
+public:
+  using value_type                             = T;
+  using propagate_on_container_copy_assignment = std::true_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap            = std::true_type;
+
+  PmrAdaptor() noexcept : m_resource(std::pmr::get_default_resource()) {}
+
+  /**
+   * @brief Construct an adaptor of a resource.
+   *
+   * @param resource Memory resource, must outlive the adaptor and all its copies.
+   */
+  PmrAdaptor(std::pmr::memory_resource * resource) noexcept  // NOLINT
+      : m_resource(resource)
+  {}
+
+  template<typename U>
+  PmrAdaptor(const PmrAdaptor<U> & o) noexcept  // NOLINT
+      : m_resource(o.resource())
+  {}
+
+  T * allocate(const std::size_t n)
+  {
+    if (n > std::numeric_limits<std::size_t>::max() / sizeof(T)) {
+      throw std::bad_array_new_length();
+    }
+    return static_cast<T *>(m_resource->allocate(n * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T * p, const std::size_t n) noexcept
+  {
+    m_resource->deallocate(p, n * sizeof(T), alignof(T));
+  }
+
+  /**
+   * @brief Underlying memory resource.
+   */
+  std::pmr::memory_resource * resource() const noexcept { return m_resource; }
+
+  template<typename U>
+  bool operator==(const PmrAdaptor<U> & o) const noexcept
+  {
+    return m_resource == o.resource() || m_resource->is_equal(*o.resource());
+  }
+
+  template<typename U>
+  bool operator!=(const PmrAdaptor<U> & o) const noexcept
+  {
+    return !(*this == o);
+  }
+
+protected:
+  /// @cond
+  std::pmr::memory_resource * m_resource;
+  /// @endcond
+};
+
+
+/**
+ * @brief Standard allocator returning memory aligned to a given boundary.
+ * @details Typically a cache line, to avoid false sharing and split SIMD loads, or a page.
+ *
+ * Example:
+ * ```
+ * std::vector<float, aligned_allocator<float, 64>> v(1024);  // v.data() is 64 bytes aligned
+ * ```
+ *
+ * @tparam T Value type.
+ * @tparam Align Alignment in bytes, a power of two. Raised to alignof(T) if smaller.
+ */
+template<typename T, std::size_t Align = 64>
+class aligned_allocator
+{
+  static_assert(Align > 0 && (Align & (Align - 1)) == 0, "Alignment must be a power of two.");
+
+public:
+  using value_type                             = T;
+  using propagate_on_container_move_assignment = std::true_type;
+  using is_always_equal                        = std::true_type;
+
+  /// Alignment of the allocations
+  static constexpr std::size_t alignment = std::max(Align, alignof(T));
+
+  template<typename U>
+  struct rebind
+  {
+    using other = aligned_allocator<U, Align>;
+  };
+
+  aligned_allocator() noexcept = default;
+
+  template<typename U>
+  aligned_allocator(const aligned_allocator<U, Align> &) noexcept  // NOLINT
+  {}
+
+  T * allocate(const std::size_t n)
+  {
+    if (n > std::numeric_limits<std::size_t>::max() / sizeof(T)) {
+      throw std::bad_array_new_length();
+    }
+    return static_cast<T *>(::operator new(n * sizeof(T), std::align_val_t{alignment}));
+  }
+
+  void deallocate(T * p, const std::size_t) noexcept
+  {
+    ::operator delete(p, std::align_val_t{alignment});
+  }
+
+  template<typename U>
+  bool operator==(const aligned_allocator<U, Align> &) const noexcept
+  {
+    return true;
+  }
+
+  template<typename U>
+  bool operator!=(const aligned_allocator<U, Align> &) const noexcept
+  {
+    return false;
+  }
+};
+
+/**
+ * @brief Size in bytes of a memory page.
+ */
+inline std::size_t page_size() noexcept
+{
+  static const auto size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+  return size;
+}
+
+/**
+ * @brief Fault in the pages of a writable memory range.
+ * @details Pages of anonymous mappings and heap allocations are only allocated by the kernel on
+ * first write. Prefaulting moves these page faults out of the real-time loop. Content is
+ * preserved.
+ *
+ * @param data Start of the range.
+ * @param size Size of the range in bytes.
+ */
+inline void prefault(void * data, const std::size_t size) noexcept
+{
+  if (size == 0) { return; }
+  const std::size_t page = page_size();
+  const auto begin       = reinterpret_cast<std::uintptr_t>(data) & ~(page - 1);
+  const auto end         = reinterpret_cast<std::uintptr_t>(data) + size;
+
+#ifdef MADV_POPULATE_WRITE
+  // one system call instead of one fault per page (Linux 5.14)
+  if (madvise(reinterpret_cast<void *>(begin), end - begin, MADV_POPULATE_WRITE) == 0) { return; }
+#endif
+
+  // touch every page with a write of its current value
+  auto * first = static_cast<volatile std::byte *>(data);
+  *first       = *first;
+  for (std::uintptr_t a = begin + page; a < end; a += page) {
+    auto * q = reinterpret_cast<volatile std::byte *>(a);
+    *q       = *q;
+  }
+}
+
+/**
+ * @brief Lock a memory range in RAM so that it is never paged out.
+ * @details Throws std::system_error on failure, typically if RLIMIT_MEMLOCK is exceeded.
+ * Locked pages are faulted in.
+ *
+ * @param data Start of the range.
+ * @param size Size of the range in bytes.
+ */
+inline void lock_memory(const void * data, const std::size_t size)
+{
+  if (mlock(data, size) != 0) { throw std::system_error(errno, std::generic_category(), "mlock"); }
+}
+
+/**
+ * @brief Unlock a memory range locked by lock_memory().
+ *
+ * @param data Start of the range.
+ * @param size Size of the range in bytes.
+ */
+inline void unlock_memory(const void * data, const std::size_t size) noexcept
+{
+  munlock(data, size);
+}
+
+/**
+ * @brief Lock all current and future memory of the process in RAM.
+ * @details To be called at the start of real-time processes, after which no memory is paged out
+ * and new allocations are faulted in immediately. Throws std::system_error on failure.
+ */
+inline void lock_all_memory()
+{
+  if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+    throw std::system_error(errno, std::generic_category(), "mlockall");
+  }
+}
+
+/**
+ * @brief Memory buffer backed by huge pages when possible.
+ * @details Large buffers accessed randomly (caches, maps, ring buffers) cause TLB misses with 4 kB
+ * pages. The buffer is allocated from the reserved huge page pool with MAP_HUGETLB, and if the
+ * pool is empty, from normal pages aligned to huge_page_size and marked with MADV_HUGEPAGE so that
+ * transparent huge pages back them when enabled. The memory is zero-initialized.
+ *
+ * Example:
+ * ```
+ * huge_page_buffer buf(1UL << 30);
+ * buf.prefault();  // or buf.lock()
+ * MonotonicArena arena(buf.data(), buf.size());
+ * ```
+ */
+class huge_page_buffer
+{
+public:
+  /// Size of a huge page, the size of buffers is rounded up to a multiple of it
+  static constexpr std::size_t huge_page_size = std::size_t{1} << 21;
+
+  huge_page_buffer(const huge_page_buffer &) = delete;
+  huge_page_buffer & operator=(const huge_page_buffer &) = delete;
+
+  huge_page_buffer() noexcept = default;
+
+  /**
+   * @brief Allocate a buffer.
+   * @details Throws std::bad_alloc if memory can not be mapped.
+   *
+   * @param size Minimal size in bytes.
+   */
+  explicit huge_page_buffer(const std::size_t size)
+  {
+    if (size == 0) { return; }
+    if (size > std::numeric_limits<std::size_t>::max() - 2 * huge_page_size) {
+      throw std::bad_alloc();
+    }
+    m_size = (size + huge_page_size - 1) / huge_page_size * huge_page_size;
+
+#ifdef MAP_HUGETLB
+    void * p = mmap(nullptr, m_size, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p != MAP_FAILED) {
+      m_data = static_cast<std::byte *>(p);
+      m_huge = true;
+      return;
+    }
+#endif
+
+    // over-allocate to align to a huge page, and unmap the excess
+    const std::size_t len = m_size + huge_page_size;
+    void * q = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (q == MAP_FAILED) {
+      m_size = 0;
+      throw std::bad_alloc();
+    }
+    const auto base  = reinterpret_cast<std::uintptr_t>(q);
+    const auto start = (base + huge_page_size - 1) & ~(huge_page_size - 1);
+    if (start > base) { munmap(q, start - base); }
+    if (start + m_size < base + len) {
+      munmap(reinterpret_cast<void *>(start + m_size), base + len - start - m_size);
+    }
+    m_data = reinterpret_cast<std::byte *>(start);
+
+#ifdef MADV_HUGEPAGE
+    madvise(m_data, m_size, MADV_HUGEPAGE);  // may fail if THP is disabled
+#endif
+  }
+
+  huge_page_buffer(huge_page_buffer && o) noexcept
+      : m_data(std::exchange(o.m_data, nullptr)), m_size(std::exchange(o.m_size, 0)),
+        m_huge(std::exchange(o.m_huge, false))
+  {}
+
+  huge_page_buffer & operator=(huge_page_buffer && o) noexcept
+  {
+    if (this != &o) {
+      release();
+      m_data = std::exchange(o.m_data, nullptr);
+      m_size = std::exchange(o.m_size, 0);
+      m_huge = std::exchange(o.m_huge, false);
+    }
+    return *this;
+  }
+
+  ~huge_page_buffer() { release(); }
+
+  /**
+   * @brief Start of the buffer, aligned to huge_page_size.
+   */
+  std::byte * data() noexcept { return m_data; }
+
+  /**
+   * @brief Start of the buffer, aligned to huge_page_size.
+   */
+  const std::byte * data() const noexcept { return m_data; }
+
+  /**
+   * @brief Size of the buffer in bytes.
+   */
+  std::size_t size() const noexcept { return m_size; }
+
+  /**
+   * @brief Check if the buffer is allocated from the reserved huge page pool.
+   * @details If false, the buffer uses transparent huge pages if enabled, else normal pages.
+   */
+  bool huge() const noexcept { return m_huge; }
+
+  /**
+   * @brief Fault in all the pages of the buffer.
+   */
+  void prefault() noexcept { cbr::prefault(m_data, m_size); }
+
+  /**
+   * @brief Lock the buffer in RAM, see lock_memory().
+   */
+  void lock() { lock_memory(m_data, m_size); }
+
+protected:
+  /// @cond
+  void release() noexcept
+  {
+    if (m_data != nullptr) { munmap(m_data, m_size); }
+    m_data = nullptr;
+    m_size = 0;
+    m_huge = false;
+  }
+
+  std::byte * m_data = nullptr;
+  std::size_t m_size = 0;
+  bool m_huge        = false;
+  /// @endcond
+};
+
+}  // namespace cbr
+
+#endif  // CBR_UTILS__ALLOCATORS_HPP_
@@ -0,0 +1,655 @@
+// Copyright Yamaha 2021
+// MIT License
+// https://github.com/yamaha-bps/cbr_utils/blob/master/LICENSE
+
+/** @file */
+
+#ifndef CBR_UTILS__ASYNC_FILE_WRITER_HPP_
+#define CBR_UTILS__ASYNC_FILE_WRITER_HPP_
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define CBR_UTILS_HAS_IO_URING 1
+#else
+#define CBR_UTILS_HAS_IO_URING 0
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace cbr {
+
+/// @cond
+
+namespace detail {
+
+#if CBR_UTILS_HAS_IO_URING
+
+// Minimal io_uring through raw system calls, for a single submitting and reaping thread
+class IoUring
+{
+public:
+  IoUring(const IoUring &) = delete;
+  IoUring(IoUring &&)      = delete;
+  IoUring & operator=(const IoUring &) = delete;
+  IoUring & operator=(IoUring &&) = delete;
+
+  // throws std::system_error if io_uring is not available
+  explicit IoUring(const unsigned entries)
+  {
+    io_uring_params p{};
+    m_fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &p));
+    if (m_fd < 0) { throw std::system_error(errno, std::generic_category(), "io_uring_setup"); }
+
+    m_sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    m_cq_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    const bool single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single) { m_sq_size = m_cq_size = std::max(m_sq_size, m_cq_size); }
+    m_sqes_size = p.sq_entries * sizeof(io_uring_sqe);
+
+    m_sq = map(m_sq_size, IORING_OFF_SQ_RING);
+    m_cq = single ? m_sq : map(m_cq_size, IORING_OFF_CQ_RING);
+    m_sqes = static_cast<io_uring_sqe *>(map(m_sqes_size, IORING_OFF_SQES));
+
+    m_sq_tail  = ptr<unsigned>(m_sq, p.sq_off.tail);
+    m_sq_mask  = *ptr<unsigned>(m_sq, p.sq_off.ring_mask);
+    m_sq_array = ptr<unsigned>(m_sq, p.sq_off.array);
+    m_cq_head  = ptr<unsigned>(m_cq, p.cq_off.head);
+    m_cq_tail  = ptr<unsigned>(m_cq, p.cq_off.tail);
+    m_cq_mask  = *ptr<unsigned>(m_cq, p.cq_off.ring_mask);
+    m_cqes     = ptr<io_uring_cqe>(m_cq, p.cq_off.cqes);
+  }
+
+  ~IoUring() { release(); }
+
+  // the caller never has more writes in flight than entries
+  void submit_writev(
+    const int fd, const iovec * iov, const uint64_t offset, const uint64_t user_data)
+  {
+    const unsigned tail = *m_sq_tail;
+    const unsigned idx  = tail & m_sq_mask;
+    io_uring_sqe & sqe  = m_sqes[idx];
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode    = IORING_OP_WRITEV;
+    sqe.fd        = fd;
+    sqe.addr      = reinterpret_cast<uint64_t>(iov);
+    sqe.len       = 1;
+    sqe.off       = offset;
+    sqe.user_data = user_data;
+    m_sq_array[idx] = idx;
+    __atomic_store_n(m_sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+    while (syscall(__NR_io_uring_enter, m_fd, 1, 0, 0, nullptr, 0) < 0) {
+      if (errno != EINTR) {
+        // nothing was consumed, take the entry back so that it is not submitted later
+        const int err = errno;
+        __atomic_store_n(m_sq_tail, tail, __ATOMIC_RELEASE);
+        throw std::system_error(err, std::generic_category(), "io_uring_enter");
+      }
+    }
+  }
+
+  // call f(user_data, res) for completed writes, wait for at least one if wait is true
+  template<typename F>
+  std::size_t reap(F && f, const bool wait)
+  {
+    std::size_t n = 0;
+    while (true) {
+      unsigned head       = *m_cq_head;
+      const unsigned tail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+      for (; head != tail; ++head, ++n) {
+        const io_uring_cqe & cqe = m_cqes[head & m_cq_mask];
+        f(cqe.user_data, cqe.res);
+      }
+      __atomic_store_n(m_cq_head, head, __ATOMIC_RELEASE);
+      if (n > 0 || !wait) { return n; }
+
+      if (syscall(__NR_io_uring_enter, m_fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0
+          && errno != EINTR) {
+        throw std::system_error(errno, std::generic_category(), "io_uring_enter");
+      }
+    }
+  }
+
+protected:
+  template<typename T>
+  static T * ptr(void * base, const std::size_t offset)
+  {
+    return reinterpret_cast<T *>(static_cast<std::byte *>(base) + offset);
+  }
+
+  void * map(const std::size_t size, const off_t offset)
+  {
+    void * p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, offset);
+    if (p == MAP_FAILED) {
+      const int err = errno;
+      release();
+      throw std::system_error(err, std::generic_category(), "mmap io_uring");
+    }
+    return p;
+  }
+
+  void release() noexcept
+  {
+    if (m_sqes != nullptr) { munmap(m_sqes, m_sqes_size); }
+    if (m_cq != nullptr && m_cq != m_sq) { munmap(m_cq, m_cq_size); }
+    if (m_sq != nullptr) { munmap(m_sq, m_sq_size); }
+    if (m_fd >= 0) { ::close(m_fd); }
+    m_sqes = nullptr;
+    m_cq   = nullptr;
+    m_sq   = nullptr;
+    m_fd   = -1;
+  }
+
+  int m_fd{-1};
+  void * m_sq{nullptr};
+  void * m_cq{nullptr};
+  io_uring_sqe * m_sqes{nullptr};
+  std::size_t m_sq_size{0};
+  std::size_t m_cq_size{0};
+  std::size_t m_sqes_size{0};
+
+  unsigned * m_sq_tail{nullptr};
+  unsigned m_sq_mask{0};
+  unsigned * m_sq_array{nullptr};
+  unsigned * m_cq_head{nullptr};
+  unsigned * m_cq_tail{nullptr};
+  unsigned m_cq_mask{0};
+  io_uring_cqe * m_cqes{nullptr};
+};
+
+#endif
+
+}  // namespace detail
+
+/// @endcond
+
+/**
+ * @brief Options of an AsyncFileWriter.
+ */
+struct AsyncFileWriterOptions
+{
+  /// Size in bytes of a buffer, rounded up to a multiple of 4096, writes are this large
+  std::size_t buffer_size = 1UL << 20;
+  /// Number of buffers, i.e. maximal number of writes in flight plus the one being filled
+  std::size_t n_buffers = 8;
+  /// Open the file with O_DIRECT to bypass the page cache
+  bool direct = false;
+  /// Use io_uring if available, else a background thread calling pwrite()
+  bool io_uring = true;
+};
+
+/**
+ * @brief Append-only file writer that never waits for the disk while it has free buffers.
+ * @details Data is copied into large aligned buffers, and full buffers are written
+ * asynchronously, through io_uring when the kernel allows it, else by a background thread
+ * calling pwrite(). The number of buffers bounds the memory and the number of writes in flight:
+ * write() only waits when all buffers are in flight, and try_write() returns false instead.
+ *
+ * With O_DIRECT, writes bypass the page cache, so that writing a large recording does not evict
+ * other data from it, nor triggers the page cache writeback that stalls write() calls. The file
+ * is padded to a multiple of 4096 bytes while open, and truncated to its size on close(). The
+ * unaligned remainder of a short write is written through a second descriptor without O_DIRECT.
+ *
+ * Example:
+ * ```
+ * AsyncFileWriter file("data.bin");
+ * file.write(&value, sizeof(value));
+ *
+ * if (!file.try_write(buf.data(), buf.size())) { ++dropped; }  // never waits
+ * ```
+ * Notes:
+ * - Not thread safe, a single thread writes.
+ * - Write errors are reported by the next call to write(), try_write(), flush() or close().
+ */
+class AsyncFileWriter
+{
+public:
+  AsyncFileWriter(const AsyncFileWriter &) = delete;
+  AsyncFileWriter(AsyncFileWriter &&)      = delete;
+  AsyncFileWriter & operator=(const AsyncFileWriter &) = delete;
+  AsyncFileWriter & operator=(AsyncFileWriter &&) = delete;
+
+  /**
+   * @brief Create (or truncate) a file for writing.
+   *
+   * @param path Path of the file.
+   * @param opts Buffers and backend options.
+   */
+  explicit AsyncFileWriter(const std::string & path, const AsyncFileWriterOptions & opts = {})
+      : m_direct(opts.direct)
+  {
+    const std::size_t buffer_size = (std::max<std::size_t>(opts.buffer_size, 1) + align - 1)
+                                  / align * align;
+    if (opts.n_buffers == 0) {
+      throw std::invalid_argument("AsyncFileWriter needs at least one buffer.");
+    }
+
+    const int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC | (opts.direct ? O_DIRECT : 0);
+    m_fd            = ::open(path.c_str(), flags, 0644);
+    if (m_fd < 0) { throw std::system_error(errno, std::generic_category(), "open " + path); }
+    m_buffered_fd = m_fd;
+
+    try {
+      if (opts.direct) {
+        m_buffered_fd = ::open(path.c_str(), O_WRONLY | O_CLOEXEC);
+        if (m_buffered_fd < 0) {
+          throw std::system_error(errno, std::generic_category(), "open " + path);
+        }
+      }
+      m_buffers.resize(opts.n_buffers);
+      for (std::size_t i = 0; i < m_buffers.size(); ++i) {
+        m_buffers[i].data =
+          static_cast<std::byte *>(::operator new(buffer_size, std::align_val_t{align}));
+        m_buffers[i].capacity = buffer_size;
+        m_free.push_back(i);
+      }
+
+#if CBR_UTILS_HAS_IO_URING
+      if (opts.io_uring) {
+        try {
+          m_ring = std::make_unique<detail::IoUring>(static_cast<unsigned>(opts.n_buffers));
+        } catch (const std::system_error &) {
+          m_ring = nullptr;  // e.g. disabled by seccomp, use the thread
+        }
+      }
+#endif
+      if (!uses_io_uring()) { m_thread = std::thread([this] { run(); }); }
+    } catch (...) {
+      release();
+      throw;
+    }
+  }
+
+  ~AsyncFileWriter()
+  {
+    try {
+      close();
+    } catch (...) {
+      release();
+    }
+  }
+
+  /**
+   * @brief Append bytes to the file.
+   * @details Waits for a write to complete if all buffers are in flight.
+   *
+   * @param data Pointer to the data.
+   * @param n Number of bytes.
+   */
+  void write(const void * data, std::size_t n)
+  {
+    check();
+    const auto * src = static_cast<const std::byte *>(data);
+    m_size += n;
+    while (n > 0) {
+      if (m_cur == npos) { acquire(); }
+      Buffer & buf        = m_buffers[m_cur];
+      const std::size_t k = std::min(n, buf.capacity - m_fill);
+      std::memcpy(buf.data + m_fill, src, k);
+      m_fill += k;
+      src += k;
+      n -= k;
+      if (m_fill == buf.capacity) { submit(m_fill, m_fill); }
+    }
+  }
+
+  /**
+   * @brief Append bytes to the file if it does not require waiting.
+   *
+   * @param data Pointer to the data.
+   * @param n Number of bytes.
+   * @return True if the bytes were appended, false if all buffers are in flight.
+   */
+  bool try_write(const void * data, const std::size_t n)
+  {
+    check();
+    const std::size_t buffer_size = m_buffers.front().capacity;
+    const std::size_t space       = m_cur == npos ? 0 : buffer_size - m_fill;
+    if (n > space) {
+      // buffers needed, the last one must also be free to keep accepting data
+      const std::size_t needed = (n - space) / buffer_size + 1;
+      if (m_free.size() < needed) { reap(false); }
+      if (m_free.size() < needed) { return false; }
+    }
+    write(data, n);
+    return true;
+  }
+
+  /**
+   * @brief Write the buffered data and wait for all writes to complete.
+   * @details With O_DIRECT the last partial block is written padded with zeros, and rewritten
+   * by the next writes.
+   */
+  void flush()
+  {
+    check();
+    if (m_cur != npos && m_fill > 0) {
+      const std::size_t len  = m_fill;
+      const std::size_t tail = m_direct ? len % align : 0;
+      if (tail > 0) { std::memset(m_buffers[m_cur].data + len, 0, align - tail); }
+      const std::size_t old = m_cur;
+      submit(len + (tail > 0 ? align - tail : 0), len - tail);
+      wait_all();
+      if (tail > 0) {
+        acquire();
+        std::memmove(m_buffers[m_cur].data, m_buffers[old].data + len - tail, tail);
+        m_fill = tail;
+      }
+    } else {
+      wait_all();
+    }
+    check();
+  }
+
+  /**
+   * @brief Flush and close the file.
+   */
+  void close()
+  {
+    if (m_fd < 0) { return; }
+    flush();
+    if (m_direct) {
+      if (ftruncate(m_fd, static_cast<off_t>(m_size)) != 0) {
+        const int err = errno;
+        release();
+        throw std::system_error(err, std::generic_category(), "ftruncate");
+      }
+    }
+    release();
+  }
+
+  /**
+   * @brief Check if file is open.
+   */
+  bool is_open() const noexcept { return m_fd >= 0; }
+
+  /**
+   * @brief Number of bytes written so far.
+   */
+  std::size_t size() const noexcept { return m_size; }
+
+  /**
+   * @brief Check if writes go through io_uring rather than a background thread.
+   */
+  bool uses_io_uring() const noexcept
+  {
+#if CBR_UTILS_HAS_IO_URING
+    return m_ring != nullptr;
+#else
+    return false;
+#endif
+  }
+
+  /**
+   * @brief Number of times write() waited for a buffer.
+   */
+  std::size_t stalls() const noexcept { return m_stalls; }
+
+protected:
+  /// @cond
+  static constexpr std::size_t align = 4096;
+  static constexpr std::size_t npos  = std::numeric_limits<std::size_t>::max();
+
+  struct Buffer
+  {
+    std::byte * data{nullptr};
+    std::size_t capacity{0};
+    std::size_t len{0};
+    uint64_t offset{0};
+    iovec iov{};
+  };
+
+  void check()
+  {
+    if (m_fd < 0) { throw std::logic_error("AsyncFileWriter is closed."); }
+    if (m_error != 0) { throw std::system_error(m_error, std::generic_category(), "write"); }
+  }
+
+  // write len bytes of the current buffer at the current offset, then advance it by advance
+  void submit(const std::size_t len, const std::size_t advance)
+  {
+    const std::size_t idx = std::exchange(m_cur, npos);
+    Buffer & buf          = m_buffers[idx];
+    buf.len               = len;
+    buf.offset            = m_offset;
+    buf.iov               = iovec{buf.data, len};
+    m_offset += advance;
+    ++m_in_flight;
+
+    try {
+#if CBR_UTILS_HAS_IO_URING
+      if (m_ring) {
+        m_ring->submit_writev(m_fd, &buf.iov, buf.offset, idx);
+        return;
+      }
+#endif
+      std::scoped_lock lock(m_mtx);
+      m_pending.push_back(idx);
+    } catch (...) {
+      // the data of the buffer is lost, fail like a write so that the file is not left with a hole
+      --m_in_flight;
+      m_free.push_back(idx);
+      m_error = EIO;
+      throw;
+    }
+    m_cv.notify_all();
+  }
+
+  void acquire()
+  {
+    if (m_free.empty()) { reap(false); }
+    if (m_free.empty()) { ++m_stalls; }
+    while (m_free.empty()) { reap(true); }
+    m_cur = m_free.back();
+    m_free.pop_back();
+    m_fill = 0;
+  }
+
+  void wait_all()
+  {
+    while (m_in_flight > 0) { reap(true); }
+  }
+
+  // move completed buffers to the free list
+  void reap(const bool wait)
+  {
+#if CBR_UTILS_HAS_IO_URING
+    if (m_ring) {
+      m_ring->reap(
+        [this](const uint64_t idx, const int res) { complete(static_cast<std::size_t>(idx), res); },
+        wait);
+      return;
+    }
+#endif
+    std::unique_lock lock(m_mtx);
+    if (wait) { m_cv.wait(lock, [this] { return !m_done.empty(); }); }
+    for (const auto & [idx, res] : m_done) { complete(idx, res); }
+    m_done.clear();
+  }
+
+  void complete(const std::size_t idx, const int res)
+  {
+    Buffer & buf = m_buffers[idx];
+    if (res < 0) {
+      m_error = -res;
+    } else if (static_cast<std::size_t>(res) < buf.len) {
+      // short write, finish it synchronously
+      if (!write_all(m_buffered_fd, buf.data + res, buf.len - static_cast<std::size_t>(res),
+            buf.offset + static_cast<uint64_t>(res))) {
+        m_error = errno;
+      }
+    }
+    --m_in_flight;
+    m_free.push_back(idx);
+  }
+
+  // the remainder of a short write is not aligned for O_DIRECT, it goes through m_buffered_fd
+  bool write_all(int fd, const std::byte * data, std::size_t n, uint64_t offset) const noexcept
+  {
+    while (n > 0) {
+      const ssize_t r = pwrite(fd, data, n, static_cast<off_t>(offset));
+      if (r < 0) {
+        if (errno == EINTR) { continue; }
+        return false;
+      }
+      data += r;
+      n -= static_cast<std::size_t>(r);
+      offset += static_cast<uint64_t>(r);
+      fd = m_buffered_fd;
+    }
+    return true;
+  }
+
+  // background thread of the fallback backend
+  void run()
+  {
+    std::unique_lock lock(m_mtx);
+    while (true) {
+      m_cv.wait(lock, [this] { return m_stop || !m_pending.empty(); });
+      if (m_pending.empty()) { return; }
+      const std::size_t idx = m_pending.front();
+      m_pending.pop_front();
+      lock.unlock();
+
+      const Buffer & buf = m_buffers[idx];
+      const int res      = write_all(m_fd, buf.data, buf.len, buf.offset)
+                           ? static_cast<int>(buf.len)
+                           : -errno;
+
+      lock.lock();
+      m_done.emplace_back(idx, res);
+      m_cv.notify_all();
+    }
+  }
+
+  void release() noexcept
+  {
+    if (m_thread.joinable()) {
+      {
+        std::scoped_lock lock(m_mtx);
+        m_stop = true;
+      }
+      m_cv.notify_all();
+      m_thread.join();
+    }
+#if CBR_UTILS_HAS_IO_URING
+    if (m_ring) {
+      // the kernel may still write from the buffers
+      try {
+        while (m_in_flight > 0) { reap(true); }
+      } catch (...) {
+      }
+      m_ring = nullptr;
+    }
+#endif
+    for (auto & buf : m_buffers) {
+      ::operator delete(buf.data, std::align_val_t{align});
+      buf.data = nullptr;
+    }
+    m_buffers.clear();
+    if (m_buffered_fd >= 0 && m_buffered_fd != m_fd) { ::close(m_buffered_fd); }
+    m_buffered_fd = -1;
+    if (m_fd >= 0) {
+      ::close(m_fd);
+      m_fd = -1;
+    }
+  }
+
+  int m_fd{-1};
+  // same file without O_DIRECT, or m_fd if not direct
+  int m_buffered_fd{-1};
+  bool m_direct;
+  std::size_t m_size{0};
+  uint64_t m_offset{0};
+  int m_error{0};
+  std::size_t m_stalls{0};
+
+  std::vector<Buffer> m_buffers{};
+  std::vector<std::size_t> m_free{};
+  std::size_t m_cur{npos};
+  std::size_t m_fill{0};
+  std::size_t m_in_flight{0};
+
+#if CBR_UTILS_HAS_IO_URING
+  std::unique_ptr<detail::IoUring> m_ring{};
+#endif
+
+  // fallback backend
+  std::thread m_thread{};
+  std::mutex m_mtx{};
+  std::condition_variable m_cv{};
+  std::deque<std::size_t> m_pending{};
+  std::vector<std::pair<std::size_t, int>> m_done{};
+  bool m_stop{false};
+  /// @endcond
+};
+
+/**
+ * @brief std::streambuf writing to an AsyncFileWriter.
+ * @details Lets std::ostream users, e.g. AsyncLogger, write through an AsyncFileWriter.
+ *
+ * Example:
+ * ```
+ * AsyncFileWriter file("log.txt");
+ * AsyncFileStreambuf buf(file);
+ * std::ostream os(&buf);
+ * AsyncLogger logger(os);
+ * ```
+ */
+class AsyncFileStreambuf : public std::streambuf
+{
+public:
+  explicit AsyncFileStreambuf(AsyncFileWriter & file) : m_file(file) {}
+
+protected:
+  /// @cond
+  int_type overflow(const int_type c) override
+  {
+    if (traits_type::eq_int_type(c, traits_type::eof())) { return traits_type::not_eof(c); }
+    const char ch = traits_type::to_char_type(c);
+    m_file.write(&ch, 1);
+    return c;
+  }
+
+  std::streamsize xsputn(const char * s, const std::streamsize n) override
+  {
+    m_file.write(s, static_cast<std::size_t>(n));
+    return n;
+  }
+
+  int sync() override
+  {
+    m_file.flush();
+    return 0;
+  }
+
+  AsyncFileWriter & m_file;
+  /// @endcond
+};
+
+}  // namespace cbr
+
+#endif  // CBR_UTILS__ASYNC_FILE_WRITER_HPP_
@@ -0,0 +1,827 @@
+// Copyright Yamaha 2021
+// MIT License
+// https://github.com/yamaha-bps/cbr_utils/blob/master/LICENSE
+
+/** @file */
+
+#ifndef CBR_UTILS__ASYNC_LOGGER_HPP_
+#define CBR_UTILS__ASYNC_LOGGER_HPP_
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "cyber_enum.hpp"
+#include "type_traits.hpp"
+#include "utils.hpp"
+
+namespace cbr {
+
+/**
+ * @brief Severity of a log message.
+ */
+struct LogLevel : CyberEnum<LogLevel>
+{
+  using this_t::CyberEnum;
+  using this_t::operator=;
+
+  static constexpr int debug = 0;
+  static constexpr int info  = 1;
+  static constexpr int warn  = 2;
+  static constexpr int error = 3;
+
+  static constexpr std::array values = {0, 1, 2, 3};
+  static constexpr std::array names  = {"debug", "info", "warn", "error"};
+};
+
+/// @cond
+
+namespace detail {
+
+/**
+ * @brief Single producer single consumer ring buffer of variable size records.
+ * @details Records are contiguous and 8 bytes aligned. A record that does not fit before the end
+ * of the buffer is preceded by a padding record filling the end of the buffer. Head and tail are
+ * monotonic byte counters.
+ */
+class LogRing
+{
+public:
+  static constexpr uint64_t padding_flag = uint64_t{1} << 63;
+
+  explicit LogRing(const std::size_t capacity)
+  {
+    std::size_t n = 64;
+    while (n < capacity) { n <<= 1; }
+    m_buf.resize(n);
+    m_mask = n - 1;
+  }
+
+  // Producer: returns a pointer to n contiguous bytes, or nullptr if the ring is full.
+  std::byte * reserve(const std::size_t n) noexcept
+  {
+    const std::size_t head       = m_head.load(std::memory_order_relaxed);
+    const std::size_t offset     = head & m_mask;
+    const std::size_t contiguous = m_buf.size() - offset;
+    const std::size_t need       = contiguous < n ? contiguous + n : n;
+
+    if (need > m_buf.size() - (head - m_tail_cache)) {
+      m_tail_cache = m_tail.load(std::memory_order_acquire);
+      if (need > m_buf.size() - (head - m_tail_cache)) {
+        // single writer, no need for an atomic increment
+        m_dropped.store(m_dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return nullptr;
+      }
+    }
+
+    if (contiguous < n) {
+      const uint64_t pad = padding_flag | contiguous;
+      std::memcpy(m_buf.data() + offset, &pad, sizeof(pad));
+      m_pending = head + contiguous + n;
+      return m_buf.data();
+    }
+    m_pending = head + n;
+    return m_buf.data() + offset;
+  }
+
+  // Producer: publish the record returned by the latest reserve().
+  void commit() noexcept { m_head.store(m_pending, std::memory_order_release); }
+
+  // Consumer: call f(record) for all published records, return the number of records.
+  template<typename F>
+  std::size_t consume(F && f)
+  {
+    std::size_t tail       = m_tail.load(std::memory_order_relaxed);
+    const std::size_t head = m_head.load(std::memory_order_acquire);
+    std::size_t count      = 0;
+    while (tail != head) {
+      const std::byte * p = m_buf.data() + (tail & m_mask);
+      uint64_t size       = 0;
+      std::memcpy(&size, p, sizeof(size));
+      if ((size & padding_flag) == 0) {
+        f(p);
+        ++count;
+      }
+      tail += static_cast<std::size_t>(size & ~padding_flag);
+    }
+    m_tail.store(tail, std::memory_order_release);
+    return count;
+  }
+
+  bool empty() const noexcept
+  {
+    return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_relaxed);
+  }
+
+  std::size_t capacity() const noexcept { return m_buf.size(); }
+
+  std::size_t dropped() const noexcept { return m_dropped.load(std::memory_order_relaxed); }
+
+protected:
+  // producer side
+  alignas(64) std::atomic<std::size_t> m_head{0};
+  std::size_t m_tail_cache = 0;
+  std::size_t m_pending    = 0;
+  std::atomic<std::size_t> m_dropped{0};
+
+  // consumer side
+  alignas(64) std::atomic<std::size_t> m_tail{0};
+
+  std::vector<std::byte> m_buf{};
+  std::size_t m_mask = 0;
+};
+
+using log_decode_fn_t = void (*)(const char *, const std::byte *, std::string &);
+
+struct LogRecordHeader
+{
+  uint64_t size;
+  int64_t stamp;  // see LogTicks
+  uint32_t format;
+  int32_t level;
+};
+
+/**
+ * @brief Raw timestamps of the logging threads.
+ * @details The time stamp counter on x86, steady_clock nanoseconds otherwise. Converted to system
+ * time by LogTickConverter on the background thread.
+ */
+struct LogTicks
+{
+  static int64_t now() noexcept
+  {
+#if defined(__x86_64__) || defined(__i386__)
+    return static_cast<int64_t>(__rdtsc());
+#else
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+  }
+};
+
+/**
+ * @brief Conversion of LogTicks to system time.
+ * @details The tick period is estimated between construction and the latest call to update(), and
+ * ticks are converted relatively to the latest update() so that the estimation error only applies
+ * to the short time between a message and the drain that formats it.
+ */
+class LogTickConverter
+{
+public:
+  LogTickConverter() noexcept : m_ticks0(LogTicks::now()), m_ns0(system_ns())
+  {
+    m_ticks1 = m_ticks0;
+    m_ns1    = m_ns0;
+  }
+
+  void update() noexcept
+  {
+    m_ticks1 = LogTicks::now();
+    m_ns1    = system_ns();
+    if (m_ticks1 > m_ticks0 && m_ns1 > m_ns0) {
+      m_ns_per_tick = static_cast<double>(m_ns1 - m_ns0) / static_cast<double>(m_ticks1 - m_ticks0);
+    }
+  }
+
+  int64_t to_ns(const int64_t ticks) const noexcept
+  {
+    return m_ns1 + std::llround(static_cast<double>(ticks - m_ticks1) * m_ns_per_tick);
+  }
+
+protected:
+  static int64_t system_ns() noexcept
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::system_clock::now().time_since_epoch())
+      .count();
+  }
+
+  int64_t m_ticks0     = 0;
+  int64_t m_ns0        = 0;
+  int64_t m_ticks1     = 0;
+  int64_t m_ns1        = 0;
+  double m_ns_per_tick = 1.;
+};
+
+/**
+ * @brief Process wide registry of message formats.
+ * @details Formats are identified by their content and argument types, so that identical format
+ * strings share an ID whether or not the compiler merged the literals. Logging threads look IDs up
+ * in a thread local cache and only lock on the first use of a format string.
+ */
+class LogFormatRegistry
+{
+public:
+  struct Format
+  {
+    std::string fmt;
+    log_decode_fn_t decode;
+  };
+
+  static LogFormatRegistry & instance()
+  {
+    static LogFormatRegistry registry;
+    return registry;
+  }
+
+  uint32_t intern(const char * fmt, const log_decode_fn_t decode)
+  {
+    std::scoped_lock lock(m_mtx);
+    auto & ids = m_ids[decode];
+    if (auto it = ids.find(fmt); it != ids.end()) { return it->second; }
+    const auto id = static_cast<uint32_t>(m_formats.size());
+    m_formats.push_back(Format{fmt, decode});
+    ids.emplace(m_formats.back().fmt, id);
+    return id;
+  }
+
+  // Append the formats registered after the first from.size() ones
+  void update(std::vector<const Format *> & from) const
+  {
+    std::scoped_lock lock(m_mtx);
+    for (std::size_t i = from.size(); i < m_formats.size(); ++i) { from.push_back(&m_formats[i]); }
+  }
+
+protected:
+  mutable std::mutex m_mtx;
+  std::deque<Format> m_formats{};
+  std::unordered_map<log_decode_fn_t, std::unordered_map<std::string_view, uint32_t>> m_ids{};
+};
+
+/**
+ * @brief Thread local direct mapped cache of format IDs.
+ */
+class LogFormatCache
+{
+public:
+  static uint32_t get(const char * fmt, const log_decode_fn_t decode)
+  {
+    thread_local std::array<Entry, 256> cache{};
+    const auto h = (reinterpret_cast<std::uintptr_t>(fmt) >> 3)
+                 ^ (reinterpret_cast<std::uintptr_t>(decode) >> 4);
+    auto & e = cache[h & 255];
+    if (e.fmt != fmt || e.decode != decode) {
+      e = Entry{fmt, decode, LogFormatRegistry::instance().intern(fmt, decode)};
+    }
+    return e.id;
+  }
+
+protected:
+  struct Entry
+  {
+    const char * fmt       = nullptr;
+    log_decode_fn_t decode = nullptr;
+    uint32_t id            = 0;
+  };
+};
+
+// Arguments convertible to a string view are copied as a length prefixed string
+struct LogString
+{};
+
+template<typename T>
+using log_arg_t = std::conditional_t<std::is_convertible_v<const T &, std::string_view>,
+  LogString,
+  std::decay_t<T>>;
+
+template<typename T, typename = void>
+struct is_log_streamable : std::false_type
+{};
+
+template<typename T>
+struct is_log_streamable<T,
+  std::void_t<decltype(std::declval<std::ostream &>() << std::declval<const T &>())>>
+    : std::true_type
+{};
+
+template<typename T>
+std::string_view log_string_view(const T & v) noexcept
+{
+  if constexpr (std::is_pointer_v<T>) {
+    if (v == nullptr) { return {}; }
+  }
+  return std::string_view(v);
+}
+
+template<typename T>
+std::size_t log_arg_size(const T & v) noexcept
+{
+  if constexpr (std::is_same_v<log_arg_t<T>, LogString>) {
+    return sizeof(uint32_t) + log_string_view(v).size();
+  } else {
+    return sizeof(log_arg_t<T>);
+  }
+}
+
+template<typename T>
+std::byte * log_arg_encode(std::byte * p, const T & v) noexcept
+{
+  if constexpr (std::is_same_v<log_arg_t<T>, LogString>) {
+    const std::string_view s = log_string_view(v);
+    const auto n             = static_cast<uint32_t>(s.size());
+    std::memcpy(p, &n, sizeof(n));
+    std::memcpy(p + sizeof(n), s.data(), s.size());
+    return p + sizeof(n) + s.size();
+  } else {
+    static_assert(std::is_trivially_copyable_v<log_arg_t<T>>,
+      "Log arguments must be strings or trivially copyable.");
+    const log_arg_t<T> copy(v);
+    std::memcpy(p, &copy, sizeof(copy));
+    return p + sizeof(copy);
+  }
+}
+
+template<typename T>
+void log_arg_format(std::string & out, const T & v)
+{
+  if constexpr (std::is_same_v<T, bool>) {
+    out += v ? "true" : "false";
+  } else if constexpr (std::is_same_v<T, char>) {
+    out += v;
+  } else if constexpr (std::is_integral_v<T>) {
+    std::array<char, 24> buf{};
+    const auto res = std::to_chars(buf.data(), buf.data() + buf.size(), v);
+    out.append(buf.data(), res.ptr);
+  } else if constexpr (std::is_floating_point_v<T>) {
+    std::array<char, 32> buf{};
+    const int n = std::snprintf(buf.data(), buf.size(), "%.9g", static_cast<double>(v));
+    out.append(buf.data(), static_cast<std::size_t>(std::max(n, 0)));
+  } else if constexpr (is_cyber_enum_v<T>) {
+    const char * name = v.c_str();
+    out += name != nullptr ? name : "invalid";
+  } else if constexpr (std::is_enum_v<T>) {
+    log_arg_format(out, static_cast<std::underlying_type_t<T>>(v));
+  } else if constexpr (is_chrono_duration_v<T>) {
+    using period = typename T::period;
+    if constexpr (std::is_same_v<period, std::nano>) {
+      log_arg_format(out, v.count());
+      out += "ns";
+    } else if constexpr (std::is_same_v<period, std::micro>) {
+      log_arg_format(out, v.count());
+      out += "us";
+    } else if constexpr (std::is_same_v<period, std::milli>) {
+      log_arg_format(out, v.count());
+      out += "ms";
+    } else {
+      const auto [value, unit] = formatDuration(std::chrono::duration<double>(v).count());
+      log_arg_format(out, value);
+      out += unit;
+    }
+  } else if constexpr (is_log_streamable<T>::value) {
+    std::ostringstream ss;
+    ss << v;
+    out += ss.str();
+  } else {
+    out += '<';
+    out += type_name<T>();
+    out += '>';
+  }
+}
+
+// Append the format string up to the next placeholder, return false if there is none
+inline bool log_next_placeholder(std::string_view & fmt, std::string & out)
+{
+  const auto pos = fmt.find("{}");
+  if (pos == std::string_view::npos) {
+    out += fmt;
+    fmt = {};
+    return false;
+  }
+  out += fmt.substr(0, pos);
+  fmt.remove_prefix(pos + 2);
+  return true;
+}
+
+template<typename T>
+const std::byte * log_arg_decode(const std::byte * p, std::string_view & fmt, std::string & out)
+{
+  if (!log_next_placeholder(fmt, out)) { out += ' '; }
+  if constexpr (std::is_same_v<T, LogString>) {
+    uint32_t n = 0;
+    std::memcpy(&n, p, sizeof(n));
+    out.append(reinterpret_cast<const char *>(p + sizeof(n)), n);
+    return p + sizeof(n) + n;
+  } else {
+    alignas(T) std::array<std::byte, sizeof(T)> storage;
+    std::memcpy(storage.data(), p, sizeof(T));
+    log_arg_format(out, *std::launder(reinterpret_cast<const T *>(storage.data())));
+    return p + sizeof(T);
+  }
+}
+
+template<typename... Ts>
+void log_decode(const char * fmt, [[maybe_unused]] const std::byte * p, std::string & out)
+{
+  std::string_view f(fmt);
+  ((p = log_arg_decode<Ts>(p, f, out)), ...);
+  out += f;
+}
+
+/**
+ * @brief Date formatter caching the dateStr() of the current second.
+ * @details Appends the nanoseconds padded to 9 digits, so that all dates have the same length.
+ */
+class LogDateFormatter
+{
+public:
+  void append(std::string & out, const int64_t ns)
+  {
+    int64_t sec  = ns / 1000000000;
+    int64_t frac = ns % 1000000000;
+    if (frac < 0) {
+      frac += 1000000000;
+      --sec;
+    }
+    if (sec != m_sec || m_prefix.empty()) {
+      m_prefix = dateStr(std::chrono::system_clock::time_point(std::chrono::seconds(sec)));
+      m_sec    = sec;
+    }
+    out += m_prefix;
+
+    std::array<char, 10> digits{'.', '0', '0', '0', '0', '0', '0', '0', '0', '0'};
+    for (std::size_t i = 9; i > 0 && frac > 0; --i) {
+      digits[i] = static_cast<char>('0' + frac % 10);
+      frac /= 10;
+    }
+    out.append(digits.data(), digits.size());
+  }
+
+protected:
+  std::string m_prefix{};
+  int64_t m_sec = 0;
+};
+
+// Per-thread rings of all loggers, keyed by unique logger id
+struct LogRingCache
+{
+  uint64_t id   = 0;
+  LogRing * ring = nullptr;
+  std::vector<std::pair<uint64_t, std::shared_ptr<LogRing>>> rings{};
+};
+
+}  // namespace detail
+
+/// @endcond
+
+/**
+ * @brief AsyncLogger options.
+ */
+struct AsyncLoggerOptions
+{
+  /// Size of the ring of each logging thread, in bytes
+  std::size_t ring_size = std::size_t{1} << 16;
+  /// Period of the background thread
+  std::chrono::nanoseconds period = std::chrono::milliseconds(10);
+  /// Size of the output batches, in bytes
+  std::size_t batch_size = std::size_t{1} << 16;
+};
+
+/**
+ * @brief Asynchronous logger with deferred formatting.
+ * @details The logging thread only copies a format ID, a raw timestamp (the time stamp counter on
+ * x86) and the arguments into a lock-free ring owned by the thread. A background thread
+ * periodically drains the rings of all threads, merges the messages by timestamp, converts the
+ * timestamps to system time, formats the messages and writes them to the output stream in large
+ * batches.
+ *
+ * Format IDs are assigned by content the first time a thread uses a format string, which is the
+ * only time the logging thread locks.
+ *
+ * Messages are formatted as `<date> [<level>] <message>`, where the date uses the same format as
+ * dateStr() with nanoseconds padded to 9 digits, and each `{}` of the format string is replaced by
+ * the next argument. Supported arguments are:
+ * - strings (std::string, std::string_view, const char *), copied on the logging thread,
+ * - CyberEnum, printed by name,
+ * - arithmetic types, enums and chrono durations (units of a second and more as formatDuration()),
+ * - other trivially copyable types, printed with operator<< if available or with type_name().
+ *
+ * Example:
+ * ```
+ * AsyncLogger logger(std::cout);
+ * logger.info("loop {} took {}", i, timer.get_latest());
+ * logger.log(LogLevel::warn, "mode {}", mode);  // mode is a CyberEnum
+ * ```
+ * Notes:
+ * - The format string must have static storage duration, e.g. a string literal, since it is
+ *   formatted after the call returns.
+ * - If the ring of a thread is full the message is dropped, the logging thread never blocks. See
+ *   dropped_count().
+ * - The output stream is only accessed by the background thread.
+ */
+class AsyncLogger
+{
+public:
+  using Options = AsyncLoggerOptions;
+
+  AsyncLogger(const AsyncLogger &) = delete;
+  AsyncLogger(AsyncLogger &&)      = delete;
+  AsyncLogger & operator=(const AsyncLogger &) = delete;
+  AsyncLogger & operator=(AsyncLogger &&) = delete;
+
+  /**
+   * @brief Start the background thread.
+   *
+   * @param os Output stream, must outlive the logger.
+   * @param opts Options.
+   */
+  explicit AsyncLogger(std::ostream & os, const Options & opts = Options{})
+      : m_os(os), m_opts(opts)
+  {
+    m_thread = std::thread([this] { run(); });
+  }
+
+  /**
+   * @brief Write all pending messages and stop the background thread.
+   */
+  ~AsyncLogger()
+  {
+    {
+      std::scoped_lock lock(m_mtx);
+      m_stop = true;
+    }
+    m_cv.notify_all();
+    m_thread.join();
+  }
+
+  /**
+   * @brief Log a message.
+   * @details Does not block, does not allocate except on the first call of a thread and the first
+   * use of a format string by a thread.
+   *
+   * @param level Severity of the message.
+   * @param fmt Format string with static storage duration.
+   * @param args Arguments replacing the `{}` of the format string.
+   * @return Returns false if the message was filtered out or dropped.
+   */
+  template<std::size_t N, typename... Args>
+  bool log(const LogLevel level, const char (&fmt)[N], const Args &... args)
+  {
+    if (level.get() < m_level.load(std::memory_order_relaxed)) { return false; }
+
+    const int64_t stamp = detail::LogTicks::now();
+
+    const std::size_t size =
+      (sizeof(detail::LogRecordHeader) + (std::size_t{0} + ... + detail::log_arg_size(args)) + 7)
+      & ~std::size_t{7};
+
+    detail::LogRing & r = ring();
+    std::byte * p       = r.reserve(size);
+    if (p == nullptr) { return false; }
+
+    const uint32_t format = detail::LogFormatCache::get(
+      static_cast<const char *>(fmt), &detail::log_decode<detail::log_arg_t<Args>...>);
+    const detail::LogRecordHeader header{size, stamp, format, static_cast<int32_t>(level.get())};
+    std::memcpy(p, &header, sizeof(header));
+    p += sizeof(header);
+    ((p = detail::log_arg_encode(p, args)), ...);
+    r.commit();
+    return true;
+  }
+
+  /**
+   * @brief Log a debug message, see log().
+   */
+  template<std::size_t N, typename... Args>
+  bool debug(const char (&fmt)[N], const Args &... args)
+  {
+    return log(LogLevel::debug, fmt, args...);
+  }
+
+  /**
+   * @brief Log an info message, see log().
+   */
+  template<std::size_t N, typename... Args>
+  bool info(const char (&fmt)[N], const Args &... args)
+  {
+    return log(LogLevel::info, fmt, args...);
+  }
+
+  /**
+   * @brief Log a warning message, see log().
+   */
+  template<std::size_t N, typename... Args>
+  bool warn(const char (&fmt)[N], const Args &... args)
+  {
+    return log(LogLevel::warn, fmt, args...);
+  }
+
+  /**
+   * @brief Log an error message, see log().
+   */
+  template<std::size_t N, typename... Args>
+  bool error(const char (&fmt)[N], const Args &... args)
+  {
+    return log(LogLevel::error, fmt, args...);
+  }
+
+  /**
+   * @brief Set the minimal level of logged messages (default: debug).
+   */
+  void set_level(const LogLevel level) noexcept
+  {
+    m_level.store(level.get(), std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Get the minimal level of logged messages.
+   */
+  LogLevel get_level() const noexcept { return LogLevel(m_level.load(std::memory_order_relaxed)); }
+
+  /**
+   * @brief Block until all messages logged before the call are written to the output stream.
+   */
+  void flush()
+  {
+    std::unique_lock lock(m_mtx);
+    const uint64_t target = ++m_flush_requested;
+    m_cv.notify_all();
+    m_flush_cv.wait(lock, [this, target] { return m_flush_done >= target; });
+  }
+
+  /**
+   * @brief Number of messages dropped because the ring of their thread was full.
+   */
+  std::size_t dropped_count() const
+  {
+    std::scoped_lock lock(m_mtx);
+    std::size_t n = m_dropped_retired;
+    for (const auto & r : m_rings) { n += r->dropped(); }
+    return n;
+  }
+
+protected:
+  /// @cond
+  detail::LogRing & ring()
+  {
+    thread_local detail::LogRingCache cache;
+    if (cache.id == m_id) { return *cache.ring; }
+    return ring_slow(cache);
+  }
+
+  detail::LogRing & ring_slow(detail::LogRingCache & cache)
+  {
+    // forget rings of destroyed loggers
+    cache.rings.erase(std::remove_if(cache.rings.begin(),
+                        cache.rings.end(),
+                        [](const auto & e) { return e.second.use_count() == 1; }),
+      cache.rings.end());
+
+    auto it = std::find_if(
+      cache.rings.begin(), cache.rings.end(), [this](const auto & e) { return e.first == m_id; });
+    if (it == cache.rings.end()) {
+      auto r = std::make_shared<detail::LogRing>(m_opts.ring_size);
+      {
+        std::scoped_lock lock(m_mtx);
+        m_rings.push_back(r);
+      }
+      cache.rings.emplace_back(m_id, std::move(r));
+      it = std::prev(cache.rings.end());
+    }
+    cache.id   = m_id;
+    cache.ring = it->second.get();
+    return *cache.ring;
+  }
+
+  void run()
+  {
+    std::vector<std::shared_ptr<detail::LogRing>> rings;
+    while (true) {
+      uint64_t flush_requested = 0;
+      bool stop                = false;
+      {
+        std::unique_lock lock(m_mtx);
+        m_cv.wait_for(lock, m_opts.period, [this] {
+          return m_stop || m_flush_requested > m_flush_done;
+        });
+        stop            = m_stop;
+        flush_requested = m_flush_requested;
+
+        // rings of exited threads
+        for (auto it = m_rings.begin(); it != m_rings.end();) {
+          if (it->use_count() == 1 && (*it)->empty()) {
+            m_dropped_retired += (*it)->dropped();
+            it = m_rings.erase(it);
+          } else {
+            ++it;
+          }
+        }
+        rings = m_rings;
+      }
+
+      drain(rings);
+      rings.clear();
+
+      {
+        std::scoped_lock lock(m_mtx);
+        m_flush_done = flush_requested;
+      }
+      m_flush_cv.notify_all();
+
+      if (stop) { return; }
+    }
+  }
+
+  void drain(const std::vector<std::shared_ptr<detail::LogRing>> & rings)
+  {
+    m_text.clear();
+    m_lines.clear();
+    m_ticks.update();
+    for (const auto & r : rings) {
+      r->consume([this](const std::byte * p) {
+        detail::LogRecordHeader header{};
+        std::memcpy(&header, p, sizeof(header));
+        if (header.format >= m_formats.size()) {
+          detail::LogFormatRegistry::instance().update(m_formats);
+        }
+        const auto & format = *m_formats[header.format];
+
+        const std::size_t begin = m_text.size();
+        m_date.append(m_text, m_ticks.to_ns(header.stamp));
+        m_text += " [";
+        m_text += LogLevel::names[static_cast<std::size_t>(header.level)];
+        m_text += "] ";
+        format.decode(format.fmt.c_str(), p + sizeof(header), m_text);
+        m_text += '\n';
+        m_lines.emplace_back(header.stamp, begin, m_text.size());
+      });
+    }
+
+    // merge threads by timestamp
+    std::stable_sort(m_lines.begin(), m_lines.end(), [](const auto & a, const auto & b) {
+      return std::get<0>(a) < std::get<0>(b);
+    });
+
+    m_batch.clear();
+    for (const auto & [stamp, begin, end] : m_lines) {
+      m_batch.append(m_text, begin, end - begin);
+      if (m_batch.size() >= m_opts.batch_size) {
+        m_os.write(m_batch.data(), static_cast<std::streamsize>(m_batch.size()));
+        m_batch.clear();
+      }
+    }
+    if (!m_batch.empty()) {
+      m_os.write(m_batch.data(), static_cast<std::streamsize>(m_batch.size()));
+    }
+    if (!m_lines.empty()) { m_os.flush(); }
+  }
+
+  static uint64_t next_id() noexcept
+  {
+    static std::atomic<uint64_t> id{0};
+    return ++id;
+  }
+
+  const uint64_t m_id = next_id();
+  std::ostream & m_os;
+  const Options m_opts;
+  std::atomic<int> m_level{LogLevel::debug};
+
+  mutable std::mutex m_mtx;
+  std::condition_variable m_cv;
+  std::condition_variable m_flush_cv;
+  std::vector<std::shared_ptr<detail::LogRing>> m_rings{};
+  std::size_t m_dropped_retired = 0;
+  uint64_t m_flush_requested    = 0;
+  uint64_t m_flush_done         = 0;
+  bool m_stop                   = false;
+
+  // background thread only
+  detail::LogTickConverter m_ticks{};
+  detail::LogDateFormatter m_date{};
+  std::vector<const detail::LogFormatRegistry::Format *> m_formats{};
+  std::string m_text{};
+  std::string m_batch{};
+  std::vector<std::tuple<int64_t, std::size_t, std::size_t>> m_lines{};
+
+  std::thread m_thread;
+  /// @endcond
+};
+
+}  // namespace cbr
+
+#endif  // CBR_UTILS__ASYNC_LOGGER_HPP_
@@ -0,0 +1,360 @@
+// Copyright Yamaha 2021
+// MIT License
+// https://github.com/yamaha-bps/cbr_utils/blob/master/LICENSE
+
+/** @file */
+
+#ifndef CBR_UTILS__BENCH_HPP_
+#define CBR_UTILS__BENCH_HPP_
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <ostream>
+#include <ratio>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "cyber_timer.hpp"
+
+/**
+ * @brief Microbenchmark harness built on CyberTimer.
+ */
+namespace cbr::bench {
+
+/**
+ * @brief Prevent the compiler from optimizing away the computation of a value.
+ *
+ * @param v Value that must be computed.
+ */
+template<typename T>
+inline void do_not_optimize(const T & v) noexcept
+{
+  asm volatile("" : : "r,m"(v) : "memory");
+}
+
+/**
+ * @brief Prevent the compiler from optimizing away the computation of a value.
+ * @details The compiler also assumes that the value may have been modified.
+ *
+ * @param v Value that must be computed.
+ */
+template<typename T>
+inline void do_not_optimize(T & v) noexcept
+{
+#if defined(__clang__)
+  asm volatile("" : "+r,m"(v) : : "memory");
+#else
+  asm volatile("" : "+m,r"(v) : : "memory");
+#endif
+}
+
+/**
+ * @brief Force all pending memory writes to be performed.
+ */
+inline void clobber_memory() noexcept { asm volatile("" : : : "memory"); }
+
+/**
+ * @brief Benchmark options.
+ */
+struct Options
+{
+  /// Warmup duration before calibration, in seconds
+  double warmup_time = 0.05;
+  /// Target duration of a sample, in seconds, used to calibrate the number of iterations
+  double sample_time = 0.01;
+  /// Number of samples
+  std::size_t samples = 30;
+  /// Maximal number of iterations per sample
+  std::size_t max_iterations = std::size_t{1} << 30;
+};
+
+/**
+ * @brief Benchmark result.
+ * @details Times are per iteration, in nanoseconds, with the timer overhead subtracted.
+ */
+struct Result
+{
+  std::string name{};
+  std::size_t iterations = 0;  ///< Iterations per sample
+  std::size_t samples    = 0;
+  double median          = 0.;
+  double mad             = 0.;  ///< Median absolute deviation
+  double mean            = 0.;
+  double min             = 0.;
+  double max             = 0.;
+  double overhead        = 0.;  ///< Timer overhead per sample
+};
+
+/// @cond
+
+namespace detail {
+
+using bench_timer_t = CyberTimer<std::nano, double, std::chrono::steady_clock, false>;
+
+inline double median(std::vector<double> v)
+{
+  if (v.empty()) { return 0.; }
+  const auto mid = v.begin() + static_cast<std::ptrdiff_t>(v.size() / 2);
+  std::nth_element(v.begin(), mid, v.end());
+  if (v.size() % 2 == 1) { return *mid; }
+  return (*mid + *std::max_element(v.begin(), mid)) / 2.;
+}
+
+// Median duration of an empty timed region
+inline double timer_overhead()
+{
+  static const double overhead = [] {
+    bench_timer_t timer;
+    std::vector<double> samples(1000);
+    for (auto & s : samples) {
+      timer.tic();
+      clobber_memory();
+      s = timer.toc();
+    }
+    return median(std::move(samples));
+  }();
+  return overhead;
+}
+
+template<typename F>
+double run_batch(F & f, const std::size_t iterations)
+{
+  bench_timer_t timer;
+  timer.tic();
+  for (std::size_t i = 0; i < iterations; ++i) { f(); }
+  clobber_memory();
+  return timer.toc();
+}
+
+inline void write_csv_string(std::ostream & os, const std::string & s)
+{
+  os << '"';
+  for (const char c : s) {
+    if (c == '"') { os << '"'; }
+    os << c;
+  }
+  os << '"';
+}
+
+inline void write_json_string(std::ostream & os, const std::string & s)
+{
+  os << '"';
+  for (const char c : s) {
+    if (c == '"' || c == '\\') {
+      os << '\\' << c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      os << ' ';
+    } else {
+      os << c;
+    }
+  }
+  os << '"';
+}
+
+}  // namespace detail
+
+/// @endcond
+
+/**
+ * @brief Benchmark a function.
+ * @details The function is first run for opts.warmup_time seconds, then the number of iterations
+ * per sample is calibrated so that a sample lasts about opts.sample_time seconds. Each sample
+ * times a batch of iterations, and the measured timer overhead is subtracted before dividing by
+ * the number of iterations.
+ *
+ * Example:
+ * ```
+ * std::vector<int> v(1000);
+ * const auto res = bench::run("accumulate", [&v] {
+ *   auto sum = std::accumulate(v.begin(), v.end(), 0);
+ *   bench::do_not_optimize(sum);
+ * });
+ * std::cout << res.median << " +- " << res.mad << " ns" << std::endl;
+ * ```
+ *
+ * @param name Name of the benchmark.
+ * @param f Function to benchmark, called without arguments.
+ * @param opts Options.
+ * @return Benchmark result.
+ */
+template<typename F>
+Result run(std::string name, F && f, const Options & opts = {})
+{
+  const double overhead = detail::timer_overhead();
+
+  // warmup
+  const double warmup_ns = opts.warmup_time * 1e9;
+  for (double t = 0.; t < warmup_ns;) { t += detail::run_batch(f, 1); }
+
+  // calibration: grow batches until they are long enough to be measured precisely
+  const double sample_ns = opts.sample_time * 1e9;
+  std::size_t iterations = 1;
+  while (iterations < opts.max_iterations) {
+    const double t = detail::run_batch(f, iterations) - overhead;
+    if (t >= sample_ns) { break; }
+    const double factor = t <= 0. ? 10. : std::clamp(1.2 * sample_ns / t, 1.2, 10.);
+    const auto next     = std::ceil(static_cast<double>(iterations) * factor);
+    iterations          = std::min(opts.max_iterations, static_cast<std::size_t>(next));
+  }
+
+  std::vector<double> samples(std::max<std::size_t>(opts.samples, 1));
+  for (auto & s : samples) {
+    s = std::max(detail::run_batch(f, iterations) - overhead, 0.) / static_cast<double>(iterations);
+  }
+
+  Result res;
+  res.name       = std::move(name);
+  res.iterations = iterations;
+  res.samples    = samples.size();
+  res.median     = detail::median(samples);
+  res.mean       = std::accumulate(samples.begin(), samples.end(), 0.)
+           / static_cast<double>(samples.size());
+  res.min      = *std::min_element(samples.begin(), samples.end());
+  res.max      = *std::max_element(samples.begin(), samples.end());
+  res.overhead = overhead;
+
+  std::vector<double> deviations(samples.size());
+  std::transform(samples.begin(), samples.end(), deviations.begin(), [&res](double s) {
+    return std::abs(s - res.median);
+  });
+  res.mad = detail::median(std::move(deviations));
+
+  return res;
+}
+
+/**
+ * @brief Collection of benchmark results.
+ * @details Example:
+ * ```
+ * bench::Suite suite;
+ * suite.run("push_back", [] { ... });
+ * suite.run("emplace_back", [] { ... });
+ * suite.write_csv(std::cout);
+ * ```
+ */
+class Suite
+{
+public:
+  /**
+   * @brief Construct a new Suite object.
+   *
+   * @param opts Options used for all benchmarks of the suite.
+   */
+  explicit Suite(const Options & opts = {}) : m_opts(opts) {}
+
+  /**
+   * @brief Run a benchmark and store its result, see bench::run().
+   *
+   * @param name Name of the benchmark.
+   * @param f Function to benchmark, called without arguments.
+   * @return Benchmark result.
+   */
+  template<typename F>
+  const Result & run(std::string name, F && f)
+  {
+    return m_results.emplace_back(bench::run(std::move(name), std::forward<F>(f), m_opts));
+  }
+
+  /**
+   * @brief Get all results.
+   */
+  const std::vector<Result> & results() const noexcept { return m_results; }
+
+  /**
+   * @brief Write results as CSV, one line per benchmark with a header line.
+   *
+   * @param os Output stream.
+   */
+  void write_csv(std::ostream & os) const
+  {
+    os << "name,iterations,samples,median_ns,mad_ns,mean_ns,min_ns,max_ns,overhead_ns\n";
+    for (const auto & r : m_results) {
+      detail::write_csv_string(os, r.name);
+      os << ',' << r.iterations << ',' << r.samples << ',' << r.median
+         << ',' << r.mad << ',' << r.mean << ',' << r.min << ',' << r.max << ',' << r.overhead
+         << '\n';
+    }
+  }
+
+  /**
+   * @brief Write results as a JSON array of objects.
+   *
+   * @param os Output stream.
+   */
+  void write_json(std::ostream & os) const
+  {
+    os << "[";
+    for (std::size_t i = 0; i < m_results.size(); ++i) {
+      const auto & r = m_results[i];
+      os << (i == 0 ? "\n" : ",\n") << "  {\"name\": ";
+      detail::write_json_string(os, r.name);
+      os << ", \"iterations\": " << r.iterations << ", \"samples\": " << r.samples
+         << ", \"median_ns\": " << r.median << ", \"mad_ns\": " << r.mad
+         << ", \"mean_ns\": " << r.mean << ", \"min_ns\": " << r.min << ", \"max_ns\": " << r.max
+         << ", \"overhead_ns\": " << r.overhead << "}";
+    }
+    os << "\n]\n";
+  }
+
+  /**
+   * @brief Write a human readable table of results.
+   *
+   * @param os Output stream.
+   */
+  void print(std::ostream & os) const
+  {
+    for (const auto & r : m_results) {
+      os << std::left << std::setw(40) << r.name << std::right << std::setw(12) << std::fixed
+         << std::setprecision(2) << r.median << " ns +- " << std::setw(8) << r.mad << " ns ("
+         << r.iterations << " x " << r.samples << ")\n";
+    }
+  }
+
+  /**
+   * @brief Write results in the format selected by the command line arguments of a benchmark.
+   * @details Meant to end the main function of a benchmark executable:
+   * ```
+   * int main(int argc, char ** argv)
+   * {
+   *   bench::Suite suite;
+   *   suite.run(...);
+   *   return suite.run_main(argc, argv);
+   * }
+   * ```
+   * Writes CSV if the first argument is `--csv`, JSON if it is `--json`, and a table otherwise.
+   *
+   * @param argc Number of arguments.
+   * @param argv Arguments, argv[0] being the program name.
+   * @param os Output stream (default: std::cout).
+   * @return Exit code of the program.
+   */
+  int run_main(const int argc, const char * const * argv, std::ostream & os = std::cout) const
+  {
+    const std::string_view format = argc > 1 ? argv[1] : "";
+    if (format == "--csv") {
+      write_csv(os);
+    } else if (format == "--json") {
+      write_json(os);
+    } else {
+      print(os);
+    }
+    return 0;
+  }
+
+protected:
+  /// @cond
+  Options m_opts;
+  std::vector<Result> m_results{};
+  /// @endcond
+};
+
+}  // namespace cbr::bench
+
+#endif  // CBR_UTILS__BENCH_HPP_
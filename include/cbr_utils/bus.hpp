@@ -0,0 +1,601 @@
+// Copyright Yamaha 2021
+// MIT License
+// https://github.com/yamaha-bps/cbr_utils/blob/master/LICENSE
+
+/** @file */
+
+#ifndef CBR_UTILS__BUS_HPP_
+#define CBR_UTILS__BUS_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "flat_map.hpp"
+#include "function.hpp"
+#include "type_traits.hpp"
+
+namespace cbr {
+
+/**
+ * @brief Topic identifier of a message type, FNV-1a hash of type_name<T>().
+ */
+template<typename T>
+constexpr uint64_t topic_id() noexcept
+{
+  uint64_t h = 14695981039346656037ULL;
+  for (const char c : type_name<T>()) {
+    h ^= static_cast<uint64_t>(static_cast<unsigned char>(c));
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+/**
+ * @brief Task type posted by a Bus to an executor.
+ */
+using bus_task_t = inplace_function<void(), 32>;
+
+class Bus;
+
+/// @cond
+namespace detail {
+
+class BusSubscriberBase
+{
+public:
+  BusSubscriberBase()                          = default;
+  BusSubscriberBase(const BusSubscriberBase &) = delete;
+  BusSubscriberBase(BusSubscriberBase &&)      = delete;
+  BusSubscriberBase & operator=(const BusSubscriberBase &) = delete;
+  BusSubscriberBase & operator=(BusSubscriberBase &&) = delete;
+  virtual ~BusSubscriberBase()                        = default;
+
+  // msg points to a std::shared_ptr<const T>
+  virtual void deliver(const void * msg) = 0;
+
+  void deactivate() noexcept { m_active.store(false, std::memory_order_release); }
+  bool active() const noexcept { return m_active.load(std::memory_order_acquire); }
+  std::size_t dropped() const noexcept { return m_dropped.load(std::memory_order_relaxed); }
+
+protected:
+  std::atomic<bool> m_active{true};
+  std::atomic<std::size_t> m_dropped{0};
+};
+
+template<typename T>
+class BusSubscriber final : public BusSubscriberBase,
+                            public std::enable_shared_from_this<BusSubscriber<T>>
+{
+public:
+  using message_t  = std::shared_ptr<const T>;
+  using callback_t = inplace_function<void(const message_t &), 64>;
+  using post_t     = inplace_function<void(bus_task_t &&), 16>;
+
+  // no capacity: callback called by the publisher, no callback: mailbox
+  BusSubscriber(callback_t cb, post_t post, const std::size_t capacity)
+      : m_cb(std::move(cb)), m_post(std::move(post)), m_ring(capacity)
+  {}
+
+  void deliver(const void * p) override
+  {
+    const auto & msg = *static_cast<const message_t *>(p);
+    if (m_ring.empty()) {
+      if (active()) { m_cb(msg); }
+      return;
+    }
+
+    bool schedule = false;
+    {
+      std::scoped_lock lock(m_mtx);
+      if (m_size == m_ring.size()) {
+        // full, drop the oldest message
+        m_ring[m_head] = msg;
+        m_head         = next(m_head);
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+      } else {
+        m_ring[(m_head + m_size) % m_ring.size()] = msg;
+        ++m_size;
+      }
+      schedule    = m_post && !m_scheduled;
+      m_scheduled = m_scheduled || schedule;
+    }
+    if (schedule) {
+      post_drain();
+    } else if (!m_post) {
+      m_cv.notify_one();
+    }
+  }
+
+  message_t try_pop()
+  {
+    std::scoped_lock lock(m_mtx);
+    return pop_locked();
+  }
+
+  template<typename Rep, typename Period>
+  message_t pop(const std::chrono::duration<Rep, Period> & timeout)
+  {
+    std::unique_lock lock(m_mtx);
+    m_cv.wait_for(lock, timeout, [this] { return m_size > 0; });
+    return pop_locked();
+  }
+
+  std::size_t size() const
+  {
+    std::scoped_lock lock(m_mtx);
+    return m_size;
+  }
+
+protected:
+  std::size_t next(const std::size_t i) const noexcept
+  {
+    return i + 1 == m_ring.size() ? 0 : i + 1;
+  }
+
+  message_t pop_locked()
+  {
+    if (m_size == 0) { return nullptr; }
+    message_t res = std::move(m_ring[m_head]);
+    m_head        = next(m_head);
+    --m_size;
+    return res;
+  }
+
+  // runs on the executor, at most one drain per subscriber at a time
+  void drain()
+  {
+    // give the worker back after a full queue worth of messages
+    for (std::size_t n = 0; n < m_ring.size(); ++n) {
+      message_t msg;
+      {
+        std::scoped_lock lock(m_mtx);
+        msg = pop_locked();
+        if (!msg) {
+          m_scheduled = false;
+          return;
+        }
+      }
+      if (active()) { m_cb(msg); }
+    }
+    post_drain();
+  }
+
+  // a failed post leaves the messages queued, the next delivery posts a drain again
+  void post_drain()
+  {
+    try {
+      m_post([self = this->shared_from_this()] { self->drain(); });
+    } catch (...) {
+      std::scoped_lock lock(m_mtx);
+      m_scheduled = false;
+      throw;
+    }
+  }
+
+  callback_t m_cb;
+  post_t m_post;
+
+  mutable std::mutex m_mtx;
+  std::condition_variable m_cv;
+  std::vector<message_t> m_ring;
+  std::size_t m_head{0};
+  std::size_t m_size{0};
+  bool m_scheduled{false};
+};
+
+template<typename T>
+struct is_shared_ptr : std::false_type
+{};
+
+template<typename T>
+struct is_shared_ptr<std::shared_ptr<T>> : std::true_type
+{};
+
+}  // namespace detail
+/// @endcond
+
+/**
+ * @brief Handle of a Bus subscription, unsubscribes when destroyed.
+ */
+class BusSubscription
+{
+public:
+  BusSubscription()                        = default;
+  BusSubscription(const BusSubscription &) = delete;
+  BusSubscription & operator=(const BusSubscription &) = delete;
+
+  BusSubscription(BusSubscription && o) noexcept
+      : m_bus(std::exchange(o.m_bus, nullptr)), m_id(o.m_id), m_sub(std::move(o.m_sub))
+  {}
+
+  BusSubscription & operator=(BusSubscription && o)
+  {
+    if (this != &o) {
+      unsubscribe();
+      m_bus = std::exchange(o.m_bus, nullptr);
+      m_id  = o.m_id;
+      m_sub = std::move(o.m_sub);
+    }
+    return *this;
+  }
+
+  ~BusSubscription() { unsubscribe(); }
+
+  /**
+   * @brief Stop receiving messages.
+   * @details Messages queued for a callback are discarded. A callback already running in another
+   * thread may still complete after this returns.
+   */
+  void unsubscribe();
+
+  /**
+   * @brief Check if the subscription is active.
+   */
+  bool subscribed() const noexcept { return m_bus != nullptr; }
+
+  /**
+   * @brief Number of messages dropped because the queue of the subscriber was full.
+   */
+  std::size_t dropped() const noexcept { return m_sub ? m_sub->dropped() : 0; }
+
+protected:
+  /// @cond
+  friend class Bus;
+
+  BusSubscription(Bus * bus, const uint64_t id, std::shared_ptr<detail::BusSubscriberBase> sub)
+      : m_bus(bus), m_id(id), m_sub(std::move(sub))
+  {}
+
+  Bus * m_bus{nullptr};
+  uint64_t m_id{0};
+  std::shared_ptr<detail::BusSubscriberBase> m_sub{};
+  /// @endcond
+};
+
+/**
+ * @brief Bus subscription whose messages are queued until popped by the owner.
+ *
+ * @tparam T Message type.
+ */
+template<typename T>
+class BusMailbox : public BusSubscription
+{
+public:
+  using message_t = std::shared_ptr<const T>;
+
+  BusMailbox() = default;
+
+  /**
+   * @brief Pop the oldest message.
+   * @return The message, nullptr if there is none.
+   */
+  message_t try_pop() { return m_sub ? subscriber().try_pop() : nullptr; }
+
+  /**
+   * @brief Pop the oldest message, waiting for one up to a timeout.
+   * @return The message, nullptr on timeout.
+   */
+  template<typename Rep, typename Period>
+  message_t pop(const std::chrono::duration<Rep, Period> & timeout)
+  {
+    return m_sub ? subscriber().pop(timeout) : nullptr;
+  }
+
+  /**
+   * @brief Number of queued messages.
+   */
+  std::size_t size() const { return m_sub ? subscriber().size() : 0; }
+
+protected:
+  /// @cond
+  friend class Bus;
+
+  explicit BusMailbox(BusSubscription && sub) : BusSubscription(std::move(sub)) {}
+
+  detail::BusSubscriber<T> & subscriber() const
+  {
+    return static_cast<detail::BusSubscriber<T> &>(*m_sub);
+  }
+  /// @endcond
+};
+
+/**
+ * @brief In-process typed publish/subscribe bus.
+ * @details Topics are message types, identified by topic_id<T>(). A published message is
+ * allocated once as a std::shared_ptr<const T> and the same immutable message is handed to all
+ * subscribers of its type, without copies. Subscribers choose how they are called:
+ * - subscribe(f): f is called by the publishing thread, the lowest latency for short callbacks.
+ * - subscribe(executor, f, capacity): messages are queued and f is called by a task posted to the
+ *   executor, e.g. a ThreadPool. There is at most one task per subscriber at a time, so that f is
+ *   called in order and never concurrently with itself, like on a strand.
+ * - mailbox(capacity): messages are queued until popped by the owner of the mailbox.
+ *
+ * Queues are bounded: when the queue of a subscriber is full its oldest message is dropped and
+ * counted in BusSubscription::dropped(). Publishers never block on slow subscribers.
+ *
+ * Example:
+ * ```
+ * Bus bus;
+ * ThreadPool pool(2);
+ *
+ * auto s1 = bus.subscribe<Image>([](const Image & img) { display(img); });
+ * auto s2 = bus.subscribe<Image>(pool, [](const std::shared_ptr<const Image> & img) {
+ *   detector.process(img);  // may keep the message without copying it
+ * });
+ * auto box = bus.mailbox<Image>(4);
+ *
+ * bus.publish(camera.grab());
+ * auto img = box.try_pop();
+ * ```
+ * Notes:
+ * - Callbacks take a const T & or a const std::shared_ptr<const T> &, and must fit in an
+ *   inplace_function of 64 bytes. Callbacks called by publishers may be called concurrently by
+ *   several publishing threads.
+ * - An executor is any object with a post() member function taking a bus_task_t, it must outlive
+ *   the subscriptions that use it.
+ * - The bus must outlive its subscriptions.
+ */
+class Bus
+{
+public:
+  template<typename T>
+  using message_t = std::shared_ptr<const T>;
+
+  Bus()            = default;
+  Bus(const Bus &) = delete;
+  Bus(Bus &&)      = delete;
+  Bus & operator=(const Bus &) = delete;
+  Bus & operator=(Bus &&) = delete;
+  ~Bus()                  = default;
+
+  /**
+   * @brief Subscribe a callback called by the publishing threads.
+   *
+   * @tparam T Message type.
+   * @param f Callback taking a const T & or a const std::shared_ptr<const T> &.
+   * @return Subscription handle.
+   */
+  template<typename T, typename F>
+  [[nodiscard]] BusSubscription subscribe(F && f)
+  {
+    return add<T>(make_callback<T>(std::forward<F>(f)), {}, 0);
+  }
+
+  /**
+   * @brief Subscribe a callback called on an executor.
+   *
+   * @tparam T Message type.
+   * @param executor Executor with a post(bus_task_t) member function, e.g. a ThreadPool.
+   * @param f Callback taking a const T & or a const std::shared_ptr<const T> &.
+   * @param capacity Maximal number of queued messages.
+   * @return Subscription handle.
+   */
+  template<typename T, typename Executor, typename F>
+  [[nodiscard]] BusSubscription subscribe(
+    Executor & executor, F && f, const std::size_t capacity = 64)
+  {
+    check_capacity(capacity);
+    return add<T>(make_callback<T>(std::forward<F>(f)),
+      [ex = &executor](bus_task_t && task) { ex->post(std::move(task)); },
+      capacity);
+  }
+
+  /**
+   * @brief Subscribe a mailbox.
+   *
+   * @tparam T Message type.
+   * @param capacity Maximal number of queued messages.
+   * @return Mailbox.
+   */
+  template<typename T>
+  [[nodiscard]] BusMailbox<T> mailbox(const std::size_t capacity = 64)
+  {
+    check_capacity(capacity);
+    return BusMailbox<T>(add<T>({}, {}, capacity));
+  }
+
+  /**
+   * @brief Publish a message to all subscribers of its type.
+   *
+   * @tparam T Message type.
+   * @param msg Message, must not be nullptr.
+   * @return Number of subscribers.
+   */
+  template<typename T>
+  std::size_t publish(message_t<T> msg)
+  {
+    const auto subs = subscribers<T>();
+    if (!subs) { return 0; }
+    for (const auto & sub : *subs) { sub->deliver(&msg); }
+    return subs->size();
+  }
+
+  /**
+   * @brief Publish a message to all subscribers of its type.
+   *
+   * @tparam T Message type.
+   * @param msg Message, must not be nullptr. It must not be modified afterwards.
+   * @return Number of subscribers.
+   */
+  template<typename T, typename = std::enable_if_t<!std::is_const_v<T>>>
+  std::size_t publish(std::shared_ptr<T> msg)
+  {
+    return publish<T>(message_t<T>(std::move(msg)));
+  }
+
+  /**
+   * @brief Publish a message to all subscribers of its type.
+   * @details The message is only allocated if there are subscribers.
+   *
+   * @param v Message.
+   * @return Number of subscribers.
+   */
+  template<typename U, typename = std::enable_if_t<!detail::is_shared_ptr<std::decay_t<U>>::value>>
+  std::size_t publish(U && v)
+  {
+    return emplace<std::decay_t<U>>(std::forward<U>(v));
+  }
+
+  /**
+   * @brief Publish a message constructed from arguments.
+   * @details The message is only constructed if there are subscribers.
+   *
+   * @tparam T Message type.
+   * @param args Arguments of the constructor of T.
+   * @return Number of subscribers.
+   */
+  template<typename T, typename... Args>
+  std::size_t emplace(Args &&... args)
+  {
+    const auto subs = subscribers<T>();
+    if (!subs) { return 0; }
+    const message_t<T> msg = std::make_shared<const T>(std::forward<Args>(args)...);
+    for (const auto & sub : *subs) { sub->deliver(&msg); }
+    return subs->size();
+  }
+
+  /**
+   * @brief Number of subscribers of a message type.
+   */
+  template<typename T>
+  std::size_t subscriber_count() const
+  {
+    const auto subs = subscribers<T>();
+    return subs ? subs->size() : 0;
+  }
+
+protected:
+  /// @cond
+  friend class BusSubscription;
+
+  using sub_ptr_t  = std::shared_ptr<detail::BusSubscriberBase>;
+  using sub_list_t = std::vector<sub_ptr_t>;
+
+  // topics are never removed, so that the table is only copied when a new type is subscribed
+  struct Topic
+  {
+    std::string_view name;
+    // copied on write and accessed with std::atomic_load/std::atomic_store, publishers iterate
+    // over a snapshot without locking
+    std::shared_ptr<const sub_list_t> subs;
+  };
+
+  using topic_map_t = flat_hash_map<uint64_t, std::shared_ptr<Topic>>;
+
+  static void check_capacity(const std::size_t capacity)
+  {
+    if (capacity == 0) { throw std::invalid_argument("Bus queue capacity must be positive."); }
+  }
+
+  template<typename T, typename F>
+  static typename detail::BusSubscriber<T>::callback_t make_callback(F && f)
+  {
+    if constexpr (std::is_invocable_v<F &, const message_t<T> &>) {
+      return std::forward<F>(f);
+    } else {
+      return [f = std::forward<F>(f)](const message_t<T> & msg) mutable { f(*msg); };
+    }
+  }
+
+  template<typename T>
+  BusSubscription add(typename detail::BusSubscriber<T>::callback_t cb,
+    typename detail::BusSubscriber<T>::post_t post,
+    const std::size_t capacity)
+  {
+    constexpr uint64_t id = topic_id<T>();
+    auto sub = std::make_shared<detail::BusSubscriber<T>>(std::move(cb), std::move(post), capacity);
+
+    std::scoped_lock lock(m_mtx);
+    Topic * topic = find_topic(id);
+    if (topic) {
+      check_name<T>(*topic);
+    } else {
+      auto new_topic = std::make_shared<Topic>(Topic{type_name<T>(), nullptr});
+      topic          = new_topic.get();
+      auto topics    = m_topics ? std::make_shared<topic_map_t>(*m_topics)
+                                : std::make_shared<topic_map_t>();
+      topics->emplace(id, std::move(new_topic));
+      std::atomic_store_explicit(&m_topics,
+        std::shared_ptr<const topic_map_t>(std::move(topics)),
+        std::memory_order_release);
+    }
+    auto subs = topic->subs ? std::make_shared<sub_list_t>(*topic->subs)
+                            : std::make_shared<sub_list_t>();
+    subs->push_back(sub);
+    std::atomic_store_explicit(
+      &topic->subs, std::shared_ptr<const sub_list_t>(std::move(subs)), std::memory_order_release);
+    return BusSubscription(this, id, std::move(sub));
+  }
+
+  void remove(const uint64_t id, const detail::BusSubscriberBase * sub)
+  {
+    std::scoped_lock lock(m_mtx);
+    Topic * topic = find_topic(id);
+    if (!topic || !topic->subs) { return; }
+    auto subs = std::make_shared<sub_list_t>();
+    subs->reserve(topic->subs->size());
+    for (const auto & s : *topic->subs) {
+      if (s.get() != sub) { subs->push_back(s); }
+    }
+    std::shared_ptr<const sub_list_t> res;
+    if (!subs->empty()) { res = std::move(subs); }
+    std::atomic_store_explicit(&topic->subs, std::move(res), std::memory_order_release);
+  }
+
+  // topics live as long as the bus since every copy of the table keeps them
+  Topic * find_topic(const uint64_t id) const
+  {
+    const auto topics = std::atomic_load_explicit(&m_topics, std::memory_order_acquire);
+    if (!topics) { return nullptr; }
+    const auto it = topics->find(id);
+    return it == topics->end() ? nullptr : it->second.get();
+  }
+
+  template<typename T>
+  std::shared_ptr<const sub_list_t> subscribers() const
+  {
+    const Topic * topic = find_topic(topic_id<T>());
+    if (!topic) { return nullptr; }
+    check_name<T>(*topic);
+    return std::atomic_load_explicit(&topic->subs, std::memory_order_acquire);
+  }
+
+  template<typename T>
+  static void check_name(const Topic & topic)
+  {
+    if (topic.name != type_name<T>()) {
+      throw std::logic_error(
+        "Bus topic id collision between " + std::string(topic.name) + " and "
+        + std::string(type_name<T>()) + ".");
+    }
+  }
+
+  // serializes subscriptions, publishers do not lock
+  std::mutex m_mtx;
+  // copied on write and accessed with std::atomic_load/std::atomic_store
+  std::shared_ptr<const topic_map_t> m_topics{};
+  /// @endcond
+};
+
+inline void BusSubscription::unsubscribe()
+{
+  if (m_bus == nullptr) { return; }
+  m_bus->remove(m_id, m_sub.get());
+  m_sub->deactivate();
+  m_bus = nullptr;
+}
+
+}  // namespace cbr
+
+#endif  // CBR_UTILS__BUS_HPP_
@@ -0,0 +1,649 @@
+// Copyright Yamaha 2021
+// MIT License
+// https://github.com/yamaha-bps/cbr_utils/blob/master/LICENSE
+
+/** @file */
+
+#ifndef CBR_UTILS__CHUNKED_RECORDER_HPP_
+#define CBR_UTILS__CHUNKED_RECORDER_HPP_
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "mapped_file.hpp"
+#include "serialization.hpp"
+#include "utils.hpp"
+
+namespace cbr {
+
+/// @cond
+
+namespace detail {
+
+inline constexpr char chunked_rec_magic[8] = {'C', 'B', 'R', 'C', 'R', 'E', 'C', '1'};
+
+struct ChunkedRecFileHeader
+{
+  char magic[8];
+  uint64_t first_chunk;  // offset of the first chunk, page aligned
+};
+
+struct ChunkedRecChunkHeader
+{
+  uint64_t size;          // bytes from the chunk start to the next chunk or to the end of file
+  uint64_t data_end;      // end of the records
+  uint64_t n_records;
+  uint64_t index_offset;  // 0 until the chunk is finalized
+  int64_t t_min;
+  int64_t t_max;
+};
+
+struct ChunkedRecRecordHeader
+{
+  uint32_t channel;
+  uint32_t size;
+  int64_t stamp;
+};
+
+// records are sorted by stamp in the index of their chunk, offsets are relative to the chunk
+struct ChunkedRecIndexEntry
+{
+  int64_t stamp;
+  uint64_t offset;
+};
+
+// records are 8 bytes aligned
+inline constexpr std::size_t chunked_rec_align(const std::size_t n)
+{
+  return (n + 7) & ~std::size_t{7};
+}
+
+}  // namespace detail
+
+/// @endcond
+
+/**
+ * @brief Options of a ChunkedRecorder.
+ */
+struct ChunkedRecorderOptions
+{
+  /// Size in bytes of the chunks, rounded up to the page size, larger for large messages
+  std::size_t chunk_size = 1UL << 26;
+  /// A new file is started when the current file reaches this size in bytes
+  std::size_t max_file_size = 1UL << 32;
+  /// A new file is started when the current file is older than this, never if zero
+  std::chrono::nanoseconds max_file_duration{0};
+};
+
+/**
+ * @brief Record serialized messages into memory-mapped chunks.
+ * @details Messages are appended as records (channel, timestamp, serialized payload) to large
+ * chunks that are preallocated on disk and mapped into memory, so that recording a message is a
+ * serialize() into the page cache, without system calls. When a chunk is full, an index of its
+ * records sorted by timestamp is written at its end and the next chunk is mapped. Files are
+ * rotated by size or age, and named by the prefix and dateStr() of their creation. Use
+ * ChunkedReader to read a recording.
+ *
+ * Payloads are serialized with serialize(), and thus can be arithmetic types, std containers or
+ * boost::hana::Struct types.
+ *
+ * Example:
+ * ```
+ * ChunkedRecorderOptions opts;
+ * opts.max_file_duration = std::chrono::minutes(10);
+ * ChunkedRecorder recorder("/data/run", opts);  // /data/run_2022-01-01_15-13-54.rec, ...
+ *
+ * recorder.record(0, imu.stamp, imu);
+ * recorder.record(1, img.stamp, img);
+ * ```
+ * Notes:
+ * - Records of a process that crashed are recovered by ChunkedReader, only the index of the last
+ *   chunk is missing and is then rebuilt.
+ * - Seeking assumes that timestamps are mostly increasing: within a chunk records are indexed by
+ *   timestamp, but chunks are searched by their time range.
+ * - Messages may be recorded from several threads.
+ */
+class ChunkedRecorder
+{
+public:
+  ChunkedRecorder(const ChunkedRecorder &) = delete;
+  ChunkedRecorder(ChunkedRecorder &&)      = delete;
+  ChunkedRecorder & operator=(const ChunkedRecorder &) = delete;
+  ChunkedRecorder & operator=(ChunkedRecorder &&) = delete;
+  ~ChunkedRecorder() { close(); }
+
+  /**
+   * @brief Create a new recording.
+   *
+   * @param prefix Path prefix of the files, completed by "_" + dateStr() + ".rec".
+   * @param opts Chunk and file sizes.
+   */
+  explicit ChunkedRecorder(std::string prefix, const ChunkedRecorderOptions & opts = {})
+      : m_prefix(std::move(prefix)), m_opts(opts),
+        m_page_size(static_cast<std::size_t>(sysconf(_SC_PAGESIZE)))
+  {
+    m_opts.chunk_size = round_page(std::max<std::size_t>(m_opts.chunk_size, 1));
+    open_file();
+  }
+
+  /**
+   * @brief Append a message to the recording.
+   *
+   * @param channel Channel of the message, e.g. the index of its topic.
+   * @param stamp Timestamp of the message.
+   * @param msg Message.
+   */
+  template<typename T>
+  void record(const uint32_t channel, const int64_t stamp, const T & msg)
+  {
+    const std::size_t n = serialized_size(msg);
+    std::scoped_lock lock(m_mtx);
+    serialize(msg, reserve(n));
+    commit(channel, stamp, n);
+  }
+
+  /**
+   * @brief Append a message already serialized to the recording.
+   *
+   * @param channel Channel of the message.
+   * @param stamp Timestamp of the message.
+   * @param data Serialized message.
+   * @param n Number of bytes.
+   */
+  void record_raw(
+    const uint32_t channel, const int64_t stamp, const void * data, const std::size_t n)
+  {
+    std::scoped_lock lock(m_mtx);
+    if (n > 0) { std::memcpy(reserve(n), data, n); }
+    commit(channel, stamp, n);
+  }
+
+  /**
+   * @brief Close the current file and start a new one.
+   */
+  void rotate()
+  {
+    std::scoped_lock lock(m_mtx);
+    if (m_fd < 0) { throw std::logic_error("ChunkedRecorder is closed."); }
+    close_file();
+    open_file();
+  }
+
+  /**
+   * @brief Ask the kernel to start writing the current chunk to disk.
+   */
+  void flush()
+  {
+    std::scoped_lock lock(m_mtx);
+    if (m_chunk != nullptr) { msync(m_chunk, m_chunk_span, MS_ASYNC); }
+  }
+
+  /**
+   * @brief Close the recording.
+   * @details Recording more messages afterwards throws.
+   */
+  void close()
+  {
+    std::scoped_lock lock(m_mtx);
+    close_file();
+  }
+
+  /**
+   * @brief Paths of the files of the recording, in creation order.
+   */
+  std::vector<std::string> files() const
+  {
+    std::scoped_lock lock(m_mtx);
+    return m_files;
+  }
+
+  /**
+   * @brief Number of recorded messages.
+   */
+  std::size_t count() const
+  {
+    std::scoped_lock lock(m_mtx);
+    return m_count;
+  }
+
+protected:
+  /// @cond
+  using chunk_header_t  = detail::ChunkedRecChunkHeader;
+  using record_header_t = detail::ChunkedRecRecordHeader;
+  using index_entry_t   = detail::ChunkedRecIndexEntry;
+
+  std::size_t round_page(const std::size_t n) const
+  {
+    return (n + m_page_size - 1) / m_page_size * m_page_size;
+  }
+
+  // pointer to n bytes of payload in the current chunk, opens a chunk or a file if needed
+  std::byte * reserve(const std::size_t n)
+  {
+    if (m_fd < 0) { throw std::logic_error("ChunkedRecorder is closed."); }
+    if (n > std::numeric_limits<uint32_t>::max()) {
+      throw std::length_error("ChunkedRecorder message too large.");
+    }
+
+    if (m_chunk != nullptr && m_opts.max_file_duration.count() > 0
+        && std::chrono::steady_clock::now() - m_file_start >= m_opts.max_file_duration) {
+      close_file();
+      open_file();
+    }
+
+    const std::size_t rec_size   = detail::chunked_rec_align(sizeof(record_header_t) + n);
+    const std::size_t index_size = (m_index.size() + 1) * sizeof(index_entry_t);
+    if (m_chunk == nullptr || m_data_end + rec_size + index_size > m_chunk_span) {
+      finish_chunk(false);
+      if (m_file_end >= m_opts.max_file_size) {
+        close_file();
+        open_file();
+      }
+      open_chunk(sizeof(chunk_header_t) + rec_size + sizeof(index_entry_t));
+    }
+    return m_chunk + m_data_end + sizeof(record_header_t);
+  }
+
+  void commit(const uint32_t channel, const int64_t stamp, const std::size_t n)
+  {
+    const record_header_t header{channel, static_cast<uint32_t>(n), stamp};
+    std::memcpy(m_chunk + m_data_end, &header, sizeof(header));
+    m_index.push_back(index_entry_t{stamp, m_data_end});
+    m_data_end += detail::chunked_rec_align(sizeof(header) + n);
+
+    // the header is kept up to date so that a crashed recording can be read
+    m_header.data_end  = m_data_end;
+    m_header.n_records = m_index.size();
+    m_header.t_min     = std::min(m_header.t_min, stamp);
+    m_header.t_max     = std::max(m_header.t_max, stamp);
+    std::memcpy(m_chunk, &m_header, sizeof(m_header));
+    ++m_count;
+  }
+
+  void open_file()
+  {
+    const std::string base = m_prefix + "_" + dateStr();
+    std::string path       = base + ".rec";
+    for (int i = 1;; ++i) {
+      m_fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+      if (m_fd >= 0) { break; }
+      if (errno != EEXIST) {
+        throw std::system_error(errno, std::generic_category(), "open " + path);
+      }
+      path = base + "_" + std::to_string(i) + ".rec";
+    }
+
+    detail::ChunkedRecFileHeader header{};
+    std::memcpy(header.magic, detail::chunked_rec_magic, sizeof(header.magic));
+    header.first_chunk = round_page(sizeof(header));
+    if (pwrite(m_fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header))) {
+      const int err = errno;
+      ::close(m_fd);
+      m_fd = -1;
+      throw std::system_error(err, std::generic_category(), "write " + path);
+    }
+
+    m_files.push_back(std::move(path));
+    m_file_end   = header.first_chunk;
+    m_file_start = std::chrono::steady_clock::now();
+  }
+
+  void open_chunk(const std::size_t min_size)
+  {
+    const std::size_t span = std::max(m_opts.chunk_size, round_page(min_size));
+    const auto offset      = static_cast<off_t>(m_file_end);
+    const int err          = posix_fallocate(m_fd, offset, static_cast<off_t>(span));
+    if (err != 0) { throw std::system_error(err, std::generic_category(), "posix_fallocate"); }
+    void * ptr = mmap(nullptr, span, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, offset);
+    if (ptr == MAP_FAILED) { throw std::system_error(errno, std::generic_category(), "mmap"); }
+
+    m_chunk      = static_cast<std::byte *>(ptr);
+    m_chunk_span = span;
+    m_data_end   = sizeof(chunk_header_t);
+    m_index.clear();
+    m_header = chunk_header_t{span,
+      m_data_end,
+      0,
+      0,
+      std::numeric_limits<int64_t>::max(),
+      std::numeric_limits<int64_t>::min()};
+    std::memcpy(m_chunk, &m_header, sizeof(m_header));
+  }
+
+  // write the index, the last chunk of a file is shrunk to its content
+  void finish_chunk(const bool last) noexcept
+  {
+    if (m_chunk == nullptr) { return; }
+
+    const auto by_stamp = [](const index_entry_t & a, const index_entry_t & b) {
+      return a.stamp < b.stamp;
+    };
+    if (!std::is_sorted(m_index.begin(), m_index.end(), by_stamp)) {
+      std::stable_sort(m_index.begin(), m_index.end(), by_stamp);
+    }
+    const std::size_t index_size = m_index.size() * sizeof(index_entry_t);
+    if (index_size > 0) { std::memcpy(m_chunk + m_data_end, m_index.data(), index_size); }
+    m_header.index_offset = m_data_end;
+    if (last) { m_header.size = m_data_end + index_size; }
+    std::memcpy(m_chunk, &m_header, sizeof(m_header));
+
+    munmap(m_chunk, m_chunk_span);
+    m_chunk = nullptr;
+    m_file_end += m_header.size;
+  }
+
+  void close_file() noexcept
+  {
+    if (m_fd < 0) { return; }
+    finish_chunk(true);
+    if (m_file_end == round_page(sizeof(detail::ChunkedRecFileHeader))) {
+      m_file_end = sizeof(detail::ChunkedRecFileHeader);  // no chunk
+    }
+    [[maybe_unused]] const int ret = ftruncate(m_fd, static_cast<off_t>(m_file_end));
+    ::close(m_fd);
+    m_fd = -1;
+  }
+
+  std::string m_prefix;
+  ChunkedRecorderOptions m_opts;
+  std::size_t m_page_size;
+
+  int m_fd{-1};
+  std::size_t m_file_end{0};
+  std::chrono::steady_clock::time_point m_file_start{};
+  std::vector<std::string> m_files{};
+
+  std::byte * m_chunk{nullptr};
+  std::size_t m_chunk_span{0};
+  std::size_t m_data_end{0};
+  chunk_header_t m_header{};
+  std::vector<index_entry_t> m_index{};
+
+  std::size_t m_count{0};
+  mutable std::mutex m_mtx;
+  /// @endcond
+};
+
+/**
+ * @brief Memory-mapped reader of a file recorded with ChunkedRecorder.
+ * @details Opening a file reads the headers of its chunks, then seek() finds the first record at
+ * or after a timestamp with a binary search over the chunks and one over the index of the chunk.
+ * Records are iterated in timestamp order within each chunk, payloads are read in place.
+ *
+ * Example:
+ * ```
+ * ChunkedReader reader(recorder.files().front());
+ * for (auto it = reader.seek(t0); it != reader.end() && it->stamp < t1; ++it) {
+ *   if (it->channel == 0) { process(it->get<Imu>()); }
+ * }
+ * ```
+ */
+class ChunkedReader
+{
+public:
+  /**
+   * @brief A record, its payload points into the mapped file.
+   */
+  struct Record
+  {
+    uint32_t channel;
+    int64_t stamp;
+    const std::byte * data;
+    std::size_t size;
+
+    /**
+     * @brief Deserialize the payload.
+     */
+    template<typename T>
+    T get() const
+    {
+      return deserialize<T>(data, size);
+    }
+  };
+
+  /**
+   * @brief Forward iterator over the records.
+   */
+  class const_iterator
+  {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type        = Record;
+    using difference_type   = std::ptrdiff_t;
+    using pointer           = const Record *;
+    using reference         = const Record &;
+
+    const_iterator() = default;
+
+    reference operator*() const noexcept { return m_rec; }
+    pointer operator->() const noexcept { return &m_rec; }
+
+    const_iterator & operator++()
+    {
+      ++m_entry;
+      normalize();
+      return *this;
+    }
+
+    const_iterator operator++(int)
+    {
+      auto res = *this;
+      ++*this;
+      return res;
+    }
+
+    friend bool operator==(const const_iterator & a, const const_iterator & b) noexcept
+    {
+      return a.m_chunk == b.m_chunk && a.m_entry == b.m_entry;
+    }
+
+    friend bool operator!=(const const_iterator & a, const const_iterator & b) noexcept
+    {
+      return !(a == b);
+    }
+
+  private:
+    friend class ChunkedReader;
+
+    const_iterator(const ChunkedReader * reader, std::size_t chunk, std::size_t entry)
+        : m_reader(reader), m_chunk(chunk), m_entry(entry)
+    {
+      normalize();
+    }
+
+    // skip to the next non empty chunk and load the record
+    void normalize()
+    {
+      const auto & chunks = m_reader->m_chunks;
+      while (m_chunk < chunks.size() && m_entry >= chunks[m_chunk].n_records) {
+        ++m_chunk;
+        m_entry = 0;
+      }
+      if (m_chunk < chunks.size()) { m_rec = m_reader->record(m_chunk, m_entry); }
+    }
+
+    const ChunkedReader * m_reader{nullptr};
+    std::size_t m_chunk{0};
+    std::size_t m_entry{0};
+    Record m_rec{};
+  };
+
+  ChunkedReader(const ChunkedReader &) = delete;
+  ChunkedReader(ChunkedReader &&)      = default;
+  ChunkedReader & operator=(const ChunkedReader &) = delete;
+  ChunkedReader & operator=(ChunkedReader &&) = default;
+  ~ChunkedReader()                            = default;
+
+  /**
+   * @brief Open a recorded file.
+   * @details Throws std::runtime_error if the file is not a recording.
+   *
+   * @param path Path of the file.
+   */
+  explicit ChunkedReader(const std::string & path) : m_file(path)
+  {
+    detail::ChunkedRecFileHeader header{};
+    if (m_file.size() < sizeof(header)) {
+      throw std::runtime_error("Invalid chunked recording " + path);
+    }
+    std::memcpy(&header, m_file.data(), sizeof(header));
+    if (std::memcmp(header.magic, detail::chunked_rec_magic, sizeof(header.magic)) != 0) {
+      throw std::runtime_error("Invalid chunked recording " + path);
+    }
+
+    std::size_t offset = header.first_chunk;
+    while (offset + sizeof(chunk_header_t) <= m_file.size()) {
+      chunk_header_t ch{};
+      std::memcpy(&ch, m_file.data() + offset, sizeof(ch));
+      // a chunk header is zero if the recorder crashed right after allocating the chunk
+      if (ch.size < sizeof(ch) || ch.size > m_file.size() - offset || ch.data_end > ch.size) {
+        break;
+      }
+      add_chunk(m_file.data() + offset, ch);
+      offset += ch.size;
+    }
+  }
+
+  /**
+   * @brief Number of records.
+   */
+  std::size_t size() const noexcept { return m_size; }
+
+  /**
+   * @brief Number of chunks.
+   */
+  std::size_t chunk_count() const noexcept { return m_chunks.size(); }
+
+  const_iterator begin() const { return const_iterator(this, 0, 0); }
+  const_iterator end() const { return const_iterator(this, m_chunks.size(), 0); }
+
+  /**
+   * @brief First record with a timestamp greater than or equal to a timestamp.
+   * @details O(log n), returns end() if there is none.
+   */
+  const_iterator seek(const int64_t stamp) const
+  {
+    const auto chunk = std::partition_point(m_chunks.begin(), m_chunks.end(),
+      [stamp](const Chunk & c) { return c.n_records == 0 || c.t_max < stamp; });
+    if (chunk == m_chunks.end()) { return end(); }
+
+    std::size_t lo = 0;
+    std::size_t hi = chunk->n_records;
+    while (lo < hi) {
+      const std::size_t mid = lo + (hi - lo) / 2;
+      if (entry(*chunk, mid).stamp < stamp) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    return const_iterator(this, static_cast<std::size_t>(chunk - m_chunks.begin()), lo);
+  }
+
+  /**
+   * @brief Call a function on every record.
+   *
+   * @param f Function called as f(const Record &).
+   * @return Number of records.
+   */
+  template<typename F>
+  std::size_t for_each(F && f) const
+  {
+    for (const auto & rec : *this) { f(rec); }
+    return m_size;
+  }
+
+  /**
+   * @brief Advise the kernel that the file will be read sequentially.
+   */
+  void advise_sequential() const noexcept { m_file.advise_sequential(); }
+
+protected:
+  /// @cond
+  using chunk_header_t  = detail::ChunkedRecChunkHeader;
+  using record_header_t = detail::ChunkedRecRecordHeader;
+  using index_entry_t   = detail::ChunkedRecIndexEntry;
+
+  struct Chunk
+  {
+    const std::byte * base;
+    std::size_t data_end;
+    std::size_t n_records;
+    int64_t t_max;
+    const std::byte * index;               // in the file
+    std::vector<index_entry_t> rebuilt{};  // if the index was not written
+  };
+
+  void add_chunk(const std::byte * base, const chunk_header_t & ch)
+  {
+    Chunk c{base, ch.data_end, ch.n_records, ch.t_max, nullptr};
+    if (ch.index_offset != 0
+        && ch.index_offset + ch.n_records * sizeof(index_entry_t) <= ch.size) {
+      c.index = base + ch.index_offset;
+    } else {
+      // not finalized, scan the records
+      std::size_t offset = sizeof(chunk_header_t);
+      while (offset + sizeof(record_header_t) <= c.data_end) {
+        record_header_t rh{};
+        std::memcpy(&rh, base + offset, sizeof(rh));
+        c.rebuilt.push_back(index_entry_t{rh.stamp, offset});
+        offset += detail::chunked_rec_align(sizeof(rh) + rh.size);
+      }
+      std::stable_sort(c.rebuilt.begin(), c.rebuilt.end(), [](const auto & a, const auto & b) {
+        return a.stamp < b.stamp;
+      });
+      c.n_records = c.rebuilt.size();
+      c.t_max     = c.rebuilt.empty() ? c.t_max : c.rebuilt.back().stamp;
+    }
+    m_size += c.n_records;
+    m_chunks.push_back(std::move(c));
+  }
+
+  static index_entry_t entry(const Chunk & c, const std::size_t i) noexcept
+  {
+    if (c.index == nullptr) { return c.rebuilt[i]; }
+    index_entry_t e{};
+    std::memcpy(&e, c.index + i * sizeof(e), sizeof(e));
+    return e;
+  }
+
+  Record record(const std::size_t chunk, const std::size_t i) const
+  {
+    const Chunk & c       = m_chunks[chunk];
+    const index_entry_t e = entry(c, i);
+    record_header_t rh{};
+    if (e.offset + sizeof(rh) > c.data_end) {
+      throw std::runtime_error("Corrupted chunked recording.");
+    }
+    std::memcpy(&rh, c.base + e.offset, sizeof(rh));
+    if (e.offset + sizeof(rh) + rh.size > c.data_end) {
+      throw std::runtime_error("Corrupted chunked recording.");
+    }
+    return Record{rh.channel, rh.stamp, c.base + e.offset + sizeof(rh), rh.size};
+  }
+
+  MappedFileReader m_file;
+  std::vector<Chunk> m_chunks{};
+  std::size_t m_size{0};
+  /// @endcond
+};
+
+}  // namespace cbr
+
+#endif  // CBR_UTILS__CHUNKED_RECORDER_HPP_
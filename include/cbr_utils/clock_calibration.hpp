@@ -0,0 +1,144 @@
+// Copyright Yamaha 2021
+// MIT License
+// https://github.com/yamaha-bps/cbr_utils/blob/master/LICENSE
+
+/** @file */
+
+#ifndef CBR_UTILS__CLOCK_CALIBRATION_HPP_
+#define CBR_UTILS__CLOCK_CALIBRATION_HPP_
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+#include "clock_traits.hpp"
+
+namespace cbr {
+
+/**
+ * @brief Measured overhead and resolution of a clock.
+ */
+struct ClockCalibration
+{
+  /// Median duration between two successive now() calls, i.e. the cost of timing an empty region
+  std::chrono::nanoseconds overhead{0};
+  /// Tick granularity, i.e. greatest common divisor of the non-zero differences observed between
+  /// now() calls, 0 if the clock did not advance
+  std::chrono::nanoseconds resolution{0};
+  /// Number of now() pairs used to measure the overhead
+  std::size_t samples = 0;
+};
+
+/// @cond
+
+namespace detail {
+
+template<typename clock_t, typename F>
+ClockCalibration calibrate_clock_impl(F && now, const std::size_t samples)
+{
+  const auto to_ns = [](const auto & d) {
+    return ClockTraits<clock_t>::template duration_cast<std::chrono::nanoseconds>(d);
+  };
+
+  ClockCalibration res;
+  res.samples = std::max<std::size_t>(samples, 1);
+
+  // warmup
+  for (std::size_t i = 0; i < 100; ++i) { static_cast<void>(now()); }
+
+  // every observed tick is a multiple of the granularity
+  int64_t granularity = 0;
+  const auto add_tick = [&granularity](const std::chrono::nanoseconds & d) {
+    if (d.count() != 0) { granularity = std::gcd(granularity, d.count()); }
+  };
+
+  std::vector<std::chrono::nanoseconds> diffs(res.samples);
+  for (auto & d : diffs) {
+    const auto t0 = now();
+    const auto t1 = now();
+    d             = to_ns(t1 - t0);
+    add_tick(d);
+  }
+  const auto mid = diffs.begin() + static_cast<std::ptrdiff_t>(diffs.size() / 2);
+  std::nth_element(diffs.begin(), mid, diffs.end());
+  res.overhead = *mid;
+
+  // spin until the clock ticks, at most 100 ticks and about 10ms
+  constexpr std::size_t max_ticks = 100;
+  constexpr std::size_t max_spins = 10'000'000;
+  const auto budget               = std::chrono::milliseconds(10);
+
+  const auto tstart = now();
+  for (std::size_t k = 0; k < max_ticks && granularity != 1; ++k) {
+    const auto t0 = now();
+    auto t1       = t0;
+    for (std::size_t s = 0; s < max_spins && t1 == t0; ++s) { t1 = now(); }
+    if (t1 == t0) { break; }  // the clock does not advance on its own
+    add_tick(to_ns(t1 - t0));
+    if (to_ns(t1 - tstart) > budget) { break; }
+  }
+  res.resolution = std::chrono::nanoseconds(granularity);
+
+  return res;
+}
+
+}  // namespace detail
+
+/// @endcond
+
+/**
+ * @brief Measure the overhead and resolution of a stateless clock.
+ * @details The overhead is the median of samples differences between two successive now() calls,
+ * which is what an empty region measures with a timer. The resolution is the tick granularity of
+ * the clock, the greatest common divisor of all the non-zero differences observed between now()
+ * calls: unlike the smallest difference, it does not include the cost of reading the clock. Takes
+ * at most about 10ms plus the time needed for the clock to tick.
+ *
+ * @tparam clock_t Clock type.
+ * @param samples Number of pairs of now() calls used to measure the overhead (default: 1001).
+ * @return Calibration.
+ */
+template<typename clock_t>
+ClockCalibration calibrate_clock(const std::size_t samples = 1001)
+{
+  static_assert(detail::is_stateless_clock_v<clock_t>, "Clock must be stateless.");
+  return detail::calibrate_clock_impl<clock_t>([] { return detail::ClockTraits<clock_t>::now(); },
+    samples);
+}
+
+/**
+ * @brief Measure the overhead and resolution of a clock instance, see calibrate_clock().
+ * @details The resolution is 0 if the clock does not advance while it is read, e.g. a simulated
+ * clock.
+ *
+ * @param clock Clock.
+ * @param samples Number of pairs of now() calls used to measure the overhead (default: 1001).
+ * @return Calibration.
+ */
+template<typename clock_t>
+ClockCalibration calibrate_clock(const clock_t & clock, const std::size_t samples = 1001)
+{
+  return detail::calibrate_clock_impl<clock_t>([&clock] { return clock.now(); }, samples);
+}
+
+/**
+ * @brief Calibration of a stateless clock, measured once on first call.
+ * @details Thread safe. Call it at startup to avoid the calibration delay in a time critical
+ * section.
+ *
+ * @tparam clock_t Clock type.
+ * @return Calibration.
+ */
+template<typename clock_t>
+const ClockCalibration & clock_calibration()
+{
+  static const ClockCalibration calibration = calibrate_clock<clock_t>();
+  return calibration;
+}
+
+}  // namespace cbr
+
+#endif  // CBR_UTILS__CLOCK_CALIBRATION_HPP_
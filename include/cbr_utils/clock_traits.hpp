@@ -8,6 +8,10 @@
 #define CBR_UTILS__CLOCK_TRAITS_HPP_
 
 #include <chrono>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <utility>
 
 namespace cbr::detail {
 
@@ -33,6 +37,110 @@ struct ClockTraits
   {
     return std::chrono::duration_cast<duration_t>(d);
   }
+
+  /**
+   * @brief Current time of a stateless clock.
+   * @details Only used for clocks for which is_stateless_clock is true.
+   *
+   * @return Current time
+   */
+  static time_point now() noexcept(noexcept(clock_t::now())) { return clock_t::now(); }
+};
+
+/**
+ * @brief Whether a clock type is stateless, i.e. all its instances are equivalent.
+ * @details True for empty types such as std::chrono clocks. Timers call stateless clocks through
+ * ClockTraits<clock_t>::now() and never allocate them, other clocks are held by shared pointer.
+ */
+template<typename clock_t>
+struct is_stateless_clock : std::is_empty<clock_t>
+{};
+
+template<typename clock_t>
+inline constexpr bool is_stateless_clock_v = is_stateless_clock<clock_t>::value;
+
+/**
+ * @brief Whether a clock has a sleep_for(std::chrono::nanoseconds) member.
+ * @details Such clocks are slept on instead of the calling thread, e.g. so that a simulated clock
+ * is advanced rather than blocking.
+ */
+template<typename clock_t, typename = void>
+struct has_clock_sleep : std::false_type
+{};
+
+template<typename clock_t>
+struct has_clock_sleep<clock_t,
+  std::void_t<decltype(std::declval<clock_t &>().sleep_for(std::chrono::nanoseconds{}))>>
+    : std::true_type
+{};
+
+template<typename clock_t>
+inline constexpr bool has_clock_sleep_v = has_clock_sleep<clock_t>::value;
+
+/**
+ * @brief Clock storage for timers, meant to be used as a base class.
+ * @details Stateful clocks are shared through a std::shared_ptr.
+ */
+template<typename clock_t, bool = is_stateless_clock_v<clock_t>>
+class ClockHolder
+{
+public:
+  using time_point = typename ClockTraits<clock_t>::time_point;
+  using pointer    = std::shared_ptr<clock_t>;
+
+  ClockHolder() = default;
+  explicit ClockHolder(pointer clock) noexcept : m_clock(std::move(clock)) {}
+
+  time_point clock_now() const { return m_clock->now(); }
+
+  void store_clock(pointer clock) noexcept { m_clock = std::move(clock); }
+
+  pointer stored_clock() const noexcept { return m_clock; }
+
+  void clock_sleep_for(const std::chrono::nanoseconds & d) const
+  {
+    if constexpr (has_clock_sleep_v<clock_t>) {
+      m_clock->sleep_for(d);
+    } else {
+      std::this_thread::sleep_for(d);
+    }
+  }
+
+protected:
+  pointer m_clock = std::make_shared<clock_t>();
+};
+
+/**
+ * @brief Clock storage for timers, specialization for stateless clocks.
+ * @details Time is read statically and no clock is allocated. A clock set by pointer is kept only
+ * so that it can be given back by stored_clock(), which otherwise creates a new instance.
+ */
+template<typename clock_t>
+class ClockHolder<clock_t, true>
+{
+public:
+  using time_point = typename ClockTraits<clock_t>::time_point;
+  using pointer    = std::shared_ptr<clock_t>;
+
+  ClockHolder() = default;
+  explicit ClockHolder(pointer clock) noexcept : m_clock(std::move(clock)) {}
+
+  static time_point clock_now() noexcept(noexcept(ClockTraits<clock_t>::now()))
+  {
+    return ClockTraits<clock_t>::now();
+  }
+
+  void store_clock(pointer clock) noexcept { m_clock = std::move(clock); }
+
+  pointer stored_clock() const { return m_clock ? m_clock : std::make_shared<clock_t>(); }
+
+  static void clock_sleep_for(const std::chrono::nanoseconds & d)
+  {
+    std::this_thread::sleep_for(d);
+  }
+
+protected:
+  pointer m_clock;
 };
 
 }  // namespace cbr::detail
@@ -7,17 +7,196 @@
 #ifndef CBR_UTILS__CYBER_TIMER_HPP_
 #define CBR_UTILS__CYBER_TIMER_HPP_
 
+#include <algorithm>
+#include <array>
 #include <chrono>
+#include <cmath>
+#include <limits>
 #include <memory>
 #include <numeric>
 #include <type_traits>
 #include <utility>
 #include <vector>
 
+#include "clock_calibration.hpp"
 #include "clock_traits.hpp"
 
 namespace cbr {
 
+/**
+ * @brief Cumulative mean of timer durations, default CyberTimer statistics.
+ * @details A statistics policy provides reset(), update(double), count() and mean(), and any
+ * additional statistics accessible through CyberTimer::get_stats(). The sum of durations is
+ * accumulated so that no division happens on update.
+ */
+class CumulativeStats
+{
+public:
+  void reset() noexcept
+  {
+    m_count = 0;
+    m_sum   = 0.;
+  }
+
+  void update(const double x) noexcept
+  {
+    ++m_count;
+    m_sum += x;
+  }
+
+  const std::size_t & count() const noexcept { return m_count; }
+
+  double mean() const noexcept { return m_count == 0 ? 0. : m_sum / static_cast<double>(m_count); }
+
+protected:
+  std::size_t m_count = 0;
+  double m_sum        = 0.;
+};
+
+/**
+ * @brief Mean, variance, minimum and maximum of timer durations.
+ * @details Uses Welford's algorithm, which is numerically stable over any number of samples.
+ */
+class WelfordStats
+{
+public:
+  void reset() noexcept { *this = WelfordStats{}; }
+
+  void update(const double x) noexcept
+  {
+    ++m_count;
+    const double delta = x - m_mean;
+    m_mean += delta / static_cast<double>(m_count);
+    m_m2 += delta * (x - m_mean);
+    m_min = std::min(m_min, x);
+    m_max = std::max(m_max, x);
+  }
+
+  const std::size_t & count() const noexcept { return m_count; }
+
+  double mean() const noexcept { return m_mean; }
+
+  /**
+   * @brief Unbiased sample variance, 0 if less than two samples.
+   */
+  double variance() const noexcept
+  {
+    return m_count < 2 ? 0. : m_m2 / static_cast<double>(m_count - 1);
+  }
+
+  /**
+   * @brief Sample standard deviation, 0 if less than two samples.
+   */
+  double stddev() const noexcept { return std::sqrt(variance()); }
+
+  /**
+   * @brief Smallest sample, +inf if no samples.
+   */
+  double min() const noexcept { return m_min; }
+
+  /**
+   * @brief Largest sample, -inf if no samples.
+   */
+  double max() const noexcept { return m_max; }
+
+protected:
+  std::size_t m_count = 0;
+  double m_mean       = 0.;
+  double m_m2         = 0.;
+  double m_min        = std::numeric_limits<double>::infinity();
+  double m_max        = -std::numeric_limits<double>::infinity();
+};
+
+/**
+ * @brief Exponential moving average of timer durations.
+ * @details The weight of a sample is halved every half_life samples. The first sample initializes
+ * the average.
+ */
+class EmaStats
+{
+public:
+  /**
+   * @brief Construct a new EmaStats object.
+   *
+   * @param half_life Half-life in number of samples (default: 16).
+   */
+  explicit EmaStats(const double half_life = 16.) noexcept { set_half_life(half_life); }
+
+  /**
+   * @brief Set the half-life of the average.
+   *
+   * @param half_life Half-life in number of samples, must be positive.
+   */
+  void set_half_life(const double half_life) noexcept
+  {
+    m_alpha = 1. - std::exp2(-1. / half_life);
+  }
+
+  void reset() noexcept
+  {
+    m_count = 0;
+    m_mean  = 0.;
+  }
+
+  void update(const double x) noexcept
+  {
+    m_mean = m_count == 0 ? x : m_mean + m_alpha * (x - m_mean);
+    ++m_count;
+  }
+
+  const std::size_t & count() const noexcept { return m_count; }
+
+  double mean() const noexcept { return m_mean; }
+
+protected:
+  std::size_t m_count = 0;
+  double m_mean       = 0.;
+  double m_alpha      = 0.;
+};
+
+/**
+ * @brief Sliding mean of the last N timer durations.
+ * @details Samples are kept in a fixed size ring buffer, the mean is over the min(count(), N)
+ * latest samples.
+ *
+ * @tparam N Window size.
+ */
+template<std::size_t N>
+class WindowStats
+{
+  static_assert(N > 0, "Window size must be positive.");
+
+public:
+  void reset() noexcept
+  {
+    m_count = 0;
+    m_sum   = 0.;
+  }
+
+  void update(const double x) noexcept
+  {
+    auto & slot = m_buffer[m_count % N];
+    if (m_count >= N) { m_sum -= slot; }
+    slot = x;
+    m_sum += x;
+    ++m_count;
+    // recompute the sum once per window so that rounding errors do not accumulate
+    if (m_count % N == 0) { m_sum = std::accumulate(m_buffer.begin(), m_buffer.end(), 0.); }
+  }
+
+  const std::size_t & count() const noexcept { return m_count; }
+
+  double mean() const noexcept
+  {
+    return m_count == 0 ? 0. : m_sum / static_cast<double>(std::min(m_count, N));
+  }
+
+protected:
+  std::array<double, N> m_buffer{};
+  std::size_t m_count = 0;
+  double m_sum        = 0.;
+};
+
 /**
  * @brief Timer class with averaging capabilities
  * @details Has a couple of basic functionalities:
@@ -31,6 +210,13 @@ namespace cbr {
  *
  * If averaging functionality is active, the successive calls to toc (when timer is started) are
  * averaged and this average can be queried by calling get_average(), or reset by calling restart().
+ * The statistics are computed by stats_t, one of CumulativeStats (default), WelfordStats, EmaStats
+ * or WindowStats<N>, and are accessible through get_stats():
+ * ```
+ * CyberTimer<std::milli, double, std::chrono::steady_clock, true, WelfordStats> timer;
+ * // tic/toc...
+ * std::cout << timer.get_average() << " +- " << timer.get_stats().stddev() << std::endl;
+ * ```
  *
  * Example usage:
  * ```
@@ -46,18 +232,25 @@ namespace cbr {
  * ```
  * Notes:
  * - Clock is default constructed from specified type if not specified at construction or set.
+ * - Stateless clocks (see detail::is_stateless_clock), such as std::chrono clocks, are called
+ *   statically and the timer does not allocate them. Other clocks are shared through a
+ *   std::shared_ptr.
  *
  * @tparam ratio_t Duration units (default: std::ratio<1>, i.e. seconds)
  * @tparam T Duration underlying representation type (default: double)
  * @tparam clock_t Clock type (default: std::chrono::high_resolution_clock)
  * @tparam with_average Boolean value to activate averaging functionality (default: true)
+ * @tparam stats_t Statistics policy used if with_average==true (default: CumulativeStats)
  */
 template<typename ratio_t = std::ratio<1>,
   typename T              = double,
   typename clock_t        = std::chrono::high_resolution_clock,
-  bool with_average       = true>
-class CyberTimer
+  bool with_average       = true,
+  typename stats_t        = CumulativeStats>
+class CyberTimer : protected detail::ClockHolder<clock_t>
 {
+  using clock_holder_t = detail::ClockHolder<clock_t>;
+
   static_assert(
     std::is_arithmetic_v<T> && !std::is_same_v<T, bool>, "Type must be arithmetic but not bool.");
 
@@ -77,28 +270,36 @@ public:
    *
    * @param clock Shared pointer to a clock.
    */
-  explicit CyberTimer(const std::shared_ptr<clock_t> & clock) noexcept : clock_(clock) {}
+  explicit CyberTimer(const std::shared_ptr<clock_t> & clock) noexcept : clock_holder_t(clock) {}
 
   /**
    * @brief Construct a new CyberTimer object.
    *
    * @param clock Shared pointer to a clock.
    */
-  explicit CyberTimer(std::shared_ptr<clock_t> && clock) noexcept : clock_(std::move(clock)) {}
+  explicit CyberTimer(std::shared_ptr<clock_t> && clock) noexcept
+      : clock_holder_t(std::move(clock))
+  {}
 
   /**
    * @brief Set the timer's clock.
    *
    * @param clock Shared pointer to a clock.
    */
-  void set_clock(const std::shared_ptr<clock_t> & clock) noexcept { clock_ = clock; }
+  void set_clock(const std::shared_ptr<clock_t> & clock) noexcept
+  {
+    clock_holder_t::store_clock(clock);
+  }
 
   /**
    * @brief Set the timer's clock.
    *
    * @param clock Shared pointer to a clock.
    */
-  void set_clock(std::shared_ptr<clock_t> && clock) noexcept { clock_ = std::move(clock); }
+  void set_clock(std::shared_ptr<clock_t> && clock) noexcept
+  {
+    clock_holder_t::store_clock(std::move(clock));
+  }
 
   /**
    * @brief Current clock time.
@@ -106,7 +307,7 @@ public:
    *
    * @return Timepoint for current clock time.
    */
-  time_point_t now() const noexcept { return clock_->now(); }
+  time_point_t now() const noexcept { return clock_holder_t::clock_now(); }
 
   /**
    * @brief Starts timer to specified timepoint.
@@ -123,7 +324,7 @@ public:
    * @brief Starts timer to current clock time.
    *
    */
-  void tic() noexcept { tic(clock_->now()); }
+  void tic() noexcept { tic(now()); }
 
   /**
    * @brief Returns duration between specified timepoint and when timer was last started.
@@ -144,7 +345,7 @@ public:
    *
    * @return Duration between current clock timepoint and when timer was last started.
    */
-  duration_t tac_chrono() const noexcept { return tac_chrono(clock_->now()); }
+  duration_t tac_chrono() const noexcept { return tac_chrono(now()); }
 
   /**
    * @brief Returns duration between specified timepoint and when timer was last started.
@@ -178,10 +379,7 @@ public:
     if (running_) {
       running_ = false;
       dt_      = tac_chrono(t_stop);
-      if constexpr (with_average) {
-        i_++;
-        compute_avg();
-      }
+      if constexpr (with_average) { stats_.update(static_cast<double>(dt_.count())); }
     }
 
     return dt_;
@@ -196,7 +394,7 @@ public:
    *
    * @return Duration between current clock timepoint and when timer was last started.
    */
-  const duration_t & toc_chrono() noexcept { return toc_chrono(clock_->now()); }
+  const duration_t & toc_chrono() noexcept { return toc_chrono(now()); }
 
   /**
    * @brief Zero delay stop and restart of timer at specified time.
@@ -218,7 +416,7 @@ public:
    *
    * @return Duration between current clock timepoint and when timer was last started.
    */
-  const duration_t & toc_tic_chrono() noexcept { return toc_tic_chrono(clock_->now()); }
+  const duration_t & toc_tic_chrono() noexcept { return toc_tic_chrono(now()); }
 
   /**
    * @brief Stops timer at specified time.
@@ -274,8 +472,7 @@ public:
   template<typename _T = void>
   std::enable_if_t<with_average, _T> restart(const time_point_t t_start) noexcept
   {
-    avg_ = 0.;
-    i_   = 0;
+    stats_.reset();
     tic(t_start);
   }
 
@@ -286,7 +483,7 @@ public:
   template<typename _T = void>
   std::enable_if_t<with_average, _T> restart() noexcept
   {
-    restart(clock_->now());
+    restart(now());
   }
 
   /**
@@ -298,21 +495,45 @@ public:
   template<typename _T = const std::size_t &>
   std::enable_if_t<with_average, _T> get_average_count() const noexcept
   {
-    return i_;
+    return stats_.count();
   }
 
   /**
    * @brief Get average timer duration.
    * @details As a double, in the time unit specified by ratio_t, for all pairs of tic() and toc()
-   * calls since construction or last restart. Only available if with_average==true. if
-   * getAverageCount()==0, returns 0.
+   * calls since construction or last restart, as computed by stats_t. Only available if
+   * with_average==true. if getAverageCount()==0, returns 0.
    *
    * @return Average duration over all pairs of successive tic and toc calls.
    */
-  template<typename _T = const double &>
+  template<typename _T = double>
   std::enable_if_t<with_average, _T> get_average() const noexcept
   {
-    return avg_;
+    return stats_.mean();
+  }
+
+  /**
+   * @brief Get timer duration statistics.
+   * @details Only available if with_average==true.
+   *
+   * @return Statistics policy object, in the time unit specified by ratio_t.
+   */
+  template<typename _T = const stats_t &>
+  std::enable_if_t<with_average, _T> get_stats() const noexcept
+  {
+    return stats_;
+  }
+
+  /**
+   * @brief Get timer duration statistics, e.g. to configure them.
+   * @details Only available if with_average==true.
+   *
+   * @return Statistics policy object, in the time unit specified by ratio_t.
+   */
+  template<typename _T = stats_t &>
+  std::enable_if_t<with_average, _T> get_stats() noexcept
+  {
+    return stats_;
   }
 
   /**
@@ -340,28 +561,68 @@ public:
   auto get_latest() const noexcept { return dt_.count(); }
 
   /**
-   * @brief Get timer's clock.
+   * @brief Get the calibration of the timer's clock, see clock_calibration().
+   * @details Measured once per clock type on first call. Only available for stateless clocks.
    *
-   * @return Timer's clock.
+   * @return Overhead and resolution of the clock.
    */
-  std::shared_ptr<clock_t> get_clock() const { return clock_; }
+  template<typename _T = const ClockCalibration &>
+  static std::enable_if_t<detail::is_stateless_clock_v<clock_t>, _T> get_calibration()
+  {
+    return clock_calibration<clock_t>();
+  }
 
-protected:
   /**
-   * @brief Update average timer duration value
+   * @brief Get latest timer duration minus the clock overhead.
+   * @details Clamped to zero. Only available for stateless clocks.
+   *
+   * @return Duration over latest successive tic and toc calls without the cost of the clock reads.
    */
-  template<typename _T = void>
-  std::enable_if_t<with_average, _T> compute_avg() noexcept
+  template<typename _T = duration_t>
+  std::enable_if_t<detail::is_stateless_clock_v<clock_t>, _T> get_latest_corrected_chrono() const
   {
-    avg_ = (static_cast<double>(i_ - 1) * avg_ + static_cast<double>(dt_.count()))
-         / static_cast<double>(i_);
+    const auto overhead = std::chrono::duration_cast<duration_t>(get_calibration().overhead);
+    return dt_ > overhead ? dt_ - overhead : duration_t::zero();
   }
 
+  /**
+   * @brief Get latest timer duration minus the clock overhead.
+   * @details Clamped to zero. Only available for stateless clocks.
+   *
+   * @return Duration over latest successive tic and toc calls without the cost of the clock reads.
+   */
+  template<typename _T = T>
+  std::enable_if_t<detail::is_stateless_clock_v<clock_t>, _T> get_latest_corrected() const
+  {
+    return get_latest_corrected_chrono().count();
+  }
+
+  /**
+   * @brief Check if the latest timer duration is at least the clock resolution.
+   * @details Durations below the resolution are dominated by the clock granularity and should not
+   * be trusted. Only available for stateless clocks.
+   */
+  template<typename _T = bool>
+  std::enable_if_t<detail::is_stateless_clock_v<clock_t>, _T> is_latest_resolved() const
+  {
+    return dt_ >= get_calibration().resolution;
+  }
+
+  /**
+   * @brief Get timer's clock.
+   *
+   * @return Timer's clock.
+   */
+  std::shared_ptr<clock_t> get_clock() const { return clock_holder_t::stored_clock(); }
+
 protected:
-  std::shared_ptr<clock_t> clock_ = std::make_shared<clock_t>();
-  std::size_t i_                  = 0;
+  /// @cond
+  struct NoStats
+  {};
+  /// @endcond
+
+  std::conditional_t<with_average, stats_t, NoStats> stats_{};
   duration_t dt_{};
-  double avg_   = 0.;
   bool running_ = false;
   time_point_t t_start_{};
 };
@@ -380,8 +641,9 @@ using CyberTimerNoAvg = CyberTimer<ratio_t, T, clock_t, false>;
  */
 template<typename T = int64_t,
   typename clock_t  = std::chrono::high_resolution_clock,
-  bool with_average = true>
-using CyberTimerMilli = CyberTimer<std::milli, T, clock_t, with_average>;
+  bool with_average = true,
+  typename stats_t  = CumulativeStats>
+using CyberTimerMilli = CyberTimer<std::milli, T, clock_t, with_average, stats_t>;
 
 /**
  * @brief Alias for a cyberTimer template with microseconds units and int64_t default duration
@@ -389,8 +651,9 @@ using CyberTimerMilli = CyberTimer<std::milli, T, clock_t, with_average>;
  */
 template<typename T = int64_t,
   typename clock_t  = std::chrono::high_resolution_clock,
-  bool with_average = true>
-using CyberTimerMicro = CyberTimer<std::micro, T, clock_t, with_average>;
+  bool with_average = true,
+  typename stats_t  = CumulativeStats>
+using CyberTimerMicro = CyberTimer<std::micro, T, clock_t, with_average, stats_t>;
 
 /**
  * @brief Alias for a cyberTimer template with nanoseconds units and int64_t default duration
@@ -398,8 +661,9 @@ using CyberTimerMicro = CyberTimer<std::micro, T, clock_t, with_average>;
  */
 template<typename T = int64_t,
   typename clock_t  = std::chrono::high_resolution_clock,
-  bool with_average = true>
-using CyberTimerNano = CyberTimer<std::nano, T, clock_t, with_average>;
+  bool with_average = true,
+  typename stats_t  = CumulativeStats>
+using CyberTimerNano = CyberTimer<std::nano, T, clock_t, with_average, stats_t>;
 
 }  // namespace cbr
 
@@ -0,0 +1,1181 @@
+// Copyright Yamaha 2021
+// MIT License
+// https://github.com/yamaha-bps/cbr_utils/blob/master/LICENSE
+
+/** @file */
+
+#ifndef CBR_UTILS__FLAT_MAP_HPP_
+#define CBR_UTILS__FLAT_MAP_HPP_
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "utils.hpp"
+
+namespace cbr {
+
+/**
+ * @brief Transparent string hash.
+ * @details Hashes std::string, std::string_view and C strings alike, so that maps keyed by
+ * std::string can be searched with a std::string_view without constructing a std::string.
+ */
+struct string_hash
+{
+  using is_transparent = void;
+
+  std::size_t operator()(const std::string_view s) const noexcept
+  {
+    return std::hash<std::string_view>{}(s);
+  }
+};
+
+/**
+ * @brief Transparent string equality, see string_hash.
+ */
+struct string_equal
+{
+  using is_transparent = void;
+
+  bool operator()(const std::string_view a, const std::string_view b) const noexcept
+  {
+    return a == b;
+  }
+};
+
+/**
+ * @brief Transparent case-insensitive string hash.
+ * @details Consistent with ci_string_equal, i.e. with strcmpi() of utils.hpp.
+ */
+struct ci_string_hash
+{
+  using is_transparent = void;
+
+  std::size_t operator()(const std::string_view s) const noexcept
+  {
+    // FNV-1a
+    uint64_t h = 14695981039346656037ULL;
+    for (const unsigned char c : s) {
+      h ^= static_cast<uint64_t>(std::toupper(c));
+      h *= 1099511628211ULL;
+    }
+    return static_cast<std::size_t>(h);
+  }
+};
+
+/**
+ * @brief Transparent case-insensitive string equality, see strcmpi().
+ */
+struct ci_string_equal
+{
+  using is_transparent = void;
+
+  bool operator()(const std::string_view a, const std::string_view b) const noexcept
+  {
+    return strcmpi(a, b);
+  }
+};
+
+/**
+ * @brief Transparent case-insensitive string ordering.
+ */
+struct ci_string_less
+{
+  using is_transparent = void;
+
+  bool operator()(const std::string_view a, const std::string_view b) const noexcept
+  {
+    return std::lexicographical_compare(
+      a.begin(), a.end(), b.begin(), b.end(), [](unsigned char c1, unsigned char c2) {
+        return std::toupper(c1) < std::toupper(c2);
+      });
+  }
+};
+
+/// @cond
+namespace detail {
+
+// Control byte of a slot: empty, deleted, end sentinel, or the 7 low bits of the hash if full
+using ctrl_t = int8_t;
+
+inline constexpr ctrl_t ctrl_empty    = -128;
+inline constexpr ctrl_t ctrl_deleted  = -2;
+inline constexpr ctrl_t ctrl_sentinel = -1;
+
+inline uint32_t lowest_bit(const uint32_t mask) noexcept
+{
+#if defined(__GNUC__)
+  return static_cast<uint32_t>(__builtin_ctz(mask));
+#else
+  uint32_t i = 0;
+  while (((mask >> i) & 1) == 0) { ++i; }
+  return i;
+#endif
+}
+
+// Control bytes of 16 consecutive slots, compared at once with SSE2 when available
+class CtrlGroup
+{
+public:
+  static constexpr std::size_t width = 16;
+
+#if defined(__SSE2__)
+  explicit CtrlGroup(const ctrl_t * p) noexcept
+      : m_ctrl(_mm_load_si128(reinterpret_cast<const __m128i *>(p)))
+  {}
+
+  // bit i is set if slot i has control byte c
+  uint32_t match(const ctrl_t c) const noexcept
+  {
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(m_ctrl, _mm_set1_epi8(c))));
+  }
+
+  uint32_t match_empty_or_deleted() const noexcept
+  {
+    return static_cast<uint32_t>(
+      _mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(ctrl_sentinel), m_ctrl)));
+  }
+
+private:
+  __m128i m_ctrl;
+#else
+  explicit CtrlGroup(const ctrl_t * p) noexcept { std::memcpy(m_ctrl, p, width); }
+
+  uint32_t match(const ctrl_t c) const noexcept
+  {
+    uint32_t res = 0;
+    for (std::size_t i = 0; i < width; ++i) {
+      if (m_ctrl[i] == c) { res |= uint32_t{1} << i; }
+    }
+    return res;
+  }
+
+  uint32_t match_empty_or_deleted() const noexcept
+  {
+    uint32_t res = 0;
+    for (std::size_t i = 0; i < width; ++i) {
+      if (m_ctrl[i] < ctrl_sentinel) { res |= uint32_t{1} << i; }
+    }
+    return res;
+  }
+
+private:
+  ctrl_t m_ctrl[width];
+#endif
+
+public:
+  uint32_t match_empty() const noexcept { return match(ctrl_empty); }
+};
+
+template<typename T, typename = void>
+struct has_is_transparent : std::false_type
+{};
+
+template<typename T>
+struct has_is_transparent<T, std::void_t<typename T::is_transparent>> : std::true_type
+{};
+
+}  // namespace detail
+/// @endcond
+
+/**
+ * @brief Open addressing hash map with SIMD probing.
+ * @details Swiss table design: elements are stored in a flat array of slots, and a parallel array
+ * holds one control byte per slot with 7 bits of the hash of its key. A lookup loads the control
+ * bytes of 16 slots at once and compares them to the hash with SSE2 instructions, so that keys are
+ * only compared for the few slots whose control byte matches. There are no per-element allocations
+ * and a lookup usually touches two cache lines.
+ *
+ * The interface follows std::unordered_map. Lookups with a type other than Key, e.g. a
+ * std::string_view in a map keyed by std::string, are enabled when Hash and KeyEqual define
+ * is_transparent, see string_hash and ci_string_hash.
+ *
+ * Example:
+ * ```
+ * flat_hash_map<std::string, Route, string_hash, string_equal> routes;
+ * routes.try_emplace("camera/left", route);
+ *
+ * const std::string_view topic = msg.topic();
+ * if (auto it = routes.find(topic); it != routes.end()) { it->second.publish(msg); }
+ * ```
+ * Notes:
+ * - Insertions may move the elements and invalidate references and iterators, unlike
+ *   std::unordered_map. Erasures only invalidate the erased elements.
+ * - Maximal load factor is 7/8.
+ *
+ * @tparam Key Key type.
+ * @tparam T Mapped type.
+ * @tparam Hash Hash function object.
+ * @tparam KeyEqual Key equality function object.
+ */
+template<typename Key,
+  typename T,
+  typename Hash     = std::hash<Key>,
+  typename KeyEqual = std::equal_to<Key>>
+class flat_hash_map
+{
+  using ctrl_t = detail::ctrl_t;
+  using group_t = detail::CtrlGroup;
+
+  static constexpr bool transparent = detail::has_is_transparent<Hash>::value
+                                   && detail::has_is_transparent<KeyEqual>::value;
+
+
+public:
+  using key_type        = Key;
+  using mapped_type     = T;
+  using value_type      = std::pair<const Key, T>;
+  using size_type       = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using hasher          = Hash;
+  using key_equal       = KeyEqual;
+  using reference       = value_type &;
+  using const_reference = const value_type &;
+
+  /**
+   * @brief Forward iterator over the elements.
+   */
+  template<bool Const>
+  class Iterator
+  {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type        = flat_hash_map::value_type;
+    using difference_type   = std::ptrdiff_t;
+    using pointer   = std::conditional_t<Const, const value_type *, value_type *>;
+    using reference = std::conditional_t<Const, const value_type &, value_type &>;
+
+    Iterator() = default;
+
+    template<bool C = Const, typename = std::enable_if_t<C>>
+    Iterator(const Iterator<false> & o) noexcept  // NOLINT
+        : m_ctrl(o.m_ctrl), m_slot(o.m_slot)
+    {}
+
+    reference operator*() const noexcept { return *m_slot; }
+    pointer operator->() const noexcept { return m_slot; }
+
+    Iterator & operator++() noexcept
+    {
+      ++m_ctrl;
+      ++m_slot;
+      skip();
+      return *this;
+    }
+
+    Iterator operator++(int) noexcept
+    {
+      auto res = *this;
+      ++*this;
+      return res;
+    }
+
+    friend bool operator==(const Iterator & a, const Iterator & b) noexcept
+    {
+      return a.m_slot == b.m_slot;
+    }
+
+    friend bool operator!=(const Iterator & a, const Iterator & b) noexcept
+    {
+      return a.m_slot != b.m_slot;
+    }
+
+  private:
+    friend class flat_hash_map;
+    template<bool>
+    friend class Iterator;
+
+    Iterator(const ctrl_t * ctrl, pointer slot) noexcept : m_ctrl(ctrl), m_slot(slot) {}
+
+    // advance to the next full slot or to the sentinel
+    void skip() noexcept
+    {
+      while (*m_ctrl < detail::ctrl_sentinel) {
+        ++m_ctrl;
+        ++m_slot;
+      }
+    }
+
+    const ctrl_t * m_ctrl = nullptr;
+    pointer m_slot        = nullptr;
+  };
+
+  using iterator       = Iterator<false>;
+  using const_iterator = Iterator<true>;
+
+  // lookups accept any type if transparent, else types convertible to Key
+  template<typename K>
+  using lookup_t = std::enable_if_t<!std::is_convertible_v<const K &, const_iterator>
+                                    && (transparent || std::is_convertible_v<const K &, Key>)>;
+
+  template<typename K>
+  static decltype(auto) lookup_key(const K & key)
+  {
+    if constexpr (transparent || std::is_same_v<K, Key>) {
+      return (key);
+    } else {
+      return Key(key);
+    }
+  }
+
+  flat_hash_map() = default;
+
+  /**
+   * @brief Construct an empty map with room for n elements.
+   */
+  explicit flat_hash_map(
+    const size_type n, const Hash & hash = Hash(), const KeyEqual & equal = KeyEqual())
+      : m_hash(hash), m_equal(equal)
+  {
+    reserve(n);
+  }
+
+  /**
+   * @brief Construct a map with the elements of a range, the first of equal keys is kept.
+   */
+  template<typename It,
+    typename = std::enable_if_t<std::is_base_of_v<std::input_iterator_tag,
+      typename std::iterator_traits<It>::iterator_category>>>
+  flat_hash_map(It first, const It last)
+  {
+    insert(first, last);
+  }
+
+  /**
+   * @brief Construct a map with the elements of an initializer list.
+   */
+  flat_hash_map(std::initializer_list<value_type> il) { insert(il); }
+
+  flat_hash_map(const flat_hash_map & o) : m_hash(o.m_hash), m_equal(o.m_equal)
+  {
+    reserve(o.size());
+    for (const auto & v : o) { try_emplace(v.first, v.second); }
+  }
+
+  flat_hash_map(flat_hash_map && o) noexcept
+      : m_hash(std::move(o.m_hash)), m_equal(std::move(o.m_equal))
+  {
+    steal(o);
+  }
+
+  flat_hash_map & operator=(const flat_hash_map & o)
+  {
+    if (this != &o) {
+      flat_hash_map tmp(o);
+      swap(tmp);
+    }
+    return *this;
+  }
+
+  flat_hash_map & operator=(flat_hash_map && o) noexcept
+  {
+    if (this != &o) {
+      release();
+      m_hash  = std::move(o.m_hash);
+      m_equal = std::move(o.m_equal);
+      steal(o);
+    }
+    return *this;
+  }
+
+  ~flat_hash_map() { release(); }
+
+  // iterators
+
+  iterator begin() noexcept
+  {
+    iterator it(m_ctrl, m_slots);
+    if (m_capacity > 0) { it.skip(); }
+    return it;
+  }
+
+  const_iterator begin() const noexcept { return const_cast<flat_hash_map *>(this)->begin(); }
+  const_iterator cbegin() const noexcept { return begin(); }
+
+  iterator end() noexcept { return iterator(m_ctrl + m_capacity, m_slots + m_capacity); }
+  const_iterator end() const noexcept { return const_cast<flat_hash_map *>(this)->end(); }
+  const_iterator cend() const noexcept { return end(); }
+
+  // capacity
+
+  bool empty() const noexcept { return m_size == 0; }
+  size_type size() const noexcept { return m_size; }
+
+  /**
+   * @brief Number of slots.
+   */
+  size_type capacity() const noexcept { return m_capacity; }
+
+  float load_factor() const noexcept
+  {
+    return m_capacity == 0 ? 0.f : static_cast<float>(m_size) / static_cast<float>(m_capacity);
+  }
+
+  static constexpr float max_load_factor() noexcept { return 0.875f; }
+
+  /**
+   * @brief Make room for n elements without rehashing.
+   */
+  void reserve(const size_type n)
+  {
+    if (n > max_elements(m_capacity)) { resize(capacity_for(n)); }
+  }
+
+  // modifiers
+
+  void clear() noexcept
+  {
+    destroy_elements();
+    if (m_capacity > 0) {
+      std::memset(m_ctrl, detail::ctrl_empty, m_capacity);
+      m_growth_left = max_elements(m_capacity);
+    }
+    m_size = 0;
+  }
+
+  /**
+   * @brief Insert an element constructed from args if the key is not present.
+   * @details args are not used if the key is present.
+   *
+   * @return Iterator to the element with the key, and true if it was inserted.
+   */
+  template<typename... Args>
+  std::pair<iterator, bool> try_emplace(const Key & key, Args &&... args)
+  {
+    return try_emplace_impl(key, std::forward<Args>(args)...);
+  }
+
+  template<typename... Args>
+  std::pair<iterator, bool> try_emplace(Key && key, Args &&... args)
+  {
+    return try_emplace_impl(std::move(key), std::forward<Args>(args)...);
+  }
+
+  /**
+   * @brief Heterogeneous try_emplace, Key is constructed from key only if it is not present.
+   */
+  template<typename K,
+    typename... Args,
+    typename = std::enable_if_t<transparent && !std::is_convertible_v<K &&, const Key &>
+                                && std::is_constructible_v<Key, K &&>>>
+  std::pair<iterator, bool> try_emplace(K && key, Args &&... args)
+  {
+    return try_emplace_impl(std::forward<K>(key), std::forward<Args>(args)...);
+  }
+
+  template<typename... Args>
+  std::pair<iterator, bool> emplace(Args &&... args)
+  {
+    value_type v(std::forward<Args>(args)...);
+    return try_emplace_impl(v.first, std::move(v.second));
+  }
+
+  std::pair<iterator, bool> insert(const value_type & v)
+  {
+    return try_emplace_impl(v.first, v.second);
+  }
+
+  std::pair<iterator, bool> insert(value_type && v)
+  {
+    return try_emplace_impl(v.first, std::move(v.second));
+  }
+
+  template<typename It>
+  void insert(It first, const It last)
+  {
+    for (; first != last; ++first) { insert(*first); }
+  }
+
+  void insert(std::initializer_list<value_type> il) { insert(il.begin(), il.end()); }
+
+  /**
+   * @brief Insert an element or assign to the mapped value if the key is present.
+   */
+  template<typename M>
+  std::pair<iterator, bool> insert_or_assign(const Key & key, M && obj)
+  {
+    auto res = try_emplace_impl(key, std::forward<M>(obj));
+    if (!res.second) { res.first->second = std::forward<M>(obj); }
+    return res;
+  }
+
+  template<typename M>
+  std::pair<iterator, bool> insert_or_assign(Key && key, M && obj)
+  {
+    auto res = try_emplace_impl(std::move(key), std::forward<M>(obj));
+    if (!res.second) { res.first->second = std::forward<M>(obj); }
+    return res;
+  }
+
+  /**
+   * @brief Remove an element.
+   * @return Iterator to the next element.
+   */
+  iterator erase(const_iterator pos)
+  {
+    iterator it(pos.m_ctrl, const_cast<value_type *>(pos.m_slot));
+    erase_at(static_cast<size_type>(it.m_slot - m_slots));
+    it.skip();
+    return it;
+  }
+
+  iterator erase(iterator pos) { return erase(const_iterator(pos)); }
+
+  /**
+   * @brief Remove the element with a key.
+   * @return Number of elements removed.
+   */
+  template<typename K = Key, typename = lookup_t<K>>
+  size_type erase(const K & key)
+  {
+    const auto it = find(key);
+    if (it == end()) { return 0; }
+    erase_at(static_cast<size_type>(it.m_slot - m_slots));
+    return 1;
+  }
+
+  void swap(flat_hash_map & o) noexcept
+  {
+    using std::swap;
+    swap(m_ctrl, o.m_ctrl);
+    swap(m_slots, o.m_slots);
+    swap(m_capacity, o.m_capacity);
+    swap(m_size, o.m_size);
+    swap(m_growth_left, o.m_growth_left);
+    swap(m_hash, o.m_hash);
+    swap(m_equal, o.m_equal);
+  }
+
+  friend void swap(flat_hash_map & a, flat_hash_map & b) noexcept { a.swap(b); }
+
+  // lookup
+
+  T & operator[](const Key & key) { return try_emplace_impl(key).first->second; }
+  T & operator[](Key && key) { return try_emplace_impl(std::move(key)).first->second; }
+
+  /**
+   * @brief Access the mapped value of a key.
+   * @details Throws std::out_of_range if the key is not present.
+   */
+  template<typename K = Key, typename = lookup_t<K>>
+  T & at(const K & key)
+  {
+    const auto it = find(key);
+    if (it == end()) { throw std::out_of_range("Key not found in flat_hash_map."); }
+    return it->second;
+  }
+
+  template<typename K = Key, typename = lookup_t<K>>
+  const T & at(const K & key) const
+  {
+    return const_cast<flat_hash_map *>(this)->at<K>(key);
+  }
+
+  template<typename K = Key, typename = lookup_t<K>>
+  iterator find(const K & key)
+  {
+    const auto & k     = lookup_key(key);
+    const size_type idx = find_index(k, hash_of(k));
+    return idx == npos ? end() : iterator(m_ctrl + idx, m_slots + idx);
+  }
+
+  template<typename K = Key, typename = lookup_t<K>>
+  const_iterator find(const K & key) const
+  {
+    return const_cast<flat_hash_map *>(this)->find<K>(key);
+  }
+
+  template<typename K = Key, typename = lookup_t<K>>
+  bool contains(const K & key) const
+  {
+    const auto & k = lookup_key(key);
+    return find_index(k, hash_of(k)) != npos;
+  }
+
+  template<typename K = Key, typename = lookup_t<K>>
+  size_type count(const K & key) const
+  {
+    return contains<K>(key) ? 1 : 0;
+  }
+
+  hasher hash_function() const { return m_hash; }
+  key_equal key_eq() const { return m_equal; }
+
+  friend bool operator==(const flat_hash_map & a, const flat_hash_map & b)
+  {
+    if (a.size() != b.size()) { return false; }
+    for (const auto & v : a) {
+      const auto it = b.find(v.first);
+      if (it == b.end() || !(it->second == v.second)) { return false; }
+    }
+    return true;
+  }
+
+  friend bool operator!=(const flat_hash_map & a, const flat_hash_map & b) { return !(a == b); }
+
+protected:
+  /// @cond
+  static constexpr size_type npos  = static_cast<size_type>(-1);
+  static constexpr size_type width = group_t::width;
+
+  static size_type max_elements(const size_type capacity) noexcept
+  {
+    return capacity - capacity / 8;
+  }
+
+  static size_type capacity_for(const size_type n) noexcept
+  {
+    size_type cap = width;
+    while (max_elements(cap) < n) { cap *= 2; }
+    return cap;
+  }
+
+  template<typename K>
+  std::size_t hash_of(const K & key) const noexcept
+  {
+    // spread the bits, std::hash of integers is the identity
+    const uint64_t x = static_cast<uint64_t>(m_hash(key)) * 0x9E3779B97F4A7C15ULL;
+    return static_cast<std::size_t>(x ^ (x >> 32));
+  }
+
+  static ctrl_t h2(const std::size_t h) noexcept { return static_cast<ctrl_t>(h & 0x7F); }
+
+  // index of the first slot of the first group in the probe sequence
+  size_type probe_start(const std::size_t h) const noexcept
+  {
+    return ((h >> 7) * width) & (m_capacity - 1);
+  }
+
+  // next group in the probe sequence, triangular steps visit every group
+  size_type probe_next(const size_type pos, const size_type i) const noexcept
+  {
+    return (pos + i * width) & (m_capacity - 1);
+  }
+
+  template<typename K>
+  size_type find_index(const K & key, const std::size_t h) const
+  {
+    if (m_capacity == 0) { return npos; }
+    size_type pos = probe_start(h);
+    for (size_type i = 1;; ++i) {
+      const group_t g(m_ctrl + pos);
+      for (uint32_t m = g.match(h2(h)); m != 0; m &= m - 1) {
+        const size_type idx = pos + detail::lowest_bit(m);
+        if (m_equal(m_slots[idx].first, key)) { return idx; }
+      }
+      if (g.match_empty() != 0) { return npos; }
+      pos = probe_next(pos, i);
+    }
+  }
+
+  size_type find_first_non_full(const std::size_t h) const noexcept
+  {
+    size_type pos = probe_start(h);
+    for (size_type i = 1;; ++i) {
+      const uint32_t m = group_t(m_ctrl + pos).match_empty_or_deleted();
+      if (m != 0) { return pos + detail::lowest_bit(m); }
+      pos = probe_next(pos, i);
+    }
+  }
+
+  template<typename K, typename... Args>
+  std::pair<iterator, bool> try_emplace_impl(K && key, Args &&... args)
+  {
+    const std::size_t h = hash_of(key);
+    size_type idx       = find_index(key, h);
+    if (idx != npos) { return {iterator(m_ctrl + idx, m_slots + idx), false}; }
+
+    if (m_capacity == 0) { resize(width); }
+    idx = find_first_non_full(h);
+    if (m_growth_left == 0 && m_ctrl[idx] == detail::ctrl_empty) {
+      // double the capacity, or only drop the deleted slots if there are many
+      resize(m_size + 1 > max_elements(m_capacity) / 2 ? 2 * m_capacity : m_capacity);
+      idx = find_first_non_full(h);
+    }
+
+    ::new (static_cast<void *>(m_slots + idx)) value_type(std::piecewise_construct,
+      std::forward_as_tuple(std::forward<K>(key)),
+      std::forward_as_tuple(std::forward<Args>(args)...));
+    if (m_ctrl[idx] == detail::ctrl_empty) { --m_growth_left; }
+    m_ctrl[idx] = h2(h);
+    ++m_size;
+    return {iterator(m_ctrl + idx, m_slots + idx), true};
+  }
+
+  void erase_at(const size_type idx) noexcept
+  {
+    m_slots[idx].~value_type();
+    --m_size;
+    // probes stop at groups with an empty slot, so no probe goes past this group
+    if (group_t(m_ctrl + (idx & ~(width - 1))).match_empty() != 0) {
+      m_ctrl[idx] = detail::ctrl_empty;
+      ++m_growth_left;
+    } else {
+      m_ctrl[idx] = detail::ctrl_deleted;
+    }
+  }
+
+  // move the elements to new arrays of a given capacity, strong exception guarantee
+  void resize(const size_type capacity)
+  {
+    flat_hash_map tmp;
+    tmp.m_hash     = m_hash;
+    tmp.m_equal    = m_equal;
+    tmp.m_capacity = capacity;
+    tmp.m_ctrl     = static_cast<ctrl_t *>(
+      ::operator new(capacity + width, std::align_val_t{alignof(std::max_align_t) * 2}));
+    std::memset(tmp.m_ctrl, detail::ctrl_empty, capacity + width);
+    tmp.m_ctrl[capacity] = detail::ctrl_sentinel;
+    try {
+      tmp.m_slots = std::allocator<value_type>{}.allocate(capacity);
+    } catch (...) {
+      tmp.m_capacity = 0;
+      ::operator delete(tmp.m_ctrl, std::align_val_t{alignof(std::max_align_t) * 2});
+      tmp.m_ctrl = nullptr;
+      throw;
+    }
+    tmp.m_growth_left = max_elements(capacity);
+
+    for (size_type i = 0; i < m_capacity; ++i) {
+      if (m_ctrl[i] < 0) { continue; }
+      const std::size_t h = tmp.hash_of(m_slots[i].first);
+      const size_type idx = tmp.find_first_non_full(h);
+      if constexpr (std::is_nothrow_move_constructible_v<Key>
+                    && std::is_nothrow_move_constructible_v<T>) {
+        // the source slot is destroyed afterwards, so its key can be moved despite being const
+        ::new (static_cast<void *>(tmp.m_slots + idx)) value_type(std::piecewise_construct,
+          std::forward_as_tuple(std::move(const_cast<Key &>(m_slots[i].first))),
+          std::forward_as_tuple(std::move(m_slots[i].second)));
+      } else {
+        ::new (static_cast<void *>(tmp.m_slots + idx)) value_type(m_slots[i]);
+      }
+      tmp.m_ctrl[idx] = h2(h);
+      --tmp.m_growth_left;
+      ++tmp.m_size;
+    }
+    swap(tmp);
+  }
+
+  void destroy_elements() noexcept
+  {
+    if constexpr (!std::is_trivially_destructible_v<value_type>) {
+      for (size_type i = 0; i < m_capacity; ++i) {
+        if (m_ctrl[i] >= 0) { m_slots[i].~value_type(); }
+      }
+    }
+  }
+
+  void release() noexcept
+  {
+    if (m_capacity == 0) { return; }
+    destroy_elements();
+    std::allocator<value_type>{}.deallocate(m_slots, m_capacity);
+    ::operator delete(m_ctrl, std::align_val_t{alignof(std::max_align_t) * 2});
+    m_ctrl        = nullptr;
+    m_slots       = nullptr;
+    m_capacity    = 0;
+    m_size        = 0;
+    m_growth_left = 0;
+  }
+
+  void steal(flat_hash_map & o) noexcept
+  {
+    m_ctrl        = std::exchange(o.m_ctrl, nullptr);
+    m_slots       = std::exchange(o.m_slots, nullptr);
+    m_capacity    = std::exchange(o.m_capacity, 0);
+    m_size        = std::exchange(o.m_size, 0);
+    m_growth_left = std::exchange(o.m_growth_left, 0);
+  }
+
+  ctrl_t * m_ctrl         = nullptr;
+  value_type * m_slots    = nullptr;
+  size_type m_capacity    = 0;
+  size_type m_size        = 0;
+  size_type m_growth_left = 0;
+  Hash m_hash{};
+  KeyEqual m_equal{};
+  /// @endcond
+};
+
+/**
+ * @brief Hash map keyed by std::string with std::string_view lookups.
+ */
+template<typename T>
+using string_hash_map = flat_hash_map<std::string, T, string_hash, string_equal>;
+
+/**
+ * @brief Hash map keyed by case-insensitive std::string with std::string_view lookups.
+ */
+template<typename T>
+using ci_string_hash_map = flat_hash_map<std::string, T, ci_string_hash, ci_string_equal>;
+
+/**
+ * @brief Ordered map stored as a sorted vector.
+ * @details The interface follows std::map. Lookups are binary searches over contiguous memory and
+ * iteration is a linear scan, both much faster than in a node based tree, while insertions and
+ * erasures move the following elements. Best for maps built once and searched often, e.g.
+ * configuration keys. Lookups with a type other than Key are enabled when Compare defines
+ * is_transparent, e.g. std::less<> or ci_string_less.
+ *
+ * Example:
+ * ```
+ * flat_map<std::string, double, std::less<>> params{{"gain", 1.5}, {"offset", 0.}};
+ * const double gain = params.at(std::string_view("gain"));
+ * ```
+ * Notes:
+ * - value_type is std::pair<Key, T>, keys must not be modified through iterators.
+ * - Insertions and erasures invalidate references and iterators.
+ *
+ * @tparam Key Key type.
+ * @tparam T Mapped type.
+ * @tparam Compare Key ordering function object.
+ */
+template<typename Key, typename T, typename Compare = std::less<Key>>
+class flat_map
+{
+  static constexpr bool transparent = detail::has_is_transparent<Compare>::value;
+
+
+public:
+  using key_type               = Key;
+  using mapped_type            = T;
+  using value_type             = std::pair<Key, T>;
+  using container_type         = std::vector<value_type>;
+  using size_type              = std::size_t;
+  using difference_type        = std::ptrdiff_t;
+  using key_compare            = Compare;
+  using reference              = value_type &;
+  using const_reference        = const value_type &;
+  using iterator               = typename container_type::iterator;
+  using const_iterator         = typename container_type::const_iterator;
+  using reverse_iterator       = typename container_type::reverse_iterator;
+  using const_reverse_iterator = typename container_type::const_reverse_iterator;
+
+  // lookups accept any type if transparent, else types convertible to Key
+  template<typename K>
+  using lookup_t = std::enable_if_t<!std::is_convertible_v<const K &, const_iterator>
+                                    && (transparent || std::is_convertible_v<const K &, Key>)>;
+
+  template<typename K>
+  static decltype(auto) lookup_key(const K & key)
+  {
+    if constexpr (transparent || std::is_same_v<K, Key>) {
+      return (key);
+    } else {
+      return Key(key);
+    }
+  }
+
+  flat_map() = default;
+
+  explicit flat_map(const Compare & comp) : m_comp(comp) {}
+
+  /**
+   * @brief Construct a map from a container of elements in any order.
+   * @details The elements are sorted, the first of equal keys is kept.
+   */
+  explicit flat_map(container_type data, const Compare & comp = Compare())
+      : m_data(std::move(data)), m_comp(comp)
+  {
+    sort_unique(0);
+  }
+
+  /**
+   * @brief Construct a map with the elements of a range, the first of equal keys is kept.
+   */
+  template<typename It,
+    typename = std::enable_if_t<std::is_base_of_v<std::input_iterator_tag,
+      typename std::iterator_traits<It>::iterator_category>>>
+  flat_map(It first, const It last, const Compare & comp = Compare())
+      : m_data(first, last), m_comp(comp)
+  {
+    sort_unique(0);
+  }
+
+  /**
+   * @brief Construct a map with the elements of an initializer list.
+   */
+  flat_map(std::initializer_list<value_type> il, const Compare & comp = Compare())
+      : flat_map(il.begin(), il.end(), comp)
+  {}
+
+  // iterators
+
+  iterator begin() noexcept { return m_data.begin(); }
+  const_iterator begin() const noexcept { return m_data.begin(); }
+  const_iterator cbegin() const noexcept { return m_data.cbegin(); }
+  iterator end() noexcept { return m_data.end(); }
+  const_iterator end() const noexcept { return m_data.end(); }
+  const_iterator cend() const noexcept { return m_data.cend(); }
+  reverse_iterator rbegin() noexcept { return m_data.rbegin(); }
+  const_reverse_iterator rbegin() const noexcept { return m_data.rbegin(); }
+  reverse_iterator rend() noexcept { return m_data.rend(); }
+  const_reverse_iterator rend() const noexcept { return m_data.rend(); }
+
+  // capacity
+
+  bool empty() const noexcept { return m_data.empty(); }
+  size_type size() const noexcept { return m_data.size(); }
+  size_type capacity() const noexcept { return m_data.capacity(); }
+  void reserve(const size_type n) { m_data.reserve(n); }
+  void shrink_to_fit() { m_data.shrink_to_fit(); }
+
+  // modifiers
+
+  void clear() noexcept { m_data.clear(); }
+
+  /**
+   * @brief Insert an element constructed from args if the key is not present.
+   * @details args are not used if the key is present.
+   *
+   * @return Iterator to the element with the key, and true if it was inserted.
+   */
+  template<typename... Args>
+  std::pair<iterator, bool> try_emplace(const Key & key, Args &&... args)
+  {
+    return try_emplace_impl(key, std::forward<Args>(args)...);
+  }
+
+  template<typename... Args>
+  std::pair<iterator, bool> try_emplace(Key && key, Args &&... args)
+  {
+    return try_emplace_impl(std::move(key), std::forward<Args>(args)...);
+  }
+
+  /**
+   * @brief Heterogeneous try_emplace, Key is constructed from key only if it is not present.
+   */
+  template<typename K,
+    typename... Args,
+    typename = std::enable_if_t<transparent && !std::is_convertible_v<K &&, const Key &>
+                                && std::is_constructible_v<Key, K &&>>>
+  std::pair<iterator, bool> try_emplace(K && key, Args &&... args)
+  {
+    return try_emplace_impl(std::forward<K>(key), std::forward<Args>(args)...);
+  }
+
+  template<typename... Args>
+  std::pair<iterator, bool> emplace(Args &&... args)
+  {
+    value_type v(std::forward<Args>(args)...);
+    return try_emplace_impl(std::move(v.first), std::move(v.second));
+  }
+
+  std::pair<iterator, bool> insert(const value_type & v)
+  {
+    return try_emplace_impl(v.first, v.second);
+  }
+
+  std::pair<iterator, bool> insert(value_type && v)
+  {
+    return try_emplace_impl(std::move(v.first), std::move(v.second));
+  }
+
+  /**
+   * @brief Insert the elements of a range, keys already present are ignored.
+   * @details Appends the range then merges it, O(n + m log m) for m new elements.
+   */
+  template<typename It>
+  void insert(It first, const It last)
+  {
+    const size_type n = m_data.size();
+    m_data.insert(m_data.end(), first, last);
+    sort_unique(n);
+  }
+
+  void insert(std::initializer_list<value_type> il) { insert(il.begin(), il.end()); }
+
+  /**
+   * @brief Insert an element or assign to the mapped value if the key is present.
+   */
+  template<typename M>
+  std::pair<iterator, bool> insert_or_assign(const Key & key, M && obj)
+  {
+    auto res = try_emplace_impl(key, std::forward<M>(obj));
+    if (!res.second) { res.first->second = std::forward<M>(obj); }
+    return res;
+  }
+
+  template<typename M>
+  std::pair<iterator, bool> insert_or_assign(Key && key, M && obj)
+  {
+    auto res = try_emplace_impl(std::move(key), std::forward<M>(obj));
+    if (!res.second) { res.first->second = std::forward<M>(obj); }
+    return res;
+  }
+
+  iterator erase(const_iterator pos) { return m_data.erase(pos); }
+  iterator erase(iterator pos) { return m_data.erase(pos); }
+  iterator erase(const_iterator first, const_iterator last) { return m_data.erase(first, last); }
+
+  /**
+   * @brief Remove the element with a key.
+   * @return Number of elements removed.
+   */
+  template<typename K = Key, typename = lookup_t<K>>
+  size_type erase(const K & key)
+  {
+    const auto it = find(key);
+    if (it == end()) { return 0; }
+    m_data.erase(it);
+    return 1;
+  }
+
+  void swap(flat_map & o) noexcept
+  {
+    using std::swap;
+    swap(m_data, o.m_data);
+    swap(m_comp, o.m_comp);
+  }
+
+  friend void swap(flat_map & a, flat_map & b) noexcept { a.swap(b); }
+
+  /**
+   * @brief Sorted elements.
+   */
+  const container_type & data() const noexcept { return m_data; }
+
+  /**
+   * @brief Move the sorted elements out of the map, which is left empty.
+   */
+  container_type extract() && { return std::move(m_data); }
+
+  // lookup
+
+  T & operator[](const Key & key) { return try_emplace_impl(key).first->second; }
+  T & operator[](Key && key) { return try_emplace_impl(std::move(key)).first->second; }
+
+  /**
+   * @brief Access the mapped value of a key.
+   * @details Throws std::out_of_range if the key is not present.
+   */
+  template<typename K = Key, typename = lookup_t<K>>
+  T & at(const K & key)
+  {
+    const auto it = find(key);
+    if (it == end()) { throw std::out_of_range("Key not found in flat_map."); }
+    return it->second;
+  }
+
+  template<typename K = Key, typename = lookup_t<K>>
+  const T & at(const K & key) const
+  {
+    return const_cast<flat_map *>(this)->at<K>(key);
+  }
+
+  template<typename K = Key, typename = lookup_t<K>>
+  iterator find(const K & key)
+  {
+    const auto & k = lookup_key(key);
+    const auto it  = lower_bound(k);
+    return (it != end() && !m_comp(k, it->first)) ? it : end();
+  }
+
+  template<typename K = Key, typename = lookup_t<K>>
+  const_iterator find(const K & key) const
+  {
+    return const_cast<flat_map *>(this)->find<K>(key);
+  }
+
+  template<typename K = Key, typename = lookup_t<K>>
+  bool contains(const K & key) const
+  {
+    return find<K>(key) != end();
+  }
+
+  template<typename K = Key, typename = lookup_t<K>>
+  size_type count(const K & key) const
+  {
+    return contains<K>(key) ? 1 : 0;
+  }
+
+  template<typename K = Key, typename = lookup_t<K>>
+  iterator lower_bound(const K & key)
+  {
+    return std::lower_bound(
+      begin(), end(), lookup_key(key), [this](const value_type & v, const auto & k) {
+        return m_comp(v.first, k);
+      });
+  }
+
+  template<typename K = Key, typename = lookup_t<K>>
+  const_iterator lower_bound(const K & key) const
+  {
+    return const_cast<flat_map *>(this)->lower_bound<K>(key);
+  }
+
+  template<typename K = Key, typename = lookup_t<K>>
+  iterator upper_bound(const K & key)
+  {
+    return std::upper_bound(
+      begin(), end(), lookup_key(key), [this](const auto & k, const value_type & v) {
+        return m_comp(k, v.first);
+      });
+  }
+
+  template<typename K = Key, typename = lookup_t<K>>
+  const_iterator upper_bound(const K & key) const
+  {
+    return const_cast<flat_map *>(this)->upper_bound<K>(key);
+  }
+
+  key_compare key_comp() const { return m_comp; }
+
+  friend bool operator==(const flat_map & a, const flat_map & b) { return a.m_data == b.m_data; }
+  friend bool operator!=(const flat_map & a, const flat_map & b) { return a.m_data != b.m_data; }
+  friend bool operator<(const flat_map & a, const flat_map & b) { return a.m_data < b.m_data; }
+
+protected:
+  /// @cond
+  template<typename K, typename... Args>
+  std::pair<iterator, bool> try_emplace_impl(K && key, Args &&... args)
+  {
+    auto it = lower_bound(key);
+    if (it != end() && !m_comp(key, it->first)) { return {it, false}; }
+    it = m_data.emplace(it,
+      std::piecewise_construct,
+      std::forward_as_tuple(std::forward<K>(key)),
+      std::forward_as_tuple(std::forward<Args>(args)...));
+    return {it, true};
+  }
+
+  // sort the elements from index n, merge them with the sorted first n, keep the first of equals
+  void sort_unique(const size_type n)
+  {
+    const auto less = [this](const value_type & a, const value_type & b) {
+      return m_comp(a.first, b.first);
+    };
+    const auto mid = m_data.begin() + static_cast<difference_type>(n);
+    std::stable_sort(mid, m_data.end(), less);
+    std::inplace_merge(m_data.begin(), mid, m_data.end(), less);
+    const auto last = std::unique(m_data.begin(), m_data.end(),
+      [this](const value_type & a, const value_type & b) { return !m_comp(a.first, b.first); });
+    m_data.erase(last, m_data.end());
+  }
+
+  container_type m_data{};
+  Compare m_comp{};
+  /// @endcond
+};
+
+}  // namespace cbr
+
+#endif  // CBR_UTILS__FLAT_MAP_HPP_
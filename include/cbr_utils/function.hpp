@@ -0,0 +1,291 @@
+// Copyright Yamaha 2021
+// MIT License
+// https://github.com/yamaha-bps/cbr_utils/blob/master/LICENSE
+
+/** @file */
+
+#ifndef CBR_UTILS__FUNCTION_HPP_
+#define CBR_UTILS__FUNCTION_HPP_
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "utils.hpp"
+
+namespace cbr {
+
+/// @cond
+namespace detail {
+
+// Function type R(Args...) from a return type and a TypePack of arguments
+template<typename R, typename Args>
+struct function_type;
+
+template<typename R, typename... Args>
+struct function_type<R, TypePack<Args...>>
+{
+  using type = R(Args...);
+};
+
+template<typename F>
+using call_signature_t = typename function_type<
+  typename signature<decltype(&F::operator())>::return_type,
+  typename signature<decltype(&F::operator())>::argument_type>::type;
+
+}  // namespace detail
+/// @endcond
+
+template<typename Sig>
+class function_ref;
+
+/**
+ * @brief Non-owning reference to a callable.
+ * @details Holds a pointer to the callable and a pointer to a function invoking it, i.e. two
+ * words, is trivially copyable and never allocates. Use it for callback parameters that are
+ * called before the function returns, where std::function would copy the callable.
+ *
+ * Example:
+ * ```
+ * void for_each_sample(function_ref<void(double)> f) { for (double x : m_samples) { f(x); } }
+ *
+ * double sum = 0;
+ * for_each_sample([&sum](double x) { sum += x; });
+ * ```
+ * Notes:
+ * - The referenced callable must outlive the function_ref, do not store function_ref built from
+ *   temporaries.
+ *
+ * @tparam R Return type.
+ * @tparam Args Argument types.
+ */
+template<typename R, typename... Args>
+class function_ref<R(Args...)>
+{
+public:
+  function_ref()                     = delete;
+  function_ref(const function_ref &) = default;
+  function_ref & operator=(const function_ref &) = default;
+  ~function_ref()                                = default;
+
+  /**
+   * @brief Reference a function.
+   */
+  function_ref(R (*f)(Args...)) noexcept  // NOLINT
+      : m_invoke([](Storage s, Args... args) -> R {
+          return reinterpret_cast<R (*)(Args...)>(s.fcn)(std::forward<Args>(args)...);
+        })
+  {
+    m_storage.fcn = reinterpret_cast<void (*)()>(f);
+  }
+
+  /**
+   * @brief Reference a callable object.
+   */
+  template<typename F,
+    typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, function_ref>
+                                && !std::is_function_v<std::remove_reference_t<F>>
+                                && std::is_invocable_r_v<R, F &, Args...>>>
+  function_ref(F && f) noexcept  // NOLINT
+      : m_invoke([](Storage s, Args... args) -> R {
+          using obj_t = std::remove_reference_t<F>;
+          return std::invoke(*static_cast<obj_t *>(s.obj), std::forward<Args>(args)...);
+        })
+  {
+    m_storage.obj = const_cast<void *>(static_cast<const volatile void *>(std::addressof(f)));
+  }
+
+  /**
+   * @brief Call the referenced callable.
+   */
+  R operator()(Args... args) const { return m_invoke(m_storage, std::forward<Args>(args)...); }
+
+protected:
+  /// @cond
+  union Storage {
+    void * obj;
+    void (*fcn)();
+  };
+
+  Storage m_storage{nullptr};
+  R (*m_invoke)(Storage, Args...);
+  /// @endcond
+};
+
+/// @cond
+template<typename R, typename... Args>
+function_ref(R (*)(Args...)) -> function_ref<R(Args...)>;
+
+template<typename F>
+function_ref(F &&) -> function_ref<detail::call_signature_t<std::remove_reference_t<F>>>;
+/// @endcond
+
+template<typename Sig, std::size_t Capacity = 32, std::size_t Alignment = alignof(std::max_align_t)>
+class inplace_function;
+
+/**
+ * @brief Move-only callable wrapper with a fixed inline capacity.
+ * @details Like std::function but the callable is always stored in an internal buffer, hence never
+ * allocates. Callables that do not fit are rejected at compile time. Move-only callables, e.g.
+ * lambdas capturing a std::unique_ptr or a std::packaged_task, are supported.
+ *
+ * Example:
+ * ```
+ * inplace_function<void(int), 32> f = [p = std::make_unique<State>()](int i) { p->update(i); };
+ * f(3);
+ * auto g = std::move(f);
+ * ```
+ *
+ * @tparam R Return type.
+ * @tparam Args Argument types.
+ * @tparam Capacity Size of the buffer in bytes.
+ * @tparam Alignment Alignment of the buffer.
+ */
+template<typename R, typename... Args, std::size_t Capacity, std::size_t Alignment>
+class inplace_function<R(Args...), Capacity, Alignment>
+{
+public:
+  /**
+   * @brief Construct an empty inplace_function.
+   */
+  inplace_function() noexcept = default;
+
+  /**
+   * @brief Construct an empty inplace_function.
+   */
+  inplace_function(std::nullptr_t) noexcept {}  // NOLINT
+
+  /**
+   * @brief Construct an inplace_function storing a callable.
+   *
+   * @param f Callable, copied or moved to the internal buffer.
+   */
+  template<typename F,
+    typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, inplace_function>
+                                && !std::is_same_v<std::decay_t<F>, std::nullptr_t>
+                                && std::is_invocable_r_v<R, std::decay_t<F> &, Args...>>>
+  inplace_function(F && f)  // NOLINT
+  {
+    using fcn_t = std::decay_t<F>;
+    static_assert(sizeof(fcn_t) <= Capacity, "Callable too large for inplace_function capacity.");
+    static_assert(Alignment % alignof(fcn_t) == 0, "Callable alignment not supported.");
+    static_assert(
+      std::is_nothrow_move_constructible_v<fcn_t>, "inplace_function requires nothrow moves.");
+
+    ::new (static_cast<void *>(m_buffer)) fcn_t(std::forward<F>(f));
+    m_vtable = &vtable_for<fcn_t>;
+  }
+
+  inplace_function(const inplace_function &) = delete;
+  inplace_function & operator=(const inplace_function &) = delete;
+
+  inplace_function(inplace_function && o) noexcept { move_from(o); }
+
+  inplace_function & operator=(inplace_function && o) noexcept
+  {
+    if (this != &o) {
+      reset();
+      move_from(o);
+    }
+    return *this;
+  }
+
+  inplace_function & operator=(std::nullptr_t) noexcept
+  {
+    reset();
+    return *this;
+  }
+
+  template<typename F,
+    typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, inplace_function>
+                                && !std::is_same_v<std::decay_t<F>, std::nullptr_t>>>
+  inplace_function & operator=(F && f)
+  {
+    return *this = inplace_function(std::forward<F>(f));
+  }
+
+  ~inplace_function() { reset(); }
+
+  /**
+   * @brief Call the stored callable.
+   * @details Throws std::bad_function_call if empty.
+   */
+  R operator()(Args... args) const
+  {
+    if (m_vtable == nullptr) { throw std::bad_function_call(); }
+    return m_vtable->invoke(m_buffer, std::forward<Args>(args)...);
+  }
+
+  /**
+   * @brief Check if a callable is stored.
+   */
+  explicit operator bool() const noexcept { return m_vtable != nullptr; }
+
+protected:
+  /// @cond
+  struct VTable
+  {
+    R (*invoke)(void *, Args &&...);
+    void (*move)(void *, void *) noexcept;
+    void (*destroy)(void *) noexcept;
+  };
+
+  template<typename F>
+  static constexpr VTable vtable_for{
+    [](void * p, Args &&... args) -> R {
+      return std::invoke(*std::launder(static_cast<F *>(p)), std::forward<Args>(args)...);
+    },
+    [](void * dst, void * src) noexcept {
+      F * s = std::launder(static_cast<F *>(src));
+      ::new (dst) F(std::move(*s));
+      s->~F();
+    },
+    [](void * p) noexcept { std::launder(static_cast<F *>(p))->~F(); },
+  };
+
+  void reset() noexcept
+  {
+    if (m_vtable != nullptr) {
+      m_vtable->destroy(m_buffer);
+      m_vtable = nullptr;
+    }
+  }
+
+  void move_from(inplace_function & o) noexcept
+  {
+    if (o.m_vtable != nullptr) {
+      o.m_vtable->move(m_buffer, o.m_buffer);
+      m_vtable   = o.m_vtable;
+      o.m_vtable = nullptr;
+    }
+  }
+
+  const VTable * m_vtable = nullptr;
+  alignas(Alignment) mutable std::byte m_buffer[Capacity];
+  /// @endcond
+};
+
+/**
+ * @brief Compare with nullptr.
+ */
+template<typename Sig, std::size_t C, std::size_t A>
+bool operator==(const inplace_function<Sig, C, A> & f, std::nullptr_t) noexcept
+{
+  return !f;
+}
+
+/**
+ * @brief Compare with nullptr.
+ */
+template<typename Sig, std::size_t C, std::size_t A>
+bool operator!=(const inplace_function<Sig, C, A> & f, std::nullptr_t) noexcept
+{
+  return static_cast<bool>(f);
+}
+
+}  // namespace cbr
+
+#endif  // CBR_UTILS__FUNCTION_HPP_
@@ -0,0 +1,697 @@
+// Copyright Yamaha 2021
+// MIT License
+// https://github.com/yamaha-bps/cbr_utils/blob/master/LICENSE
+
+/** @file */
+
+#ifndef CBR_UTILS__INLINE_VECTOR_HPP_
+#define CBR_UTILS__INLINE_VECTOR_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace cbr {
+
+/// @cond
+namespace detail {
+
+// Elements stored in a plain array, which makes the container usable in constant expressions
+template<typename T>
+inline constexpr bool is_inline_trivial_v = std::is_trivially_default_constructible_v<T>
+                                            && std::is_trivially_destructible_v<T>
+                                            && std::is_trivially_copyable_v<T>;
+
+template<typename It>
+using require_input_iterator_t = std::enable_if_t<std::is_base_of_v<std::input_iterator_tag,
+  typename std::iterator_traits<It>::iterator_category>>;
+
+// std::vector interface shared by static_vector and small_vector, Derived provides:
+// - m_size: number of elements
+// - data_ptr(): pointer to the first element
+// - capacity_impl(): number of elements that fit in the current storage
+// - grow(n): increase the capacity to at least n, or throw
+// - trivial_storage: true if elements are plain array members that can be assigned
+template<typename Derived, typename T>
+class InlineVectorBase
+{
+public:
+  using value_type             = T;
+  using size_type              = std::size_t;
+  using difference_type        = std::ptrdiff_t;
+  using reference              = T &;
+  using const_reference        = const T &;
+  using pointer                = T *;
+  using const_pointer          = const T *;
+  using iterator               = T *;
+  using const_iterator         = const T *;
+  using reverse_iterator       = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+  // element access
+
+  constexpr reference at(const size_type i)
+  {
+    if (i >= size()) { throw std::out_of_range("Index out of range."); }
+    return data()[i];
+  }
+
+  constexpr const_reference at(const size_type i) const
+  {
+    if (i >= size()) { throw std::out_of_range("Index out of range."); }
+    return data()[i];
+  }
+
+  constexpr reference operator[](const size_type i) noexcept { return data()[i]; }
+  constexpr const_reference operator[](const size_type i) const noexcept { return data()[i]; }
+
+  constexpr reference front() noexcept { return data()[0]; }
+  constexpr const_reference front() const noexcept { return data()[0]; }
+
+  constexpr reference back() noexcept { return data()[size() - 1]; }
+  constexpr const_reference back() const noexcept { return data()[size() - 1]; }
+
+  constexpr T * data() noexcept { return derived().data_ptr(); }
+  constexpr const T * data() const noexcept { return derived().data_ptr(); }
+
+  // iterators
+
+  constexpr iterator begin() noexcept { return data(); }
+  constexpr const_iterator begin() const noexcept { return data(); }
+  constexpr const_iterator cbegin() const noexcept { return data(); }
+
+  constexpr iterator end() noexcept { return data() + size(); }
+  constexpr const_iterator end() const noexcept { return data() + size(); }
+  constexpr const_iterator cend() const noexcept { return data() + size(); }
+
+  constexpr reverse_iterator rbegin() noexcept { return reverse_iterator(end()); }
+  constexpr const_reverse_iterator rbegin() const noexcept { return crbegin(); }
+  constexpr const_reverse_iterator crbegin() const noexcept
+  {
+    return const_reverse_iterator(end());
+  }
+
+  constexpr reverse_iterator rend() noexcept { return reverse_iterator(begin()); }
+  constexpr const_reverse_iterator rend() const noexcept { return crend(); }
+  constexpr const_reverse_iterator crend() const noexcept
+  {
+    return const_reverse_iterator(begin());
+  }
+
+  // capacity
+
+  constexpr bool empty() const noexcept { return size() == 0; }
+  constexpr size_type size() const noexcept { return derived().m_size; }
+  constexpr size_type capacity() const noexcept { return derived().capacity_impl(); }
+
+  constexpr void reserve(const size_type n)
+  {
+    if (n > capacity()) { derived().grow(n); }
+  }
+
+  // modifiers
+
+  constexpr void clear() noexcept
+  {
+    destroy_range(0, size());
+    set_size(0);
+  }
+
+  constexpr void push_back(const T & v) { emplace_back(v); }
+  constexpr void push_back(T && v) { emplace_back(std::move(v)); }
+
+  template<typename... Args>
+  constexpr reference emplace_back(Args &&... args)
+  {
+    if (size() == capacity()) {
+      T tmp(std::forward<Args>(args)...);  // arguments may refer to an element
+      derived().grow(size() + 1);
+      construct(end(), std::move(tmp));
+    } else {
+      construct(end(), std::forward<Args>(args)...);
+    }
+    set_size(size() + 1);
+    return back();
+  }
+
+  constexpr void pop_back() noexcept
+  {
+    destroy_range(size() - 1, size());
+    set_size(size() - 1);
+  }
+
+  constexpr void resize(const size_type n)
+  {
+    if (n <= size()) {
+      destroy_range(n, size());
+      set_size(n);
+      return;
+    }
+    reserve(n);
+    while (size() < n) {
+      construct(end());
+      set_size(size() + 1);
+    }
+  }
+
+  constexpr void resize(const size_type n, const T & v)
+  {
+    if (n <= size()) {
+      destroy_range(n, size());
+      set_size(n);
+      return;
+    }
+    insert(cend(), n - size(), v);
+  }
+
+  template<typename... Args>
+  constexpr iterator emplace(const_iterator pos, Args &&... args)
+  {
+    const auto idx = static_cast<size_type>(pos - cbegin());
+    emplace_back(std::forward<Args>(args)...);
+    rotate(idx, size() - 1);
+    return begin() + idx;
+  }
+
+  constexpr iterator insert(const_iterator pos, const T & v) { return emplace(pos, v); }
+  constexpr iterator insert(const_iterator pos, T && v) { return emplace(pos, std::move(v)); }
+
+  constexpr iterator insert(const_iterator pos, const size_type n, const T & v)
+  {
+    const auto idx     = static_cast<size_type>(pos - cbegin());
+    const size_type n0 = size();
+    if (n > 0) {
+      const T tmp(v);  // v may refer to an element
+      reserve(n0 + n);
+      for (size_type i = 0; i < n; ++i) { emplace_back(tmp); }
+      rotate(idx, n0);
+    }
+    return begin() + idx;
+  }
+
+  template<typename It, typename = require_input_iterator_t<It>>
+  constexpr iterator insert(const_iterator pos, It first, const It last)
+  {
+    const auto idx     = static_cast<size_type>(pos - cbegin());
+    const size_type n0 = size();
+    for (; first != last; ++first) { emplace_back(*first); }
+    rotate(idx, n0);
+    return begin() + idx;
+  }
+
+  constexpr iterator insert(const_iterator pos, std::initializer_list<T> il)
+  {
+    return insert(pos, il.begin(), il.end());
+  }
+
+  constexpr iterator erase(const_iterator pos) { return erase(pos, pos + 1); }
+
+  constexpr iterator erase(const_iterator first, const_iterator last)
+  {
+    const auto i = static_cast<size_type>(first - cbegin());
+    const auto j = static_cast<size_type>(last - cbegin());
+    if (i != j) {
+      T * d = data();
+      for (size_type k = j; k < size(); ++k) { d[i + k - j] = std::move(d[k]); }
+      destroy_range(size() - (j - i), size());
+      set_size(size() - (j - i));
+    }
+    return begin() + i;
+  }
+
+  constexpr void assign(const size_type n, const T & v)
+  {
+    const T tmp(v);  // v may refer to an element
+    clear();
+    reserve(n);
+    for (size_type i = 0; i < n; ++i) { emplace_back(tmp); }
+  }
+
+  template<typename It, typename = require_input_iterator_t<It>>
+  constexpr void assign(It first, const It last)
+  {
+    clear();
+    for (; first != last; ++first) { emplace_back(*first); }
+  }
+
+  constexpr void assign(std::initializer_list<T> il) { assign(il.begin(), il.end()); }
+
+  // comparisons
+
+  friend constexpr bool operator==(const Derived & a, const Derived & b)
+  {
+    if (a.size() != b.size()) { return false; }
+    for (size_type i = 0; i < a.size(); ++i) {
+      if (!(a[i] == b[i])) { return false; }
+    }
+    return true;
+  }
+
+  friend constexpr bool operator!=(const Derived & a, const Derived & b) { return !(a == b); }
+
+  friend constexpr bool operator<(const Derived & a, const Derived & b)
+  {
+    for (size_type i = 0; i < a.size() && i < b.size(); ++i) {
+      if (a[i] < b[i]) { return true; }
+      if (b[i] < a[i]) { return false; }
+    }
+    return a.size() < b.size();
+  }
+
+  friend constexpr bool operator>(const Derived & a, const Derived & b) { return b < a; }
+  friend constexpr bool operator<=(const Derived & a, const Derived & b) { return !(b < a); }
+  friend constexpr bool operator>=(const Derived & a, const Derived & b) { return !(a < b); }
+
+protected:
+  constexpr Derived & derived() noexcept { return static_cast<Derived &>(*this); }
+  constexpr const Derived & derived() const noexcept
+  {
+    return static_cast<const Derived &>(*this);
+  }
+
+  constexpr void set_size(const size_type n) noexcept { derived().m_size = n; }
+
+  template<typename... Args>
+  static constexpr void construct(T * p, Args &&... args)
+  {
+    if constexpr (Derived::trivial_storage) {
+      *p = T(std::forward<Args>(args)...);
+    } else {
+      ::new (static_cast<void *>(p)) T(std::forward<Args>(args)...);
+    }
+  }
+
+  constexpr void destroy_range(const size_type first, const size_type last) noexcept
+  {
+    if constexpr (!std::is_trivially_destructible_v<T>) {
+      for (size_type i = first; i < last; ++i) { data()[i].~T(); }
+    }
+  }
+
+  // rotate [first, end) so that the element at mid becomes the element at first
+  constexpr void rotate(const size_type first, const size_type mid)
+  {
+    reverse(first, mid);
+    reverse(mid, size());
+    reverse(first, size());
+  }
+
+  constexpr void reverse(size_type first, size_type last)
+  {
+    T * d = data();
+    while (first + 1 < last) {
+      T tmp(std::move(d[first]));
+      d[first] = std::move(d[last - 1]);
+      d[last - 1] = std::move(tmp);
+      ++first;
+      --last;
+    }
+  }
+};
+
+// Storage of static_vector: plain array for trivial types
+template<typename T, std::size_t N, bool = is_inline_trivial_v<T>>
+class StaticVectorStorage
+{
+protected:
+  static constexpr bool trivial_storage = true;
+
+  constexpr T * data_ptr() noexcept { return m_data; }
+  constexpr const T * data_ptr() const noexcept { return m_data; }
+
+  T m_data[N]{};
+  std::size_t m_size = 0;
+};
+
+// Storage of static_vector: uninitialized bytes for other types
+template<typename T, std::size_t N>
+class StaticVectorStorage<T, N, false>
+{
+protected:
+  static constexpr bool trivial_storage = false;
+
+  StaticVectorStorage() noexcept = default;
+
+  StaticVectorStorage(const StaticVectorStorage & o) { copy_from(o); }
+
+  StaticVectorStorage(StaticVectorStorage && o) noexcept(std::is_nothrow_move_constructible_v<T>)
+  {
+    move_from(o);
+  }
+
+  StaticVectorStorage & operator=(const StaticVectorStorage & o)
+  {
+    if (this != &o) {
+      destroy();
+      copy_from(o);
+    }
+    return *this;
+  }
+
+  StaticVectorStorage & operator=(StaticVectorStorage && o) noexcept(
+    std::is_nothrow_move_constructible_v<T>)
+  {
+    if (this != &o) {
+      destroy();
+      move_from(o);
+    }
+    return *this;
+  }
+
+  ~StaticVectorStorage() { destroy(); }
+
+  T * data_ptr() noexcept { return std::launder(reinterpret_cast<T *>(m_raw)); }
+  const T * data_ptr() const noexcept { return std::launder(reinterpret_cast<const T *>(m_raw)); }
+
+  void copy_from(const StaticVectorStorage & o)
+  {
+    try {
+      for (; m_size < o.m_size; ++m_size) {
+        ::new (m_raw + m_size * sizeof(T)) T(o.data_ptr()[m_size]);
+      }
+    } catch (...) {
+      destroy();
+      throw;
+    }
+  }
+
+  void move_from(StaticVectorStorage & o)
+  {
+    try {
+      for (; m_size < o.m_size; ++m_size) {
+        ::new (m_raw + m_size * sizeof(T)) T(std::move(o.data_ptr()[m_size]));
+      }
+    } catch (...) {
+      destroy();
+      throw;
+    }
+    o.destroy();
+  }
+
+  void destroy() noexcept
+  {
+    if constexpr (!std::is_trivially_destructible_v<T>) {
+      for (std::size_t i = 0; i < m_size; ++i) { data_ptr()[i].~T(); }
+    }
+    m_size = 0;
+  }
+
+  alignas(T) std::byte m_raw[N * sizeof(T)];
+  std::size_t m_size = 0;
+};
+
+}  // namespace detail
+/// @endcond
+
+/**
+ * @brief Vector with a fixed capacity stored inline.
+ * @details Has the interface of std::vector but never allocates: operations exceeding the capacity
+ * throw std::length_error. Usable in constant expressions when T is trivial.
+ *
+ * Example:
+ * ```
+ * static_vector<Detection, 16> detections;
+ * for (const auto & blob : blobs) {
+ *   if (detections.size() == detections.capacity()) { break; }
+ *   detections.emplace_back(blob);
+ * }
+ * ```
+ *
+ * @tparam T Element type.
+ * @tparam N Capacity.
+ */
+template<typename T, std::size_t N>
+class static_vector
+    : public detail::InlineVectorBase<static_vector<T, N>, T>,
+      protected detail::StaticVectorStorage<T, N>
+{
+  static_assert(N > 0, "static_vector capacity must be positive.");
+
+  using base_t    = detail::InlineVectorBase<static_vector<T, N>, T>;
+  using storage_t = detail::StaticVectorStorage<T, N>;
+  friend base_t;
+
+public:
+  using typename base_t::size_type;
+
+  /**
+   * @brief Construct an empty static_vector.
+   */
+  constexpr static_vector() noexcept = default;
+
+  /**
+   * @brief Construct a static_vector with n value initialized elements.
+   */
+  constexpr explicit static_vector(const size_type n) { this->resize(n); }
+
+  /**
+   * @brief Construct a static_vector with n copies of a value.
+   */
+  constexpr static_vector(const size_type n, const T & v) { this->assign(n, v); }
+
+  /**
+   * @brief Construct a static_vector with the elements of a range.
+   */
+  template<typename It, typename = detail::require_input_iterator_t<It>>
+  constexpr static_vector(It first, const It last)
+  {
+    this->assign(first, last);
+  }
+
+  /**
+   * @brief Construct a static_vector with the elements of an initializer list.
+   */
+  constexpr static_vector(std::initializer_list<T> il) { this->assign(il); }
+
+  constexpr static_vector & operator=(std::initializer_list<T> il)
+  {
+    this->assign(il);
+    return *this;
+  }
+
+  /**
+   * @brief Maximal number of elements.
+   */
+  static constexpr size_type max_size() noexcept { return N; }
+
+protected:
+  /// @cond
+  using storage_t::trivial_storage;
+
+  constexpr size_type capacity_impl() const noexcept { return N; }
+
+  [[noreturn]] void grow(size_type) const
+  {
+    throw std::length_error("static_vector capacity exceeded.");
+  }
+  /// @endcond
+};
+
+/**
+ * @brief Vector storing up to N elements inline before falling back to the heap.
+ * @details Has the interface of std::vector. Small sizes, the common case, do not allocate, and
+ * larger ones keep working.
+ *
+ * Example:
+ * ```
+ * small_vector<int, 8> ids;  // allocates only past 8 elements
+ * for (const auto & msg : set) { ids.push_back(msg.id); }
+ * ```
+ *
+ * @tparam T Element type.
+ * @tparam N Number of elements stored inline.
+ */
+template<typename T, std::size_t N>
+class small_vector : public detail::InlineVectorBase<small_vector<T, N>, T>
+{
+  static_assert(N > 0, "small_vector inline capacity must be positive.");
+
+  using base_t = detail::InlineVectorBase<small_vector<T, N>, T>;
+  friend base_t;
+
+public:
+  using typename base_t::size_type;
+
+  /**
+   * @brief Construct an empty small_vector.
+   */
+  small_vector() noexcept : m_ptr(inline_ptr()) {}
+
+  /**
+   * @brief Construct a small_vector with n value initialized elements.
+   */
+  explicit small_vector(const size_type n) : small_vector() { this->resize(n); }
+
+  /**
+   * @brief Construct a small_vector with n copies of a value.
+   */
+  small_vector(const size_type n, const T & v) : small_vector() { this->assign(n, v); }
+
+  /**
+   * @brief Construct a small_vector with the elements of a range.
+   */
+  template<typename It, typename = detail::require_input_iterator_t<It>>
+  small_vector(It first, const It last) : small_vector()
+  {
+    this->assign(first, last);
+  }
+
+  /**
+   * @brief Construct a small_vector with the elements of an initializer list.
+   */
+  small_vector(std::initializer_list<T> il) : small_vector() { this->assign(il); }
+
+  small_vector(const small_vector & o) : small_vector() { this->assign(o.begin(), o.end()); }
+
+  /**
+   * @brief Move constructor.
+   * @details Steals the heap buffer of o if any, moves the elements otherwise.
+   */
+  small_vector(small_vector && o) noexcept(std::is_nothrow_move_constructible_v<T>)
+      : small_vector()
+  {
+    move_from(o);
+  }
+
+  small_vector & operator=(const small_vector & o)
+  {
+    if (this != &o) { this->assign(o.begin(), o.end()); }
+    return *this;
+  }
+
+  small_vector & operator=(small_vector && o) noexcept(std::is_nothrow_move_constructible_v<T>)
+  {
+    if (this != &o) {
+      this->clear();
+      release();
+      move_from(o);
+    }
+    return *this;
+  }
+
+  small_vector & operator=(std::initializer_list<T> il)
+  {
+    this->assign(il);
+    return *this;
+  }
+
+  ~small_vector()
+  {
+    this->clear();
+    release();
+  }
+
+  /**
+   * @brief Check if the elements are stored inline.
+   */
+  bool is_inline() const noexcept { return m_ptr == inline_ptr(); }
+
+  /**
+   * @brief Number of elements stored inline.
+   */
+  static constexpr size_type inline_capacity() noexcept { return N; }
+
+  /**
+   * @brief Maximal number of elements.
+   */
+  size_type max_size() const noexcept { return std::allocator_traits<alloc_t>::max_size({}); }
+
+  /**
+   * @brief Release unused capacity, moving the elements back inline if they fit.
+   */
+  void shrink_to_fit()
+  {
+    if (is_inline() || this->size() == m_capacity) { return; }
+    if (this->size() <= N) {
+      relocate(inline_ptr(), N);
+    } else {
+      relocate(alloc_t{}.allocate(this->size()), this->size());
+    }
+  }
+
+protected:
+  /// @cond
+  using alloc_t = std::allocator<T>;
+
+  static constexpr bool trivial_storage = false;
+
+  T * data_ptr() noexcept { return m_ptr; }
+  const T * data_ptr() const noexcept { return m_ptr; }
+
+  size_type capacity_impl() const noexcept { return m_capacity; }
+
+  T * inline_ptr() noexcept { return std::launder(reinterpret_cast<T *>(m_inline)); }
+  const T * inline_ptr() const noexcept
+  {
+    return std::launder(reinterpret_cast<const T *>(m_inline));
+  }
+
+  void grow(const size_type n)
+  {
+    const size_type cap = std::max(n, 2 * m_capacity);
+    relocate(alloc_t{}.allocate(cap), cap);
+  }
+
+  // move the elements to new storage and release the current one
+  void relocate(T * dst, const size_type cap)
+  {
+    size_type i = 0;
+    try {
+      for (; i < this->size(); ++i) {
+        ::new (static_cast<void *>(dst + i)) T(std::move_if_noexcept(m_ptr[i]));
+      }
+    } catch (...) {
+      for (size_type j = 0; j < i; ++j) { dst[j].~T(); }
+      if (dst != inline_ptr()) { alloc_t{}.deallocate(dst, cap); }
+      throw;
+    }
+    const size_type n = this->size();
+    this->destroy_range(0, n);
+    release();
+    m_ptr      = dst;
+    m_capacity = cap;
+  }
+
+  // deallocate the heap buffer, elements must have been destroyed
+  void release() noexcept
+  {
+    if (!is_inline()) { alloc_t{}.deallocate(m_ptr, m_capacity); }
+    m_ptr      = inline_ptr();
+    m_capacity = N;
+  }
+
+  // this must be empty and inline
+  void move_from(small_vector & o)
+  {
+    if (o.is_inline()) {
+      for (auto & x : o) {
+        ::new (static_cast<void *>(m_ptr + m_size)) T(std::move(x));
+        ++m_size;
+      }
+      o.clear();
+    } else {
+      m_ptr        = o.m_ptr;
+      m_size       = o.m_size;
+      m_capacity   = o.m_capacity;
+      o.m_ptr      = o.inline_ptr();
+      o.m_size     = 0;
+      o.m_capacity = N;
+    }
+  }
+
+  T * m_ptr;
+  size_type m_size     = 0;
+  size_type m_capacity = N;
+  alignas(T) std::byte m_inline[N * sizeof(T)];
+  /// @endcond
+};
+
+}  // namespace cbr
+
+#endif  // CBR_UTILS__INLINE_VECTOR_HPP_
@@ -156,8 +156,8 @@ using iseq_apply_t = typename iseq_apply<ISeq, T>::type;
 
 /// @cond
 
-// Exclusive prefix sum for std::integer_sequence
-template<typename Cur, typename ISeq, typename ISeq::value_type Sum>
+// Exclusive prefix sum for std::integer_sequence, Sum is of the value type of ISeq
+template<typename Cur, typename ISeq, auto Sum>
 struct iseq_psum
 {
   using type = Cur;
@@ -167,7 +167,7 @@ template<typename T, T... Cur, T First, T... Rem, T Sum>
 struct iseq_psum<std::integer_sequence<T, Cur...>, std::integer_sequence<T, First, Rem...>, Sum>
     : iseq_psum<std::integer_sequence<T, Cur..., Sum>,
         std::integer_sequence<T, Rem...>,
-        Sum + First>
+        static_cast<T>(Sum + First)>
 {};
 
 /// @endcond
@@ -181,7 +181,9 @@ struct iseq_psum<std::integer_sequence<T, Cur...>, std::integer_sequence<T, Firs
  */
 template<class ISeq>
 using iseq_psum_t =
-  typename iseq_psum<std::integer_sequence<typename ISeq::value_type>, ISeq, 0>::type;
+  typename iseq_psum<std::integer_sequence<typename ISeq::value_type>,
+    ISeq,
+    static_cast<typename ISeq::value_type>(0)>::type;
 
 /// @cond
 
@@ -0,0 +1,295 @@
+// Copyright Yamaha 2021
+// MIT License
+// https://github.com/yamaha-bps/cbr_utils/blob/master/LICENSE
+
+/** @file */
+
+#ifndef CBR_UTILS__LATEST_HPP_
+#define CBR_UTILS__LATEST_HPP_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace cbr {
+
+/**
+ * @brief Latest value channel based on a sequence lock.
+ * @details A single writer publishes values that readers copy without ever blocking it. The writer
+ * increments a sequence number before and after writing, and a reader retries if the sequence
+ * number was odd or changed during its copy, so that it always gets a consistent snapshot. The
+ * value is stored as relaxed atomic words so that concurrent copies are not data races.
+ *
+ * Suited to small values updated at a moderate rate, e.g. the state of an estimator read by a
+ * LoopTimer paced control loop. Reads retry while the writer is writing, use TripleBuffer if the
+ * value is large or updated continuously.
+ *
+ * Example:
+ * ```
+ * Latest<State> state;
+ *
+ * // estimator thread
+ * state.write(estimate());
+ *
+ * // control loop
+ * while (true) {
+ *   timer.wait();
+ *   const State s = state.read();
+ *   control(s);
+ * }
+ * ```
+ *
+ * @tparam T Trivially copyable value type.
+ */
+template<typename T>
+class Latest
+{
+  static_assert(std::is_trivially_copyable_v<T>, "Latest requires a trivially copyable type.");
+
+public:
+  Latest(const Latest &) = delete;
+  Latest(Latest &&)      = delete;
+  Latest & operator=(const Latest &) = delete;
+  Latest & operator=(Latest &&) = delete;
+  ~Latest()                     = default;
+
+  /**
+   * @brief Construct a new Latest object holding a value initialized T.
+   */
+  Latest() noexcept : Latest(T{}) {}
+
+  /**
+   * @brief Construct a new Latest object.
+   *
+   * @param v Initial value, version() is 0.
+   */
+  explicit Latest(const T & v) noexcept { store_words(v); }
+
+  /**
+   * @brief Publish a value.
+   * @details Writer only, never blocks.
+   */
+  void write(const T & v) noexcept
+  {
+    const uint64_t seq = m_seq.load(std::memory_order_relaxed);
+    m_seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    store_words(v);
+    m_seq.store(seq + 2, std::memory_order_release);
+  }
+
+  /**
+   * @brief Try to copy the latest value.
+   * @details Makes a single attempt, which fails if the writer is writing concurrently.
+   *
+   * @param v Assigned the latest value on success.
+   * @return Returns true on success.
+   */
+  bool try_read(T & v) const noexcept
+  {
+    uint64_t version = 0;
+    return try_read(v, version);
+  }
+
+  /**
+   * @brief Try to copy the latest value and its version.
+   *
+   * @param v Assigned the latest value on success.
+   * @param version Assigned the version of the value on success.
+   * @return Returns true on success.
+   */
+  bool try_read(T & v, uint64_t & version) const noexcept
+  {
+    const uint64_t seq0 = m_seq.load(std::memory_order_acquire);
+    if (seq0 & 1) { return false; }
+
+    std::array<uint64_t, n_words> buf;
+    for (std::size_t i = 0; i < n_words; ++i) {
+      buf[i] = m_words[i].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    if (m_seq.load(std::memory_order_relaxed) != seq0) { return false; }
+    std::memcpy(static_cast<void *>(&v), buf.data(), sizeof(T));
+    version = seq0 / 2;
+    return true;
+  }
+
+  /**
+   * @brief Copy the latest value.
+   * @details Retries until no write overlaps the copy.
+   */
+  T read() const noexcept
+  {
+    T v{};
+    while (!try_read(v)) { spin(); }
+    return v;
+  }
+
+  /**
+   * @brief Number of values written since construction.
+   * @details Compare with a previous version to check for a new value.
+   */
+  uint64_t version() const noexcept { return m_seq.load(std::memory_order_acquire) / 2; }
+
+protected:
+  /// @cond
+  static constexpr std::size_t n_words = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+  void store_words(const T & v) noexcept
+  {
+    std::array<uint64_t, n_words> buf{};
+    std::memcpy(buf.data(), &v, sizeof(T));
+    for (std::size_t i = 0; i < n_words; ++i) {
+      m_words[i].store(buf[i], std::memory_order_relaxed);
+    }
+  }
+
+  static void spin() noexcept
+  {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#else
+    std::this_thread::yield();
+#endif
+  }
+
+  alignas(64) std::atomic<uint64_t> m_seq{0};
+  std::array<std::atomic<uint64_t>, n_words> m_words{};
+  /// @endcond
+};
+
+/**
+ * @brief Latest value channel based on a triple buffer.
+ * @details The writer fills a back buffer and publishes it by swapping it with a shared middle
+ * buffer, and the reader swaps its front buffer with the middle buffer when a new value was
+ * published. Both sides only perform a single atomic exchange and never wait, whatever the size
+ * of the value. Intermediate values are overwritten if the reader does not keep up.
+ *
+ * Example:
+ * ```
+ * TripleBuffer<PointCloud> cloud;
+ *
+ * // writer thread, fills the back buffer in place
+ * auto & buf = cloud.write_buffer();
+ * fill(buf);
+ * cloud.publish();
+ *
+ * // reader thread
+ * if (cloud.update()) { process(cloud.read_buffer()); }
+ * ```
+ *
+ * @tparam T Value type, must be default constructible or copy constructible.
+ */
+template<typename T>
+class TripleBuffer
+{
+public:
+  TripleBuffer(const TripleBuffer &) = delete;
+  TripleBuffer(TripleBuffer &&)      = delete;
+  TripleBuffer & operator=(const TripleBuffer &) = delete;
+  TripleBuffer & operator=(TripleBuffer &&) = delete;
+  ~TripleBuffer()                           = default;
+
+  /**
+   * @brief Construct a new TripleBuffer object with default constructed buffers.
+   */
+  TripleBuffer() = default;
+
+  /**
+   * @brief Construct a new TripleBuffer object.
+   *
+   * @param v Initial value of all buffers.
+   */
+  explicit TripleBuffer(const T & v) : m_slots{Slot{v}, Slot{v}, Slot{v}} {}
+
+  /**
+   * @brief Back buffer, to be filled by the writer before publish().
+   * @details Writer only. Holds an older value, not necessarily the latest one.
+   */
+  T & write_buffer() noexcept { return m_slots[m_back].value; }
+
+  /**
+   * @brief Publish the back buffer.
+   * @details Writer only, wait-free.
+   */
+  void publish() noexcept
+  {
+    m_back = m_middle.exchange(m_back | dirty, std::memory_order_acq_rel) & index_mask;
+  }
+
+  /**
+   * @brief Copy a value to the back buffer and publish it.
+   * @details Writer only.
+   */
+  void write(const T & v)
+  {
+    write_buffer() = v;
+    publish();
+  }
+
+  /**
+   * @brief Move a value to the back buffer and publish it.
+   * @details Writer only.
+   */
+  void write(T && v)
+  {
+    write_buffer() = std::move(v);
+    publish();
+  }
+
+  /**
+   * @brief Switch the front buffer to the latest published value, if any.
+   * @details Reader only, wait-free.
+   *
+   * @return Returns true if a new value was published since the last update.
+   */
+  bool update() noexcept
+  {
+    if ((m_middle.load(std::memory_order_relaxed) & dirty) == 0) { return false; }
+    m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & index_mask;
+    return true;
+  }
+
+  /**
+   * @brief Front buffer.
+   * @details Reader only. Valid until the next update().
+   */
+  const T & read_buffer() const noexcept { return m_slots[m_front].value; }
+
+  /**
+   * @brief Update and return the front buffer.
+   * @details Reader only. Valid until the next call.
+   */
+  const T & read() noexcept
+  {
+    update();
+    return read_buffer();
+  }
+
+protected:
+  /// @cond
+  static constexpr uint8_t index_mask = 0b11;
+  static constexpr uint8_t dirty      = 0b100;
+
+  struct alignas(64) Slot
+  {
+    T value{};
+  };
+
+  std::array<Slot, 3> m_slots{};
+
+  alignas(64) uint8_t m_back = 0;  // writer
+  alignas(64) std::atomic<uint8_t> m_middle{1};
+  alignas(64) uint8_t m_front = 2;  // reader
+  /// @endcond
+};
+
+}  // namespace cbr
+
+#endif  // CBR_UTILS__LATEST_HPP_
@@ -38,13 +38,18 @@ namespace cbr {
  * Notes:
  * - Clock is default constructed from specified type if not specified at construction or set.
  * - First call to wait() does NOT wait.
+ * - Stateless clocks (see detail::is_stateless_clock), such as std::chrono clocks, are called
+ *   statically and the timer does not allocate them. Other clocks are shared through a
+ *   std::shared_ptr.
  *
  * @tparam clock_t Clock type (default: std::chrono::high_resolution_clock).
  * @tparam steady Boolean value to activate steady functionality (default: false).
  */
 template<typename clock_t = std::chrono::high_resolution_clock, bool steady = false>
-class LoopTimer
+class LoopTimer : protected detail::ClockHolder<clock_t>
 {
+  using clock_holder_t = detail::ClockHolder<clock_t>;
+
 public:
   using time_point_t = typename detail::ClockTraits<clock_t>::time_point;
   using duration_t   = typename detail::ClockTraits<clock_t>::duration;
@@ -70,7 +75,7 @@ public:
    * @param clock Shared pointer to a clock.
    */
   LoopTimer(const duration_t & rate, const std::shared_ptr<clock_t> & clock) noexcept
-      : m_rate(rate), m_clock(clock)
+      : clock_holder_t(clock), m_rate(rate)
   {}
 
   /**
@@ -80,7 +85,7 @@ public:
    * @param clock Shared pointer to a clock.
    */
   LoopTimer(const duration_t & rate, std::shared_ptr<clock_t> && clock) noexcept
-      : m_rate(rate), m_clock(std::move(clock))
+      : clock_holder_t(std::move(clock)), m_rate(rate)
   {}
 
   /**
@@ -88,14 +93,20 @@ public:
    *
    * @param clock Shared pointer to a clock.
    */
-  void set_clock(const std::shared_ptr<clock_t> & clock) noexcept { m_clock = clock; }
+  void set_clock(const std::shared_ptr<clock_t> & clock) noexcept
+  {
+    clock_holder_t::store_clock(clock);
+  }
 
   /**
    * @brief Set the timer's clock.
    *
    * @param clock Shared pointer to a clock.
    */
-  void set_clock(std::shared_ptr<clock_t> && clock) noexcept { m_clock = std::move(clock); }
+  void set_clock(std::shared_ptr<clock_t> && clock) noexcept
+  {
+    clock_holder_t::store_clock(std::move(clock));
+  }
 
   /**
    * @brief Set the timer's rate.
@@ -111,7 +122,7 @@ public:
    */
   void wait()
   {
-    const auto tNow = m_clock->now();
+    const auto tNow = clock_holder_t::clock_now();
     if (m_count > 0) {
       const auto tTarget = m_tNm1 + m_rate;
       const auto wait_time =
@@ -154,11 +165,10 @@ public:
    *
    * @return Timer's clock.
    */
-  std::shared_ptr<clock_t> get_clock() const { return m_clock; }
+  std::shared_ptr<clock_t> get_clock() const { return clock_holder_t::stored_clock(); }
 
 protected:
   duration_t m_rate{1};
-  std::shared_ptr<clock_t> m_clock = std::make_shared<clock_t>();
   time_point_t m_tNm1;
   std::size_t m_count = 0;
 };
@@ -0,0 +1,283 @@
+// Copyright Yamaha 2021
+// MIT License
+// https://github.com/yamaha-bps/cbr_utils/blob/master/LICENSE
+
+/** @file */
+
+#ifndef CBR_UTILS__MAPPED_FILE_HPP_
+#define CBR_UTILS__MAPPED_FILE_HPP_
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+
+namespace cbr {
+
+/**
+ * @brief Append-only file writer through a memory mapping.
+ * @details The file is grown (and remapped) by chunks of grow_size bytes as data is appended, and
+ * truncated to the exact amount of written data when closed. Writing is a memcpy into the page
+ * cache, there are no write() system calls on the hot path. The disk space of a chunk is
+ * allocated when the file is grown, so that a full disk makes reserve() or write() throw a
+ * std::system_error instead of the mapping raising SIGBUS.
+ *
+ * If the process dies before close(), the file keeps its grown size and ends with zeros, so
+ * formats written with it must store their own length, e.g. in a header updated through data().
+ *
+ * Example:
+ * ```
+ * MappedFileWriter file("data.bin");
+ * file.write(&value, sizeof(value));
+ *
+ * auto * dst = file.reserve(n);  // write n bytes in place
+ * std::memcpy(dst, src, n);
+ * file.commit(n);
+ * ```
+ */
+class MappedFileWriter
+{
+public:
+  MappedFileWriter(const MappedFileWriter &) = delete;
+  MappedFileWriter & operator=(const MappedFileWriter &) = delete;
+
+  MappedFileWriter(MappedFileWriter && o) noexcept
+      : m_fd(std::exchange(o.m_fd, -1)), m_data(std::exchange(o.m_data, nullptr)),
+        m_size(std::exchange(o.m_size, 0)), m_capacity(std::exchange(o.m_capacity, 0)),
+        m_grow_size(o.m_grow_size)
+  {}
+
+  MappedFileWriter & operator=(MappedFileWriter && o) noexcept
+  {
+    if (this != &o) {
+      close();
+      m_fd        = std::exchange(o.m_fd, -1);
+      m_data      = std::exchange(o.m_data, nullptr);
+      m_size      = std::exchange(o.m_size, 0);
+      m_capacity  = std::exchange(o.m_capacity, 0);
+      m_grow_size = o.m_grow_size;
+    }
+    return *this;
+  }
+
+  /**
+   * @brief Create (or truncate) a file for writing.
+   *
+   * @param path Path of the file.
+   * @param grow_size Number of bytes by which the file is grown when full (default: 16MB).
+   */
+  explicit MappedFileWriter(const std::string & path, const std::size_t grow_size = 1UL << 24)
+      : m_grow_size(grow_size == 0 ? 1 : grow_size)
+  {
+    m_fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (m_fd < 0) { throw std::system_error(errno, std::generic_category(), "open " + path); }
+  }
+
+  ~MappedFileWriter() { close(); }
+
+  /**
+   * @brief Get pointer to n writable bytes at the end of the file.
+   * @details The pointer is invalidated by the next call to reserve(), write() or close().
+   *
+   * @param n Number of bytes to reserve.
+   * @return Pointer to the reserved bytes.
+   */
+  std::byte * reserve(const std::size_t n)
+  {
+    if (m_size + n > m_capacity) { grow(m_size + n); }
+    return m_data + m_size;
+  }
+
+  /**
+   * @brief Append n previously reserved bytes to the file.
+   *
+   * @param n Number of bytes to append.
+   */
+  void commit(const std::size_t n) noexcept { m_size += n; }
+
+  /**
+   * @brief Append bytes to the file.
+   *
+   * @param data Pointer to the data.
+   * @param n Number of bytes to append.
+   */
+  void write(const void * data, const std::size_t n)
+  {
+    if (n == 0) { return; }
+    std::memcpy(reserve(n), data, n);
+    commit(n);
+  }
+
+  /**
+   * @brief Ask the kernel to start writing dirty pages back to disk.
+   * @details Does not block.
+   */
+  void flush() noexcept
+  {
+    if (m_data != nullptr) { msync(m_data, m_capacity, MS_ASYNC); }
+  }
+
+  /**
+   * @brief Unmap and truncate the file to the written size.
+   */
+  void close() noexcept
+  {
+    if (m_data != nullptr) {
+      munmap(m_data, m_capacity);
+      m_data = nullptr;
+    }
+    if (m_fd >= 0) {
+      [[maybe_unused]] const int ret = ftruncate(m_fd, static_cast<off_t>(m_size));
+      ::close(m_fd);
+      m_fd = -1;
+    }
+    m_capacity = 0;
+  }
+
+  /**
+   * @brief Check if file is open.
+   */
+  bool is_open() const noexcept { return m_fd >= 0; }
+
+  /**
+   * @brief Number of bytes written so far.
+   */
+  std::size_t size() const noexcept { return m_size; }
+
+  /**
+   * @brief Pointer to the beginning of the mapped data.
+   * @details The pointer is invalidated by the next call to reserve(), write() or close().
+   */
+  std::byte * data() noexcept { return m_data; }
+
+protected:
+  /// @cond
+  void grow(const std::size_t min_capacity)
+  {
+    if (m_fd < 0) { throw std::logic_error("MappedFileWriter is closed."); }
+
+    const std::size_t capacity = (min_capacity + m_grow_size - 1) / m_grow_size * m_grow_size;
+    const int err              = posix_fallocate(
+      m_fd, static_cast<off_t>(m_capacity), static_cast<off_t>(capacity - m_capacity));
+    if (err != 0) { throw std::system_error(err, std::generic_category(), "posix_fallocate"); }
+    if (m_data != nullptr) { munmap(m_data, m_capacity); }
+    void * ptr = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (ptr == MAP_FAILED) {
+      m_data     = nullptr;
+      m_capacity = 0;
+      throw std::system_error(errno, std::generic_category(), "mmap");
+    }
+    m_data     = static_cast<std::byte *>(ptr);
+    m_capacity = capacity;
+  }
+
+  int m_fd                = -1;
+  std::byte * m_data      = nullptr;
+  std::size_t m_size      = 0;
+  std::size_t m_capacity  = 0;
+  std::size_t m_grow_size = 0;
+  /// @endcond
+};
+
+/**
+ * @brief Read-only memory mapping of a whole file.
+ */
+class MappedFileReader
+{
+public:
+  MappedFileReader(const MappedFileReader &) = delete;
+  MappedFileReader & operator=(const MappedFileReader &) = delete;
+
+  MappedFileReader(MappedFileReader && o) noexcept
+      : m_data(std::exchange(o.m_data, nullptr)), m_size(std::exchange(o.m_size, 0))
+  {}
+
+  MappedFileReader & operator=(MappedFileReader && o) noexcept
+  {
+    if (this != &o) {
+      unmap();
+      m_data = std::exchange(o.m_data, nullptr);
+      m_size = std::exchange(o.m_size, 0);
+    }
+    return *this;
+  }
+
+  /**
+   * @brief Map a file for reading.
+   *
+   * @param path Path of the file.
+   */
+  explicit MappedFileReader(const std::string & path)
+  {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) { throw std::system_error(errno, std::generic_category(), "open " + path); }
+
+    struct stat st
+    {};
+    if (fstat(fd, &st) != 0) {
+      const int err = errno;
+      ::close(fd);
+      throw std::system_error(err, std::generic_category(), "fstat " + path);
+    }
+
+    m_size = static_cast<std::size_t>(st.st_size);
+    if (m_size > 0) {
+      void * ptr = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (ptr == MAP_FAILED) {
+        const int err = errno;
+        ::close(fd);
+        throw std::system_error(err, std::generic_category(), "mmap " + path);
+      }
+      m_data = static_cast<const std::byte *>(ptr);
+    }
+    ::close(fd);
+  }
+
+  ~MappedFileReader() { unmap(); }
+
+  /**
+   * @brief Pointer to the beginning of the file.
+   */
+  const std::byte * data() const noexcept { return m_data; }
+
+  /**
+   * @brief Size of the file.
+   */
+  std::size_t size() const noexcept { return m_size; }
+
+  /**
+   * @brief Advise the kernel that the file will be read sequentially.
+   */
+  void advise_sequential() const noexcept
+  {
+    if (m_data != nullptr) {
+      madvise(const_cast<std::byte *>(m_data), m_size, MADV_SEQUENTIAL);  // NOLINT
+    }
+  }
+
+protected:
+  /// @cond
+  void unmap() noexcept
+  {
+    if (m_data != nullptr) {
+      munmap(const_cast<std::byte *>(m_data), m_size);  // NOLINT
+      m_data = nullptr;
+    }
+  }
+
+  const std::byte * m_data = nullptr;
+  std::size_t m_size       = 0;
+  /// @endcond
+};
+
+}  // namespace cbr
+
+#endif  // CBR_UTILS__MAPPED_FILE_HPP_
@@ -0,0 +1,632 @@
+// Copyright Yamaha 2021
+// MIT License
+// https://github.com/yamaha-bps/cbr_utils/blob/master/LICENSE
+
+/** @file */
+
+#ifndef CBR_UTILS__METRICS_HPP_
+#define CBR_UTILS__METRICS_HPP_
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "flat_map.hpp"
+
+namespace cbr {
+
+/// @cond
+
+namespace detail {
+
+// One cache line of counters, shards never share a line
+struct alignas(64) MetricLine
+{
+  std::array<std::atomic<uint64_t>, 8> v{};
+};
+
+// Small dense index of the calling thread, used to pick a shard
+inline std::size_t metric_thread_index() noexcept
+{
+  static std::atomic<std::size_t> next{0};
+  thread_local const std::size_t index = next.fetch_add(1, std::memory_order_relaxed);
+  return index;
+}
+
+inline std::size_t metric_default_shards() noexcept
+{
+  const std::size_t n = std::max(1U, std::thread::hardware_concurrency());
+  std::size_t shards  = 1;
+  while (shards < n) { shards <<= 1; }
+  return shards;
+}
+
+inline void metric_add_double(std::atomic<uint64_t> & a, const double v) noexcept
+{
+  uint64_t old = a.load(std::memory_order_relaxed);
+  uint64_t upd = 0;
+  do {
+    double d = 0.;
+    std::memcpy(&d, &old, sizeof(d));
+    d += v;
+    std::memcpy(&upd, &d, sizeof(d));
+  } while (!a.compare_exchange_weak(old, upd, std::memory_order_relaxed));
+}
+
+inline double metric_load_double(const std::atomic<uint64_t> & a) noexcept
+{
+  const uint64_t bits = a.load(std::memory_order_relaxed);
+  double d            = 0.;
+  std::memcpy(&d, &bits, sizeof(d));
+  return d;
+}
+
+inline void metric_write_value(std::ostream & os, const double v)
+{
+  if (std::isnan(v)) {
+    os << "NaN";
+  } else if (std::isinf(v)) {
+    os << (v > 0 ? "+Inf" : "-Inf");
+  } else {
+    // shortest of 15 or 17 significant digits that round trips
+    std::array<char, 32> buf{};
+    int n = std::snprintf(buf.data(), buf.size(), "%.15g", v);
+    if (std::strtod(buf.data(), nullptr) != v) {
+      n = std::snprintf(buf.data(), buf.size(), "%.17g", v);
+    }
+    os.write(buf.data(), std::max(n, 0));
+  }
+}
+
+}  // namespace detail
+
+/// @endcond
+
+/**
+ * @brief Counter with one cache line per shard.
+ * @details Threads increment the shard of their thread index, so that threads updating the counter
+ * concurrently do not share cache lines as long as there are enough shards. The value is the sum
+ * of all shards, computed when read.
+ *
+ * Example:
+ * ```
+ * ShardedCounter tasks;
+ * pool.enqueue([&tasks] { work(); tasks.inc(); });
+ * std::cout << tasks.value() << std::endl;
+ * ```
+ */
+class ShardedCounter
+{
+public:
+  ShardedCounter(const ShardedCounter &) = delete;
+  ShardedCounter(ShardedCounter &&)      = delete;
+  ShardedCounter & operator=(const ShardedCounter &) = delete;
+  ShardedCounter & operator=(ShardedCounter &&) = delete;
+  ~ShardedCounter()                             = default;
+
+  /**
+   * @brief Construct a new ShardedCounter object.
+   *
+   * @param n_shards Number of shards, rounded up to a power of two (default: number of hardware
+   * threads).
+   */
+  explicit ShardedCounter(const std::size_t n_shards = detail::metric_default_shards())
+  {
+    std::size_t n = 1;
+    while (n < n_shards) { n <<= 1; }
+    m_lines = std::make_unique<detail::MetricLine[]>(n);
+    m_mask  = n - 1;
+  }
+
+  /**
+   * @brief Add to the counter.
+   *
+   * @param n Increment, can be negative to use the counter as a gauge.
+   */
+  void inc(const int64_t n = 1) noexcept
+  {
+    m_lines[detail::metric_thread_index() & m_mask].v[0].fetch_add(
+      static_cast<uint64_t>(n), std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Sum of all shards.
+   */
+  int64_t value() const noexcept
+  {
+    uint64_t sum = 0;
+    for (std::size_t i = 0; i <= m_mask; ++i) {
+      sum += m_lines[i].v[0].load(std::memory_order_relaxed);
+    }
+    return static_cast<int64_t>(sum);
+  }
+
+  /**
+   * @brief Set the counter to zero.
+   * @details Increments performed concurrently may be lost.
+   */
+  void reset() noexcept
+  {
+    for (std::size_t i = 0; i <= m_mask; ++i) {
+      m_lines[i].v[0].store(0, std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * @brief Number of shards.
+   */
+  std::size_t shards() const noexcept { return m_mask + 1; }
+
+protected:
+  /// @cond
+  std::unique_ptr<detail::MetricLine[]> m_lines;
+  std::size_t m_mask = 0;
+  /// @endcond
+};
+
+/**
+ * @brief Gauge holding a single value.
+ * @details Intended for values that are set from one place, e.g. a queue size sampled by a loop.
+ * Use a ShardedCounter for values that are incremented and decremented by many threads.
+ */
+class Gauge
+{
+public:
+  /**
+   * @brief Set the value.
+   */
+  void set(const double v) noexcept
+  {
+    uint64_t bits = 0;
+    std::memcpy(&bits, &v, sizeof(v));
+    m_line.v[0].store(bits, std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Add to the value.
+   */
+  void add(const double v) noexcept { detail::metric_add_double(m_line.v[0], v); }
+
+  /**
+   * @brief Current value.
+   */
+  double value() const noexcept { return detail::metric_load_double(m_line.v[0]); }
+
+protected:
+  /// @cond
+  detail::MetricLine m_line{};
+  /// @endcond
+};
+
+/**
+ * @brief Snapshot of a Histogram.
+ */
+struct HistogramSnapshot
+{
+  std::vector<double> bounds{};    ///< Upper bounds of the buckets, without +Inf
+  std::vector<uint64_t> counts{};  ///< Number of observations per bucket, the last one is +Inf
+  double sum     = 0.;             ///< Sum of the observations
+  uint64_t count = 0;              ///< Number of observations
+};
+
+/**
+ * @brief Histogram with fixed buckets and cache line padded shards.
+ * @details An observation increments the bucket of the first upper bound greater than or equal to
+ * it, and adds it to the sum, in the shard of the calling thread. Shards are aggregated by
+ * snapshot().
+ *
+ * Example:
+ * ```
+ * Histogram latency(Histogram::exponential_buckets(1e-6, 2., 20));
+ * timer.tic();
+ * work();
+ * latency.observe(timer.toc());
+ * ```
+ */
+class Histogram
+{
+public:
+  Histogram(const Histogram &) = delete;
+  Histogram(Histogram &&)      = delete;
+  Histogram & operator=(const Histogram &) = delete;
+  Histogram & operator=(Histogram &&) = delete;
+  ~Histogram()                        = default;
+
+  /**
+   * @brief Construct a new Histogram object.
+   * @details Throws std::invalid_argument if bounds are not strictly increasing.
+   *
+   * @param bounds Upper bounds of the buckets, an implicit +Inf bucket is added.
+   * @param n_shards Number of shards, rounded up to a power of two (default: number of hardware
+   * threads).
+   */
+  explicit Histogram(std::vector<double> bounds = default_buckets(),
+    const std::size_t n_shards                  = detail::metric_default_shards())
+      : m_bounds(std::move(bounds))
+  {
+    for (std::size_t i = 0; i < m_bounds.size(); ++i) {
+      if (std::isnan(m_bounds[i]) || (i > 0 && !(m_bounds[i - 1] < m_bounds[i]))) {
+        throw std::invalid_argument("Histogram bounds must be strictly increasing.");
+      }
+    }
+    if (!m_bounds.empty() && std::isinf(m_bounds.back()) && m_bounds.back() > 0) {
+      m_bounds.pop_back();
+    }
+
+    std::size_t n = 1;
+    while (n < n_shards) { n <<= 1; }
+    m_mask = n - 1;
+
+    // bucket counts followed by the sum
+    m_lines_per_shard = (m_bounds.size() + 2 + 7) / 8;
+    m_lines           = std::make_unique<detail::MetricLine[]>(n * m_lines_per_shard);
+  }
+
+  /**
+   * @brief Add an observation.
+   */
+  void observe(const double v) noexcept
+  {
+    const auto bucket = static_cast<std::size_t>(
+      std::lower_bound(m_bounds.begin(), m_bounds.end(), v) - m_bounds.begin());
+    const std::size_t shard = (detail::metric_thread_index() & m_mask) * m_lines_per_shard;
+    slot(shard, bucket).fetch_add(1, std::memory_order_relaxed);
+    detail::metric_add_double(slot(shard, m_bounds.size() + 1), v);
+  }
+
+  /**
+   * @brief Aggregate all shards.
+   */
+  HistogramSnapshot snapshot() const
+  {
+    HistogramSnapshot res;
+    res.bounds = m_bounds;
+    res.counts.assign(m_bounds.size() + 1, 0);
+    for (std::size_t s = 0; s <= m_mask; ++s) {
+      const std::size_t shard = s * m_lines_per_shard;
+      for (std::size_t b = 0; b <= m_bounds.size(); ++b) {
+        res.counts[b] += slot(shard, b).load(std::memory_order_relaxed);
+      }
+      res.sum += detail::metric_load_double(slot(shard, m_bounds.size() + 1));
+    }
+    for (const auto c : res.counts) { res.count += c; }
+    return res;
+  }
+
+  /**
+   * @brief Upper bounds of the buckets, without +Inf.
+   */
+  const std::vector<double> & bounds() const noexcept { return m_bounds; }
+
+  /**
+   * @brief Default buckets, suited to durations in seconds.
+   */
+  static std::vector<double> default_buckets()
+  {
+    return {0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1., 2.5, 5., 10.};
+  }
+
+  /**
+   * @brief Buckets start, start + width, ..., start + (n - 1) * width.
+   */
+  static std::vector<double> linear_buckets(const double start, const double width, std::size_t n)
+  {
+    std::vector<double> res(n);
+    for (std::size_t i = 0; i < n; ++i) { res[i] = start + static_cast<double>(i) * width; }
+    return res;
+  }
+
+  /**
+   * @brief Buckets start, start * factor, ..., start * factor^(n - 1).
+   */
+  static std::vector<double> exponential_buckets(
+    const double start, const double factor, std::size_t n)
+  {
+    std::vector<double> res(n);
+    double b = start;
+    for (std::size_t i = 0; i < n; ++i, b *= factor) { res[i] = b; }
+    return res;
+  }
+
+protected:
+  /// @cond
+  std::atomic<uint64_t> & slot(const std::size_t shard, const std::size_t i) const noexcept
+  {
+    return m_lines[shard + i / 8].v[i % 8];
+  }
+
+  std::vector<double> m_bounds;
+  std::size_t m_mask            = 0;
+  std::size_t m_lines_per_shard = 1;
+  std::unique_ptr<detail::MetricLine[]> m_lines;
+  /// @endcond
+};
+
+/**
+ * @brief Named collection of metrics exported in Prometheus text format.
+ * @details Metrics are created on first access and shared by subsequent accesses with the same
+ * name. Values computed by other components, e.g. the number of pending ThreadPool tasks or the
+ * average of a CyberTimer, are exported with callback gauges evaluated at export time.
+ *
+ * Example:
+ * ```
+ * MetricsRegistry registry;
+ * auto & frames = registry.counter("frames_total", "Number of synchronized frames.");
+ * auto & latency = registry.histogram("loop_seconds", "Loop duration.");
+ * registry.gauge_callback("loop_average_seconds", "Average loop duration.", [&timer] {
+ *   return timer.get_average();
+ * });
+ *
+ * sync.register_callback([&frames](auto &&...) { frames.inc(); });
+ *
+ * registry.write_file("/var/lib/node_exporter/app.prom");
+ * ```
+ * Notes:
+ * - Metric names must match `[a-zA-Z_:][a-zA-Z0-9_:]*`, std::invalid_argument is thrown otherwise
+ *   or if a name is reused for another metric type.
+ * - Returned references are valid for the lifetime of the registry.
+ */
+class MetricsRegistry
+{
+public:
+  /**
+   * @brief Get or create a counter.
+   *
+   * @param name Metric name.
+   * @param help Help text, ignored if the metric exists.
+   */
+  ShardedCounter & counter(const std::string & name, const std::string & help = "")
+  {
+    return get<ShardedCounter>(name, help, [] { return std::make_unique<ShardedCounter>(); });
+  }
+
+  /**
+   * @brief Get or create a gauge.
+   *
+   * @param name Metric name.
+   * @param help Help text, ignored if the metric exists.
+   */
+  Gauge & gauge(const std::string & name, const std::string & help = "")
+  {
+    return get<Gauge>(name, help, [] { return std::make_unique<Gauge>(); });
+  }
+
+  /**
+   * @brief Get or create a histogram.
+   *
+   * @param name Metric name.
+   * @param help Help text, ignored if the metric exists.
+   * @param bounds Upper bounds of the buckets, ignored if the metric exists.
+   */
+  Histogram & histogram(const std::string & name,
+    const std::string & help   = "",
+    std::vector<double> bounds = Histogram::default_buckets())
+  {
+    return get<Histogram>(name, help, [&bounds] {
+      return std::make_unique<Histogram>(std::move(bounds));
+    });
+  }
+
+  /**
+   * @brief Register a gauge whose value is computed at export time.
+   * @details Replaces an existing callback gauge of the same name. The callback is called by the
+   * thread exporting the metrics, without holding the registry lock, so that it may access the
+   * registry.
+   *
+   * @param name Metric name.
+   * @param help Help text.
+   * @param f Callback returning the value.
+   */
+  void gauge_callback(const std::string & name, const std::string & help, std::function<double()> f)
+  {
+    check_name(name);
+    std::scoped_lock lock(m_mtx);
+    auto it = m_metrics.find(name);
+    if (it != m_metrics.end() && !std::holds_alternative<std::function<double()>>(it->second.m)) {
+      throw std::invalid_argument("Metric " + name + " already exists with another type.");
+    }
+    m_metrics[name] = Entry{help, std::move(f)};
+  }
+
+  /**
+   * @brief Remove a metric.
+   * @details Invalidates references to it.
+   */
+  void remove(const std::string & name)
+  {
+    std::scoped_lock lock(m_mtx);
+    m_metrics.erase(name);
+  }
+
+  /**
+   * @brief Write all metrics in Prometheus text format, sorted by name.
+   *
+   * @param os Output stream.
+   */
+  void write(std::ostream & os) const
+  {
+    // values are read under the lock, callbacks run and the output is formatted without it
+    std::vector<Sample> samples;
+    {
+      std::scoped_lock lock(m_mtx);
+      samples.reserve(m_metrics.size());
+      for (const auto & [name, entry] : m_metrics) {
+        samples.push_back(Sample{name,
+          entry.help,
+          std::visit(
+            [](const auto & m) -> sample_t {
+              using T = std::decay_t<decltype(m)>;
+              if constexpr (std::is_same_v<T, std::function<double()>>) {
+                return m;
+              } else if constexpr (std::is_same_v<T, std::unique_ptr<Histogram>>) {
+                return m->snapshot();
+              } else {
+                return m->value();
+              }
+            },
+            entry.m)});
+      }
+    }
+
+    for (const auto & [name, help, value] : samples) {
+      if (!help.empty()) { os << "# HELP " << name << ' ' << escape_help(help) << '\n'; }
+      std::visit(
+        [&os, &name = name](const auto & v) {
+          using T = std::decay_t<decltype(v)>;
+          if constexpr (std::is_same_v<T, int64_t>) {
+            os << "# TYPE " << name << " counter\n" << name << ' ' << v << '\n';
+          } else if constexpr (std::is_same_v<T, HistogramSnapshot>) {
+            os << "# TYPE " << name << " histogram\n";
+            uint64_t cumulative = 0;
+            for (std::size_t i = 0; i < v.counts.size(); ++i) {
+              cumulative += v.counts[i];
+              os << name << "_bucket{le=\"";
+              if (i < v.bounds.size()) {
+                detail::metric_write_value(os, v.bounds[i]);
+              } else {
+                os << "+Inf";
+              }
+              os << "\"} " << cumulative << '\n';
+            }
+            os << name << "_sum ";
+            detail::metric_write_value(os, v.sum);
+            os << '\n' << name << "_count " << v.count << '\n';
+          } else {
+            os << "# TYPE " << name << " gauge\n" << name << ' ';
+            if constexpr (std::is_same_v<T, double>) {
+              detail::metric_write_value(os, v);
+            } else {
+              detail::metric_write_value(os, v ? v() : std::nan(""));
+            }
+            os << '\n';
+          }
+        },
+        value);
+    }
+  }
+
+  /**
+   * @brief Get all metrics in Prometheus text format, see write().
+   */
+  std::string to_string() const
+  {
+    std::ostringstream ss;
+    write(ss);
+    return ss.str();
+  }
+
+  /**
+   * @brief Write all metrics to a file in Prometheus text format.
+   * @details The file is written to a temporary file that is renamed, so that readers such as the
+   * node exporter textfile collector never see a partial file. Throws std::runtime_error on
+   * failure.
+   *
+   * @param path File path.
+   */
+  void write_file(const std::string & path) const
+  {
+    const std::string tmp = path + ".tmp";
+    {
+      std::ofstream ofs(tmp, std::ios::trunc);
+      if (!ofs) { throw std::runtime_error("Could not open " + tmp); }
+      write(ofs);
+      if (!ofs) { throw std::runtime_error("Could not write " + tmp); }
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+      std::remove(tmp.c_str());
+      throw std::runtime_error("Could not rename " + tmp + " to " + path);
+    }
+  }
+
+protected:
+  /// @cond
+  using metric_t = std::variant<std::unique_ptr<ShardedCounter>,
+    std::unique_ptr<Gauge>,
+    std::unique_ptr<Histogram>,
+    std::function<double()>>;
+
+  struct Entry
+  {
+    std::string help;
+    metric_t m;
+  };
+
+  // value of a metric at export time: counter, gauge, histogram or gauge callback
+  using sample_t = std::variant<int64_t, double, HistogramSnapshot, std::function<double()>>;
+
+  struct Sample
+  {
+    std::string name;
+    std::string help;
+    sample_t value;
+  };
+
+  template<typename T, typename F>
+  T & get(const std::string & name, const std::string & help, F && make)
+  {
+    check_name(name);
+    std::scoped_lock lock(m_mtx);
+    auto it = m_metrics.find(name);
+    if (it == m_metrics.end()) {
+      it = m_metrics.emplace(name, Entry{help, std::forward<F>(make)()}).first;
+    }
+    auto * m = std::get_if<std::unique_ptr<T>>(&it->second.m);
+    if (m == nullptr) {
+      throw std::invalid_argument("Metric " + name + " already exists with another type.");
+    }
+    return **m;
+  }
+
+  static void check_name(const std::string_view name)
+  {
+    const auto valid_char = [](const char c, const bool first) {
+      return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c == ':'
+          || (!first && c >= '0' && c <= '9');
+    };
+    bool valid = !name.empty();
+    for (std::size_t i = 0; valid && i < name.size(); ++i) { valid = valid_char(name[i], i == 0); }
+    if (!valid) { throw std::invalid_argument("Invalid metric name: " + std::string(name)); }
+  }
+
+  static std::string escape_help(const std::string & help)
+  {
+    std::string res;
+    for (const char c : help) {
+      if (c == '\\') {
+        res += "\\\\";
+      } else if (c == '\n') {
+        res += "\\n";
+      } else {
+        res += c;
+      }
+    }
+    return res;
+  }
+
+  mutable std::mutex m_mtx;
+  flat_map<std::string, Entry, std::less<>> m_metrics{};
+  /// @endcond
+};
+
+}  // namespace cbr
+
+#endif  // CBR_UTILS__METRICS_HPP_
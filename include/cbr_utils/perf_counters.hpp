@@ -0,0 +1,295 @@
+// Copyright Yamaha 2021
+// MIT License
+// https://github.com/yamaha-bps/cbr_utils/blob/master/LICENSE
+
+/** @file */
+
+#ifndef CBR_UTILS__PERF_COUNTERS_HPP_
+#define CBR_UTILS__PERF_COUNTERS_HPP_
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace cbr {
+
+/**
+ * @brief Values of the hardware counters of a PerfCounters region.
+ * @details Counters that could not be opened have their valid flag set to false and a value of 0.
+ */
+struct PerfCounterValues
+{
+  uint64_t cycles        = 0;
+  uint64_t instructions  = 0;
+  uint64_t cache_misses  = 0;
+  uint64_t branch_misses = 0;
+
+  bool cycles_valid        = false;
+  bool instructions_valid  = false;
+  bool cache_misses_valid  = false;
+  bool branch_misses_valid = false;
+
+  /**
+   * @brief Instructions per cycle, 0 if unavailable.
+   */
+  double ipc() const noexcept
+  {
+    if (!cycles_valid || !instructions_valid || cycles == 0) { return 0.; }
+    return static_cast<double>(instructions) / static_cast<double>(cycles);
+  }
+
+  PerfCounterValues & operator+=(const PerfCounterValues & o) noexcept
+  {
+    cycles += o.cycles;
+    instructions += o.instructions;
+    cache_misses += o.cache_misses;
+    branch_misses += o.branch_misses;
+    cycles_valid        = o.cycles_valid;
+    instructions_valid  = o.instructions_valid;
+    cache_misses_valid  = o.cache_misses_valid;
+    branch_misses_valid = o.branch_misses_valid;
+    return *this;
+  }
+};
+
+/**
+ * @brief Linux hardware performance counters for a code region.
+ * @details Opens a perf event group counting cycles, instructions, cache misses and branch misses
+ * of the calling thread in user space. The group is started and stopped with tic() and toc(), in
+ * the same way as a CyberTimer, and all counters are read at once with a single read() of the
+ * group. If the counters are multiplexed by the kernel the values are scaled accordingly.
+ *
+ * Perf events are often unavailable, e.g. in containers or when kernel.perf_event_paranoid is too
+ * restrictive. In that case available() returns false, tic() and toc() do nothing and all values
+ * are reported invalid. Individual counters that are not supported by the hardware are reported
+ * invalid as well.
+ *
+ * Example usage:
+ * ```
+ * PerfCounters counters;
+ * CyberTimerMicro<> timer;
+ *
+ * timer.tic();
+ * counters.tic();
+ * hotFunction();
+ * const auto & v = counters.toc();
+ * timer.toc();
+ *
+ * std::cout << v.instructions << " instructions, ipc " << v.ipc() << std::endl;
+ * ```
+ * Notes:
+ * - Counters only count the thread that constructed the object.
+ */
+class PerfCounters
+{
+public:
+  PerfCounters(const PerfCounters &) = delete;
+  PerfCounters & operator=(const PerfCounters &) = delete;
+
+  PerfCounters(PerfCounters && o) noexcept
+      : m_fds(std::exchange(o.m_fds, closed_fds())), m_ids(o.m_ids), m_latest(o.m_latest),
+        m_total(o.m_total), m_count(o.m_count), m_running(o.m_running)
+  {}
+
+  PerfCounters & operator=(PerfCounters && o) noexcept
+  {
+    if (this != &o) {
+      close_all();
+      m_fds     = std::exchange(o.m_fds, closed_fds());
+      m_ids     = o.m_ids;
+      m_latest  = o.m_latest;
+      m_total   = o.m_total;
+      m_count   = o.m_count;
+      m_running = o.m_running;
+    }
+    return *this;
+  }
+
+  /**
+   * @brief Open the counter group for the calling thread.
+   * @details Never throws, see available().
+   */
+  PerfCounters() noexcept
+  {
+    static constexpr std::array<uint64_t, n_counters> configs{PERF_COUNT_HW_CPU_CYCLES,
+      PERF_COUNT_HW_INSTRUCTIONS,
+      PERF_COUNT_HW_CACHE_MISSES,
+      PERF_COUNT_HW_BRANCH_MISSES};
+
+    for (std::size_t i = 0; i < n_counters; ++i) {
+      perf_event_attr attr{};
+      attr.type           = PERF_TYPE_HARDWARE;
+      attr.size           = sizeof(perf_event_attr);
+      attr.config         = configs[i];
+      attr.exclude_kernel = 1;
+      attr.exclude_hv     = 1;
+      attr.read_format    = PERF_FORMAT_GROUP | PERF_FORMAT_ID | PERF_FORMAT_TOTAL_TIME_ENABLED
+                       | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+      const int leader = group_fd();
+      if (leader < 0) { attr.disabled = 1; }  // members follow the leader
+      const long fd = syscall(SYS_perf_event_open, &attr, 0, -1, leader, PERF_FLAG_FD_CLOEXEC);
+      if (fd >= 0) {
+        m_fds[i] = static_cast<int>(fd);
+        if (ioctl(m_fds[i], PERF_EVENT_IOC_ID, &m_ids[i]) != 0) {
+          ::close(m_fds[i]);
+          m_fds[i] = -1;
+        }
+      }
+    }
+  }
+
+  ~PerfCounters() { close_all(); }
+
+  /**
+   * @brief Check if at least one counter could be opened.
+   */
+  bool available() const noexcept { return group_fd() >= 0; }
+
+  /**
+   * @brief Reset and start the counters.
+   */
+  void tic() noexcept
+  {
+    const int leader = group_fd();
+    if (leader < 0) { return; }
+    ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    m_running = true;
+  }
+
+  /**
+   * @brief Stop the counters and read them.
+   * @details Returns the latest values if the counters are not running.
+   *
+   * @return Counter values since last tic().
+   */
+  const PerfCounterValues & toc() noexcept
+  {
+    if (!m_running) { return m_latest; }
+    m_running = false;
+
+    const int leader = group_fd();
+    ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+    // layout of a group read with PERF_FORMAT_TOTAL_TIME_* and PERF_FORMAT_ID
+    struct
+    {
+      uint64_t nr;
+      uint64_t time_enabled;
+      uint64_t time_running;
+      struct
+      {
+        uint64_t value;
+        uint64_t id;
+      } values[n_counters];
+    } data{};
+
+    m_latest = PerfCounterValues{};
+    if (read(leader, &data, sizeof(data)) <= 0 || data.time_running == 0) { return m_latest; }
+
+    const double scale =
+      static_cast<double>(data.time_enabled) / static_cast<double>(data.time_running);
+
+    for (std::size_t j = 0; j < data.nr && j < n_counters; ++j) {
+      for (std::size_t i = 0; i < n_counters; ++i) {
+        if (m_fds[i] < 0 || m_ids[i] != data.values[j].id) { continue; }
+        const auto v = static_cast<uint64_t>(static_cast<double>(data.values[j].value) * scale);
+        switch (i) {
+          case 0:
+            m_latest.cycles       = v;
+            m_latest.cycles_valid = true;
+            break;
+          case 1:
+            m_latest.instructions       = v;
+            m_latest.instructions_valid = true;
+            break;
+          case 2:
+            m_latest.cache_misses       = v;
+            m_latest.cache_misses_valid = true;
+            break;
+          default:
+            m_latest.branch_misses       = v;
+            m_latest.branch_misses_valid = true;
+            break;
+        }
+      }
+    }
+
+    m_total += m_latest;
+    ++m_count;
+    return m_latest;
+  }
+
+  /**
+   * @brief Reset the accumulated values and restart the counters.
+   */
+  void restart() noexcept
+  {
+    m_total = PerfCounterValues{};
+    m_count = 0;
+    tic();
+  }
+
+  /**
+   * @brief Get whether or not the counters are running.
+   */
+  bool is_running() const noexcept { return m_running; }
+
+  /**
+   * @brief Get counter values between the latest tic() and toc() calls.
+   */
+  const PerfCounterValues & get_latest() const noexcept { return m_latest; }
+
+  /**
+   * @brief Get counter values accumulated over all pairs of tic() and toc() calls.
+   * @details Since construction or last restart.
+   */
+  const PerfCounterValues & get_total() const noexcept { return m_total; }
+
+  /**
+   * @brief Get number of pairs of tic() and toc() calls accumulated in get_total().
+   */
+  const std::size_t & get_count() const noexcept { return m_count; }
+
+protected:
+  /// @cond
+  static constexpr std::size_t n_counters = 4;
+
+  static constexpr std::array<int, n_counters> closed_fds() noexcept { return {-1, -1, -1, -1}; }
+
+  // first opened counter leads the group
+  int group_fd() const noexcept
+  {
+    for (const int fd : m_fds) {
+      if (fd >= 0) { return fd; }
+    }
+    return -1;
+  }
+
+  void close_all() noexcept
+  {
+    for (int & fd : m_fds) {
+      if (fd >= 0) { ::close(fd); }
+      fd = -1;
+    }
+  }
+
+  std::array<int, n_counters> m_fds = closed_fds();
+  std::array<uint64_t, n_counters> m_ids{};
+  PerfCounterValues m_latest{};
+  PerfCounterValues m_total{};
+  std::size_t m_count = 0;
+  bool m_running      = false;
+  /// @endcond
+};
+
+}  // namespace cbr
+
+#endif  // CBR_UTILS__PERF_COUNTERS_HPP_
@@ -0,0 +1,290 @@
+// Copyright Yamaha 2021
+// MIT License
+// https://github.com/yamaha-bps/cbr_utils/blob/master/LICENSE
+
+/** @file */
+
+#ifndef CBR_UTILS__RATE_LIMITER_HPP_
+#define CBR_UTILS__RATE_LIMITER_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+#include "clock_traits.hpp"
+
+namespace cbr {
+
+/// @cond
+
+namespace detail {
+
+/**
+ * @brief Rate limiter based on the generic cell rate algorithm (GCRA).
+ * @details The whole state is a single theoretical arrival time (TAT), in nanoseconds since
+ * construction, updated with one compare-exchange per request (retried only under contention).
+ * A request of n units conforms if max(TAT, now) + n * T - now <= tau, where T is the emission
+ * interval and tau the tolerance.
+ *
+ * @tparam clock_t Clock type.
+ * @tparam shaping If true, acquire() spaces requests by T, otherwise bursts up to tau are allowed.
+ */
+template<typename clock_t, bool shaping>
+class GcraLimiter : protected ClockHolder<clock_t>
+{
+  using clock_holder_t = ClockHolder<clock_t>;
+
+public:
+  using time_point_t = typename ClockTraits<clock_t>::time_point;
+
+  GcraLimiter(const GcraLimiter &) = delete;
+  GcraLimiter(GcraLimiter &&)      = delete;
+  GcraLimiter & operator=(const GcraLimiter &) = delete;
+  GcraLimiter & operator=(GcraLimiter &&) = delete;
+  ~GcraLimiter()                          = default;
+
+  GcraLimiter(const double rate, const double tolerance) { init(rate, tolerance); }
+
+  GcraLimiter(const double rate, const double tolerance, std::shared_ptr<clock_t> clock)
+      : clock_holder_t(std::move(clock))
+  {
+    init(rate, tolerance);
+  }
+
+  bool try_acquire(const int64_t n) noexcept
+  {
+    if (n <= 0) { return false; }
+    const int64_t now = elapsed();
+    int64_t tat       = m_tat.load(std::memory_order_relaxed);
+    while (true) {
+      const int64_t new_tat = std::max(tat, now) + n * m_interval;
+      if (new_tat - now > m_tau) { return false; }
+      if (m_tat.compare_exchange_weak(tat, new_tat, std::memory_order_relaxed)) { return true; }
+    }
+  }
+
+  std::chrono::nanoseconds acquire(const int64_t n)
+  {
+    if (n <= 0) { throw std::invalid_argument("Rate limiter requests must be positive."); }
+    const int64_t now = elapsed();
+    int64_t tat       = m_tat.load(std::memory_order_relaxed);
+    int64_t new_tat   = 0;
+    do {
+      new_tat = std::max(tat, now) + n * m_interval;
+    } while (!m_tat.compare_exchange_weak(tat, new_tat, std::memory_order_relaxed));
+
+    // conformance time of the request
+    const int64_t start = shaping ? new_tat - n * m_interval : new_tat - m_tau;
+    const auto wait     = std::chrono::nanoseconds(std::max<int64_t>(0, start - now));
+    if (wait.count() > 0) { clock_holder_t::clock_sleep_for(wait); }
+    return wait;
+  }
+
+  double available() const noexcept
+  {
+    const int64_t now = elapsed();
+    const int64_t tat = std::max(m_tat.load(std::memory_order_relaxed), now);
+    return static_cast<double>(m_tau - (tat - now)) / static_cast<double>(m_interval);
+  }
+
+  void reset() noexcept { m_tat.store(elapsed(), std::memory_order_relaxed); }
+
+protected:
+  void init(const double rate, const double tolerance)
+  {
+    if (!(rate > 0.) || !(tolerance >= 1.)) {
+      throw std::invalid_argument("Rate limiter rate must be positive and capacity at least 1.");
+    }
+    m_t0       = clock_holder_t::clock_now();
+    m_interval = std::max<int64_t>(1, std::llround(1e9 / rate));
+    m_tau      = std::llround(tolerance * static_cast<double>(m_interval));
+  }
+
+  int64_t elapsed() const noexcept
+  {
+    const auto d = clock_holder_t::clock_now() - m_t0;
+    return ClockTraits<clock_t>::template duration_cast<std::chrono::nanoseconds>(d).count();
+  }
+
+  time_point_t m_t0{};
+  int64_t m_interval = 1;
+  int64_t m_tau      = 1;
+  std::atomic<int64_t> m_tat{0};
+};
+
+}  // namespace detail
+
+/// @endcond
+
+/**
+ * @brief Lock-free token bucket rate limiter.
+ * @details Tokens are added at a constant rate to a bucket holding at most burst tokens, which is
+ * initially full. A request of n tokens is granted if the bucket holds n tokens. Bursts of up to
+ * burst requests are thus allowed, and the long term rate is bounded by rate.
+ *
+ * Implemented with the generic cell rate algorithm: the state is a single atomic timestamp updated
+ * by one compare-exchange per try_acquire(), so the limiter can be shared by several threads
+ * without locking.
+ *
+ * Example:
+ * ```
+ * TokenBucket<> limiter(10., 5.);  // 10 per second, bursts of 5
+ * if (limiter.try_acquire()) { log(msg); }
+ *
+ * while (true) {
+ *   limiter.acquire();  // paces the loop like LoopTimer::wait()
+ *   produce();
+ * }
+ * ```
+ * Notes:
+ * - Clock is default constructed from specified type if not specified at construction. Stateless
+ *   clocks are called statically and not allocated, see detail::is_stateless_clock.
+ * - acquire() sleeps through the clock if it has a sleep_for(std::chrono::nanoseconds) member, so
+ *   that simulated clocks are advanced instead of blocking (see detail::has_clock_sleep).
+ *
+ * @tparam clock_t Clock type (default: std::chrono::steady_clock).
+ */
+template<typename clock_t = std::chrono::steady_clock>
+class TokenBucket : protected detail::GcraLimiter<clock_t, false>
+{
+  using base_t = detail::GcraLimiter<clock_t, false>;
+
+public:
+  using typename base_t::time_point_t;
+
+  /**
+   * @brief Construct a new TokenBucket object.
+   * @details Throws std::invalid_argument if rate is not positive or burst is less than 1.
+   *
+   * @param rate Number of tokens added per second.
+   * @param burst Capacity of the bucket (default: 1).
+   */
+  explicit TokenBucket(const double rate, const double burst = 1.) : base_t(rate, burst) {}
+
+  /**
+   * @brief Construct a new TokenBucket object with a given clock.
+   *
+   * @param rate Number of tokens added per second.
+   * @param burst Capacity of the bucket.
+   * @param clock Shared pointer to a clock.
+   */
+  TokenBucket(const double rate, const double burst, std::shared_ptr<clock_t> clock)
+      : base_t(rate, burst, std::move(clock))
+  {}
+
+  /**
+   * @brief Take tokens from the bucket if it holds enough of them.
+   * @details Does not block.
+   *
+   * @param n Number of tokens, requests of less than one token are rejected.
+   * @return Returns true if the tokens were taken.
+   */
+  bool try_acquire(const int64_t n = 1) noexcept { return base_t::try_acquire(n); }
+
+  /**
+   * @brief Take tokens from the bucket, blocking until they are available.
+   * @details Requests are served in call order. Used in a loop, acquire(1) paces it to rate after
+   * an initial burst, in the same way as LoopTimer::wait(). Throws std::invalid_argument if n is
+   * not positive.
+   *
+   * @param n Number of tokens.
+   * @return Time spent waiting.
+   */
+  std::chrono::nanoseconds acquire(const int64_t n = 1) { return base_t::acquire(n); }
+
+  /**
+   * @brief Number of tokens currently in the bucket, negative if requests are waiting.
+   */
+  double available() const noexcept { return base_t::available(); }
+
+  /**
+   * @brief Refill the bucket.
+   */
+  void reset() noexcept { base_t::reset(); }
+};
+
+/**
+ * @brief Lock-free leaky bucket rate limiter.
+ * @details Requests fill a bucket of size capacity that leaks at a constant rate. A request is
+ * admitted by try_acquire() if it fits in the bucket. Unlike TokenBucket, acquire() spaces
+ * requests by exactly 1/rate seconds, so that the output never bursts.
+ *
+ * Same implementation as TokenBucket: a single atomic timestamp updated with one compare-exchange.
+ *
+ * Example:
+ * ```
+ * LeakyBucket<> limiter(100.);  // at most one message every 10ms
+ * while (true) {
+ *   limiter.acquire();
+ *   send(msg);
+ * }
+ * ```
+ *
+ * @tparam clock_t Clock type (default: std::chrono::steady_clock).
+ */
+template<typename clock_t = std::chrono::steady_clock>
+class LeakyBucket : protected detail::GcraLimiter<clock_t, true>
+{
+  using base_t = detail::GcraLimiter<clock_t, true>;
+
+public:
+  using typename base_t::time_point_t;
+
+  /**
+   * @brief Construct a new LeakyBucket object.
+   * @details Throws std::invalid_argument if rate is not positive or capacity is less than 1.
+   *
+   * @param rate Number of units leaking per second.
+   * @param capacity Capacity of the bucket (default: 1).
+   */
+  explicit LeakyBucket(const double rate, const double capacity = 1.) : base_t(rate, capacity) {}
+
+  /**
+   * @brief Construct a new LeakyBucket object with a given clock.
+   *
+   * @param rate Number of units leaking per second.
+   * @param capacity Capacity of the bucket.
+   * @param clock Shared pointer to a clock.
+   */
+  LeakyBucket(const double rate, const double capacity, std::shared_ptr<clock_t> clock)
+      : base_t(rate, capacity, std::move(clock))
+  {}
+
+  /**
+   * @brief Add units to the bucket if they fit.
+   * @details Does not block.
+   *
+   * @param n Number of units, requests of less than one unit are rejected.
+   * @return Returns true if the units were added.
+   */
+  bool try_acquire(const int64_t n = 1) noexcept { return base_t::try_acquire(n); }
+
+  /**
+   * @brief Add units to the bucket and block until they have leaked.
+   * @details Requests are served in call order, each one 1/rate seconds after the previous one.
+   * Throws std::invalid_argument if n is not positive.
+   *
+   * @param n Number of units.
+   * @return Time spent waiting.
+   */
+  std::chrono::nanoseconds acquire(const int64_t n = 1) { return base_t::acquire(n); }
+
+  /**
+   * @brief Free space in the bucket, negative if requests are waiting.
+   */
+  double available() const noexcept { return base_t::available(); }
+
+  /**
+   * @brief Empty the bucket.
+   */
+  void reset() noexcept { base_t::reset(); }
+};
+
+}  // namespace cbr
+
+#endif  // CBR_UTILS__RATE_LIMITER_HPP_
@@ -0,0 +1,304 @@
+// Copyright Yamaha 2021
+// MIT License
+// https://github.com/yamaha-bps/cbr_utils/blob/master/LICENSE
+
+/** @file */
+
+#ifndef CBR_UTILS__SERIALIZATION_HPP_
+#define CBR_UTILS__SERIALIZATION_HPP_
+
+#include <boost/hana/concept/struct.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "introspection.hpp"
+#include "type_traits.hpp"
+
+namespace cbr {
+
+/// @cond
+
+namespace detail {
+
+// Types that are serialized as their raw bytes
+template<typename T>
+inline constexpr bool is_raw_serializable_v = std::is_arithmetic_v<T> || std::is_enum_v<T>;
+
+template<typename T>
+struct Serializer
+{
+  static std::size_t size(const T & v)
+  {
+    if constexpr (is_raw_serializable_v<T>) {
+      return sizeof(T);
+    } else if constexpr (is_chrono_duration_v<T>) {  // NOLINT
+      return sizeof(typename T::rep);
+    } else if constexpr (std::is_same_v<T, std::string> || is_vector_like_v<T>) {  // NOLINT
+      using V = typename T::value_type;
+      if constexpr (is_raw_serializable_v<V>) {
+        return sizeof(uint64_t) + v.size() * sizeof(V);
+      } else {
+        std::size_t n = sizeof(uint64_t);
+        for (const auto & x : v) { n += Serializer<V>::size(x); }
+        return n;
+      }
+    } else if constexpr (is_std_array_v<T>) {  // NOLINT
+      std::size_t n = 0;
+      for (const auto & x : v) { n += Serializer<typename T::value_type>::size(x); }
+      return n;
+    } else if constexpr (is_std_optional_v<T>) {  // NOLINT
+      return sizeof(uint8_t) + (v.has_value() ? Serializer<typename T::value_type>::size(*v) : 0);
+    } else if constexpr (is_std_pair_v<T> || is_std_tuple_v<T>) {  // NOLINT
+      return std::apply(
+        [](const auto &... x) {
+          return (std::size_t{0} + ... + Serializer<std::decay_t<decltype(x)>>::size(x));
+        },
+        v);
+    } else if constexpr (boost::hana::Struct<T>::value) {  // NOLINT
+      const auto fields = bind_to_tuple(v);
+      return Serializer<std::decay_t<decltype(fields)>>::size(fields);
+    } else {
+      static_assert(false_v<T>, "Unsupported type for serialization.");
+    }
+  }
+
+  static std::byte * write(const T & v, std::byte * dst)
+  {
+    if constexpr (is_raw_serializable_v<T>) {
+      std::memcpy(dst, &v, sizeof(T));
+      return dst + sizeof(T);
+    } else if constexpr (is_chrono_duration_v<T>) {  // NOLINT
+      return Serializer<typename T::rep>::write(v.count(), dst);
+    } else if constexpr (std::is_same_v<T, std::string> || is_vector_like_v<T>) {  // NOLINT
+      using V = typename T::value_type;
+      dst     = Serializer<uint64_t>::write(static_cast<uint64_t>(v.size()), dst);
+      if constexpr (is_raw_serializable_v<V>) {
+        if (!v.empty()) { std::memcpy(dst, v.data(), v.size() * sizeof(V)); }
+        return dst + v.size() * sizeof(V);
+      } else {
+        for (const auto & x : v) { dst = Serializer<V>::write(x, dst); }
+        return dst;
+      }
+    } else if constexpr (is_std_array_v<T>) {  // NOLINT
+      for (const auto & x : v) { dst = Serializer<typename T::value_type>::write(x, dst); }
+      return dst;
+    } else if constexpr (is_std_optional_v<T>) {  // NOLINT
+      dst = Serializer<uint8_t>::write(static_cast<uint8_t>(v.has_value()), dst);
+      if (v.has_value()) { dst = Serializer<typename T::value_type>::write(*v, dst); }
+      return dst;
+    } else if constexpr (is_std_pair_v<T> || is_std_tuple_v<T>) {  // NOLINT
+      std::apply(
+        [&dst](const auto &... x) {
+          ((dst = Serializer<std::decay_t<decltype(x)>>::write(x, dst)), ...);
+        },
+        v);
+      return dst;
+    } else if constexpr (boost::hana::Struct<T>::value) {  // NOLINT
+      const auto fields = bind_to_tuple(v);
+      return Serializer<std::decay_t<decltype(fields)>>::write(fields, dst);
+    } else {
+      static_assert(false_v<T>, "Unsupported type for serialization.");
+    }
+  }
+
+  static const std::byte * read(const std::byte * src, const std::byte * end, T & v)
+  {
+    if constexpr (is_raw_serializable_v<T>) {
+      check(src, end, sizeof(T));
+      std::memcpy(&v, src, sizeof(T));
+      return src + sizeof(T);
+    } else if constexpr (is_chrono_duration_v<T>) {  // NOLINT
+      typename T::rep r{};
+      src = Serializer<typename T::rep>::read(src, end, r);
+      v   = T(r);
+      return src;
+    } else if constexpr (std::is_same_v<T, std::string> || is_vector_like_v<T>) {  // NOLINT
+      using V    = typename T::value_type;
+      uint64_t n = 0;
+      src        = Serializer<uint64_t>::read(src, end, n);
+      if constexpr (is_static_vector_v<T>) {
+        if (n > T::max_size()) { throw std::out_of_range("Too many elements for static_vector."); }
+      }
+      if constexpr (is_raw_serializable_v<V>) {
+        check(src, end, static_cast<std::size_t>(n) * sizeof(V));
+        v.resize(static_cast<std::size_t>(n));
+        if (n > 0) { std::memcpy(v.data(), src, static_cast<std::size_t>(n) * sizeof(V)); }
+        return src + static_cast<std::size_t>(n) * sizeof(V);
+      } else {
+        v.clear();
+        for (uint64_t i = 0; i < n; ++i) {
+          V x{};
+          src = Serializer<V>::read(src, end, x);
+          v.push_back(std::move(x));
+        }
+        return src;
+      }
+    } else if constexpr (is_std_array_v<T>) {  // NOLINT
+      for (auto & x : v) { src = Serializer<typename T::value_type>::read(src, end, x); }
+      return src;
+    } else if constexpr (is_std_optional_v<T>) {  // NOLINT
+      uint8_t has_value = 0;
+      src               = Serializer<uint8_t>::read(src, end, has_value);
+      if (has_value != 0) {
+        typename T::value_type x{};
+        src = Serializer<typename T::value_type>::read(src, end, x);
+        v   = std::move(x);
+      } else {
+        v.reset();
+      }
+      return src;
+    } else if constexpr (is_std_pair_v<T> || is_std_tuple_v<T>) {  // NOLINT
+      std::apply(
+        [&src, end](auto &... x) {
+          ((src = Serializer<std::decay_t<decltype(x)>>::read(src, end, x)), ...);
+        },
+        v);
+      return src;
+    } else if constexpr (boost::hana::Struct<T>::value) {  // NOLINT
+      auto fields = bind_to_tuple(v);
+      return Serializer<std::decay_t<decltype(fields)>>::read(src, end, fields);
+    } else {
+      static_assert(false_v<T>, "Unsupported type for deserialization.");
+    }
+  }
+
+  static void check(const std::byte * src, const std::byte * end, const std::size_t n)
+  {
+    if (static_cast<std::size_t>(end - src) < n) {
+      throw std::out_of_range("Not enough data to deserialize.");
+    }
+  }
+};
+
+// tuples of references produced by bind_to_tuple
+template<typename... Ts>
+struct Serializer<std::tuple<Ts &...>>
+{
+  static std::size_t size(const std::tuple<Ts &...> & v)
+  {
+    return std::apply(
+      [](const auto &... x) {
+        return (std::size_t{0} + ... + Serializer<std::decay_t<decltype(x)>>::size(x));
+      },
+      v);
+  }
+
+  static std::byte * write(const std::tuple<Ts &...> & v, std::byte * dst)
+  {
+    std::apply(
+      [&dst](const auto &... x) {
+        ((dst = Serializer<std::decay_t<decltype(x)>>::write(x, dst)), ...);
+      },
+      v);
+    return dst;
+  }
+
+  static const std::byte * read(
+    const std::byte * src, const std::byte * end, std::tuple<Ts &...> & v)
+  {
+    std::apply(
+      [&src, end](auto &... x) {
+        ((src = Serializer<std::decay_t<decltype(x)>>::read(src, end, x)), ...);
+      },
+      v);
+    return src;
+  }
+};
+
+}  // namespace detail
+
+/// @endcond
+
+/**
+ * @brief Number of bytes needed to serialize a value.
+ * @details Supported types:
+ * - Arithmetic types and enums (native byte order)
+ * - std::chrono::duration
+ * - std::string, std::vector, cbr::static_vector, cbr::small_vector, std::array, std::optional,
+ *   std::pair and std::tuple of supported types
+ * - boost::hana::Struct whose fields are supported types (recursive)
+ *
+ * @tparam T Type of the value.
+ * @param v Value to serialize.
+ * @return Size in bytes of the serialized value.
+ */
+template<typename T>
+std::size_t serialized_size(const T & v)
+{
+  return detail::Serializer<T>::size(v);
+}
+
+/**
+ * @brief Serialize a value into a buffer.
+ * @details See serialized_size() for the supported types.
+ *
+ * @tparam T Type of the value.
+ * @param v Value to serialize.
+ * @param dst Buffer of at least serialized_size(v) bytes.
+ * @return Pointer past the last written byte.
+ */
+template<typename T>
+std::byte * serialize(const T & v, std::byte * dst)
+{
+  return detail::Serializer<T>::write(v, dst);
+}
+
+/**
+ * @brief Serialize a value into a new byte vector.
+ *
+ * @tparam T Type of the value.
+ * @param v Value to serialize.
+ * @return Serialized value.
+ */
+template<typename T>
+std::vector<std::byte> serialize(const T & v)
+{
+  std::vector<std::byte> out(serialized_size(v));
+  serialize(v, out.data());
+  return out;
+}
+
+/**
+ * @brief Deserialize a value from a buffer.
+ * @details Throws std::out_of_range if the buffer is too short.
+ *
+ * @tparam T Type of the value.
+ * @param src Start of the buffer.
+ * @param end End of the buffer.
+ * @param v Value to deserialize into.
+ * @return Pointer past the last read byte.
+ */
+template<typename T>
+const std::byte * deserialize(const std::byte * src, const std::byte * end, T & v)
+{
+  return detail::Serializer<T>::read(src, end, v);
+}
+
+/**
+ * @brief Deserialize a value from a buffer.
+ * @details Throws std::out_of_range if the buffer is too short.
+ *
+ * @tparam T Type of the value, must be default constructible.
+ * @param src Start of the buffer.
+ * @param size Size of the buffer.
+ * @return Deserialized value.
+ */
+template<typename T>
+T deserialize(const std::byte * src, const std::size_t size)
+{
+  T v{};
+  deserialize(src, src + size, v);
+  return v;
+}
+
+}  // namespace cbr
+
+#endif  // CBR_UTILS__SERIALIZATION_HPP_
@@ -0,0 +1,589 @@
+// Copyright Yamaha 2021
+// MIT License
+// https://github.com/yamaha-bps/cbr_utils/blob/master/LICENSE
+
+/** @file */
+
+#ifndef CBR_UTILS__SHM_TRANSPORT_HPP_
+#define CBR_UTILS__SHM_TRANSPORT_HPP_
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+namespace cbr {
+
+/// @cond
+
+namespace detail {
+
+inline constexpr uint64_t shm_magic         = 0x43425253484d3031;  // "CBRSHM01"
+inline constexpr std::size_t shm_cache_line = 64;
+
+constexpr std::size_t shm_round_up(const std::size_t n, const std::size_t align)
+{
+  return (n + align - 1) / align * align;
+}
+
+static_assert(
+  std::atomic<uint64_t>::is_always_lock_free, "Process shared rings require lock-free atomics.");
+
+// Indices of a single producer single consumer ring, on separate cache lines
+struct ShmRingIndices
+{
+  alignas(shm_cache_line) std::atomic<uint64_t> head{0};  // next element to read
+  alignas(shm_cache_line) std::atomic<uint64_t> tail{0};  // next element to write
+};
+
+// Descriptor of a published slot
+struct ShmSlotDesc
+{
+  uint64_t slot;
+  uint64_t size;
+  int64_t stamp;
+};
+
+// Memory layout: header | full ring | free ring | slab
+struct ShmHeader
+{
+  std::atomic<uint64_t> magic{0};
+  uint64_t slot_count;
+  uint64_t slot_size;
+  ShmRingIndices full;  // producer -> consumer, published slots
+  ShmRingIndices free;  // consumer -> producer, released slots
+};
+
+struct ShmLayout
+{
+  std::size_t full_offset;
+  std::size_t free_offset;
+  std::size_t slab_offset;
+  std::size_t total;
+
+  ShmLayout(const std::size_t slot_count, const std::size_t slot_size)
+  {
+    full_offset = shm_round_up(sizeof(ShmHeader), shm_cache_line);
+    free_offset = shm_round_up(full_offset + slot_count * sizeof(ShmSlotDesc), shm_cache_line);
+    slab_offset = shm_round_up(free_offset + slot_count * sizeof(uint64_t), shm_cache_line);
+    total       = slab_offset + slot_count * shm_round_up(slot_size, shm_cache_line);
+  }
+};
+
+struct ShmReleaser;
+
+[[noreturn]] inline void shm_throw(const std::string & what)
+{
+  throw std::system_error(errno, std::generic_category(), what);
+}
+
+}  // namespace detail
+
+/// @endcond
+
+/**
+ * @brief POSIX shared memory channel between two processes.
+ * @details The channel holds a slab of fixed size slots, and two lock-free single producer single
+ * consumer rings: one to pass published slots from the producer to the consumer, and one to give
+ * released slots back to the producer. Payloads are written once into the slab by the producer and
+ * read in place by the consumer, they are never copied.
+ *
+ * One process creates the channel, the other one opens it. Use ShmProducer and ShmConsumer to
+ * access it.
+ *
+ * Example:
+ * ```
+ * // Driver process
+ * auto channel = ShmChannel::create("/camera", 8, 1 << 20);
+ * ShmProducer producer(channel);
+ * if (void * buf = producer.try_reserve()) {
+ *   const auto size = grab_frame(buf, producer.slot_size());
+ *   producer.commit(size, stamp);
+ * }
+ *
+ * // Consumer process
+ * ShmConsumer consumer(ShmChannel::open("/camera"));
+ * Synchronizer<ShmMessage, Lidar> sync;
+ * sync.set_time_fcn<0>([](const ShmMessage & m) { return m.stamp(); });
+ * consumer.drain<0>(sync);
+ * ```
+ */
+class ShmChannel
+{
+public:
+  ShmChannel(const ShmChannel &) = delete;
+  ShmChannel(ShmChannel &&)      = delete;
+  ShmChannel & operator=(const ShmChannel &) = delete;
+  ShmChannel & operator=(ShmChannel &&) = delete;
+
+  ~ShmChannel()
+  {
+    if (m_base != nullptr) { munmap(m_base, m_size); }
+    if (m_owner) { shm_unlink(m_name.c_str()); }
+  }
+
+  /**
+   * @brief Create a new shared memory channel.
+   * @details Fails if a shared memory object with the same name already exists. The shared memory
+   * object is unlinked when the returned channel is destroyed.
+   *
+   * @param name Name of the shared memory object (e.g. "/camera").
+   * @param slot_count Number of payload slots.
+   * @param slot_size Maximal size in bytes of a payload.
+   * @return Shared pointer to the channel.
+   */
+  static std::shared_ptr<ShmChannel> create(
+    const std::string & name, const std::size_t slot_count, const std::size_t slot_size)
+  {
+    if (slot_count == 0 || slot_size == 0) {
+      throw std::invalid_argument("ShmChannel slot count and size must be positive.");
+    }
+
+    const detail::ShmLayout layout(slot_count, slot_size);
+
+    const int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) { detail::shm_throw("shm_open failed for " + name); }
+
+    std::shared_ptr<ShmChannel> channel(new ShmChannel(name, true));
+    if (ftruncate(fd, static_cast<off_t>(layout.total)) != 0) {
+      close(fd);
+      detail::shm_throw("ftruncate failed for " + name);
+    }
+    channel->map(fd, layout.total);
+
+    auto * header       = new (channel->m_base) detail::ShmHeader;
+    header->slot_count  = slot_count;
+    header->slot_size   = slot_size;
+    auto * free_entries = reinterpret_cast<uint64_t *>(channel->m_base + layout.free_offset);
+    for (std::size_t i = 0; i < slot_count; ++i) { free_entries[i] = i; }
+    header->free.tail.store(slot_count, std::memory_order_relaxed);
+    header->magic.store(detail::shm_magic, std::memory_order_release);
+
+    channel->init_views();
+    return channel;
+  }
+
+  /**
+   * @brief Open an existing shared memory channel.
+   *
+   * @param name Name of the shared memory object.
+   * @return Shared pointer to the channel.
+   */
+  static std::shared_ptr<ShmChannel> open(const std::string & name)
+  {
+    const int fd = shm_open(name.c_str(), O_RDWR, 0600);
+    if (fd < 0) { detail::shm_throw("shm_open failed for " + name); }
+
+    struct stat st
+    {};
+    if (fstat(fd, &st) != 0) {
+      close(fd);
+      detail::shm_throw("fstat failed for " + name);
+    }
+
+    std::shared_ptr<ShmChannel> channel(new ShmChannel(name, false));
+    channel->map(fd, static_cast<std::size_t>(st.st_size));
+
+    if (
+      channel->m_size < sizeof(detail::ShmHeader)
+      || channel->header()->magic.load(std::memory_order_acquire) != detail::shm_magic) {
+      throw std::runtime_error("ShmChannel " + name + " is not initialized.");
+    }
+    const auto * header = channel->header();
+    if (detail::ShmLayout(header->slot_count, header->slot_size).total > channel->m_size) {
+      throw std::runtime_error("ShmChannel " + name + " has an invalid size.");
+    }
+
+    channel->init_views();
+    return channel;
+  }
+
+  /**
+   * @brief Number of payload slots.
+   */
+  std::size_t slot_count() const noexcept { return header()->slot_count; }
+
+  /**
+   * @brief Maximal size in bytes of a payload.
+   */
+  std::size_t slot_size() const noexcept { return header()->slot_size; }
+
+  /**
+   * @brief Name of the shared memory object.
+   */
+  const std::string & name() const noexcept { return m_name; }
+
+protected:
+  /// @cond
+  friend class ShmProducer;
+  friend class ShmConsumer;
+  friend struct detail::ShmReleaser;
+
+  ShmChannel(std::string name, const bool owner) : m_name(std::move(name)), m_owner(owner) {}
+
+  void map(const int fd, const std::size_t size)
+  {
+    void * base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) { detail::shm_throw("mmap failed for " + m_name); }
+    m_base = static_cast<std::byte *>(base);
+    m_size = size;
+  }
+
+  void init_views() noexcept
+  {
+    const detail::ShmLayout layout(header()->slot_count, header()->slot_size);
+    m_full   = reinterpret_cast<detail::ShmSlotDesc *>(m_base + layout.full_offset);
+    m_free   = reinterpret_cast<uint64_t *>(m_base + layout.free_offset);
+    m_slab   = m_base + layout.slab_offset;
+    m_stride = detail::shm_round_up(header()->slot_size, detail::shm_cache_line);
+  }
+
+  detail::ShmHeader * header() const noexcept
+  {
+    return std::launder(reinterpret_cast<detail::ShmHeader *>(m_base));
+  }
+
+  std::byte * slot(const uint64_t i) const noexcept
+  {
+    return m_slab + static_cast<std::size_t>(i) * m_stride;
+  }
+
+  std::string m_name;
+  bool m_owner;
+  std::byte * m_base = nullptr;
+  std::size_t m_size = 0;
+
+  detail::ShmSlotDesc * m_full = nullptr;
+  uint64_t * m_free            = nullptr;
+  std::byte * m_slab           = nullptr;
+  std::size_t m_stride         = 0;
+  /// @endcond
+};
+
+/**
+ * @brief Writing end of a ShmChannel.
+ * @details Payloads are written in place: try_reserve() returns a pointer into a free slot of the
+ * shared slab, and commit() publishes it to the consumer. Only one thread of one process may
+ * write to a given channel.
+ */
+class ShmProducer
+{
+public:
+  /**
+   * @brief Construct a new ShmProducer.
+   *
+   * @param channel Channel to write to.
+   */
+  explicit ShmProducer(std::shared_ptr<ShmChannel> channel) : m_channel(std::move(channel))
+  {
+    m_cached_free_tail = m_channel->header()->free.tail.load(std::memory_order_acquire);
+  }
+
+  /**
+   * @brief Reserve a slot to write a payload in.
+   * @details Calling it again before commit() returns the same slot. Throws if the consumer gave
+   * back an invalid slot.
+   *
+   * @return Pointer to slot_size() writable bytes, or nullptr if all slots are in use.
+   */
+  void * try_reserve()
+  {
+    if (m_reserved) { return m_channel->slot(*m_reserved); }
+
+    auto & ring       = m_channel->header()->free;
+    const auto n      = m_channel->slot_count();
+    const uint64_t hd = ring.head.load(std::memory_order_relaxed);
+    if (hd == m_cached_free_tail) {
+      m_cached_free_tail = ring.tail.load(std::memory_order_acquire);
+      if (hd == m_cached_free_tail) { return nullptr; }
+    }
+    const uint64_t slot = m_channel->m_free[hd % n];
+    if (slot >= n) {
+      throw std::runtime_error("ShmChannel " + m_channel->name() + " is corrupted.");
+    }
+    m_reserved = slot;
+    ring.head.store(hd + 1, std::memory_order_release);
+    return m_channel->slot(slot);
+  }
+
+  /**
+   * @brief Publish the reserved slot to the consumer.
+   * @details Never fails since there can not be more published slots than slots.
+   * Throws if no slot is reserved or size is larger than slot_size().
+   *
+   * @param size Size in bytes of the payload.
+   * @param stamp Timestamp of the payload.
+   */
+  void commit(const std::size_t size, const int64_t stamp)
+  {
+    if (!m_reserved) { throw std::logic_error("ShmProducer::commit called without reservation."); }
+    if (size > m_channel->slot_size()) {
+      throw std::length_error("ShmProducer::commit payload larger than slot.");
+    }
+
+    auto & ring       = m_channel->header()->full;
+    const uint64_t tl = ring.tail.load(std::memory_order_relaxed);
+    m_channel->m_full[tl % m_channel->slot_count()] = {*m_reserved, size, stamp};
+    ring.tail.store(tl + 1, std::memory_order_release);
+    m_reserved.reset();
+  }
+
+  /**
+   * @brief Copy a payload into the channel.
+   *
+   * @param data Pointer to the payload.
+   * @param size Size in bytes of the payload.
+   * @param stamp Timestamp of the payload.
+   * @return True if the payload was published, false if all slots are in use.
+   */
+  bool try_send(const void * data, const std::size_t size, const int64_t stamp)
+  {
+    void * buf = try_reserve();
+    if (buf == nullptr) { return false; }
+    std::memcpy(buf, data, size);
+    commit(size, stamp);
+    return true;
+  }
+
+  /**
+   * @brief Maximal size in bytes of a payload.
+   */
+  std::size_t slot_size() const noexcept { return m_channel->slot_size(); }
+
+protected:
+  /// @cond
+  std::shared_ptr<ShmChannel> m_channel;
+  uint64_t m_cached_free_tail = 0;
+  std::optional<uint64_t> m_reserved{};
+  /// @endcond
+};
+
+/// @cond
+namespace detail {
+
+// Gives released slots back to the producer without locking, from any number of threads.
+// A release claims a position of the free ring, writes the slot and marks the position ready.
+// The tail seen by the producer is then advanced over the ready positions in order, by whichever
+// releasing thread finds the next one ready. Operations on m_ready and on the tail are
+// sequentially consistent, so that a position marked ready is always published by someone.
+struct ShmReleaser
+{
+  explicit ShmReleaser(std::shared_ptr<ShmChannel> channel)
+      : m_channel(std::move(channel)),
+        m_ready(std::make_unique<std::atomic<uint64_t>[]>(m_channel->slot_count())),
+        m_next(m_channel->header()->free.tail.load())
+  {}
+
+  void release(const uint64_t slot) noexcept
+  {
+    auto & ring       = m_channel->header()->free;
+    const auto n      = m_channel->slot_count();
+    const uint64_t ps = m_next.fetch_add(1, std::memory_order_relaxed);
+    // there are at most n slots, so that position ps was consumed by the producer
+    m_channel->m_free[ps % n] = slot;
+    m_ready[ps % n].store(ps + 1);
+
+    uint64_t tl = ring.tail.load();
+    while (m_ready[tl % n].load() == tl + 1) {
+      if (ring.tail.compare_exchange_weak(tl, tl + 1)) { ++tl; }
+    }
+  }
+
+  std::shared_ptr<ShmChannel> m_channel;
+  // position + 1 of the last release written at each index
+  std::unique_ptr<std::atomic<uint64_t>[]> m_ready;
+  std::atomic<uint64_t> m_next;
+};
+
+}  // namespace detail
+/// @endcond
+
+/**
+ * @brief Payload received from a ShmChannel.
+ * @details Move only view into the shared slab, the slot is given back to the producer when the
+ * message is destroyed. Messages can be destroyed from any thread of the consumer process, and
+ * keep the channel mapped while they are alive. Giving back a slot does not lock.
+ */
+class ShmMessage
+{
+public:
+  ShmMessage()                   = default;
+  ShmMessage(const ShmMessage &) = delete;
+  ShmMessage & operator=(const ShmMessage &) = delete;
+
+  ShmMessage(ShmMessage && o) noexcept
+      : m_releaser(std::move(o.m_releaser)), m_slot(o.m_slot), m_data(o.m_data), m_size(o.m_size),
+        m_stamp(o.m_stamp)
+  {}
+
+  ShmMessage & operator=(ShmMessage && o) noexcept
+  {
+    if (this != &o) {
+      release();
+      m_releaser = std::move(o.m_releaser);
+      m_slot     = o.m_slot;
+      m_data     = o.m_data;
+      m_size     = o.m_size;
+      m_stamp    = o.m_stamp;
+    }
+    return *this;
+  }
+
+  ~ShmMessage() { release(); }
+
+  /**
+   * @brief Pointer to the payload.
+   */
+  const std::byte * data() const noexcept { return m_data; }
+
+  /**
+   * @brief Size in bytes of the payload.
+   */
+  std::size_t size() const noexcept { return m_size; }
+
+  /**
+   * @brief Timestamp of the payload.
+   */
+  int64_t stamp() const noexcept { return m_stamp; }
+
+  /**
+   * @brief Access payload as a trivially copyable type written by the producer.
+   *
+   * @tparam U Type of the payload.
+   * @return Reference to the payload.
+   */
+  template<typename U>
+  const U & as() const
+  {
+    static_assert(std::is_trivially_copyable_v<U>, "Payload type must be trivially copyable.");
+    if (sizeof(U) > m_size) { throw std::length_error("ShmMessage payload too small for type."); }
+    return *std::launder(reinterpret_cast<const U *>(m_data));
+  }
+
+  /**
+   * @brief Check if message holds a payload.
+   */
+  explicit operator bool() const noexcept { return m_releaser != nullptr; }
+
+protected:
+  /// @cond
+  friend class ShmConsumer;
+
+  ShmMessage(std::shared_ptr<detail::ShmReleaser> releaser,
+    const uint64_t slot,
+    const std::byte * data,
+    const std::size_t size,
+    const int64_t stamp)
+      : m_releaser(std::move(releaser)), m_slot(slot), m_data(data), m_size(size), m_stamp(stamp)
+  {}
+
+  void release() noexcept
+  {
+    if (m_releaser) {
+      m_releaser->release(m_slot);
+      m_releaser.reset();
+    }
+  }
+
+  std::shared_ptr<detail::ShmReleaser> m_releaser{};
+  uint64_t m_slot          = 0;
+  const std::byte * m_data = nullptr;
+  std::size_t m_size       = 0;
+  int64_t m_stamp          = 0;
+  /// @endcond
+};
+
+/**
+ * @brief Reading end of a ShmChannel.
+ * @details Only one thread of one process may read from a given channel. Received messages can
+ * however be handed over to, and destroyed by, other threads.
+ */
+class ShmConsumer
+{
+public:
+  /**
+   * @brief Construct a new ShmConsumer.
+   *
+   * @param channel Channel to read from.
+   */
+  explicit ShmConsumer(std::shared_ptr<ShmChannel> channel)
+      : m_releaser(std::make_shared<detail::ShmReleaser>(std::move(channel)))
+  {}
+
+  /**
+   * @brief Receive the oldest published payload.
+   *
+   * @return Message if one was published, std::nullopt otherwise.
+   */
+  std::optional<ShmMessage> try_receive()
+  {
+    auto & channel    = *m_releaser->m_channel;
+    auto & ring       = channel.header()->full;
+    const uint64_t hd = ring.head.load(std::memory_order_relaxed);
+    if (hd == m_cached_full_tail) {
+      m_cached_full_tail = ring.tail.load(std::memory_order_acquire);
+      if (hd == m_cached_full_tail) { return std::nullopt; }
+    }
+    const auto desc = channel.m_full[hd % channel.slot_count()];
+    if (desc.slot >= channel.slot_count()) {
+      throw std::runtime_error("ShmChannel " + channel.name() + " is corrupted.");
+    }
+    ring.head.store(hd + 1, std::memory_order_release);
+
+    if (desc.size > channel.slot_size()) {
+      // give the slot back so that the producer does not lose it
+      m_releaser->release(desc.slot);
+      throw std::runtime_error("ShmChannel " + channel.name() + " is corrupted.");
+    }
+
+    return ShmMessage(m_releaser,
+      desc.slot,
+      channel.slot(desc.slot),
+      static_cast<std::size_t>(desc.size),
+      desc.stamp);
+  }
+
+  /**
+   * @brief Feed all published payloads to a synchronizer.
+   * @details Calls sync.add_and_search<k>() on every received message.
+   *
+   * @tparam k Index of the synchronizer queue to insert in.
+   * @param sync Synchronizer with ShmMessage as k-th message type.
+   * @return Number of messages fed to the synchronizer.
+   */
+  template<std::size_t k, typename Sync>
+  std::size_t drain(Sync & sync)
+  {
+    std::size_t n = 0;
+    while (auto msg = try_receive()) {
+      sync.template add_and_search<k>(std::move(*msg));
+      ++n;
+    }
+    return n;
+  }
+
+protected:
+  /// @cond
+  std::shared_ptr<detail::ShmReleaser> m_releaser;
+  uint64_t m_cached_full_tail = 0;
+  /// @endcond
+};
+
+}  // namespace cbr
+
+#endif  // CBR_UTILS__SHM_TRANSPORT_HPP_
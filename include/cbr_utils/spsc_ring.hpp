@@ -0,0 +1,339 @@
+// Copyright Yamaha 2021
+// MIT License
+// https://github.com/yamaha-bps/cbr_utils/blob/master/LICENSE
+
+/** @file */
+
+#ifndef CBR_UTILS__SPSC_RING_HPP_
+#define CBR_UTILS__SPSC_RING_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace cbr {
+
+/**
+ * @brief Bounded wait-free single producer single consumer ring buffer.
+ * @details One thread pushes and one thread pops, without locks: every operation completes in a
+ * bounded number of steps. Each side caches the index of the other side and only reloads it when
+ * the ring looks full (producer) or empty (consumer), so that in steady state the two threads do
+ * not touch each other's cache lines.
+ *
+ * Example:
+ * ```
+ * SpscRing<Image> ring(64);
+ *
+ * // sensor thread
+ * if (!ring.try_emplace(width, height)) { ++dropped; }
+ *
+ * // pipeline thread
+ * while (auto img = ring.try_pop()) { sync.add<0>(std::move(*img)); }
+ *
+ * // or without moving the elements
+ * const auto spans = ring.read_spans();
+ * for (std::size_t i = 0; i < spans.first_size; ++i) { process(spans.first[i]); }
+ * for (std::size_t i = 0; i < spans.second_size; ++i) { process(spans.second[i]); }
+ * ring.consume(spans.size());
+ * ```
+ * Notes:
+ * - Producer functions: try_push(), try_emplace(), write_available().
+ * - Consumer functions: try_pop(), front(), pop(), read_spans(), consume(), read_available().
+ * - size() and empty() can be called by any thread but are only a snapshot.
+ *
+ * @tparam T Element type.
+ */
+template<typename T>
+class SpscRing
+{
+public:
+  /**
+   * @brief Contiguous ranges of readable elements.
+   * @details Elements wrap around the end of the buffer, hence two ranges.
+   */
+  struct ReadSpans
+  {
+    T * first               = nullptr;
+    std::size_t first_size  = 0;
+    T * second              = nullptr;
+    std::size_t second_size = 0;
+
+    /// Total number of elements
+    std::size_t size() const noexcept { return first_size + second_size; }
+  };
+
+  SpscRing(const SpscRing &) = delete;
+  SpscRing(SpscRing &&)      = delete;
+  SpscRing & operator=(const SpscRing &) = delete;
+  SpscRing & operator=(SpscRing &&) = delete;
+
+  /**
+   * @brief Construct a new SpscRing object.
+   * @details Throws std::invalid_argument if capacity is 0.
+   *
+   * @param capacity Minimal number of elements, rounded up to a power of two.
+   */
+  explicit SpscRing(const std::size_t capacity)
+  {
+    if (capacity == 0) { throw std::invalid_argument("SpscRing capacity must be positive."); }
+    std::size_t n = 1;
+    while (n < capacity) { n <<= 1; }
+    m_storage = std::make_unique<storage_t[]>(n);
+    m_mask    = n - 1;
+  }
+
+  ~SpscRing()
+  {
+    if constexpr (!std::is_trivially_destructible_v<T>) { consume(read_available()); }
+  }
+
+  /**
+   * @brief Construct an element in place at the back of the ring.
+   * @details Producer only.
+   *
+   * @param args Arguments forwarded to the constructor of T.
+   * @return Returns false if the ring is full.
+   */
+  template<typename... Args>
+  bool try_emplace(Args &&... args) noexcept(std::is_nothrow_constructible_v<T, Args...>)
+  {
+    const std::size_t head = m_head.load(std::memory_order_relaxed);
+    if (head - m_tail_cache > m_mask) {
+      m_tail_cache = m_tail.load(std::memory_order_acquire);
+      if (head - m_tail_cache > m_mask) { return false; }
+    }
+    ::new (slot(head)) T(std::forward<Args>(args)...);
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Copy an element at the back of the ring.
+   * @details Producer only.
+   *
+   * @return Returns false if the ring is full.
+   */
+  bool try_push(const T & v) noexcept(std::is_nothrow_copy_constructible_v<T>)
+  {
+    return try_emplace(v);
+  }
+
+  /**
+   * @brief Move an element at the back of the ring.
+   * @details Producer only.
+   *
+   * @return Returns false if the ring is full.
+   */
+  bool try_push(T && v) noexcept(std::is_nothrow_move_constructible_v<T>)
+  {
+    return try_emplace(std::move(v));
+  }
+
+  /**
+   * @brief Copy a range of elements at the back of the ring.
+   * @details Producer only. Copies as many elements as fit and publishes them at once.
+   *
+   * @param first Iterator to the first element.
+   * @param last Iterator past the last element.
+   * @return Number of elements pushed.
+   */
+  template<typename It>
+  std::size_t try_push(It first, const It last)
+  {
+    const std::size_t head = m_head.load(std::memory_order_relaxed);
+    std::size_t n          = 0;
+    for (; first != last; ++first, ++n) {
+      if (head + n - m_tail_cache > m_mask) {
+        m_tail_cache = m_tail.load(std::memory_order_acquire);
+        if (head + n - m_tail_cache > m_mask) { break; }
+      }
+      ::new (slot(head + n)) T(*first);
+    }
+    if (n > 0) { m_head.store(head + n, std::memory_order_release); }
+    return n;
+  }
+
+  /**
+   * @brief Pop the front element.
+   * @details Consumer only.
+   *
+   * @return Front element, or std::nullopt if the ring is empty.
+   */
+  std::optional<T> try_pop() noexcept(std::is_nothrow_move_constructible_v<T>)
+  {
+    T * p = front();
+    if (p == nullptr) { return std::nullopt; }
+    std::optional<T> res(std::move(*p));
+    pop();
+    return res;
+  }
+
+  /**
+   * @brief Pop the front element.
+   * @details Consumer only.
+   *
+   * @param v Assigned the front element.
+   * @return Returns false if the ring is empty.
+   */
+  bool try_pop(T & v) noexcept(std::is_nothrow_move_assignable_v<T>)
+  {
+    T * p = front();
+    if (p == nullptr) { return false; }
+    v = std::move(*p);
+    pop();
+    return true;
+  }
+
+  /**
+   * @brief Pop up to max_n front elements.
+   * @details Consumer only. Frees the space of all popped elements at once.
+   *
+   * @param out Output iterator to which the elements are moved.
+   * @param max_n Maximal number of elements.
+   * @return Number of elements popped.
+   */
+  template<typename OutIt>
+  std::size_t try_pop(OutIt out, const std::size_t max_n)
+  {
+    const auto spans    = read_spans();
+    const std::size_t n = std::min(max_n, spans.size());
+    const std::size_t n1 = std::min(n, spans.first_size);
+    out = std::move(spans.first, spans.first + n1, out);
+    std::move(spans.second, spans.second + (n - n1), out);
+    consume(n);
+    return n;
+  }
+
+  /**
+   * @brief Access the front element without popping it.
+   * @details Consumer only.
+   *
+   * @return Pointer to the front element, or nullptr if the ring is empty.
+   */
+  T * front() noexcept
+  {
+    const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+    if (tail == m_head_cache) {
+      m_head_cache = m_head.load(std::memory_order_acquire);
+      if (tail == m_head_cache) { return nullptr; }
+    }
+    return element(tail);
+  }
+
+  /**
+   * @brief Remove the front element.
+   * @details Consumer only, the ring must not be empty.
+   */
+  void pop() noexcept { consume(1); }
+
+  /**
+   * @brief Access all readable elements without popping them.
+   * @details Consumer only. The elements stay valid until they are consumed.
+   *
+   * @return Contiguous ranges of readable elements, in order.
+   */
+  ReadSpans read_spans() noexcept
+  {
+    const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+    m_head_cache           = m_head.load(std::memory_order_acquire);
+    const std::size_t n    = m_head_cache - tail;
+    const std::size_t off  = tail & m_mask;
+
+    ReadSpans res;
+    res.first      = element(tail);
+    res.first_size = std::min(n, m_mask + 1 - off);
+    if (res.first_size < n) {
+      res.second      = element(0);
+      res.second_size = n - res.first_size;
+    }
+    return res;
+  }
+
+  /**
+   * @brief Remove n front elements.
+   * @details Consumer only, at least n elements must be readable.
+   */
+  void consume(const std::size_t n) noexcept
+  {
+    const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+    if constexpr (!std::is_trivially_destructible_v<T>) {
+      for (std::size_t i = 0; i < n; ++i) { element(tail + i)->~T(); }
+    }
+    m_tail.store(tail + n, std::memory_order_release);
+  }
+
+  /**
+   * @brief Number of elements that can be popped.
+   * @details Consumer only.
+   */
+  std::size_t read_available() const noexcept
+  {
+    return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Number of elements that can be pushed.
+   * @details Producer only.
+   */
+  std::size_t write_available() const noexcept
+  {
+    return capacity() - (m_head.load(std::memory_order_relaxed)
+                          - m_tail.load(std::memory_order_acquire));
+  }
+
+  /**
+   * @brief Number of elements in the ring.
+   */
+  std::size_t size() const noexcept
+  {
+    const std::size_t tail = m_tail.load(std::memory_order_acquire);
+    return m_head.load(std::memory_order_acquire) - tail;
+  }
+
+  /**
+   * @brief Check if the ring is empty.
+   */
+  bool empty() const noexcept { return size() == 0; }
+
+  /**
+   * @brief Maximal number of elements.
+   */
+  std::size_t capacity() const noexcept { return m_mask + 1; }
+
+protected:
+  /// @cond
+  struct storage_t
+  {
+    alignas(T) std::byte data[sizeof(T)];
+  };
+
+  void * slot(const std::size_t i) const noexcept { return m_storage[i & m_mask].data; }
+
+  T * element(const std::size_t i) const noexcept
+  {
+    return std::launder(reinterpret_cast<T *>(slot(i)));
+  }
+
+  // producer side
+  alignas(64) std::atomic<std::size_t> m_head{0};
+  std::size_t m_tail_cache = 0;
+
+  // consumer side
+  alignas(64) std::atomic<std::size_t> m_tail{0};
+  std::size_t m_head_cache = 0;
+
+  // shared, read only
+  alignas(64) std::unique_ptr<storage_t[]> m_storage;
+  std::size_t m_mask = 0;
+  /// @endcond
+};
+
+}  // namespace cbr
+
+#endif  // CBR_UTILS__SPSC_RING_HPP_
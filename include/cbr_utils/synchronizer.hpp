@@ -8,31 +8,320 @@
 #define CBR_UTILS__SYNCHRONIZER_HPP_
 
 #include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
 #include <deque>
+#include <exception>
 #include <functional>
 #include <limits>
+#include <map>
+#include <memory>
 #include <mutex>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
 #include <utility>
 
+#include "clock_traits.hpp"
+#include "function.hpp"
+#include "thread_pool.hpp"
+
 namespace cbr {
 
 /// @cond
 
+namespace detail {
+
+// Runs work items on a thread pool and calls their completions one at a time in submission order.
+// Does not own the pool so that the pool is never destroyed from one of its own workers.
+// The first exception thrown by a work item or a completion is kept and rethrown by wait().
+class OrderedDispatcher
+{
+public:
+  using completion_t = inplace_function<void(), 32>;
+
+  explicit OrderedDispatcher(ThreadPool & pool) : m_pool(&pool) {}
+
+  // work is run on the pool and must return a completion of signature void()
+  template<typename W>
+  static void dispatch(const std::shared_ptr<OrderedDispatcher> & self, W && work)
+  {
+    std::size_t seq;
+    {
+      std::scoped_lock lock(self->m_mtx);
+      seq = self->m_next_in++;
+    }
+    try {
+      self->m_pool->enqueue([self, seq, work = std::forward<W>(work)]() mutable {
+        const Running running(self.get());
+        completion_t done;
+        try {
+          done = work();
+        } catch (...) {
+          self->set_error(std::current_exception());
+        }
+        self->complete(seq, std::move(done));
+      });
+    } catch (...) {
+      std::scoped_lock lock(self->m_mtx);
+      --self->m_next_in;
+      throw;
+    }
+  }
+
+  // block until every dispatched item has completed, and rethrow the first exception if any
+  void wait()
+  {
+    if (running() == this) {
+      throw std::logic_error("wait_dispatched() called from a parallel callback.");
+    }
+    std::unique_lock lock(m_mtx);
+    m_cv.wait(lock, [this] { return m_next_out == m_next_in; });
+    if (m_error) { std::rethrow_exception(std::exchange(m_error, nullptr)); }
+  }
+
+  std::size_t in_flight() const
+  {
+    std::scoped_lock lock(m_mtx);
+    return m_next_in - m_next_out;
+  }
+
+protected:
+  // marks the dispatcher whose work or completion is running on the current thread
+  static const OrderedDispatcher *& running() noexcept
+  {
+    static thread_local const OrderedDispatcher * current = nullptr;
+    return current;
+  }
+
+  struct Running
+  {
+    explicit Running(const OrderedDispatcher * d) noexcept : prev(std::exchange(running(), d)) {}
+    Running(const Running &) = delete;
+    Running & operator=(const Running &) = delete;
+    ~Running() { running() = prev; }
+
+    const OrderedDispatcher * prev;
+  };
+
+  void set_error(std::exception_ptr e)
+  {
+    std::scoped_lock lock(m_mtx);
+    if (!m_error) { m_error = std::move(e); }
+  }
+
+  void complete(const std::size_t seq, completion_t && done)
+  {
+    std::unique_lock lock(m_mtx);
+    m_reorder.emplace(seq, std::move(done));
+
+    // only one thread drains the reorder buffer at a time, the others just leave their result
+    if (m_draining) { return; }
+    m_draining = true;
+    while (!m_reorder.empty() && m_reorder.begin()->first == m_next_out) {
+      auto f = std::move(m_reorder.begin()->second);
+      m_reorder.erase(m_reorder.begin());
+      lock.unlock();
+      if (f) {
+        try {
+          f();
+        } catch (...) {
+          set_error(std::current_exception());
+        }
+      }
+      lock.lock();
+      ++m_next_out;
+    }
+    m_draining = false;
+    lock.unlock();
+    m_cv.notify_all();
+  }
+
+  ThreadPool * m_pool;
+  mutable std::mutex m_mtx;
+  std::condition_variable m_cv;
+  std::map<std::size_t, completion_t> m_reorder;
+  std::size_t m_next_in  = 0;
+  std::size_t m_next_out = 0;
+  bool m_draining        = false;
+  std::exception_ptr m_error{};
+};
+
+}  // namespace detail
+
+/// @endcond
+
+/// @cond
+
+namespace detail {
+
+// Timestamp types supported by the synchronizer: arithmetic types and chrono time points
+template<typename S, typename = void>
+struct SyncStampTraits
+{
+  static_assert(std::is_arithmetic_v<S>, "Synchronizer stamps must be arithmetic or time points.");
+
+  using duration = S;
+  using rep      = S;
+
+  static constexpr S lowest() noexcept { return std::numeric_limits<S>::lowest(); }
+
+  static constexpr S count(const S s) noexcept { return s; }
+
+  static constexpr S from_count(const rep r) noexcept { return r; }
+};
+
+template<typename S>
+struct SyncStampTraits<S, std::void_t<typename S::clock, typename S::duration>>
+{
+  using duration = typename S::duration;
+  using rep      = typename S::rep;
+
+  static constexpr S lowest() noexcept { return S::min(); }
+
+  static constexpr rep count(const S s) noexcept { return s.time_since_epoch().count(); }
+
+  static constexpr S from_count(const rep r) noexcept { return S(duration(r)); }
+};
+
+}  // namespace detail
+
+/// @endcond
+
+/**
+ * @brief Default synchronizer policy.
+ * @details A policy defines:
+ * - queue_t<U>: Container used to store the messages of type U in each stream. Must provide the
+ *   empty(), size(), front(), back(), at(), pop_front(), emplace_back(), begin() and end()
+ *   members of std::deque.
+ * - stamp_t: Type returned by the time functions, an arithmetic type or a std::chrono::time_point.
+ * - duration_t: Type of delta_t, i.e. of the difference of two stamp_t.
+ * - function_t<Sig>: Type storing the callbacks and time functions, std::function<Sig> by default.
+ *   See SynchronizerInplacePolicy to store them without allocating.
+ * - allocator_type: Allocator accepted by the constructor, rebound to each message type to
+ *   construct the queues. Only used by that constructor.
+ *
+ * Custom policies can derive from SynchronizerPolicy and only redefine what they need.
+ */
+struct SynchronizerPolicy
+{
+  template<typename U>
+  using queue_t = std::deque<U>;
+
+  using allocator_type = std::allocator<std::byte>;
+
+  template<typename Sig>
+  using function_t = std::function<Sig>;
+
+  using stamp_t    = int64_t;
+  using duration_t = int64_t;
+};
+
+/**
+ * @brief Synchronizer policy for timestamps of type S.
+ * @details Time functions return S directly, so that e.g. double seconds or chrono time points
+ * are compared in their native representation without conversions.
+ *
+ * @tparam S Timestamp type, an arithmetic type or a std::chrono::time_point.
+ */
+template<typename S>
+struct SynchronizerStampPolicy : public SynchronizerPolicy
+{
+  using stamp_t    = S;
+  using duration_t = typename detail::SyncStampTraits<S>::duration;
+};
+
+/**
+ * @brief Synchronizer policy storing messages with a custom allocator.
+ * @details Queues are std::deque with Alloc rebound to each message type. The allocator instance
+ * is given to the synchronizer constructor, and default constructed otherwise. Example with a
+ * PmrAdaptor over a pool resource:
+ * ```
+ * std::pmr::unsynchronized_pool_resource pool;
+ * BasicSynchronizer<SynchronizerAllocPolicy<PmrAdaptor<std::byte>>, Type0, Type1> sync(0, &pool);
+ * ```
+ *
+ * @tparam Alloc Allocator, rebound to the message types.
+ */
+template<typename Alloc>
+struct SynchronizerAllocPolicy : public SynchronizerPolicy
+{
+  template<typename U>
+  using queue_t = std::deque<U, typename std::allocator_traits<Alloc>::template rebind_alloc<U>>;
+
+  using allocator_type = Alloc;
+};
+
+/**
+ * @brief Synchronizer policy storing the callbacks and time functions as inplace_function.
+ * @details Registering a callable never allocates, but callables must be at most Size bytes and
+ * become move-only, so that CallbackAll and CallbackThis are not copyable. Example:
+ * ```
+ * BasicSynchronizer<SynchronizerInplacePolicy<SynchronizerStampPolicy<double>>, Type0> sync;
+ * ```
+ *
+ * @tparam Base Policy defining everything else.
+ * @tparam Size Capacity in bytes of the callables.
+ */
+template<typename Base = SynchronizerPolicy, std::size_t Size = 64>
+struct SynchronizerInplacePolicy : public Base
+{
+  template<typename Sig>
+  using function_t = inplace_function<Sig, Size>;
+};
+
+/**
+ * @brief Synchronizer policy for timestamps given as time points of a clock.
+ *
+ * @tparam clock_t Clock type, must be compatible with ClockTraits.
+ */
+template<typename clock_t>
+using SynchronizerClockPolicy =
+  SynchronizerStampPolicy<typename detail::ClockTraits<clock_t>::time_point>;
+
+/// @cond
+
 // Synchronizer data structure: base definition
-template<typename... T>
-class Synchronizer;
+template<typename Policy, typename... T>
+class BasicSynchronizer;
 
-template<>
-class Synchronizer<>
+template<typename Policy>
+class BasicSynchronizer<Policy>
 {
 public:
-  explicit Synchronizer(const int64_t delta_t)
-      : m_delta_t(delta_t), m_next_t(std::numeric_limits<int64_t>::min())
+  using stamp_t    = typename Policy::stamp_t;
+  using duration_t = typename Policy::duration_t;
+
+  explicit BasicSynchronizer(const duration_t delta_t)
+      : m_delta_t(delta_t), m_next_t(detail::SyncStampTraits<stamp_t>::lowest())
   {}
 
+  BasicSynchronizer(const duration_t delta_t, const typename Policy::allocator_type &)
+      : BasicSynchronizer(delta_t)
+  {}
+
+  BasicSynchronizer(const BasicSynchronizer &) = delete;
+  BasicSynchronizer(BasicSynchronizer &&)      = delete;
+  BasicSynchronizer & operator=(const BasicSynchronizer &) = delete;
+  BasicSynchronizer & operator=(BasicSynchronizer &&) = delete;
+
+  ~BasicSynchronizer()
+  {
+    if (m_dispatcher) {
+      try {
+        m_dispatcher->wait();
+      } catch (...) {
+      }
+    }
+  }
+
 protected:
   std::mutex m_search_mtx;  // to run one search at a time
-  int64_t m_delta_t, m_next_t;
+  duration_t m_delta_t;
+  stamp_t m_next_t;
+  std::shared_ptr<ThreadPool> m_pool{};
+  std::shared_ptr<detail::OrderedDispatcher> m_dispatcher{};
 };
 
 /// @endcond
@@ -71,36 +360,70 @@ protected:
  * sync.add_and_search<1>(o1_1);
  * ```
  *
+ * Sets can also be processed concurrently on a ThreadPool, see register_parallel_callback().
+ *
+ * Synchronizer<T, Ts...> is an alias for BasicSynchronizer<SynchronizerPolicy, T, Ts...>, see
+ * SynchronizerPolicy for how to customize the message storage and the timestamp type. Timestamps
+ * are int64_t by default, StampedSynchronizer<S, T, Ts...> uses timestamps of type S instead:
+ * ```
+ * StampedSynchronizer<std::chrono::steady_clock::time_point, Type0, Type1> sync;
+ * sync.set_time_fcn<0>([] (const Type0 & o0) { return o0.time_point; });
+ * ```
+ *
+ * @tparam Policy Synchronizer policy.
  * @tparam T, Ts Variadic templates for message types.
  */
-template<typename T, typename... Ts>
-class Synchronizer<T, Ts...> : public Synchronizer<Ts...>
+template<typename Policy, typename T, typename... Ts>
+class BasicSynchronizer<Policy, T, Ts...> : public BasicSynchronizer<Policy, Ts...>
 {
 public:
-  using CallbackAll  = std::function<void(T &&, Ts &&...)>;
-  using CallbackThis = std::function<void(T &&)>;
+  using typename BasicSynchronizer<Policy>::stamp_t;
+  using typename BasicSynchronizer<Policy>::duration_t;
+
+  using CallbackAll    = typename Policy::template function_t<void(T &&, Ts &&...)>;
+  using CallbackThis   = typename Policy::template function_t<void(T &&)>;
+  using TimeFcn        = typename Policy::template function_t<stamp_t(const T &)>;
+  using allocator_type = typename Policy::allocator_type;
 
   /**
    * @brief Construct a new Synchronizer object.
    *
    * @param delta_t Minimal time between messages
    */
-  explicit Synchronizer<T, Ts...>(int64_t delta_t = 0)
-      : Synchronizer<Ts...>(delta_t), m_impl{{},
-                                        0,
-                                        0,
-                                        [](const T &) { return 0; },
-                                        [](T &&) { return; }},
+  explicit BasicSynchronizer(duration_t delta_t = duration_t{0})
+      : BasicSynchronizer<Policy, Ts...>(delta_t), m_impl{{},
+                                                     0,
+                                                     0,
+                                                     [](const T &) { return stamp_t{}; },
+                                                     [](T &&) { return; }},
+        callback_([](T &&, Ts &&...) {})
+  {}
+
+  /**
+   * @brief Construct a new Synchronizer object storing messages with the given allocator.
+   * @details The allocator is rebound to each message type, see SynchronizerAllocPolicy.
+   *
+   * @param delta_t Minimal time between messages
+   * @param alloc Allocator of the queues
+   */
+  BasicSynchronizer(duration_t delta_t, const allocator_type & alloc)
+      : BasicSynchronizer<Policy, Ts...>(delta_t, alloc),
+        m_impl{queue_t(typename std::allocator_traits<allocator_type>::template rebind_alloc<T>(
+                 alloc)),
+          0,
+          0,
+          [](const T &) { return stamp_t{}; },
+          [](T &&) { return; }},
         callback_([](T &&, Ts &&...) {})
   {}
 
   /* Copies not allowed */
-  Synchronizer<T, Ts...>(const Synchronizer<T, Ts...> &) = delete;
-  Synchronizer<T, Ts...> & operator=(const Synchronizer<T, Ts...> &) = delete;
+  BasicSynchronizer(const BasicSynchronizer &) = delete;
+  BasicSynchronizer & operator=(const BasicSynchronizer &) = delete;
   /* FIXME(pettni): implement proper moving */
-  Synchronizer<T, Ts...>(Synchronizer<T, Ts...> &&) = delete;
-  Synchronizer<T, Ts...> & operator=(Synchronizer<T, Ts...> &&) = delete;
-  ~Synchronizer<T, Ts...>()                                     = default;
+  BasicSynchronizer(BasicSynchronizer &&) = delete;
+  BasicSynchronizer & operator=(BasicSynchronizer &&) = delete;
+  ~BasicSynchronizer()                                = default;
 
   /**
    * @brief Register a callback to use for synchronized element sets.
@@ -116,7 +439,89 @@ public:
   template<typename S>
   void register_callback(S && c)
   {
-    callback_ = c;
+    callback_ = std::forward<S>(c);
+  }
+
+  /**
+   * @brief Register callbacks to process synchronized sets concurrently on a thread pool.
+   * @details The work callback is called on the pool, possibly on several sets at the same time.
+   * Its result is then passed to the completion callback, which is called on one set at a time
+   * and in the order in which the sets were found, i.e. in timestamp order. The search is thus
+   * never blocked by the processing of a set.
+   *
+   * Example:
+   * ```
+   * auto pool = std::make_shared<ThreadPool>(4);
+   * Synchronizer<Type1, Type2> sync;
+   * sync.register_parallel_callback(pool,
+   *   [] (Type1 && t1, Type2 && t2) {
+   *     return process(t1, t2);  // concurrent
+   *   },
+   *   [] (Result && r) {
+   *     // in order
+   *   });
+   * ```
+   * If the work callback returns void, the completion callback takes no argument.
+   * The first exception thrown by either callback is rethrown by wait_dispatched(). A set whose
+   * work callback threw is not passed to the completion callback.
+   *
+   * @param pool Thread pool to dispatch sets onto.
+   * @param work Callback taking an r-value of each template type.
+   * @param complete Callback taking an r-value of the result of work.
+   */
+  template<typename W, typename C>
+  void register_parallel_callback(std::shared_ptr<ThreadPool> pool, W && work, C && complete)
+  {
+    using work_t     = std::decay_t<W>;
+    using complete_t = std::decay_t<C>;
+    using result_t   = std::invoke_result_t<work_t &, T &&, Ts &&...>;
+
+    using base_t = BasicSynchronizer<Policy>;
+
+    wait_dispatched();
+    base_t::m_pool       = std::move(pool);
+    base_t::m_dispatcher = std::make_shared<detail::OrderedDispatcher>(*base_t::m_pool);
+
+    auto fcns = std::make_shared<std::pair<work_t, complete_t>>(
+      std::forward<W>(work), std::forward<C>(complete));
+
+    callback_ = [d = base_t::m_dispatcher, fcns](T && t, Ts &&... ts) {
+      auto set = std::make_shared<std::tuple<T, Ts...>>(std::move(t), std::move(ts)...);
+      detail::OrderedDispatcher::dispatch(
+        d, [fcns, set]() -> detail::OrderedDispatcher::completion_t {
+          if constexpr (std::is_void_v<result_t>) {
+            std::apply(fcns->first, std::move(*set));
+            return [fcns]() { std::invoke(fcns->second); };
+          } else {
+            auto res = std::make_shared<result_t>(std::apply(fcns->first, std::move(*set)));
+            return [fcns, res]() { std::invoke(fcns->second, std::move(*res)); };
+          }
+        });
+    };
+  }
+
+  /**
+   * @brief Block until all sets dispatched with register_parallel_callback() have completed.
+   * @details Returns immediately if no parallel callback is registered. Rethrows the first
+   * exception thrown by the parallel callbacks since the last call.
+   *
+   * Must not be called from a task of the pool, since it waits for tasks that may be queued
+   * behind it. Calls from the parallel callbacks throw std::logic_error.
+   */
+  void wait_dispatched()
+  {
+    const auto & d = BasicSynchronizer<Policy>::m_dispatcher;
+    if (d) { d->wait(); }
+  }
+
+  /**
+   * @brief Number of sets dispatched with register_parallel_callback() that have not completed yet.
+   */
+  std::size_t get_dispatched_count() const
+  {
+    const auto & d = BasicSynchronizer<Policy>::m_dispatcher;
+    if (d) { return d->in_flight(); }
+    return 0;
   }
 
   /**
@@ -134,15 +539,16 @@ public:
   template<std::size_t k, typename S>
   void register_nonsync_callback(S && c)
   {
-    if constexpr (k == 0) { m_impl.callback_this_ = c; }
+    if constexpr (k == 0) { m_impl.callback_this_ = std::forward<S>(c); }
     if constexpr (k != 0) {
-      Synchronizer<Ts...>::template register_nonsync_callback<k - 1>(std::forward<S>(c));
+      BasicSynchronizer<Policy, Ts...>::template register_nonsync_callback<k - 1>(
+        std::forward<S>(c));
     }
   }
 
   /**
    * @brief Set function to compute timestamps
-   * @param f function T -> int64_t
+   * @param f function T -> stamp_t
    *
    *  Example:
    *  > Synchronizer<Type1, Type2> sync;
@@ -153,8 +559,23 @@ public:
   template<std::size_t k, typename S>
   void set_time_fcn(S && f)
   {
-    if constexpr (k == 0) { m_impl.time_fcn = f; }
-    if constexpr (k != 0) { Synchronizer<Ts...>::template set_time_fcn<k - 1>(std::forward<S>(f)); }
+    if constexpr (k == 0) { m_impl.time_fcn = std::forward<S>(f); }
+    if constexpr (k != 0) {
+      BasicSynchronizer<Policy, Ts...>::template set_time_fcn<k - 1>(std::forward<S>(f));
+    }
+  }
+
+  /**
+   * @brief Compute the timestamp of an element with the registered time function.
+   *
+   * @tparam k Index of queue the element belongs to.
+   * @param el Element.
+   * @return Timestamp of the element.
+   */
+  template<std::size_t k, typename S>
+  stamp_t get_time(const S & el) const
+  {
+    return getImpl<k>().time_fcn(el);
   }
 
   /**
@@ -168,7 +589,7 @@ public:
   {
     if constexpr (k == 0) {
       auto el_time = m_impl.time_fcn(el);
-      if (el_time < Synchronizer<>::m_next_t) {
+      if (el_time < BasicSynchronizer<Policy>::m_next_t) {
         return;  // doesn't respect minimal delta_t
       }
       if (!m_impl.queue.empty() && el_time < m_impl.time_fcn(m_impl.queue.back())) {
@@ -176,7 +597,9 @@ public:
       }
       m_impl.queue.emplace_back(std::forward<S>(el));
     }
-    if constexpr (k != 0) { Synchronizer<Ts...>::template add<k - 1>(std::forward<S>(el)); }
+    if constexpr (k != 0) {
+      BasicSynchronizer<Policy, Ts...>::template add<k - 1>(std::forward<S>(el));
+    }
   }
 
   /**
@@ -198,17 +621,17 @@ public:
   void add_and_search(S && el)
   {
     add<k>(std::forward<S>(el));
-    if (Synchronizer<Ts...>::m_search_mtx.try_lock()) {
+    if (BasicSynchronizer<Policy, Ts...>::m_search_mtx.try_lock()) {
       bool search_more = true;
       while (search_more) { search_more = search(); }
-      Synchronizer<Ts...>::m_search_mtx.unlock();
+      BasicSynchronizer<Policy, Ts...>::m_search_mtx.unlock();
     }
   }
 
   /**
    * @brief Print wrapper for ostream.
    */
-  friend std::ostream & operator<<(std::ostream & os, const Synchronizer<T, Ts...> & s)
+  friend std::ostream & operator<<(std::ostream & os, const BasicSynchronizer & s)
   {
     s.printOn(os);
     return os;
@@ -216,11 +639,13 @@ public:
 
 protected:
   /// @cond
+  using queue_t = typename Policy::template queue_t<T>;
+
   struct Impl
   {
-    std::deque<T> queue;
+    queue_t queue;
     std::size_t search_idx, optimal_idx;
-    std::function<int64_t(const T &)> time_fcn;
+    TimeFcn time_fcn;
     CallbackThis callback_this_;
   };
 
@@ -239,7 +664,7 @@ protected:
 
   // for each queue keep at most n elements with a stamp smaller than time
   // single-element callback is used on those elements that are removed
-  void keep_n_before_time(std::size_t n, int64_t time)
+  void keep_n_before_time(std::size_t n, stamp_t time)
   {
     mapApply(
       [n, time](auto & impl) {
@@ -252,13 +677,15 @@ protected:
   }
 
   // increase first counter for first element with stamp at least time
-  void increase_first_with_time(int64_t time)
+  void increase_first_with_time(stamp_t time)
   {
     if (time >= m_impl.time_fcn(m_impl.queue.at(m_impl.search_idx))) {
       ++m_impl.search_idx;
       return;
     }
-    if constexpr (sizeof...(Ts) != 0) { Synchronizer<Ts...>::increase_first_with_time(time); }
+    if constexpr (sizeof...(Ts) != 0) {
+      BasicSynchronizer<Policy, Ts...>::increase_first_with_time(time);
+    }
   }
 
   // return Impl & for given index
@@ -270,7 +697,7 @@ protected:
       return (m_impl);  // return reference due to ()
       // *INDENT-ON*
     }
-    if constexpr (k != 0) { return Synchronizer<Ts...>::template getImpl<k - 1>(); }
+    if constexpr (k != 0) { return BasicSynchronizer<Policy, Ts...>::template getImpl<k - 1>(); }
   }
 
   // return const Impl & for given index
@@ -282,27 +709,27 @@ protected:
       return (m_impl);  // return reference due to ()
       // *INDENT-ON*
     }
-    if constexpr (k != 0) { return Synchronizer<Ts...>::template getImpl<k - 1>(); }
+    if constexpr (k != 0) { return BasicSynchronizer<Policy, Ts...>::template getImpl<k - 1>(); }
   }
 
   // Minimal search time across all queues
   template<std::size_t... I>
-  int64_t min_first_time(std::index_sequence<I...>) const
+  stamp_t min_first_time(std::index_sequence<I...>) const
   {
     auto search_time = [](const auto & impl) {
       return impl.time_fcn(impl.queue.at(impl.search_idx));
     };
-    return std::min<int64_t>({search_time(getImpl<I>())...});
+    return std::min<stamp_t>({search_time(getImpl<I>())...});
   }
 
   // Maximal search time across all queues
   template<std::size_t... I>
-  int64_t max_first_time(std::index_sequence<I...>) const
+  stamp_t max_first_time(std::index_sequence<I...>) const
   {
     auto search_time = [](const auto & impl) {
       return impl.time_fcn(impl.queue.at(impl.search_idx));
     };
-    return std::max<int64_t>({search_time(getImpl<I>())...});
+    return std::max<stamp_t>({search_time(getImpl<I>())...});
   }
 
   // fold with && over indices
@@ -330,6 +757,23 @@ protected:
   /// @endcond
 };
 
+/**
+ * @brief Synchronizer with the default policy.
+ *
+ * @tparam T Variadic templates for message types.
+ */
+template<typename... T>
+using Synchronizer = BasicSynchronizer<SynchronizerPolicy, T...>;
+
+/**
+ * @brief Synchronizer with timestamps of type S.
+ *
+ * @tparam S Timestamp type, an arithmetic type or a std::chrono::time_point.
+ * @tparam T Variadic templates for message types.
+ */
+template<typename S, typename... T>
+using StampedSynchronizer = BasicSynchronizer<SynchronizerStampPolicy<S>, T...>;
+
 }  // namespace cbr
 
 #include "synchronizer_impl.hxx"
@@ -0,0 +1,503 @@
+// Copyright Yamaha 2021
+// MIT License
+// https://github.com/yamaha-bps/cbr_utils/blob/master/LICENSE
+
+/** @file */
+
+#ifndef CBR_UTILS__SYNCHRONIZER_HUB_HPP_
+#define CBR_UTILS__SYNCHRONIZER_HUB_HPP_
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "synchronizer.hpp"
+
+namespace cbr {
+
+/// @cond
+
+namespace detail {
+
+// Shared ingestion buffer of a stream, indexed by absolute message index
+template<typename U, typename S>
+struct HubBuffer
+{
+  std::deque<U> items;
+  uint64_t base = 0;  // absolute index of items.front()
+  S last_t      = SyncStampTraits<S>::lowest();
+
+  uint64_t end() const noexcept { return base + items.size(); }
+};
+
+// Cursor into a shared buffer, used as a synchronizer queue
+template<typename U, typename S>
+class HubQueueView
+{
+public:
+  using const_iterator = typename std::deque<U>::const_iterator;
+
+  HubQueueView() = default;
+  HubQueueView(const HubBuffer<U, S> & buf, const uint64_t begin) : m_buf(&buf), m_begin(begin) {}
+
+  bool empty() const noexcept { return size() == 0; }
+
+  std::size_t size() const noexcept
+  {
+    return m_buf == nullptr ? 0 : static_cast<std::size_t>(m_buf->end() - m_begin);
+  }
+
+  const U & at(const std::size_t i) const
+  {
+    if (i >= size()) { throw std::out_of_range("HubQueueView::at"); }
+    return m_buf->items[static_cast<std::size_t>(m_begin - m_buf->base) + i];
+  }
+
+  // returns a copy since the shared buffer must not be moved from
+  U front() const { return at(0); }
+
+  const U & back() const { return at(size() - 1); }
+
+  void pop_front() noexcept { ++m_begin; }
+
+  const_iterator begin() const
+  {
+    return m_buf->items.begin() + static_cast<std::ptrdiff_t>(m_begin - m_buf->base);
+  }
+
+  const_iterator end() const { return m_buf->items.end(); }
+
+  uint64_t cursor() const noexcept { return m_begin; }
+
+protected:
+  const HubBuffer<U, S> * m_buf = nullptr;
+  uint64_t m_begin              = 0;
+};
+
+template<typename Policy>
+struct HubPolicy : public Policy
+{
+  template<typename U>
+  using queue_t = HubQueueView<U, typename Policy::stamp_t>;
+};
+
+}  // namespace detail
+
+template<typename Policy, typename... T>
+class BasicSynchronizerHub;
+
+/// @endcond
+
+/**
+ * @brief Synchronizer reading from the shared buffers of a SynchronizerHub.
+ * @details Behaves like a Synchronizer<std::shared_ptr<const T>...> whose messages are added
+ * through the hub. Callbacks receive shared pointers to the messages stored in the hub, and are
+ * called by the hub after it has released its lock.
+ *
+ * @tparam Policy Synchronizer policy, defines the timestamp type.
+ * @tparam T Variadic templates for message types.
+ */
+template<typename Policy, typename... T>
+class BasicSynchronizerHubMatcher
+    : public BasicSynchronizer<detail::HubPolicy<Policy>, std::shared_ptr<const T>...>
+{
+  using base_t = BasicSynchronizer<detail::HubPolicy<Policy>, std::shared_ptr<const T>...>;
+
+public:
+  using typename base_t::duration_t;
+
+  template<std::size_t k>
+  using message_t = std::tuple_element_t<k, std::tuple<T...>>;
+
+  /**
+   * @brief Construct a new matcher, use SynchronizerHub::add_matcher() instead.
+   *
+   * @param delta_t Minimal time between sets.
+   */
+  explicit BasicSynchronizerHubMatcher(const duration_t delta_t = duration_t{0}) : base_t(delta_t)
+  {
+    base_t::register_callback([this](std::shared_ptr<const T> &&... msgs) {
+      m_events.push_back(Event{npos, {std::move(msgs)...}});
+    });
+    install_nonsync(std::index_sequence_for<T...>{});
+  }
+
+  /**
+   * @brief Register a callback to use for synchronized sets.
+   *
+   * @param c Callback taking an r-value shared pointer to each message type.
+   */
+  template<typename S>
+  void register_callback(S && c)
+  {
+    m_callback = std::forward<S>(c);
+  }
+
+  /**
+   * @brief Register a callback to use on individual messages that are not synchronized.
+   *
+   * @tparam k Index of the stream.
+   * @param c Callback taking an r-value shared pointer to a message_t<k>.
+   */
+  template<std::size_t k, typename S>
+  void register_nonsync_callback(S && c)
+  {
+    std::get<k>(m_nonsync_callbacks) = std::forward<S>(c);
+  }
+
+protected:
+  /// @cond
+  friend class BasicSynchronizerHub<Policy, T...>;
+
+  static constexpr std::size_t npos = std::numeric_limits<std::size_t>::max();
+
+  // a synchronized set if stream is npos, else a non-synchronized message of a stream
+  struct Event
+  {
+    std::size_t stream;
+    std::tuple<std::shared_ptr<const T>...> msgs;
+  };
+
+  // messages and time functions are handled by the hub
+  using base_t::add;
+  using base_t::add_and_search;
+  using base_t::search;
+  using base_t::set_time_fcn;
+
+  template<std::size_t... I>
+  void install_nonsync(std::index_sequence<I...>)
+  {
+    (base_t::template register_nonsync_callback<I>(
+       [this](std::shared_ptr<const message_t<I>> && msg) {
+         Event e{I, {}};
+         std::get<I>(e.msgs) = std::move(msg);
+         m_events.push_back(std::move(e));
+       }),
+      ...);
+  }
+
+  void dispatch(Event && e)
+  {
+    if (e.stream == npos) {
+      if (m_callback) { std::apply(m_callback, std::move(e.msgs)); }
+    } else {
+      dispatch_nonsync(e, std::index_sequence_for<T...>{});
+    }
+  }
+
+  template<std::size_t... I>
+  void dispatch_nonsync(Event & e, std::index_sequence<I...>)
+  {
+    const auto f = [&e](auto & cb, auto & msg, const std::size_t i) {
+      if (e.stream == i && cb) { cb(std::move(msg)); }
+    };
+    (f(std::get<I>(m_nonsync_callbacks), std::get<I>(e.msgs), I), ...);
+  }
+
+  std::function<void(std::shared_ptr<const T> &&...)> m_callback{};
+  std::tuple<std::function<void(std::shared_ptr<const T> &&)>...> m_nonsync_callbacks{};
+  std::vector<Event> m_events{};  // found by the last searches, not dispatched yet
+  /// @endcond
+};
+
+/**
+ * @brief Synchronize the same message streams with several matchers.
+ * @details Each stream has a single ingestion buffer of reference counted immutable messages,
+ * which is shared by all the matchers. Each matcher has its own delta_t and callbacks, and keeps
+ * a cursor into each shared buffer. Messages are dropped from the shared buffers once every matcher
+ * is done with them. Compared to several Synchronizer instances, messages are stored and copied
+ * once instead of once per synchronizer.
+ *
+ * Notes:
+ * - Messages are assumed to arrive in order in each stream, out of order messages are discarded.
+ * - Messages that are too close to the previous set of a matcher (see delta_t) are passed to the
+ *   non-sync callback of that matcher instead of being silently discarded.
+ * - Callbacks are called without the hub locked, one at a time and in the order the sets were
+ *   found. They may add messages to the hub, which are then processed once they return.
+ *
+ * Usage example:
+ * ```
+ * SynchronizerHub<Camera, Lidar> hub;
+ * hub.set_time_fcn<0>([](const Camera & c) { return c.t; });
+ * hub.set_time_fcn<1>([](const Lidar & l) { return l.t; });
+ *
+ * auto & fast = hub.add_matcher(0);
+ * fast.register_callback(
+ *   [](std::shared_ptr<const Camera> && c, std::shared_ptr<const Lidar> && l) {});
+ * auto & slow = hub.add_matcher(100);
+ * slow.register_callback(
+ *   [](std::shared_ptr<const Camera> && c, std::shared_ptr<const Lidar> && l) {});
+ *
+ * hub.add_and_search<0>(camera_msg);
+ * hub.add_and_search<1>(lidar_msg);
+ * ```
+ *
+ * SynchronizerHub<T...> is an alias for BasicSynchronizerHub<SynchronizerPolicy, T...>, the
+ * policy defines the timestamp type, see SynchronizerPolicy.
+ *
+ * @tparam Policy Synchronizer policy.
+ * @tparam T Variadic templates for message types.
+ */
+template<typename Policy, typename... T>
+class BasicSynchronizerHub
+{
+  static_assert(sizeof...(T) > 0, "SynchronizerHub needs at least one stream.");
+
+public:
+  using Matcher    = BasicSynchronizerHubMatcher<Policy, T...>;
+  using stamp_t    = typename Policy::stamp_t;
+  using duration_t = typename Policy::duration_t;
+
+  template<std::size_t k>
+  using message_t = std::tuple_element_t<k, std::tuple<T...>>;
+
+  BasicSynchronizerHub()                             = default;
+  BasicSynchronizerHub(const BasicSynchronizerHub &) = delete;
+  BasicSynchronizerHub(BasicSynchronizerHub &&)      = delete;
+  BasicSynchronizerHub & operator=(const BasicSynchronizerHub &) = delete;
+  BasicSynchronizerHub & operator=(BasicSynchronizerHub &&) = delete;
+  ~BasicSynchronizerHub()                                   = default;
+
+  /**
+   * @brief Set function to compute timestamps, for all matchers.
+   *
+   * @tparam k Index of the stream.
+   * @param f function message_t<k> -> stamp_t
+   */
+  template<std::size_t k, typename S>
+  void set_time_fcn(S && f)
+  {
+    std::scoped_lock lock(m_mtx);
+    std::get<k>(m_time_fcns) = std::forward<S>(f);
+    for (auto & m : m_matchers) { install_time_fcn<k>(*m); }
+  }
+
+  /**
+   * @brief Add a new matcher.
+   * @details The matcher only sees messages added after its creation. The returned reference is
+   * valid until the matcher is removed or the hub destroyed.
+   *
+   * @param delta_t Minimal time between sets of the matcher.
+   * @return Reference to the new matcher, to register callbacks on.
+   */
+  Matcher & add_matcher(const duration_t delta_t = duration_t{0})
+  {
+    std::scoped_lock lock(m_mtx);
+    auto & m = *m_matchers.emplace_back(std::make_shared<Matcher>(delta_t));
+    init_matcher(m, std::index_sequence_for<T...>{});
+    return m;
+  }
+
+  /**
+   * @brief Remove a matcher.
+   * @details Sets found by the matcher that were not dispatched yet are dropped.
+   *
+   * @param matcher Matcher to remove.
+   */
+  void remove_matcher(const Matcher & matcher)
+  {
+    std::scoped_lock lock(m_mtx);
+    const auto is_matcher = [&matcher](const auto & m) { return m.get() == &matcher; };
+    m_matchers.erase(
+      std::remove_if(m_matchers.begin(), m_matchers.end(), is_matcher), m_matchers.end());
+    m_pending.erase(std::remove_if(m_pending.begin(),
+                      m_pending.end(),
+                      [&is_matcher](const auto & p) { return is_matcher(p.first); }),
+      m_pending.end());
+    trim(std::index_sequence_for<T...>{});
+  }
+
+  /**
+   * @brief Get number of matchers.
+   */
+  std::size_t matcher_count() const
+  {
+    std::scoped_lock lock(m_mtx);
+    return m_matchers.size();
+  }
+
+  /**
+   * @brief Insert new element in shared buffer.
+   * @details Not thread safe.
+   *
+   * @tparam k Index of the stream to insert in.
+   * @param el New element, either a message_t<k> or a std::shared_ptr<const message_t<k>>.
+   */
+  template<std::size_t k, typename S>
+  void add(S && el)
+  {
+    using U = message_t<k>;
+
+    std::shared_ptr<const U> msg;
+    if constexpr (std::is_convertible_v<S, std::shared_ptr<const U>>) {
+      msg = std::forward<S>(el);
+    } else {
+      msg = std::make_shared<const U>(std::forward<S>(el));
+    }
+
+    auto & buf         = std::get<k>(m_buffers);
+    const stamp_t el_t = std::get<k>(m_time_fcns)(*msg);
+    if (el_t < buf.last_t) {
+      return;  // time not monotonically increasing
+    }
+    buf.last_t = el_t;
+    buf.items.emplace_back(std::move(msg));
+  }
+
+  /**
+   * @brief Run the search of every matcher, then drop messages no matcher needs anymore.
+   * @details Not thread safe.
+   *
+   * @return Returns true if a synchronized set was found by any matcher.
+   */
+  bool search()
+  {
+    const bool found = collect();
+    dispatch();
+    return found;
+  }
+
+  /**
+   * @brief Insert new element and run search of every matcher.
+   * @details Thread safe. Callbacks are called after the hub is unlocked, see the class notes.
+   *
+   * @tparam k Index of the stream to insert in.
+   * @param el New element, either a message_t<k> or a std::shared_ptr<const message_t<k>>.
+   */
+  template<std::size_t k, typename S>
+  void add_and_search(S && el)
+  {
+    {
+      std::scoped_lock lock(m_mtx);
+      add<k>(std::forward<S>(el));
+      collect();
+    }
+    dispatch();
+  }
+
+  /**
+   * @brief Get number of messages held in the shared buffer of a stream.
+   *
+   * @tparam k Index of the stream.
+   */
+  template<std::size_t k>
+  std::size_t buffer_size() const
+  {
+    std::scoped_lock lock(m_mtx);
+    return std::get<k>(m_buffers).items.size();
+  }
+
+protected:
+  /// @cond
+  using event_t = typename Matcher::Event;
+
+  template<std::size_t k>
+  void install_time_fcn(Matcher & m)
+  {
+    m.template set_time_fcn<k>(
+      [f = std::get<k>(m_time_fcns)](const std::shared_ptr<const message_t<k>> & msg) {
+        return f(*msg);
+      });
+  }
+
+  template<std::size_t... I>
+  void init_matcher(Matcher & m, std::index_sequence<I...>)
+  {
+    ((m.template getImpl<I>().queue = {std::get<I>(m_buffers), std::get<I>(m_buffers).end()}),
+      ...);
+    (install_time_fcn<I>(m), ...);
+  }
+
+  // run the searches and queue the found sets, with the hub locked
+  bool collect()
+  {
+    bool found = false;
+    for (auto & m : m_matchers) {
+      while (m->search()) { found = true; }
+      for (auto & e : m->m_events) { m_pending.emplace_back(m, std::move(e)); }
+      m->m_events.clear();
+    }
+    trim(std::index_sequence_for<T...>{});
+    return found;
+  }
+
+  // call the callbacks of the queued sets, unless another thread or a caller up the stack does
+  void dispatch()
+  {
+    std::unique_lock lock(m_mtx);
+    if (m_dispatching) { return; }
+    m_dispatching = true;
+    while (!m_pending.empty()) {
+      auto [m, e] = std::move(m_pending.front());
+      m_pending.pop_front();
+      lock.unlock();
+      try {
+        m->dispatch(std::move(e));
+      } catch (...) {
+        lock.lock();
+        m_dispatching = false;
+        throw;
+      }
+      lock.lock();
+    }
+    m_dispatching = false;
+  }
+
+  template<std::size_t k>
+  void trim_buffer()
+  {
+    auto & buf          = std::get<k>(m_buffers);
+    uint64_t min_cursor = buf.end();
+    for (const auto & m : m_matchers) {
+      min_cursor = std::min(min_cursor, m->template getImpl<k>().queue.cursor());
+    }
+    while (buf.base < min_cursor) {
+      buf.items.pop_front();
+      ++buf.base;
+    }
+  }
+
+  template<std::size_t... I>
+  void trim(std::index_sequence<I...>)
+  {
+    (trim_buffer<I>(), ...);
+  }
+
+  std::tuple<detail::HubBuffer<std::shared_ptr<const T>, stamp_t>...> m_buffers{};
+  std::tuple<std::function<stamp_t(const T &)>...> m_time_fcns{
+    std::function<stamp_t(const T &)>([](const T &) { return stamp_t{}; })...};
+  std::vector<std::shared_ptr<Matcher>> m_matchers{};
+  std::deque<std::pair<std::shared_ptr<Matcher>, event_t>> m_pending{};
+  bool m_dispatching = false;
+  mutable std::mutex m_mtx{};
+  /// @endcond
+};
+
+/**
+ * @brief Matcher of a SynchronizerHub.
+ *
+ * @tparam T Variadic templates for message types.
+ */
+template<typename... T>
+using SynchronizerHubMatcher = BasicSynchronizerHubMatcher<SynchronizerPolicy, T...>;
+
+/**
+ * @brief SynchronizerHub with the default policy.
+ *
+ * @tparam T Variadic templates for message types.
+ */
+template<typename... T>
+using SynchronizerHub = BasicSynchronizerHub<SynchronizerPolicy, T...>;
+
+}  // namespace cbr
+
+#endif  // CBR_UTILS__SYNCHRONIZER_HUB_HPP_
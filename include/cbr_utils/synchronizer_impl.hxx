@@ -14,12 +14,12 @@
 
 namespace cbr {
 
-template<typename T, typename... Ts>
-bool Synchronizer<T, Ts...>::search()
+template<typename Policy, typename T, typename... Ts>
+bool BasicSynchronizer<Policy, T, Ts...>::search()
 {
   static constexpr auto all_idx = std::make_index_sequence<1 + sizeof...(Ts)>{};
 
-  keep_n_before_time(0, Synchronizer<>::m_next_t);
+  keep_n_before_time(0, BasicSynchronizer<Policy>::m_next_t);
 
   //// BOOK KEEPING ////
   auto one_of_every_type =
@@ -46,10 +46,10 @@ bool Synchronizer<T, Ts...>::search()
   //// START SEARCH ////
 
   // base case
-  int64_t min_t      = min_first_time(all_idx);
-  int64_t max_t      = pivot_time;
-  int64_t min_t_best = min_t;
-  int64_t max_t_best = max_t;
+  stamp_t min_t      = min_first_time(all_idx);
+  stamp_t max_t      = pivot_time;
+  stamp_t min_t_best = min_t;
+  stamp_t max_t_best = max_t;
 
   while (min_t < pivot_time) {
     increase_first_with_time(min_t);
@@ -84,7 +84,7 @@ bool Synchronizer<T, Ts...>::search()
   keep_n_before_time(1, max_t_best);
 
   // set time to start searching for next msg
-  Synchronizer<>::m_next_t = min_t_best + Synchronizer<>::m_delta_t;
+  BasicSynchronizer<Policy>::m_next_t = min_t_best + BasicSynchronizer<Policy>::m_delta_t;
 
   // optimal solution is now at front, call callback on set
   call_callback(all_idx);
@@ -100,18 +100,22 @@ bool Synchronizer<T, Ts...>::search()
   return true;
 }
 
-template<typename T, typename... Ts>
-void Synchronizer<T, Ts...>::printOn(std::ostream & os) const
+template<typename Policy, typename T, typename... Ts>
+void BasicSynchronizer<Policy, T, Ts...>::printOn(std::ostream & os) const
 {
-  os << "Synchronizer size " << 1 + sizeof...(Ts) << " (dt=" << Synchronizer<>::m_delta_t
-     << ", nt=" << Synchronizer<>::m_next_t << ")" << std::endl;
+  using traits_t = detail::SyncStampTraits<stamp_t>;
+
+  const auto delta_t = BasicSynchronizer<Policy>::m_delta_t;
+  os << "Synchronizer size " << 1 + sizeof...(Ts)
+     << " (dt=" << traits_t::count(stamp_t{} + delta_t)
+     << ", nt=" << traits_t::count(BasicSynchronizer<Policy>::m_next_t) << ")" << std::endl;
   size_t counter = 0;
   auto f         = [&os, &counter](const auto & impl) {
     if (impl.queue.empty()) {
       os << "Queue #" << counter << ": (empty)" << std::endl;
     } else {
       os << "Queue #" << counter << ": ";
-      for (auto & item : impl.queue) { os << impl.time_fcn(item) << " "; }
+      for (auto & item : impl.queue) { os << traits_t::count(impl.time_fcn(item)) << " "; }
       os << std::endl;
     }
     ++counter;
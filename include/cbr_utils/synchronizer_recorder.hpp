@@ -0,0 +1,443 @@
+// Copyright Yamaha 2021
+// MIT License
+// https://github.com/yamaha-bps/cbr_utils/blob/master/LICENSE
+
+/** @file */
+
+#ifndef CBR_UTILS__SYNCHRONIZER_RECORDER_HPP_
+#define CBR_UTILS__SYNCHRONIZER_RECORDER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "mapped_file.hpp"
+#include "serialization.hpp"
+#include "synchronizer.hpp"
+
+namespace cbr {
+
+/// @cond
+
+namespace detail {
+
+inline constexpr char sync_rec_magic[8] = {'C', 'B', 'R', 'S', 'R', 'E', 'C', '2'};
+
+// how a message reached the synchronizer
+enum class SyncRecOp : uint32_t { add = 0, add_and_search = 1 };
+
+// stamps are stored as their count, as an integer or a floating point number
+enum class SyncRecStamp : uint32_t { integer = 0, floating = 1 };
+
+struct SyncRecFileHeader
+{
+  char magic[8];
+  uint32_t n_streams;
+  SyncRecStamp stamp_type;
+  uint64_t size;  // bytes of complete records including this header, updated after each record
+};
+
+struct SyncRecRecordHeader
+{
+  uint32_t stream;
+  uint32_t size;
+  SyncRecOp op;
+  uint32_t reserved;
+  union {
+    int64_t i;
+    double f;
+  } stamp;
+};
+
+// how stamps of type S are recorded
+template<typename S>
+struct SyncRecStampTraits
+{
+  using rep = typename SyncStampTraits<S>::rep;
+
+  static_assert(std::is_arithmetic_v<rep> && sizeof(rep) <= 8, "Unsupported stamp type.");
+
+  static constexpr SyncRecStamp type =
+    std::is_floating_point_v<rep> ? SyncRecStamp::floating : SyncRecStamp::integer;
+
+  static void store(SyncRecRecordHeader & header, const S s) noexcept
+  {
+    if constexpr (type == SyncRecStamp::floating) {
+      header.stamp.f = static_cast<double>(SyncStampTraits<S>::count(s));
+    } else {
+      header.stamp.i = static_cast<int64_t>(SyncStampTraits<S>::count(s));
+    }
+  }
+
+  static S load(const SyncRecRecordHeader & header) noexcept
+  {
+    if constexpr (type == SyncRecStamp::floating) {
+      return SyncStampTraits<S>::from_count(static_cast<rep>(header.stamp.f));
+    } else {
+      return SyncStampTraits<S>::from_count(static_cast<rep>(header.stamp.i));
+    }
+  }
+};
+
+}  // namespace detail
+
+/// @endcond
+
+/**
+ * @brief Record the input of a Synchronizer to a file.
+ * @details Every message added through the recorder is appended to a memory-mapped file as a
+ * compact binary record (stream index, timestamp, whether it was added with add() or
+ * add_and_search(), serialized payload) before being forwarded to the synchronizer. Payloads are
+ * serialized with serialize(), and thus can be arithmetic types, std containers or
+ * boost::hana::Struct types. The recording can then be fed back into a synchronizer with
+ * SynchronizerReplayer.
+ *
+ * The file header holds the size of the complete records and is updated after each record, so
+ * that a recording is readable up to its last record if the process dies before close().
+ *
+ * Example:
+ * ```
+ * Synchronizer<Camera, Lidar> sync;
+ * SynchronizerRecorder<Camera, Lidar> recorder("sync.rec");
+ *
+ * recorder.add_and_search<0>(sync, camera);  // instead of sync.add_and_search<0>(camera)
+ * ```
+ * Notes:
+ * - Recording is thread safe, but the synchronizer is called after the recorder is unlocked so
+ *   that its callbacks can add messages. Calls made concurrently from several threads reach the
+ *   synchronizer in the recorded order only if the caller serializes them.
+ * - SynchronizerRecorder<T...> is an alias for BasicSynchronizerRecorder<SynchronizerPolicy, T...>,
+ *   the policy must be the one of the synchronizer and defines the timestamp type.
+ *
+ * @tparam Policy Synchronizer policy.
+ * @tparam T Variadic templates for message types.
+ */
+template<typename Policy, typename... T>
+class BasicSynchronizerRecorder
+{
+public:
+  using stamp_t = typename Policy::stamp_t;
+
+  template<std::size_t k>
+  using message_t = std::tuple_element_t<k, std::tuple<T...>>;
+
+  BasicSynchronizerRecorder(const BasicSynchronizerRecorder &) = delete;
+  BasicSynchronizerRecorder(BasicSynchronizerRecorder &&)      = delete;
+  BasicSynchronizerRecorder & operator=(const BasicSynchronizerRecorder &) = delete;
+  BasicSynchronizerRecorder & operator=(BasicSynchronizerRecorder &&) = delete;
+  ~BasicSynchronizerRecorder()                                        = default;
+
+  /**
+   * @brief Create a new recording.
+   *
+   * @param path Path of the recording file, truncated if it exists.
+   * @param grow_size Number of bytes by which the file is grown when full (default: 16MB).
+   */
+  explicit BasicSynchronizerRecorder(
+    const std::string & path, const std::size_t grow_size = 1UL << 24)
+      : m_file(path, grow_size)
+  {
+    detail::SyncRecFileHeader header{};
+    std::memcpy(header.magic, detail::sync_rec_magic, sizeof(header.magic));
+    header.n_streams  = static_cast<uint32_t>(sizeof...(T));
+    header.stamp_type = stamp_traits_t::type;
+    header.size       = sizeof(header);
+    m_file.write(&header, sizeof(header));
+  }
+
+  /**
+   * @brief Append a message to the recording, it is replayed with add_and_search<k>().
+   *
+   * @tparam k Index of the stream.
+   * @param el Message.
+   * @param stamp Timestamp of the message.
+   */
+  template<std::size_t k>
+  void record(const message_t<k> & el, const stamp_t stamp)
+  {
+    std::scoped_lock lock(m_mtx);
+    record_impl<k>(el, stamp, detail::SyncRecOp::add_and_search);
+  }
+
+  /**
+   * @brief Record a message, then call sync.add<k>().
+   *
+   * @tparam k Index of the stream.
+   * @param sync Synchronizer to add the message to.
+   * @param el Message.
+   */
+  template<std::size_t k, typename Sync, typename S>
+  void add(Sync & sync, S && el)
+  {
+    check_sync<Sync>();
+    {
+      std::scoped_lock lock(m_mtx);
+      record_impl<k>(el, sync.template get_time<k>(el), detail::SyncRecOp::add);
+    }
+    sync.template add<k>(std::forward<S>(el));
+  }
+
+  /**
+   * @brief Record a message, then call sync.add_and_search<k>().
+   *
+   * @tparam k Index of the stream.
+   * @param sync Synchronizer to add the message to.
+   * @param el Message.
+   */
+  template<std::size_t k, typename Sync, typename S>
+  void add_and_search(Sync & sync, S && el)
+  {
+    check_sync<Sync>();
+    {
+      std::scoped_lock lock(m_mtx);
+      record_impl<k>(el, sync.template get_time<k>(el), detail::SyncRecOp::add_and_search);
+    }
+    sync.template add_and_search<k>(std::forward<S>(el));
+  }
+
+  /**
+   * @brief Ask the kernel to start writing the recording to disk.
+   */
+  void flush()
+  {
+    std::scoped_lock lock(m_mtx);
+    m_file.flush();
+  }
+
+  /**
+   * @brief Close the recording file.
+   * @details Recording more messages afterwards throws.
+   */
+  void close()
+  {
+    std::scoped_lock lock(m_mtx);
+    m_file.close();
+  }
+
+  /**
+   * @brief Number of recorded messages.
+   */
+  std::size_t count() const
+  {
+    std::scoped_lock lock(m_mtx);
+    return m_count;
+  }
+
+  /**
+   * @brief Size of the recording in bytes.
+   */
+  std::size_t size() const
+  {
+    std::scoped_lock lock(m_mtx);
+    return m_file.size();
+  }
+
+protected:
+  /// @cond
+  using stamp_traits_t = detail::SyncRecStampTraits<stamp_t>;
+
+  template<typename Sync>
+  static constexpr void check_sync()
+  {
+    static_assert(std::is_same_v<typename Sync::stamp_t, stamp_t>,
+      "Recorder and synchronizer stamp types differ, use the policy of the synchronizer.");
+  }
+
+  template<std::size_t k, typename S>
+  void record_impl(const S & el, const stamp_t stamp, const detail::SyncRecOp op)
+  {
+    const auto & msg = static_cast<const message_t<k> &>(el);
+    const auto n     = serialized_size(msg);
+    if (n > std::numeric_limits<uint32_t>::max()) {
+      throw std::length_error("SynchronizerRecorder message too large.");
+    }
+
+    detail::SyncRecRecordHeader header{};
+    header.stream = static_cast<uint32_t>(k);
+    header.size   = static_cast<uint32_t>(n);
+    header.op     = op;
+    stamp_traits_t::store(header, stamp);
+
+    auto * dst = m_file.reserve(sizeof(header) + n);
+    std::memcpy(dst, &header, sizeof(header));
+    serialize(msg, dst + sizeof(header));
+    m_file.commit(sizeof(header) + n);
+    ++m_count;
+
+    // publish the record
+    const uint64_t size = m_file.size();
+    std::memcpy(m_file.data() + offsetof(detail::SyncRecFileHeader, size), &size, sizeof(size));
+  }
+
+  MappedFileWriter m_file;
+  std::size_t m_count = 0;
+  mutable std::mutex m_mtx;
+  /// @endcond
+};
+
+/**
+ * @brief Feed a recording made with SynchronizerRecorder back into a Synchronizer.
+ * @details The recording is memory-mapped, and the messages are deserialized and added to the
+ * synchronizer in the recorded order, as fast as possible. The synchronizer thus sees the exact
+ * same sequence of add<k>() and add_and_search<k>() calls as during recording.
+ *
+ * Example:
+ * ```
+ * Synchronizer<Camera, Lidar> sync;
+ * // set time functions and callbacks...
+ *
+ * SynchronizerReplayer<Camera, Lidar> replayer("sync.rec");
+ * replayer.replay(sync);
+ * ```
+ *
+ * @tparam Policy Synchronizer policy, same as for the recording.
+ * @tparam T Variadic templates for message types, same as for the recording.
+ */
+template<typename Policy, typename... T>
+class BasicSynchronizerReplayer
+{
+public:
+  using stamp_t = typename Policy::stamp_t;
+
+  template<std::size_t k>
+  using message_t = std::tuple_element_t<k, std::tuple<T...>>;
+
+  /**
+   * @brief Open a recording.
+   * @details Throws if the file is not a recording of sizeof...(T) streams with stamps of the
+   * same type.
+   *
+   * @param path Path of the recording file.
+   */
+  explicit BasicSynchronizerReplayer(const std::string & path) : m_file(path)
+  {
+    detail::SyncRecFileHeader header{};
+    if (m_file.size() < sizeof(header)) {
+      throw std::runtime_error("Invalid synchronizer recording " + path);
+    }
+    std::memcpy(&header, m_file.data(), sizeof(header));
+    if (std::memcmp(header.magic, detail::sync_rec_magic, sizeof(header.magic)) != 0) {
+      throw std::runtime_error("Invalid synchronizer recording " + path);
+    }
+    if (header.n_streams != sizeof...(T)) {
+      throw std::runtime_error("Synchronizer recording " + path + " has wrong number of streams");
+    }
+    if (header.stamp_type != detail::SyncRecStampTraits<stamp_t>::type) {
+      throw std::runtime_error("Synchronizer recording " + path + " has wrong stamp type");
+    }
+    if (header.size < sizeof(header) || header.size > m_file.size()) {
+      throw std::runtime_error("Invalid synchronizer recording " + path);
+    }
+    // data past the size in the header was not completely written
+    m_size = static_cast<std::size_t>(header.size);
+  }
+
+  /**
+   * @brief Call a function on every recorded message.
+   *
+   * @param f Function called as f(std::integral_constant<std::size_t, k>, stamp_t stamp,
+   * message_t<k> && msg) for every recorded message, in the recorded order.
+   * @return Number of messages.
+   */
+  template<typename F>
+  std::size_t for_each(F && f) const
+  {
+    return for_each_impl([&f](auto k, const detail::SyncRecRecordHeader & header, auto && msg) {
+      f(k, detail::SyncRecStampTraits<stamp_t>::load(header), std::move(msg));
+    });
+  }
+
+  /**
+   * @brief Add all recorded messages to a synchronizer.
+   * @details Each message is added with add<k>() or add_and_search<k>(), as it was recorded.
+   *
+   * @param sync Synchronizer to feed.
+   * @return Number of messages.
+   */
+  template<typename Sync>
+  std::size_t replay(Sync & sync) const
+  {
+    return for_each_impl([&sync](auto k, const detail::SyncRecRecordHeader & header, auto && msg) {
+      if (header.op == detail::SyncRecOp::add) {
+        sync.template add<decltype(k)::value>(std::move(msg));
+      } else {
+        sync.template add_and_search<decltype(k)::value>(std::move(msg));
+      }
+    });
+  }
+
+protected:
+  /// @cond
+  template<typename F>
+  std::size_t for_each_impl(F && f) const
+  {
+    std::size_t n         = 0;
+    const std::byte * src = m_file.data() + sizeof(detail::SyncRecFileHeader);
+    const std::byte * end = m_file.data() + m_size;
+
+    while (src != end) {
+      detail::SyncRecRecordHeader header{};
+      if (static_cast<std::size_t>(end - src) < sizeof(header)) {
+        throw std::runtime_error("Truncated synchronizer recording.");
+      }
+      std::memcpy(&header, src, sizeof(header));
+      src += sizeof(header);
+      if (static_cast<std::size_t>(end - src) < header.size) {
+        throw std::runtime_error("Truncated synchronizer recording.");
+      }
+      if (header.stream >= sizeof...(T)) {
+        throw std::runtime_error("Invalid stream index in synchronizer recording.");
+      }
+
+      dispatch(f, header, src, std::index_sequence_for<T...>{});
+      src += header.size;
+      ++n;
+    }
+    return n;
+  }
+
+  template<typename F, std::size_t... I>
+  static void dispatch(F & f,
+    const detail::SyncRecRecordHeader & header,
+    const std::byte * src,
+    std::index_sequence<I...>)
+  {
+    ((header.stream == I ? (f(std::integral_constant<std::size_t, I>{},
+                              header,
+                              deserialize<message_t<I>>(src, header.size)),
+                            true)
+                         : false)
+      || ...);
+  }
+
+  MappedFileReader m_file;
+  std::size_t m_size = 0;
+  /// @endcond
+};
+
+/**
+ * @brief Recorder for synchronizers with the default policy.
+ *
+ * @tparam T Variadic templates for message types.
+ */
+template<typename... T>
+using SynchronizerRecorder = BasicSynchronizerRecorder<SynchronizerPolicy, T...>;
+
+/**
+ * @brief Replayer for synchronizers with the default policy.
+ *
+ * @tparam T Variadic templates for message types.
+ */
+template<typename... T>
+using SynchronizerReplayer = BasicSynchronizerReplayer<SynchronizerPolicy, T...>;
+
+}  // namespace cbr
+
+#endif  // CBR_UTILS__SYNCHRONIZER_RECORDER_HPP_
@@ -25,6 +25,8 @@
 #define CBR_UTILS__THREAD_POOL_HPP_
 
 #include <condition_variable>
+#include <cstddef>
+#include <deque>
 #include <functional>
 #include <future>
 #include <memory>
@@ -32,25 +34,40 @@
 #include <queue>
 #include <stdexcept>
 #include <thread>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
+#include "function.hpp"
+
 namespace cbr {
 
 /**
  * @brief Thread pool.
  * @details Pool with a fixed number of workers that can be used to dispatch work.
+ *
+ * The allocator is used for the task queue and the shared state of the tasks, e.g. a PmrAdaptor
+ * over a std::pmr::synchronized_pool_resource avoids heap allocations in enqueue() once the pool
+ * is warm. It is called concurrently by the workers and by enqueue().
+ *
+ * Tasks are stored as std::function<void()> by default. With a move-only Task such as
+ * inplace_function<void(), 32>, the std::packaged_task of enqueue() is moved into the queue
+ * directly and post() never allocates, but tasks must fit in its buffer.
+ *
+ * @tparam Alloc Allocator, rebound to the stored types.
+ * @tparam Task Type of the queued tasks, a callable wrapper of signature void().
  */
-class ThreadPool
+template<typename Alloc = std::allocator<std::byte>, typename Task = std::function<void()>>
+class BasicThreadPool
 {
 public:
   // Constructors
-  ThreadPool()                   = default;
-  ThreadPool(const ThreadPool &) = delete;
-  ThreadPool(ThreadPool &&)      = delete;
-  ThreadPool & operator=(const ThreadPool &) = delete;
-  ThreadPool & operator=(ThreadPool &&) = delete;
-  ~ThreadPool()
+  BasicThreadPool()                        = default;
+  BasicThreadPool(const BasicThreadPool &) = delete;
+  BasicThreadPool(BasicThreadPool &&)      = delete;
+  BasicThreadPool & operator=(const BasicThreadPool &) = delete;
+  BasicThreadPool & operator=(BasicThreadPool &&) = delete;
+  ~BasicThreadPool()
   {
     {
       std::scoped_lock lock(m_mtx);
@@ -61,16 +78,18 @@ public:
   }
 
   /**
-   * @brief Construct a new ThreadPool with a given number of workers.
+   * @brief Construct a new BasicThreadPool with a given number of workers.
    *
    * @param n_workers Number of workers in the thread pool.
+   * @param alloc Allocator of the tasks.
    */
-  explicit ThreadPool(const std::size_t n_workers) : m_stop(false)
+  explicit BasicThreadPool(const std::size_t n_workers, const Alloc & alloc = Alloc())
+      : m_alloc(alloc), m_tasks(task_queue_t(alloc)), m_stop(false)
   {
     for (std::size_t i = 0; i < n_workers; ++i) {
       m_workers.emplace_back([this] {
         while (true) {
-          std::function<void()> task;
+          task_t task;
           {
             std::unique_lock lock(this->m_mtx);
             this->m_cv.wait(lock, [this] { return this->m_stop || !this->m_tasks.empty(); });
@@ -100,28 +119,69 @@ public:
   {
     using return_type = typename std::result_of<F(Args...)>::type;
 
-    auto task = std::make_shared<std::packaged_task<return_type()>>(
-      std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+    if constexpr (std::is_copy_constructible_v<task_t>) {
+      auto task = std::allocate_shared<std::packaged_task<return_type()>>(
+        m_alloc, std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+
+      std::future<return_type> res = task->get_future();
+      push("enqueue on stopped ThreadPool", [task]() { (*task)(); });
+      return res;
+    } else {
+      std::packaged_task<return_type()> task(
+        std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+
+      std::future<return_type> res = task.get_future();
+      push("enqueue on stopped ThreadPool", [task = std::move(task)]() mutable { task(); });
+      return res;
+    }
+  }
+
+  /**
+   * @brief Enqueue a task without a future.
+   * @details Cheaper than enqueue() since there is no shared state to allocate, but nothing
+   * reports the completion of the task, and an exception escaping it terminates the program.
+   *
+   * @tparam F Type of the task, move-only callables are wrapped in a shared_ptr when Task is
+   * copyable.
+   * @param f Task callable object.
+   */
+  template<class F>
+  void post(F && f)
+  {
+    using fcn_t = std::decay_t<F>;
+    if constexpr (std::is_copy_constructible_v<task_t> && !std::is_copy_constructible_v<fcn_t>) {
+      auto task = std::allocate_shared<fcn_t>(m_alloc, std::forward<F>(f));
+      push("post on stopped ThreadPool", [task]() { (*task)(); });
+    } else {
+      push("post on stopped ThreadPool", std::forward<F>(f));
+    }
+  }
 
-    std::future<return_type> res = task->get_future();
+private:
+  /// @cond
+  template<class F>
+  void push(const char * error, F && f)
+  {
     {
       std::scoped_lock lock(m_mtx);
 
       // don't allow enqueueing after stopping the pool
-      if (m_stop) { throw std::runtime_error("enqueue on stopped ThreadPool"); }
+      if (m_stop) { throw std::runtime_error(error); }
 
-      m_tasks.emplace([task]() { (*task)(); });
+      m_tasks.emplace(std::forward<F>(f));
     }
     m_cv.notify_one();
-    return res;
   }
 
-private:
-  /// @cond
+  using task_t       = Task;
+  using task_alloc_t = typename std::allocator_traits<Alloc>::template rebind_alloc<task_t>;
+  using task_queue_t = std::deque<task_t, task_alloc_t>;
+
+  Alloc m_alloc{};
   // need to keep track of threads so we can join them
   std::vector<std::thread> m_workers;
   // the task queue
-  std::queue<std::function<void()>> m_tasks;
+  std::queue<task_t, task_queue_t> m_tasks;
 
   // synchronization
   std::mutex m_mtx;
@@ -130,6 +190,15 @@ private:
   /// @endcond
 };
 
+/**
+ * @brief Thread pool using the default allocator.
+ */
+class ThreadPool : public BasicThreadPool<>
+{
+public:
+  using BasicThreadPool::BasicThreadPool;
+};
+
 }  // namespace cbr
 
 #endif  // CBR_UTILS__THREAD_POOL_HPP_
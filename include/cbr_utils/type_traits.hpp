@@ -8,6 +8,7 @@
 #define CBR_UTILS__TYPE_TRAITS_HPP_
 
 #include <chrono>
+#include <cstddef>
 #include <map>
 #include <memory>
 #include <optional>
@@ -139,6 +140,50 @@ struct is_std_vector<std::vector<T, Ts...>> : std::true_type
 template<typename T>
 inline constexpr bool is_std_vector_v = is_std_vector<T>::value;
 
+// static_vector and small_vector
+/// @cond
+template<typename T, std::size_t N>
+class static_vector;
+
+template<typename T, std::size_t N>
+class small_vector;
+
+template<typename>
+struct is_static_vector : std::false_type
+{};
+
+template<typename T, std::size_t N>
+struct is_static_vector<static_vector<T, N>> : std::true_type
+{};
+
+template<typename>
+struct is_small_vector : std::false_type
+{};
+
+template<typename T, std::size_t N>
+struct is_small_vector<small_vector<T, N>> : std::true_type
+{};
+/// @endcond
+
+/**
+ * @brief Check if type is a cbr::static_vector.
+ */
+template<typename T>
+inline constexpr bool is_static_vector_v = is_static_vector<T>::value;
+
+/**
+ * @brief Check if type is a cbr::small_vector.
+ */
+template<typename T>
+inline constexpr bool is_small_vector_v = is_small_vector<T>::value;
+
+/**
+ * @brief Check if type is an std::vector, a cbr::static_vector or a cbr::small_vector.
+ */
+template<typename T>
+inline constexpr bool is_vector_like_v =
+  is_std_vector_v<T> || is_static_vector_v<T> || is_small_vector_v<T>;
+
 // std::array
 /// @cond
 template<typename, bool = false>
@@ -305,6 +305,20 @@ struct signature<R (Cls::*)(Args...) const>
   using argument_type = cbr::TypePack<Args...>;
 };
 
+template<typename R, typename Cls, typename... Args>
+struct signature<R (Cls::*)(Args...) noexcept>
+{
+  using return_type   = R;
+  using argument_type = cbr::TypePack<Args...>;
+};
+
+template<typename R, typename Cls, typename... Args>
+struct signature<R (Cls::*)(Args...) const noexcept>
+{
+  using return_type   = R;
+  using argument_type = cbr::TypePack<Args...>;
+};
+
 /// @endcond
 
 // is_sorted implementationm
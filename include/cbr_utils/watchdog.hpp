@@ -0,0 +1,362 @@
+// Copyright Yamaha 2021
+// MIT License
+// https://github.com/yamaha-bps/cbr_utils/blob/master/LICENSE
+
+/** @file */
+
+#ifndef CBR_UTILS__WATCHDOG_HPP_
+#define CBR_UTILS__WATCHDOG_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace cbr {
+
+/**
+ * @brief Description of a missed deadline.
+ */
+struct WatchdogEvent
+{
+  const std::string & name;          ///< Name of the heartbeat
+  std::chrono::nanoseconds timeout;  ///< Timeout of the heartbeat
+  std::chrono::nanoseconds overdue;  ///< Time elapsed since the deadline
+  const char * context;              ///< Context passed to the latest beat, or nullptr
+};
+
+class Watchdog;
+
+/**
+ * @brief Heartbeat of a loop or task monitored by a Watchdog.
+ * @details Created by Watchdog::add(). The monitored code calls beat() at least once per timeout,
+ * which is a single relaxed atomic store of the current time.
+ */
+class WatchdogHeartbeat
+{
+public:
+  using Callback = std::function<void(const WatchdogEvent &)>;
+
+  WatchdogHeartbeat(const WatchdogHeartbeat &) = delete;
+  WatchdogHeartbeat(WatchdogHeartbeat &&)      = delete;
+  WatchdogHeartbeat & operator=(const WatchdogHeartbeat &) = delete;
+  WatchdogHeartbeat & operator=(WatchdogHeartbeat &&) = delete;
+  ~WatchdogHeartbeat()                                = default;
+
+  /**
+   * @brief Signal that the monitored code is alive, and arm the heartbeat if it was disarmed.
+   *
+   * @param context Optional static string describing where the code is, e.g. __func__. Reported
+   * on expiry, the pointer must stay valid.
+   */
+  void beat(const char * context = nullptr) noexcept
+  {
+    if (context != nullptr) { m_context.store(context, std::memory_order_relaxed); }
+    m_last.store(now_ns(), std::memory_order_release);
+  }
+
+  /**
+   * @brief Stop monitoring until the next beat(), e.g. while a loop is intentionally paused.
+   */
+  void disarm() noexcept { m_last.store(disarmed, std::memory_order_release); }
+
+  /**
+   * @brief Check if the heartbeat is armed.
+   */
+  bool is_armed() const noexcept { return m_last.load(std::memory_order_relaxed) != disarmed; }
+
+  /**
+   * @brief Name of the heartbeat.
+   */
+  const std::string & name() const noexcept { return m_name; }
+
+  /**
+   * @brief Timeout of the heartbeat.
+   */
+  std::chrono::nanoseconds timeout() const noexcept { return std::chrono::nanoseconds(m_timeout); }
+
+  /**
+   * @brief Number of times the deadline was missed.
+   */
+  std::size_t expired_count() const noexcept { return m_expired.load(std::memory_order_relaxed); }
+
+  /// @cond
+  WatchdogHeartbeat(std::string name, const std::chrono::nanoseconds timeout, Callback cb)
+      : m_name(std::move(name)), m_timeout(std::max<int64_t>(1, timeout.count())),
+        m_callback(std::move(cb))
+  {}
+  /// @endcond
+
+protected:
+  /// @cond
+  friend class Watchdog;
+
+  static constexpr int64_t disarmed = -1;
+
+  static int64_t now_ns() noexcept
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+  }
+
+  // written by monitored code
+  alignas(64) std::atomic<int64_t> m_last{now_ns()};
+  std::atomic<const char *> m_context{nullptr};
+
+  // written by the monitor thread
+  alignas(64) std::atomic<std::size_t> m_expired{0};
+  std::atomic<bool> m_removed{false};
+  int64_t m_fired_for = disarmed;  // beat time for which the callback was last fired
+  std::size_t m_rounds = 0;        // remaining wheel turns before the entry is due
+
+  const std::string m_name;
+  const int64_t m_timeout;
+  const Callback m_callback;
+  /// @endcond
+};
+
+/**
+ * @brief RAII arming of a heartbeat for the duration of a task.
+ * @details Beats on construction and disarms on destruction, so that a task running on a
+ * ThreadPool is only monitored while it runs.
+ *
+ * Example:
+ * ```
+ * pool.enqueue([hb] {
+ *   WatchdogScope scope(*hb, "process");
+ *   process();  // reported if it takes longer than the timeout of hb
+ * });
+ * ```
+ */
+class WatchdogScope
+{
+public:
+  WatchdogScope(const WatchdogScope &) = delete;
+  WatchdogScope(WatchdogScope &&)      = delete;
+  WatchdogScope & operator=(const WatchdogScope &) = delete;
+  WatchdogScope & operator=(WatchdogScope &&) = delete;
+
+  /**
+   * @brief Arm the heartbeat.
+   *
+   * @param hb Heartbeat.
+   * @param context Optional static context string, see WatchdogHeartbeat::beat().
+   */
+  explicit WatchdogScope(WatchdogHeartbeat & hb, const char * context = nullptr) noexcept
+      : m_hb(hb)
+  {
+    m_hb.beat(context);
+  }
+
+  ~WatchdogScope() { m_hb.disarm(); }
+
+protected:
+  /// @cond
+  WatchdogHeartbeat & m_hb;
+  /// @endcond
+};
+
+/**
+ * @brief Deadline watchdog for loops and tasks.
+ * @details A single monitor thread checks the deadlines of all registered heartbeats. Heartbeats
+ * are stored in a hashed timing wheel indexed by deadline, so that each tick only looks at the
+ * heartbeats that may have expired. When a heartbeat misses its deadline its callback is called
+ * once, on the monitor thread, with the name, the overdue time and the context of the latest
+ * beat. The callback is called again if the heartbeat resumes and misses a later deadline.
+ *
+ * Example:
+ * ```
+ * Watchdog watchdog;
+ * auto hb = watchdog.add("control", 50ms, [](const WatchdogEvent & e) {
+ *   std::cerr << e.name << " stalled in " << (e.context ? e.context : "?") << std::endl;
+ * });
+ *
+ * LoopTimer timer(10ms);
+ * while (true) {
+ *   timer.wait();
+ *   hb->beat();
+ *   control();
+ * }
+ * ```
+ * Notes:
+ * - Deadlines are detected with a delay of at most one resolution.
+ * - Callbacks must be short, they delay the detection of other deadlines. Exceptions thrown by
+ *   callbacks are swallowed.
+ */
+class Watchdog
+{
+public:
+  using Callback = WatchdogHeartbeat::Callback;
+
+  Watchdog(const Watchdog &) = delete;
+  Watchdog(Watchdog &&)      = delete;
+  Watchdog & operator=(const Watchdog &) = delete;
+  Watchdog & operator=(Watchdog &&) = delete;
+
+  /**
+   * @brief Start the monitor thread.
+   *
+   * @param resolution Tick period of the monitor thread (default: 1ms).
+   * @param wheel_size Number of slots of the timing wheel (default: 256).
+   */
+  explicit Watchdog(const std::chrono::nanoseconds resolution = std::chrono::milliseconds(1),
+    const std::size_t wheel_size                              = 256)
+      : m_resolution(std::max<int64_t>(1, resolution.count())),
+        m_wheel(std::max<std::size_t>(1, wheel_size))
+  {
+    m_thread = std::thread([this] { run(); });
+  }
+
+  ~Watchdog()
+  {
+    {
+      std::scoped_lock lock(m_mtx);
+      m_stop = true;
+    }
+    m_cv.notify_all();
+    m_thread.join();
+  }
+
+  /**
+   * @brief Register a heartbeat.
+   * @details The heartbeat is armed, i.e. it must beat within timeout from now.
+   *
+   * @param name Name of the monitored loop or task.
+   * @param timeout Maximal time between two beats.
+   * @param cb Callback called on the monitor thread when the deadline is missed.
+   * @return Heartbeat handle.
+   */
+  std::shared_ptr<WatchdogHeartbeat> add(
+    std::string name, const std::chrono::nanoseconds timeout, Callback cb = {})
+  {
+    auto hb = std::make_shared<WatchdogHeartbeat>(std::move(name), timeout, std::move(cb));
+    std::scoped_lock lock(m_mtx);
+    m_pending.push_back(hb);
+    return hb;
+  }
+
+  /**
+   * @brief Stop monitoring a heartbeat.
+   *
+   * @param hb Heartbeat returned by add().
+   */
+  void remove(const std::shared_ptr<WatchdogHeartbeat> & hb) noexcept
+  {
+    if (hb) { hb->m_removed.store(true, std::memory_order_relaxed); }
+  }
+
+  /**
+   * @brief Total number of missed deadlines.
+   */
+  std::size_t expired_count() const noexcept { return m_expired.load(std::memory_order_relaxed); }
+
+protected:
+  /// @cond
+  using entry_t = std::shared_ptr<WatchdogHeartbeat>;
+
+  void run()
+  {
+    auto next_tick = std::chrono::steady_clock::now();
+    std::vector<entry_t> due;
+    while (true) {
+      {
+        std::unique_lock lock(m_mtx);
+        if (m_cv.wait_until(lock, next_tick, [this] { return m_stop; })) { return; }
+        for (auto & hb : m_pending) { schedule(std::move(hb), WatchdogHeartbeat::now_ns()); }
+        m_pending.clear();
+      }
+
+      const int64_t now = WatchdogHeartbeat::now_ns();
+      std::swap(due, m_wheel[m_cursor]);
+      for (auto & hb : due) {
+        if (hb->m_rounds > 0) {
+          --hb->m_rounds;
+          m_wheel[m_cursor].push_back(std::move(hb));
+        } else {
+          check(std::move(hb), now);
+        }
+      }
+      due.clear();
+
+      m_cursor = (m_cursor + 1) % m_wheel.size();
+      next_tick += std::chrono::nanoseconds(m_resolution);
+    }
+  }
+
+  void check(entry_t && hb, const int64_t now)
+  {
+    if (hb->m_removed.load(std::memory_order_relaxed)) { return; }
+
+    const int64_t last = hb->m_last.load(std::memory_order_acquire);
+    if (last == WatchdogHeartbeat::disarmed) {
+      schedule_at(std::move(hb), now + hb->m_timeout, now);
+      return;
+    }
+
+    const int64_t deadline = last + hb->m_timeout;
+    if (now < deadline) {
+      schedule_at(std::move(hb), deadline, now);
+      return;
+    }
+
+    if (hb->m_fired_for != last) {
+      hb->m_fired_for = last;
+      hb->m_expired.fetch_add(1, std::memory_order_relaxed);
+      m_expired.fetch_add(1, std::memory_order_relaxed);
+      if (hb->m_callback) {
+        try {
+          hb->m_callback(WatchdogEvent{hb->m_name,
+            std::chrono::nanoseconds(hb->m_timeout),
+            std::chrono::nanoseconds(now - deadline),
+            hb->m_context.load(std::memory_order_relaxed)});
+        } catch (...) {}
+      }
+    }
+    // poll for the next beat
+    schedule_at(std::move(hb), now + hb->m_timeout, now);
+  }
+
+  void schedule(entry_t && hb, const int64_t now)
+  {
+    const int64_t last = hb->m_last.load(std::memory_order_relaxed);
+    const int64_t base = last == WatchdogHeartbeat::disarmed ? now : last;
+    schedule_at(std::move(hb), base + hb->m_timeout, now);
+  }
+
+  // insert in the slot of the first tick at or after deadline
+  void schedule_at(entry_t && hb, const int64_t deadline, const int64_t now)
+  {
+    const int64_t ticks =
+      std::max<int64_t>(1, (deadline - now + m_resolution - 1) / m_resolution);
+    const auto d  = static_cast<std::size_t>(ticks);
+    hb->m_rounds  = (d - 1) / m_wheel.size();
+    const auto sl = (m_cursor + d) % m_wheel.size();
+    m_wheel[sl].push_back(std::move(hb));
+  }
+
+  const int64_t m_resolution;
+  std::vector<std::vector<entry_t>> m_wheel;
+  std::size_t m_cursor = 0;
+
+  std::atomic<std::size_t> m_expired{0};
+
+  std::mutex m_mtx;
+  std::condition_variable m_cv;
+  std::vector<entry_t> m_pending{};
+  bool m_stop = false;
+  std::thread m_thread;
+  /// @endcond
+};
+
+}  // namespace cbr
+
+#endif  // CBR_UTILS__WATCHDOG_HPP_
@@ -32,6 +32,7 @@ namespace YAML {
  * - Scoped enums
  * - std::tuple
  * - std::optional
+ * - cbr::static_vector and cbr::small_vector
  */
 template<typename T>
 struct convert
@@ -60,6 +61,10 @@ struct convert
     } else if constexpr (::cbr::is_std_optional_v<T>) {  // NOLINT
       if (val.has_value()) { return Node(val.value()); }
       return Node();
+    } else if constexpr (::cbr::is_static_vector_v<T> || ::cbr::is_small_vector_v<T>) {  // NOLINT
+      Node yaml(NodeType::Sequence);
+      for (const auto & x : val) { yaml.push_back(x); }
+      return yaml;
     } else {
       static_assert(::cbr::false_v<T>, "Unsupported type for YAML encoding.");
     }
@@ -117,6 +122,16 @@ struct convert
       } catch (const std::exception & e) {
         return false;
       }
+      return true;
+    } else if constexpr (::cbr::is_static_vector_v<T> || ::cbr::is_small_vector_v<T>) {  // NOLINT
+      if (!yaml.IsSequence()) { return false; }
+      if constexpr (::cbr::is_static_vector_v<T>) {
+        if (yaml.size() > T::max_size()) { return false; }
+      }
+
+      val.clear();
+      for (const auto & x : yaml) { val.push_back(x.template as<typename T::value_type>()); }
+
       return true;
     } else {
       static_assert(::cbr::false_v<T>, "Unsupported type for YAML decoding.");
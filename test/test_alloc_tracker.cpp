@@ -0,0 +1,119 @@
+// Copyright Yamaha 2021
+// MIT License
+// https://github.com/yamaha-bps/cbr_utils/blob/master/LICENSE
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <new>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cbr_utils/alloc_tracker.hpp"
+#include "cbr_utils/synchronizer.hpp"
+
+CBR_UTILS_INSTALL_ALLOC_TRACKER();
+
+using cbr::AllocStats;
+
+TEST(AllocTracker, Installed) { ASSERT_TRUE(cbr::alloc_tracker_installed()); }
+
+TEST(AllocTracker, Basic)
+{
+  cbr::AllocTracker tracker;
+  ASSERT_FALSE(tracker.is_running());
+
+  tracker.tic();
+  ASSERT_TRUE(tracker.is_running());
+  auto p = std::make_unique<int64_t>(1);
+  ASSERT_EQ(tracker.tac().count, 1LU);
+  std::vector<char> v(1000);
+  p.reset();
+  const auto stats = tracker.toc();
+  ASSERT_FALSE(tracker.is_running());
+
+  ASSERT_EQ(stats.count, 2LU);
+  ASSERT_EQ(stats.bytes, sizeof(int64_t) + 1000);
+  ASSERT_EQ(stats.frees, 1LU);
+
+  // stopped tracker returns latest values
+  auto q = std::make_unique<int64_t>(1);
+  ASSERT_EQ(tracker.toc().count, 2LU);
+  ASSERT_EQ(tracker.get_latest().count, 2LU);
+
+  struct alignas(64) Aligned
+  {
+    char c[64];
+  };
+  ASSERT_EQ(cbr::count_allocations([] { std::make_unique<Aligned>(); }).count, 1LU);
+}
+
+TEST(AllocTracker, Scope)
+{
+  AllocStats stats;
+  {
+    cbr::AllocScope scope(stats);
+    std::string s(100, 'a');
+  }
+  ASSERT_EQ(stats.count, 1LU);
+  ASSERT_EQ(stats.frees, 1LU);
+
+  // counters are per thread
+  const auto other = cbr::count_allocations([] {
+    std::thread t([] { std::vector<int> v(100); });
+    t.join();
+  });
+  // the thread state may be counted, but not the vector allocated by the thread
+  ASSERT_LT(other.bytes, 100 * sizeof(int));
+}
+
+namespace {
+int handler_calls = 0;
+}
+
+TEST(AllocTracker, NewHandler)
+{
+  // the handler is called until it gives up by uninstalling itself
+  std::set_new_handler([] {
+    if (++handler_calls == 2) { std::set_new_handler(nullptr); }
+  });
+  volatile std::size_t huge = SIZE_MAX / 2;
+  void * p = nullptr;
+  ASSERT_THROW(p = ::operator new(huge), std::bad_alloc);
+  ASSERT_EQ(p, nullptr);
+  ASSERT_EQ(handler_calls, 2);
+
+  handler_calls = 0;
+  std::set_new_handler([] {
+    ++handler_calls;
+    throw std::bad_alloc();
+  });
+  ASSERT_EQ(::operator new(huge, std::nothrow), nullptr);
+  ASSERT_EQ(handler_calls, 1);
+  std::set_new_handler(nullptr);
+}
+
+TEST(AllocTracker, SynchronizerSearch)
+{
+  cbr::Synchronizer<int64_t, int64_t> sync;
+  sync.set_time_fcn<0>([](const int64_t & i) { return i; });
+  sync.set_time_fcn<1>([](const int64_t & i) { return i; });
+
+  int64_t sum = 0;
+  sync.register_callback([&sum](int64_t && i0, int64_t && i1) { sum += i0 + i1; });
+
+  for (int64_t i = 0; i < 100; i++) {
+    sync.add<0>(2 * i);
+    sync.add<1>(2 * i + 1);
+  }
+
+  ASSERT_NO_THROW(cbr::expect_no_allocations([&sync] {
+    while (sync.search()) {}
+  }));
+  ASSERT_GT(sum, 0);
+
+  ASSERT_THROW(
+    cbr::expect_no_allocations([] { std::make_unique<int64_t>(1); }), std::runtime_error);
+}
@@ -0,0 +1,316 @@
+// Copyright Yamaha 2021
+// MIT License
+// https://github.com/yamaha-bps/cbr_utils/blob/master/LICENSE
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <list>
+#include <memory_resource>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "cbr_utils/allocators.hpp"
+#include "cbr_utils/synchronizer.hpp"
+#include "cbr_utils/thread_pool.hpp"
+
+namespace {
+
+struct Throwing
+{
+  explicit Throwing(bool t)
+  {
+    if (t) { throw std::runtime_error("throwing"); }
+  }
+};
+
+// Forwards to the new/delete resource and counts the allocations
+class CountingResource : public std::pmr::memory_resource
+{
+public:
+  std::atomic<std::size_t> count{0};
+
+protected:
+  void * do_allocate(std::size_t bytes, std::size_t alignment) override
+  {
+    ++count;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+
+  void do_deallocate(void * p, std::size_t bytes, std::size_t alignment) override
+  {
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource & other) const noexcept override
+  {
+    return this == &other;
+  }
+};
+
+}  // namespace
+
+TEST(ObjectPool, Basic)
+{
+  ASSERT_THROW(cbr::ObjectPool<int>(0), std::invalid_argument);
+
+  cbr::ObjectPool<std::string> pool(3);
+  ASSERT_EQ(pool.capacity(), 3LU);
+
+  std::string * a = pool.create(3, 'a');
+  std::string * b = pool.create("b");
+  auto c          = pool.make_unique("c");
+  ASSERT_NE(a, nullptr);
+  ASSERT_NE(b, nullptr);
+  ASSERT_TRUE(c);
+  ASSERT_EQ(*a, "aaa");
+  ASSERT_EQ(*c, "c");
+  ASSERT_TRUE(pool.owns(a));
+  ASSERT_TRUE(pool.owns(c.get()));
+
+  std::string s;
+  ASSERT_FALSE(pool.owns(&s));
+
+  // exhausted
+  ASSERT_EQ(pool.allocate(), nullptr);
+  ASSERT_FALSE(pool.make_unique("d"));
+
+  // slots are reused
+  pool.destroy(b);
+  std::string * d = pool.create("d");
+  ASSERT_EQ(d, b);
+  c.reset();
+  ASSERT_TRUE(pool.make_unique("e"));
+
+  pool.destroy(a);
+  pool.destroy(d);
+
+  // storage is returned if the constructor throws
+  cbr::ObjectPool<Throwing> tpool(1);
+  ASSERT_THROW(tpool.create(true), std::runtime_error);
+  ASSERT_NE(tpool.create(false), nullptr);
+  ASSERT_EQ(tpool.create(false), nullptr);
+}
+
+TEST(ObjectPool, Threads)
+{
+  static constexpr std::size_t n_threads = 4;
+  static constexpr int n                 = 20000;
+
+  cbr::ObjectPool<int64_t> pool(8);
+
+  std::vector<std::thread> threads;
+  std::atomic<bool> ok{true};
+  for (std::size_t t = 0; t < n_threads; ++t) {
+    threads.emplace_back([&pool, &ok, t] {
+      for (int i = 0; i < n; ++i) {
+        const int64_t v = static_cast<int64_t>(t) * n + i;
+        int64_t * p     = pool.create(v);
+        if (p == nullptr) {
+          std::this_thread::yield();
+          continue;
+        }
+        std::this_thread::yield();
+        if (*p != v) { ok = false; }  // slot handed out twice
+        pool.destroy(p);
+      }
+    });
+  }
+  for (auto & th : threads) { th.join(); }
+  ASSERT_TRUE(ok);
+
+  // all slots are free
+  std::vector<int64_t *> ptrs;
+  for (std::size_t i = 0; i < pool.capacity(); ++i) { ptrs.push_back(pool.allocate()); }
+  for (auto p : ptrs) { ASSERT_NE(p, nullptr); }
+  ASSERT_EQ(pool.allocate(), nullptr);
+}
+
+TEST(MonotonicArena, Basic)
+{
+  cbr::MonotonicArena arena(256);
+  ASSERT_EQ(arena.capacity(), 256LU);
+
+  void * p1 = arena.allocate(3, 1);
+  void * p2 = arena.allocate(8, 8);
+  ASSERT_EQ(reinterpret_cast<std::uintptr_t>(p2) % 8, 0LU);
+  ASSERT_EQ(static_cast<std::byte *>(p2) - static_cast<std::byte *>(p1), 8);
+  ASSERT_EQ(arena.used(), 16LU);
+
+  const auto mark = arena.mark();
+  void * p3       = arena.allocate(64, 64);
+  ASSERT_EQ(reinterpret_cast<std::uintptr_t>(p3) % 64, 0LU);
+  arena.deallocate(p3, 64, 64);  // no-op
+  ASSERT_GT(arena.used(), mark);
+
+  arena.rewind(mark);
+  ASSERT_EQ(arena.used(), 16LU);
+  ASSERT_THROW(arena.rewind(100), std::invalid_argument);
+
+  ASSERT_THROW(static_cast<void>(arena.allocate(300, 1)), std::bad_alloc);
+  arena.reset();
+  ASSERT_EQ(arena.used(), 0LU);
+  ASSERT_EQ(arena.allocate(256, 1), p1);
+
+  // external buffer
+  alignas(16) std::byte buffer[64];
+  cbr::MonotonicArena ext(buffer, sizeof(buffer));
+  std::pmr::vector<int32_t> v(&ext);
+  v.reserve(16);
+  ASSERT_EQ(static_cast<void *>(v.data()), static_cast<void *>(buffer));
+  ASSERT_THROW(v.reserve(17), std::bad_alloc);
+}
+
+TEST(PmrAdaptor, Basic)
+{
+  CountingResource res;
+
+  std::vector<int, cbr::PmrAdaptor<int>> v(&res);
+  v.resize(10);
+  ASSERT_EQ(res.count, 1LU);
+
+  // the resource propagates on copy, unlike std::pmr::polymorphic_allocator
+  std::vector<int, cbr::PmrAdaptor<int>> w;
+  w = v;
+  ASSERT_EQ(w.get_allocator().resource(), &res);
+  ASSERT_EQ(res.count, 2LU);
+
+  const cbr::PmrAdaptor<double> d(v.get_allocator());
+  ASSERT_TRUE(d == v.get_allocator());
+  ASSERT_TRUE(d != cbr::PmrAdaptor<double>());
+  ASSERT_EQ(cbr::PmrAdaptor<int>().resource(), std::pmr::get_default_resource());
+}
+
+TEST(PmrAdaptor, Synchronizer)
+{
+  using msg_t    = std::pair<int64_t, int>;
+  using policy_t = cbr::SynchronizerAllocPolicy<cbr::PmrAdaptor<std::byte>>;
+
+  CountingResource res;
+  auto prev = std::pmr::set_default_resource(&res);
+  {
+    cbr::BasicSynchronizer<policy_t, msg_t, msg_t> sync(5);
+    sync.set_time_fcn<0>([](const msg_t & m) { return m.first; });
+    sync.set_time_fcn<1>([](const msg_t & m) { return m.first; });
+
+    std::vector<std::pair<int, int>> out;
+    sync.register_callback(
+      [&out](msg_t && m0, msg_t && m1) { out.emplace_back(m0.second, m1.second); });
+
+    sync.add_and_search<0>(msg_t{10, 0});
+    sync.add_and_search<1>(msg_t{11, 1});
+    sync.add_and_search<0>(msg_t{30, 2});
+    sync.add_and_search<1>(msg_t{30, 3});
+
+    ASSERT_EQ(out.size(), 2LU);
+    ASSERT_EQ(out[1], std::make_pair(2, 3));
+    ASSERT_GT(res.count, 0LU);  // queues allocate through the resource
+  }
+  std::pmr::set_default_resource(prev);
+
+  // allocator given to the constructor
+  CountingResource res2;
+  {
+    cbr::BasicSynchronizer<policy_t, msg_t, msg_t> sync(5, &res2);
+    sync.set_time_fcn<0>([](const msg_t & m) { return m.first; });
+    sync.set_time_fcn<1>([](const msg_t & m) { return m.first; });
+    const std::size_t before = res.count;
+    sync.add_and_search<0>(msg_t{10, 0});
+    sync.add_and_search<1>(msg_t{11, 1});
+    ASSERT_GT(res2.count, 0LU);
+    ASSERT_EQ(res.count, before);
+  }
+}
+
+TEST(PmrAdaptor, ThreadPool)
+{
+  CountingResource upstream;
+  std::pmr::synchronized_pool_resource res(&upstream);
+
+  std::vector<std::future<int>> futures;
+  {
+    cbr::BasicThreadPool<cbr::PmrAdaptor<std::byte>> pool(2, &res);
+    for (int i = 0; i < 100; ++i) {
+      futures.push_back(pool.enqueue([](int x) { return 2 * x; }, i));
+    }
+    for (int i = 0; i < 100; ++i) { ASSERT_EQ(futures[i].get(), 2 * i); }
+  }
+  ASSERT_GT(upstream.count, 0LU);
+}
+
+TEST(AlignedAllocator, Basic)
+{
+  std::vector<float, cbr::aligned_allocator<float>> v;
+  for (int i = 0; i < 100; ++i) {
+    v.push_back(static_cast<float>(i));
+    ASSERT_EQ(reinterpret_cast<std::uintptr_t>(v.data()) % 64, 0LU);
+  }
+
+  std::vector<char, cbr::aligned_allocator<char, 4096>> page(10);
+  ASSERT_EQ(reinterpret_cast<std::uintptr_t>(page.data()) % 4096, 0LU);
+
+  // rebind to node types, values are at the same offset in aligned nodes
+  std::list<int, cbr::aligned_allocator<int, 128>> l{1, 2, 3};
+  const auto offset = reinterpret_cast<std::uintptr_t>(&l.front()) % 128;
+  for (const auto & x : l) { ASSERT_EQ(reinterpret_cast<std::uintptr_t>(&x) % 128, offset); }
+
+  static_assert(cbr::aligned_allocator<double, 1>::alignment == alignof(double));
+  ASSERT_TRUE(cbr::aligned_allocator<int>{} == cbr::aligned_allocator<float>{});
+}
+
+TEST(HugePageBuffer, Basic)
+{
+  cbr::huge_page_buffer empty;
+  ASSERT_EQ(empty.data(), nullptr);
+  ASSERT_EQ(empty.size(), 0LU);
+
+  constexpr std::size_t hp = cbr::huge_page_buffer::huge_page_size;
+  cbr::huge_page_buffer buf(hp + 1);
+  ASSERT_EQ(buf.size(), 2 * hp);
+  ASSERT_EQ(reinterpret_cast<std::uintptr_t>(buf.data()) % hp, 0LU);
+  ASSERT_EQ(buf.data()[0], std::byte{0});
+
+  buf.data()[42] = std::byte{7};
+  buf.prefault();  // preserves content
+  ASSERT_EQ(buf.data()[42], std::byte{7});
+  ASSERT_EQ(buf.data()[buf.size() - 1], std::byte{0});
+
+  const bool huge = buf.huge();
+  auto moved      = std::move(buf);
+  ASSERT_EQ(buf.data(), nullptr);  // NOLINT
+  ASSERT_EQ(moved.size(), 2 * hp);
+  ASSERT_EQ(moved.huge(), huge);
+  ASSERT_EQ(moved.data()[42], std::byte{7});
+
+  // arena over the buffer
+  cbr::MonotonicArena arena(moved.data(), moved.size());
+  std::pmr::vector<double> v(hp / sizeof(double), &arena);
+  ASSERT_EQ(static_cast<void *>(v.data()), static_cast<void *>(moved.data()));
+
+  moved = cbr::huge_page_buffer(1);
+  ASSERT_EQ(moved.size(), hp);
+}
+
+TEST(HugePageBuffer, Lock)
+{
+  cbr::huge_page_buffer buf(1);
+  try {
+    buf.lock();
+  } catch (const std::system_error & e) {
+    GTEST_SKIP() << "mlock not permitted: " << e.what();
+  }
+  cbr::unlock_memory(buf.data(), buf.size());
+
+  // prefault of unaligned heap memory
+  std::vector<std::byte> v(3 * cbr::page_size() + 5, std::byte{3});
+  cbr::prefault(v.data() + 1, v.size() - 1);
+  ASSERT_EQ(v.back(), std::byte{3});
+}
@@ -0,0 +1,202 @@
+// Copyright Yamaha 2021
+// MIT License
+// https://github.com/yamaha-bps/cbr_utils/blob/master/LICENSE
+
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <ostream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "cbr_utils/async_file_writer.hpp"
+
+namespace {
+
+std::string tmp_path(const std::string & name)
+{
+  return "/tmp/cbr_utils_test_" + std::to_string(getpid()) + "_" + name;
+}
+
+std::vector<char> read_file(const std::string & path)
+{
+  std::ifstream f(path, std::ios::binary);
+  return std::vector<char>(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+}
+
+std::vector<char> pattern(const std::size_t n, const std::size_t seed)
+{
+  std::vector<char> v(n);
+  for (std::size_t i = 0; i < n; ++i) { v[i] = static_cast<char>((i * 31 + seed) % 251); }
+  return v;
+}
+
+void write_and_check(const std::string & name, const cbr::AsyncFileWriterOptions & opts)
+{
+  const auto path = tmp_path(name);
+  std::vector<char> expected;
+  {
+    cbr::AsyncFileWriter file(path, opts);
+    // sizes below, equal to and above the buffer size
+    for (std::size_t i = 0; i < 200; ++i) {
+      const auto chunk = pattern((i * 997) % 20000 + 1, i);
+      file.write(chunk.data(), chunk.size());
+      expected.insert(expected.end(), chunk.begin(), chunk.end());
+      if (i % 50 == 0) {
+        file.flush();
+        // O_DIRECT pads the file to whole blocks until close()
+        const std::size_t block = opts.direct ? 4096 : 1;
+        ASSERT_EQ(read_file(path).size(), (expected.size() + block - 1) / block * block);
+      }
+    }
+    ASSERT_EQ(file.size(), expected.size());
+  }
+  ASSERT_EQ(read_file(path), expected);
+  std::remove(path.c_str());
+}
+
+// writes fail beyond limit bytes, after a short write
+void write_with_size_limit(const std::string & name, const cbr::AsyncFileWriterOptions & opts)
+{
+  constexpr std::size_t limit = 10000;
+  const auto path             = tmp_path(name);
+
+  rlimit old{};
+  getrlimit(RLIMIT_FSIZE, &old);
+  rlimit lim   = old;
+  lim.rlim_cur = limit;
+  const auto handler = std::signal(SIGXFSZ, SIG_IGN);
+  setrlimit(RLIMIT_FSIZE, &lim);
+  {
+    cbr::AsyncFileWriter file(path, opts);
+    const auto data = pattern(3 * 4096, 0);
+    EXPECT_THROW(
+      {
+        for (int i = 0; i < 10; ++i) { file.write(data.data(), data.size()); }
+        file.flush();
+      },
+      std::system_error);
+    EXPECT_THROW(file.close(), std::system_error);
+  }  // does not wait for writes that were never submitted
+  setrlimit(RLIMIT_FSIZE, &old);
+  std::signal(SIGXFSZ, handler);
+
+  // the short write was completed up to the limit
+  auto expected = pattern(3 * 4096, 0);
+  expected.resize(limit);
+  ASSERT_EQ(read_file(path), expected);
+  std::remove(path.c_str());
+}
+
+bool direct_supported()
+{
+  const auto path = tmp_path("direct_probe");
+  const int fd    = ::open(path.c_str(), O_WRONLY | O_CREAT | O_DIRECT, 0644);
+  if (fd >= 0) { ::close(fd); }
+  std::remove(path.c_str());
+  return fd >= 0;
+}
+
+}  // namespace
+
+TEST(AsyncFileWriter, IoUring)
+{
+  cbr::AsyncFileWriterOptions opts;
+  opts.buffer_size = 8192;
+  opts.n_buffers   = 3;
+  write_and_check("uring", opts);
+}
+
+TEST(AsyncFileWriter, Thread)
+{
+  cbr::AsyncFileWriterOptions opts;
+  opts.buffer_size = 8192;
+  opts.n_buffers   = 3;
+  opts.io_uring    = false;
+  {
+    cbr::AsyncFileWriter file(tmp_path("thread_check"), opts);
+    ASSERT_FALSE(file.uses_io_uring());
+  }
+  std::remove(tmp_path("thread_check").c_str());
+  write_and_check("thread", opts);
+}
+
+TEST(AsyncFileWriter, Direct)
+{
+  if (!direct_supported()) { GTEST_SKIP() << "O_DIRECT not supported by /tmp"; }
+  cbr::AsyncFileWriterOptions opts;
+  opts.buffer_size = 8192;
+  opts.n_buffers   = 3;
+  opts.direct      = true;
+  write_and_check("direct", opts);
+  opts.io_uring = false;
+  write_and_check("direct_thread", opts);
+}
+
+TEST(AsyncFileWriter, TryWrite)
+{
+  const auto path = tmp_path("try");
+  cbr::AsyncFileWriterOptions opts;
+  opts.buffer_size = 4096;
+  opts.n_buffers   = 2;
+  cbr::AsyncFileWriter file(path, opts);
+
+  // larger than all buffers
+  const auto big = pattern(3 * 4096, 0);
+  ASSERT_FALSE(file.try_write(big.data(), big.size()));
+  ASSERT_EQ(file.size(), 0LU);
+
+  std::size_t written = 0;
+  const auto small    = pattern(1000, 1);
+  for (int i = 0; i < 100; ++i) {
+    if (file.try_write(small.data(), small.size())) { written += small.size(); }
+  }
+  ASSERT_GT(written, 0LU);
+  file.close();
+  ASSERT_FALSE(file.is_open());
+  ASSERT_EQ(read_file(path).size(), written);
+  ASSERT_THROW(file.write(small.data(), small.size()), std::logic_error);
+  std::remove(path.c_str());
+}
+
+TEST(AsyncFileWriter, Streambuf)
+{
+  const auto path = tmp_path("stream");
+  {
+    cbr::AsyncFileWriter file(path);
+    cbr::AsyncFileStreambuf buf(file);
+    std::ostream os(&buf);
+    os << "hello " << 42 << std::endl;
+    ASSERT_EQ(read_file(path).size(), 9LU);  // std::endl flushes
+    os << 'x';
+  }
+  const auto data = read_file(path);
+  ASSERT_EQ(std::string(data.begin(), data.end()), "hello 42\nx");
+  std::remove(path.c_str());
+}
+
+TEST(AsyncFileWriter, WriteError)
+{
+  cbr::AsyncFileWriterOptions opts;
+  opts.buffer_size = 8192;
+  opts.n_buffers   = 2;
+  write_with_size_limit("error_uring", opts);
+  opts.io_uring = false;
+  write_with_size_limit("error_thread", opts);
+}
+
+TEST(AsyncFileWriter, Invalid)
+{
+  ASSERT_THROW(cbr::AsyncFileWriter("/nonexistent/file.bin"), std::system_error);
+  cbr::AsyncFileWriterOptions opts;
+  opts.n_buffers = 0;
+  ASSERT_THROW(cbr::AsyncFileWriter(tmp_path("invalid"), opts), std::invalid_argument);
+}
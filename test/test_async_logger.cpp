@@ -0,0 +1,220 @@
+// Copyright Yamaha 2021
+// MIT License
+// https://github.com/yamaha-bps/cbr_utils/blob/master/LICENSE
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cbr_utils/async_logger.hpp"
+#include "cbr_utils/utils.hpp"
+
+using namespace std::chrono_literals;
+
+namespace {
+
+struct Mode : cbr::CyberEnum<Mode>
+{
+  using this_t::CyberEnum;
+  using this_t::operator=;
+
+  static constexpr int idle = 0;
+  static constexpr int run  = 1;
+
+  static constexpr std::array values = {0, 1};
+  static constexpr std::array names  = {"idle", "run"};
+};
+
+enum class Color : uint8_t { red = 3 };
+
+struct Point
+{
+  int x;
+  int y;
+};
+
+struct Opaque
+{
+  int x;
+};
+
+std::ostream & operator<<(std::ostream & os, const Point & p)
+{
+  return os << '(' << p.x << ", " << p.y << ')';
+}
+
+std::vector<std::string> lines(const std::string & s)
+{
+  std::vector<std::string> res;
+  std::istringstream ss(s);
+  for (std::string l; std::getline(ss, l);) { res.push_back(l); }
+  return res;
+}
+
+// message without the date
+std::string message(const std::string & line) { return line.substr(line.find(' ') + 1); }
+
+}  // namespace
+
+TEST(AsyncLogger, Format)
+{
+  std::ostringstream os;
+  {
+    cbr::AsyncLogger logger(os);
+
+    std::string s = "hello";
+    ASSERT_TRUE(logger.info("{} {}", s, "world"));
+    s = "modified";
+
+    logger.warn("int {} double {} bool {} char {}", -12, 0.5, true, 'c');
+    logger.error("mode {} color {}", Mode(Mode::run), Color::red);
+    logger.debug("durations {} {} {} {} {}", 12ns, 3us, 4ms, 2s, 90s);
+    logger.info("point {} opaque {}", Point{1, 2}, Opaque{3});
+    logger.info("missing {} {}", 1);
+    logger.info("extra", 1, 2);
+    logger.info("no args");
+    logger.flush();
+
+    const auto l = lines(os.str());
+    ASSERT_EQ(l.size(), 8LU);
+    ASSERT_EQ(message(l[0]), "[info] hello world");
+    ASSERT_EQ(message(l[1]), "[warn] int -12 double 0.5 bool true char c");
+    ASSERT_EQ(message(l[2]), "[error] mode run color 3");
+    ASSERT_EQ(message(l[3]), "[debug] durations 12ns 3us 4ms 2s 1.5min");
+    ASSERT_NE(message(l[4]).find("point (1, 2) opaque <"), std::string::npos);
+    ASSERT_NE(message(l[4]).find("Opaque"), std::string::npos);
+    ASSERT_EQ(message(l[5]), "[info] missing 1 {}");
+    ASSERT_EQ(message(l[6]), "[info] extra 1 2");
+    ASSERT_EQ(message(l[7]), "[info] no args");
+
+    // date: YYYY-mm-dd_HH-MM-SS.nnnnnnnnn
+    const auto date = l[0].substr(0, l[0].find(' '));
+    ASSERT_EQ(date.size(), 29LU);
+    ASSERT_EQ(date[10], '_');
+    ASSERT_EQ(date[19], '.');
+
+    // timestamps are converted to system time
+    const auto dt = std::chrono::system_clock::now() - cbr::fromDateStr(date);
+    ASSERT_GE(dt, 0s);
+    ASSERT_LT(dt, 10s);
+  }
+}
+
+TEST(AsyncLogger, FormatId)
+{
+  // identical formats share an ID whether or not the literals are merged
+  static constexpr char fmt1[] = "value {}";
+  static constexpr char fmt2[] = "value {}";
+  ASSERT_NE(static_cast<const char *>(fmt1), static_cast<const char *>(fmt2));
+
+  const auto decode_int    = &cbr::detail::log_decode<int>;
+  const auto decode_double = &cbr::detail::log_decode<double>;
+  const auto id1           = cbr::detail::LogFormatCache::get(fmt1, decode_int);
+  ASSERT_EQ(cbr::detail::LogFormatCache::get(fmt2, decode_int), id1);
+  ASSERT_NE(cbr::detail::LogFormatCache::get(fmt1, decode_double), id1);
+
+  std::ostringstream os;
+  {
+    cbr::AsyncLogger logger(os);
+    logger.info(fmt1, 1);
+    logger.info(fmt2, 2);
+    logger.info(fmt1, 0.5);
+  }
+  const auto l = lines(os.str());
+  ASSERT_EQ(l.size(), 3LU);
+  ASSERT_EQ(message(l[0]), "[info] value 1");
+  ASSERT_EQ(message(l[1]), "[info] value 2");
+  ASSERT_EQ(message(l[2]), "[info] value 0.5");
+}
+
+TEST(AsyncLogger, Level)
+{
+  std::ostringstream os;
+  cbr::AsyncLogger logger(os);
+
+  ASSERT_EQ(logger.get_level(), cbr::LogLevel::debug);
+  logger.set_level(cbr::LogLevel::warn);
+  ASSERT_FALSE(logger.debug("debug"));
+  ASSERT_FALSE(logger.info("info"));
+  ASSERT_TRUE(logger.warn("warn"));
+  ASSERT_TRUE(logger.log(cbr::LogLevel::error, "error"));
+  logger.flush();
+
+  const auto l = lines(os.str());
+  ASSERT_EQ(l.size(), 2LU);
+  ASSERT_EQ(message(l[0]), "[warn] warn");
+  ASSERT_EQ(message(l[1]), "[error] error");
+}
+
+TEST(AsyncLogger, Threads)
+{
+  std::ostringstream os;
+  {
+    cbr::AsyncLogger logger(os);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+      threads.emplace_back([&logger, t] {
+        for (int i = 0; i < 100; ++i) {
+          while (!logger.info("thread {} message {}", t, i)) { std::this_thread::yield(); }
+        }
+      });
+    }
+    for (auto & th : threads) { th.join(); }
+  }
+
+  // all messages written at destruction, in order for each thread
+  const auto l = lines(os.str());
+  ASSERT_EQ(l.size(), 400LU);
+  std::vector<int> next(4, 0);
+  for (const auto & line : l) {
+    int t = 0;
+    int i = 0;
+    ASSERT_EQ(std::sscanf(message(line).c_str(), "[info] thread %d message %d", &t, &i), 2);
+    ASSERT_EQ(next[static_cast<std::size_t>(t)]++, i);
+  }
+}
+
+TEST(AsyncLogger, Dropped)
+{
+  std::ostringstream os;
+  cbr::AsyncLogger::Options opts;
+  opts.ring_size = 256;
+  opts.period    = 10s;
+  cbr::AsyncLogger logger(os, opts);
+
+  std::size_t logged = 0;
+  for (int i = 0; i < 100; ++i) { logged += logger.info("message {}", i) ? 1 : 0; }
+  ASSERT_LT(logged, 100LU);
+  ASSERT_EQ(logger.dropped_count(), 100 - logged);
+
+  // too large for the ring
+  const std::string large(1000, 'x');
+  logger.flush();
+  ASSERT_FALSE(logger.info("{}", large));
+
+  // space is available again after draining
+  ASSERT_TRUE(logger.info("message"));
+  logger.flush();
+  ASSERT_EQ(lines(os.str()).size(), logged + 1);
+}
+
+TEST(AsyncLogger, ThreadExit)
+{
+  std::ostringstream os;
+  cbr::AsyncLogger logger(os);
+
+  for (int i = 0; i < 10; ++i) {
+    std::thread([&logger, i] { logger.info("thread {}", i); }).join();
+  }
+  logger.flush();
+  ASSERT_EQ(lines(os.str()).size(), 10LU);
+}
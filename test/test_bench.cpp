@@ -0,0 +1,92 @@
+// Copyright Yamaha 2021
+// MIT License
+// https://github.com/yamaha-bps/cbr_utils/blob/master/LICENSE
+
+#include <gtest/gtest.h>
+
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "cbr_utils/bench.hpp"
+
+using namespace cbr;
+
+TEST(Bench, Run)
+{
+  bench::Options opts;
+  opts.warmup_time = 0.001;
+  opts.sample_time = 0.001;
+  opts.samples     = 5;
+
+  std::vector<int> v(1000, 1);
+  std::size_t n_calls = 0;
+
+  const auto res = bench::run(
+    "accumulate",
+    [&v, &n_calls] {
+      auto sum = std::accumulate(v.begin(), v.end(), 0);
+      bench::do_not_optimize(sum);
+      ++n_calls;
+    },
+    opts);
+
+  ASSERT_EQ(res.name, "accumulate");
+  ASSERT_EQ(res.samples, 5LU);
+  ASSERT_GE(res.iterations, 1LU);
+  ASSERT_GE(n_calls, res.iterations * res.samples);
+  ASSERT_GT(res.median, 0.);
+  ASSERT_GE(res.mad, 0.);
+  ASSERT_LE(res.min, res.median);
+  ASSERT_GE(res.max, res.median);
+  ASSERT_GE(res.overhead, 0.);
+}
+
+TEST(Bench, Suite)
+{
+  bench::Options opts;
+  opts.warmup_time    = 0.;
+  opts.sample_time    = 0.;
+  opts.samples        = 3;
+  opts.max_iterations = 10;
+
+  bench::Suite suite(opts);
+  suite.run("empty", [] { bench::clobber_memory(); });
+  suite.run("quoted \"name\"", [] {
+    int x = 1;
+    bench::do_not_optimize(x);
+  });
+
+  ASSERT_EQ(suite.results().size(), 2LU);
+  ASSERT_EQ(suite.results()[0].iterations, 1LU);
+
+  std::stringstream csv, json, txt;
+  suite.write_csv(csv);
+  suite.write_json(json);
+  suite.print(txt);
+
+  std::string line;
+  std::getline(csv, line);
+  ASSERT_EQ(line.rfind("name,iterations,samples,median_ns", 0), 0LU);
+  std::getline(csv, line);
+  ASSERT_EQ(line.rfind("\"empty\",1,3,", 0), 0LU);
+  std::getline(csv, line);
+  ASSERT_EQ(line.rfind("\"quoted \"\"name\"\"\",", 0), 0LU);
+
+  ASSERT_NE(json.str().find("{\"name\": \"quoted \\\"name\\\"\", \"iterations\": 1"),
+    std::string::npos);
+  ASSERT_EQ(json.str().front(), '[');
+
+  // output selected by the command line
+  const char * argv_csv[]  = {"bench", "--csv"};
+  const char * argv_json[] = {"bench", "--json"};
+  const char * argv_none[] = {"bench"};
+  std::stringstream csv2, json2, txt2;
+  ASSERT_EQ(suite.run_main(2, argv_csv, csv2), 0);
+  ASSERT_EQ(suite.run_main(2, argv_json, json2), 0);
+  ASSERT_EQ(suite.run_main(1, argv_none, txt2), 0);
+  ASSERT_EQ(csv2.str().rfind("name,iterations", 0), 0LU);
+  ASSERT_EQ(json2.str(), json.str());
+  ASSERT_EQ(txt2.str(), txt.str());
+}
@@ -0,0 +1,221 @@
+// Copyright Yamaha 2021
+// MIT License
+// https://github.com/yamaha-bps/cbr_utils/blob/master/LICENSE
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "cbr_utils/bus.hpp"
+#include "cbr_utils/thread_pool.hpp"
+
+namespace {
+
+struct Image
+{
+  explicit Image(int i) : id(i) {}
+  Image(const Image &) = delete;  // fan-out must not copy
+  Image(Image &&)      = default;
+  Image & operator=(const Image &) = delete;
+  Image & operator=(Image &&) = default;
+  ~Image()                    = default;
+
+  int id;
+};
+
+struct Imu
+{
+  double acc;
+};
+
+// executor failing on demand, tasks are run by run()
+struct ManualExecutor
+{
+  void post(cbr::bus_task_t && task)
+  {
+    if (fail) { throw std::runtime_error("post failed"); }
+    tasks.push_back(std::move(task));
+  }
+
+  void run()
+  {
+    while (!tasks.empty()) {
+      auto task = std::move(tasks.front());
+      tasks.erase(tasks.begin());
+      task();
+    }
+  }
+
+  bool fail{false};
+  std::vector<cbr::bus_task_t> tasks;
+};
+
+}  // namespace
+
+TEST(Bus, TopicId)
+{
+  static_assert(cbr::topic_id<Image>() == cbr::topic_id<Image>());
+  static_assert(cbr::topic_id<Image>() != cbr::topic_id<Imu>());
+  static_assert(cbr::topic_id<int>() != cbr::topic_id<double>());
+}
+
+TEST(Bus, Inline)
+{
+  cbr::Bus bus;
+  ASSERT_EQ(bus.emplace<Image>(0), 0LU);  // not constructed
+
+  std::vector<int> ids;
+  const Image * addr1 = nullptr;
+  const Image * addr2 = nullptr;
+  auto s1 = bus.subscribe<Image>([&](const Image & img) {
+    ids.push_back(img.id);
+    addr1 = &img;
+  });
+  auto s2 = bus.subscribe<Image>([&](const std::shared_ptr<const Image> & img) {
+    addr2 = img.get();
+  });
+  ASSERT_EQ(bus.subscriber_count<Image>(), 2LU);
+  ASSERT_EQ(bus.subscriber_count<Imu>(), 0LU);
+
+  ASSERT_EQ(bus.publish(Image(1)), 2LU);
+  ASSERT_EQ(bus.emplace<Image>(2), 2LU);
+  ASSERT_EQ(bus.publish(std::make_shared<const Image>(3)), 2LU);
+  ASSERT_EQ(bus.publish(std::make_shared<Image>(4)), 2LU);
+  ASSERT_EQ(bus.publish(Imu{1.}), 0LU);
+  ASSERT_EQ(ids, (std::vector<int>{1, 2, 3, 4}));
+  ASSERT_EQ(addr1, addr2);  // same message
+
+  s1.unsubscribe();
+  ASSERT_FALSE(s1.subscribed());
+  ASSERT_EQ(bus.subscriber_count<Image>(), 1LU);
+  bus.emplace<Image>(5);
+  ASSERT_EQ(ids.size(), 4LU);
+
+  {
+    auto s3 = std::move(s2);
+    ASSERT_FALSE(s2.subscribed());
+    ASSERT_EQ(bus.subscriber_count<Image>(), 1LU);
+  }
+  ASSERT_EQ(bus.subscriber_count<Image>(), 0LU);
+}
+
+TEST(Bus, Mailbox)
+{
+  cbr::Bus bus;
+  auto box = bus.mailbox<Imu>(2);
+  ASSERT_EQ(box.try_pop(), nullptr);
+
+  bus.publish(Imu{1.});
+  bus.publish(Imu{2.});
+  bus.publish(Imu{3.});
+  ASSERT_EQ(box.size(), 2LU);
+  ASSERT_EQ(box.dropped(), 1LU);  // oldest dropped
+  ASSERT_EQ(box.try_pop()->acc, 2.);
+  ASSERT_EQ(box.try_pop()->acc, 3.);
+  ASSERT_EQ(box.pop(std::chrono::milliseconds(1)), nullptr);
+
+  std::thread t([&bus] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    bus.publish(Imu{4.});
+  });
+  const auto msg = box.pop(std::chrono::seconds(5));
+  t.join();
+  ASSERT_NE(msg, nullptr);
+  ASSERT_EQ(msg->acc, 4.);
+
+  ASSERT_THROW(static_cast<void>(bus.mailbox<Imu>(0)), std::invalid_argument);
+}
+
+TEST(Bus, ThreadPool)
+{
+  cbr::Bus bus;
+  cbr::ThreadPool pool(4);
+
+  constexpr int n = 10000;
+  std::atomic<int> concurrent{0};
+  std::atomic<bool> overlap{false};
+  std::vector<int> ids;
+  std::atomic<int> count{0};
+
+  auto sub = bus.subscribe<Image>(
+    pool,
+    [&](const Image & img) {
+      // a subscriber is never called concurrently and in publication order
+      if (concurrent.fetch_add(1) != 0) { overlap = true; }
+      ids.push_back(img.id);
+      concurrent.fetch_sub(1);
+      ++count;
+    },
+    n);
+
+  std::atomic<int> count2{0};
+  auto sub2 = bus.subscribe<Image>(pool, [&](const Image &) { ++count2; }, n);
+
+  for (int i = 0; i < n; ++i) { bus.emplace<Image>(i); }
+
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while ((count < n || count2 < n) && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  ASSERT_EQ(count, n);
+  ASSERT_EQ(count2, n);
+  ASSERT_FALSE(overlap);
+  ASSERT_EQ(sub.dropped(), 0LU);
+  for (int i = 0; i < n; ++i) { ASSERT_EQ(ids[static_cast<std::size_t>(i)], i); }
+}
+
+TEST(Bus, PostFailure)
+{
+  cbr::Bus bus;
+  ManualExecutor ex;
+  std::vector<double> res;
+  auto sub = bus.subscribe<Imu>(ex, [&res](const Imu & imu) { res.push_back(imu.acc); }, 4);
+
+  ex.fail = true;
+  ASSERT_THROW(bus.publish(Imu{1.}), std::runtime_error);
+  ASSERT_TRUE(ex.tasks.empty());
+
+  // the failed post does not prevent the next one
+  ex.fail = false;
+  bus.publish(Imu{2.});
+  ASSERT_EQ(ex.tasks.size(), 1LU);
+  ex.run();
+  ASSERT_EQ(res, (std::vector<double>{1., 2.}));
+}
+
+TEST(Bus, Threads)
+{
+  // concurrent publishers and subscription changes
+  cbr::Bus bus;
+  std::atomic<int> count{0};
+  auto sub = bus.subscribe<Imu>([&count](const Imu &) { ++count; });
+
+  std::atomic<bool> stop{false};
+  std::thread churn([&] {
+    while (!stop) {
+      auto tmp = bus.subscribe<Imu>([](const Imu &) {});
+      auto box = bus.mailbox<Imu>(1);
+    }
+  });
+
+  std::vector<std::thread> publishers;
+  for (int t = 0; t < 3; ++t) {
+    publishers.emplace_back([&bus] {
+      for (int i = 0; i < 10000; ++i) { bus.publish(Imu{static_cast<double>(i)}); }
+    });
+  }
+  for (auto & p : publishers) { p.join(); }
+  stop = true;
+  churn.join();
+
+  ASSERT_EQ(count, 30000);
+  ASSERT_EQ(bus.subscriber_count<Imu>(), 1LU);
+}
@@ -0,0 +1,179 @@
+// Copyright Yamaha 2021
+// MIT License
+// https://github.com/yamaha-bps/cbr_utils/blob/master/LICENSE
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <boost/hana/adapt_struct.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cbr_utils/chunked_recorder.hpp"
+
+namespace {
+
+struct Msg
+{
+  BOOST_HANA_DEFINE_STRUCT(Msg, (int64_t, t), (std::vector<double>, data));
+};
+
+std::string tmp_prefix(const std::string & name)
+{
+  return "/tmp/cbr_utils_test_" + std::to_string(getpid()) + "_" + name;
+}
+
+void remove_files(const std::vector<std::string> & files)
+{
+  for (const auto & f : files) { std::remove(f.c_str()); }
+}
+
+}  // namespace
+
+TEST(ChunkedRecorder, RecordSeek)
+{
+  std::vector<std::string> files;
+  {
+    // small chunks to have many of them
+    cbr::ChunkedRecorderOptions opts;
+    opts.chunk_size = 4096;
+    cbr::ChunkedRecorder recorder(tmp_prefix("seek"), opts);
+    for (int64_t i = 0; i < 1000; ++i) {
+      recorder.record(0, 10 * i, Msg{i, std::vector<double>(static_cast<std::size_t>(i % 7), 1.)});
+      if (i % 10 == 0) { recorder.record(1, 10 * i + 5, static_cast<int>(i)); }
+    }
+    // larger than a chunk
+    recorder.record(2, 20000, std::vector<double>(2000, 2.));
+    ASSERT_EQ(recorder.count(), 1101LU);
+    files = recorder.files();
+  }
+  ASSERT_EQ(files.size(), 1LU);
+
+  cbr::ChunkedReader reader(files[0]);
+  ASSERT_EQ(reader.size(), 1101LU);
+  ASSERT_GT(reader.chunk_count(), 10LU);
+
+  // iteration in time order
+  int64_t prev = -1;
+  std::size_t n = 0;
+  for (const auto & rec : reader) {
+    ASSERT_GT(rec.stamp, prev);
+    prev = rec.stamp;
+    if (rec.channel == 0) {
+      const auto msg = rec.get<Msg>();
+      ASSERT_EQ(10 * msg.t, rec.stamp);
+      ASSERT_EQ(msg.data.size(), static_cast<std::size_t>(msg.t % 7));
+    } else if (rec.channel == 1) {
+      ASSERT_EQ(10 * rec.get<int>() + 5, rec.stamp);
+    } else {
+      ASSERT_EQ(rec.get<std::vector<double>>().size(), 2000LU);
+    }
+    ++n;
+  }
+  ASSERT_EQ(n, 1101LU);
+
+  // seek
+  auto it = reader.seek(5000);
+  ASSERT_EQ(it->stamp, 5000);
+  ASSERT_EQ(it->channel, 0LU);
+  ++it;
+  ASSERT_EQ(it->stamp, 5005);
+  ASSERT_EQ(reader.seek(5001)->stamp, 5005);
+  ASSERT_EQ(reader.seek(5006)->stamp, 5010);
+  ASSERT_EQ(reader.seek(-100)->stamp, 0);
+  ASSERT_EQ(reader.seek(19999)->stamp, 20000);
+  ASSERT_EQ(reader.seek(20001), reader.end());
+
+  remove_files(files);
+}
+
+TEST(ChunkedRecorder, Rotation)
+{
+  std::vector<std::string> files;
+  {
+    cbr::ChunkedRecorderOptions opts;
+    opts.chunk_size    = 4096;
+    opts.max_file_size = 3 * 4096;
+    cbr::ChunkedRecorder recorder(tmp_prefix("rotate"), opts);
+    for (int i = 0; i < 2000; ++i) { recorder.record(0, i, i); }
+    recorder.rotate();
+    recorder.record(0, 2000, 2000);
+    files = recorder.files();
+  }
+  ASSERT_GT(files.size(), 2LU);
+
+  // files are unique, and records are all there in order
+  std::size_t n = 0;
+  for (const auto & f : files) {
+    ASSERT_EQ(std::count(files.begin(), files.end(), f), 1);
+    cbr::ChunkedReader reader(f);
+    for (const auto & rec : reader) {
+      ASSERT_EQ(rec.stamp, static_cast<int64_t>(n));
+      ASSERT_EQ(rec.get<int>(), static_cast<int>(n));
+      ++n;
+    }
+  }
+  ASSERT_EQ(n, 2001LU);
+
+  {
+    cbr::ChunkedRecorderOptions opts;
+    opts.max_file_duration = std::chrono::milliseconds(1);
+    cbr::ChunkedRecorder recorder(tmp_prefix("age"), opts);
+    recorder.record(0, 0, 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    recorder.record(0, 1, 1);
+    recorder.close();
+    ASSERT_THROW(recorder.record(0, 2, 2), std::logic_error);
+    ASSERT_EQ(recorder.files().size(), 2LU);
+    remove_files(recorder.files());
+  }
+
+  remove_files(files);
+}
+
+TEST(ChunkedRecorder, Unsorted)
+{
+  std::vector<std::string> files;
+  {
+    cbr::ChunkedRecorder recorder(tmp_prefix("unsorted"));
+    for (int64_t i : {3, 1, 2, 0}) { recorder.record(0, i, i); }
+    files = recorder.files();
+  }
+  cbr::ChunkedReader reader(files[0]);
+  std::vector<int64_t> stamps;
+  for (const auto & rec : reader) { stamps.push_back(rec.stamp); }
+  ASSERT_EQ(stamps, (std::vector<int64_t>{0, 1, 2, 3}));
+  ASSERT_EQ(reader.seek(2)->get<int64_t>(), 2);
+  remove_files(files);
+}
+
+TEST(ChunkedRecorder, Crash)
+{
+  // a recorder that is never closed, as if the process had crashed
+  auto * recorder = new cbr::ChunkedRecorder(tmp_prefix("crash"));
+  for (int i = 0; i < 100; ++i) { recorder->record(0, i, i); }
+  const auto files = recorder->files();
+
+  cbr::ChunkedReader reader(files[0]);
+  ASSERT_EQ(reader.size(), 100LU);
+  ASSERT_EQ(reader.seek(42)->get<int>(), 42);
+
+  delete recorder;
+  remove_files(files);
+}
+
+TEST(ChunkedRecorder, Invalid)
+{
+  ASSERT_THROW(cbr::ChunkedReader("/nonexistent/file.rec"), std::system_error);
+
+  const auto path = tmp_prefix("invalid.rec");
+  FILE * f        = std::fopen(path.c_str(), "w");
+  std::fputs("not a recording", f);
+  std::fclose(f);
+  ASSERT_THROW(cbr::ChunkedReader{path}, std::runtime_error);
+  std::remove(path.c_str());
+}
@@ -4,6 +4,8 @@
 
 #include <gtest/gtest.h>
 
+#include <chrono>
+#include <thread>
 #include <vector>
 
 #include "cbr_utils/cyber_timer.hpp"
@@ -11,6 +13,7 @@
 #include "cyber_clock.hpp"
 
 using cbr::CyberTimer;
+using cbr::CyberTimerMilli;
 using cbr::CyberTimerNoAvg;
 
 template<typename T>
@@ -43,6 +46,26 @@ TEST(CyberTimer, Init)
   testTmr<CyberTimerNoAvg<>>();
 }
 
+TEST(CyberTimer, StatelessClock)
+{
+  using clk_t = std::chrono::steady_clock;
+
+  // a stateless clock set by pointer is given back but not used to read time
+  static_assert(std::is_same_v<decltype(CyberTimer<std::ratio<1>, double, clk_t>{}.get_clock()),
+    std::shared_ptr<clk_t>>);
+  auto clock = std::make_shared<clk_t>();
+  CyberTimer<std::ratio<1>, double, clk_t> timer;
+  ASSERT_NE(timer.get_clock(), nullptr);
+  timer.set_clock(clock);
+  ASSERT_EQ(timer.get_clock(), clock);
+
+  const auto t0 = clk_t::now();
+  timer.tic();
+  const auto t1 = clk_t::now();
+  ASSERT_GE(timer.toc(t1), 0.);
+  ASSERT_LE(timer.get_latest(), std::chrono::duration<double>(t1 - t0).count());
+}
+
 TEST(CyberTimer, Basic)
 {
   constexpr std::size_t N = 100;
@@ -102,3 +125,100 @@ TEST(CyberTimer, Basic)
   *clock += 10;
   ASSERT_DOUBLE_EQ(tmr.tac(), 10000.);
 }
+
+TEST(CyberTimer, Stats)
+{
+  auto clock = std::make_shared<CyberClock>();
+
+  CyberTimerMilli<double, CyberClock, true, cbr::WelfordStats> welford(clock);
+  CyberTimerMilli<double, CyberClock, true, cbr::EmaStats> ema(clock);
+  CyberTimerMilli<double, CyberClock, true, cbr::WindowStats<3>> window(clock);
+
+  ema.get_stats().set_half_life(1.);
+
+  for (std::size_t dt : {2, 4, 4, 4, 5, 5, 7, 9}) {
+    welford.tic();
+    ema.tic();
+    window.tic();
+    *clock += dt;
+    welford.toc();
+    ema.toc();
+    window.toc();
+  }
+
+  ASSERT_EQ(welford.get_average_count(), 8LU);
+  ASSERT_DOUBLE_EQ(welford.get_average(), 5.);
+  ASSERT_DOUBLE_EQ(welford.get_stats().variance(), 32. / 7.);
+  ASSERT_DOUBLE_EQ(welford.get_stats().min(), 2.);
+  ASSERT_DOUBLE_EQ(welford.get_stats().max(), 9.);
+
+  // each sample weighs as much as all the previous ones
+  double expected = 2.;
+  for (double x : {4., 4., 4., 5., 5., 7., 9.}) { expected = (expected + x) / 2.; }
+  ASSERT_EQ(ema.get_average_count(), 8LU);
+  ASSERT_DOUBLE_EQ(ema.get_average(), expected);
+
+  ASSERT_EQ(window.get_average_count(), 8LU);
+  ASSERT_DOUBLE_EQ(window.get_average(), 7.);
+
+  welford.restart();
+  window.restart();
+  ASSERT_EQ(welford.get_average_count(), 0LU);
+  ASSERT_EQ(welford.get_stats().variance(), 0.);
+  ASSERT_EQ(window.get_average(), 0.);
+}
+
+TEST(CyberTimer, Calibration)
+{
+  using nano_timer_t = CyberTimer<std::nano, double, std::chrono::steady_clock>;
+
+  const auto & calibration = nano_timer_t::get_calibration();
+  ASSERT_EQ(&calibration, &cbr::clock_calibration<std::chrono::steady_clock>());
+  ASSERT_EQ(calibration.samples, 1001LU);
+  ASSERT_GE(calibration.overhead.count(), 0);
+  ASSERT_GT(calibration.resolution.count(), 0);
+  ASSERT_LT(calibration.resolution, std::chrono::milliseconds(1));
+
+  nano_timer_t timer;
+  timer.tic();
+  timer.toc();
+  ASSERT_LE(timer.get_latest_corrected(), timer.get_latest());
+  ASSERT_GE(timer.get_latest_corrected(), 0.);
+  ASSERT_EQ(timer.get_latest_corrected_chrono().count(), timer.get_latest_corrected());
+
+  timer.tic();
+  std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  timer.toc();
+  ASSERT_TRUE(timer.is_latest_resolved());
+  ASSERT_NEAR(timer.get_latest() - timer.get_latest_corrected(),
+    static_cast<double>(calibration.overhead.count()),
+    1e-6);
+
+  // integer milliseconds: the overhead rounds to zero
+  CyberTimerMilli<int64_t, std::chrono::steady_clock> timer_ms;
+  timer_ms.tic();
+  timer_ms.toc();
+  ASSERT_EQ(timer_ms.get_latest_corrected(), 0);
+  ASSERT_FALSE(timer_ms.is_latest_resolved());
+
+  // a simulated clock does not advance on its own
+  CyberClock clock;
+  const auto cyber_calibration = cbr::calibrate_clock(clock, 11);
+  ASSERT_EQ(cyber_calibration.samples, 11LU);
+  ASSERT_EQ(cyber_calibration.overhead.count(), 0);
+  ASSERT_EQ(cyber_calibration.resolution.count(), 0);
+
+  // the resolution is the tick granularity, not the smallest observed difference
+  struct CoarseClock
+  {
+    using duration   = std::chrono::nanoseconds;
+    using time_point = std::chrono::time_point<CoarseClock, duration>;
+
+    mutable int64_t reads = 0;
+
+    time_point now() const { return time_point(std::chrono::microseconds(reads++ / 3)); }
+  };
+  const auto coarse_calibration = cbr::calibrate_clock(CoarseClock{});
+  ASSERT_EQ(coarse_calibration.overhead.count(), 0);
+  ASSERT_EQ(coarse_calibration.resolution, std::chrono::microseconds(1));
+}
@@ -0,0 +1,223 @@
+// Copyright Yamaha 2021
+// MIT License
+// https://github.com/yamaha-bps/cbr_utils/blob/master/LICENSE
+
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "cbr_utils/flat_map.hpp"
+
+namespace {
+
+// key counting its copies
+struct CountedKey
+{
+  static inline int copies = 0;
+
+  explicit CountedKey(const int i) : v(i) {}
+  CountedKey(const CountedKey & o) : v(o.v) { ++copies; }
+  CountedKey(CountedKey &&) noexcept = default;
+  CountedKey & operator=(const CountedKey &) = default;
+  CountedKey & operator=(CountedKey &&) noexcept = default;
+  ~CountedKey()                                  = default;
+
+  bool operator==(const CountedKey & o) const noexcept { return v == o.v; }
+
+  int v;
+};
+
+struct CountedKeyHash
+{
+  std::size_t operator()(const CountedKey & k) const noexcept { return std::hash<int>{}(k.v); }
+};
+
+}  // namespace
+
+TEST(FlatHashMap, Basic)
+{
+  cbr::flat_hash_map<int, std::string> m;
+  ASSERT_TRUE(m.empty());
+  ASSERT_EQ(m.find(1), m.end());
+  ASSERT_EQ(m.begin(), m.end());
+
+  ASSERT_TRUE(m.try_emplace(1, "a").second);
+  ASSERT_FALSE(m.try_emplace(1, "b").second);
+  ASSERT_TRUE(m.insert({2, "b"}).second);
+  ASSERT_TRUE(m.emplace(3, "c").second);
+  m[4] = "d";
+  ASSERT_FALSE(m.insert_or_assign(4, "e").second);
+
+  ASSERT_EQ(m.size(), 4LU);
+  ASSERT_EQ(m.at(1), "a");
+  ASSERT_EQ(m.at(4), "e");
+  ASSERT_THROW(m.at(5), std::out_of_range);
+  ASSERT_TRUE(m.contains(2));
+  ASSERT_EQ(m.count(5), 0LU);
+
+  ASSERT_EQ(m.erase(2), 1LU);
+  ASSERT_EQ(m.erase(2), 0LU);
+  ASSERT_FALSE(m.contains(2));
+
+  std::map<int, std::string> sorted(m.begin(), m.end());
+  ASSERT_EQ(sorted, (std::map<int, std::string>{{1, "a"}, {3, "c"}, {4, "e"}}));
+
+  // copies and moves
+  const auto c = m;
+  ASSERT_EQ(c, m);
+  auto d = std::move(m);
+  ASSERT_TRUE(m.empty());
+  ASSERT_EQ(d, c);
+  m = d;
+  m.clear();
+  ASSERT_TRUE(m.empty());
+  ASSERT_NE(m, d);
+  m.try_emplace(7, "g");
+  ASSERT_EQ(m.at(7), "g");
+}
+
+TEST(FlatHashMap, Random)
+{
+  // compare with std::unordered_map through growths, erasures and deleted slot reuse
+  cbr::flat_hash_map<uint64_t, uint64_t> m;
+  std::unordered_map<uint64_t, uint64_t> ref;
+  std::mt19937_64 rng(42);
+
+  for (int i = 0; i < 100000; ++i) {
+    const uint64_t k = rng() % 2000;
+    switch (rng() % 3) {
+    case 0:
+      m[k] = static_cast<uint64_t>(i);
+      ref[k] = static_cast<uint64_t>(i);
+      break;
+    case 1:
+      ASSERT_EQ(m.erase(k), ref.erase(k));
+      break;
+    default:
+      ASSERT_EQ(m.contains(k), ref.count(k) == 1);
+      break;
+    }
+  }
+  ASSERT_EQ(m.size(), ref.size());
+  ASSERT_LE(m.load_factor(), m.max_load_factor());
+  for (const auto & [k, v] : ref) { ASSERT_EQ(m.at(k), v); }
+
+  std::size_t n = 0;
+  for (auto it = m.begin(); it != m.end();) {
+    it = (it->first % 2 == 0) ? m.erase(it) : std::next(it);
+    ++n;
+  }
+  ASSERT_EQ(n, ref.size());
+  for (const auto & [k, v] : m) { ASSERT_EQ(k % 2, 1LU); }
+
+  m.reserve(10000);
+  const auto cap = m.capacity();
+  for (uint64_t k = 0; k < 10000; ++k) { m.try_emplace(k, k); }
+  ASSERT_EQ(m.capacity(), cap);
+  ASSERT_EQ(m.size(), 10000LU);
+}
+
+TEST(FlatHashMap, Strings)
+{
+  cbr::string_hash_map<int> m{{"left", 1}, {"right", 2}};
+  const std::string_view key = "left";
+  ASSERT_EQ(m.find(key)->second, 1);
+  ASSERT_EQ(m.at("right"), 2);
+  ASSERT_EQ(m.erase(std::string_view("right")), 1LU);
+  ASSERT_TRUE(m.try_emplace(std::string_view("center"), 3).second);
+  ASSERT_EQ(m.at(std::string("center")), 3);
+
+  // not transparent, converted to Key
+  cbr::flat_hash_map<std::string, int> s{{"a", 1}};
+  ASSERT_EQ(s.find("a")->second, 1);
+  ASSERT_EQ(s.erase("a"), 1LU);
+
+  cbr::ci_string_hash_map<int> ci;
+  ci["Camera"] = 1;
+  ASSERT_TRUE(ci.contains("CAMERA"));
+  ASSERT_EQ(ci.at("camera"), 1);
+  ASSERT_FALSE(ci.try_emplace("cAmErA", 2).second);
+  ASSERT_EQ(ci.size(), 1LU);
+  ASSERT_FALSE(ci.contains("camera2"));
+
+  // move only values and elements destroyed
+  const auto p = std::make_shared<int>(0);
+  {
+    cbr::flat_hash_map<int, std::unique_ptr<std::shared_ptr<int>>> u;
+    for (int i = 0; i < 100; ++i) { u[i] = std::make_unique<std::shared_ptr<int>>(p); }
+    ASSERT_EQ(p.use_count(), 101);
+    u.erase(0);
+    ASSERT_EQ(p.use_count(), 100);
+  }
+  ASSERT_EQ(p.use_count(), 1);
+}
+
+TEST(FlatHashMap, RehashMovesKeys)
+{
+  cbr::flat_hash_map<CountedKey, std::string, CountedKeyHash> m;
+  for (int i = 0; i < 1000; ++i) { m[CountedKey(i)] = std::to_string(i); }
+  ASSERT_EQ(CountedKey::copies, 0);
+  for (int i = 0; i < 1000; ++i) { ASSERT_EQ(m.at(CountedKey(i)), std::to_string(i)); }
+}
+
+TEST(FlatMap, Basic)
+{
+  cbr::flat_map<int, std::string> m{{3, "c"}, {1, "a"}, {2, "b"}, {1, "z"}};
+  ASSERT_EQ(m.size(), 3LU);
+  ASSERT_EQ(m.at(1), "a");  // first of equal keys is kept
+  ASSERT_THROW(m.at(4), std::out_of_range);
+
+  ASSERT_TRUE(m.try_emplace(0, "0").second);
+  ASSERT_FALSE(m.emplace(0, "1").second);
+  m[5] = "e";
+  ASSERT_FALSE(m.insert_or_assign(5, "f").second);
+  m.insert({{7, "g"}, {4, "d"}, {3, "x"}});
+
+  std::vector<int> keys;
+  for (const auto & [k, v] : m) { keys.push_back(k); }
+  ASSERT_EQ(keys, (std::vector<int>{0, 1, 2, 3, 4, 5, 7}));
+  ASSERT_EQ(m.at(3), "c");
+  ASSERT_EQ(m.at(5), "f");
+
+  ASSERT_EQ(m.lower_bound(6)->first, 7);
+  ASSERT_EQ(m.upper_bound(5)->first, 7);
+  ASSERT_EQ(m.erase(1), 1LU);
+  ASSERT_FALSE(m.contains(1));
+  m.erase(m.begin());
+  ASSERT_EQ(m.begin()->first, 2);
+
+  const auto data = std::move(m).extract();
+  ASSERT_EQ(data.size(), 5LU);
+  using map_t = cbr::flat_map<int, std::string>;
+  ASSERT_EQ(map_t(data).data(), data);
+}
+
+TEST(FlatMap, Strings)
+{
+  cbr::flat_map<std::string, int, std::less<>> m;
+  m.try_emplace(std::string_view("b"), 2);
+  m["a"] = 1;
+  ASSERT_EQ(m.at(std::string_view("b")), 2);
+  ASSERT_EQ(m.find("a")->second, 1);
+  ASSERT_EQ(m.erase(std::string_view("a")), 1LU);
+
+  cbr::flat_map<std::string, int, cbr::ci_string_less> ci{{"Beta", 2}, {"alpha", 1}, {"BETA", 3}};
+  ASSERT_EQ(ci.size(), 2LU);
+  ASSERT_EQ(ci.begin()->first, "alpha");
+  ASSERT_EQ(ci.at("beta"), 2);
+  ASSERT_TRUE(ci.contains("ALPHA"));
+
+  ASSERT_TRUE(cbr::ci_string_equal{}("Hello", "hELLO"));
+  ASSERT_FALSE(cbr::ci_string_equal{}("Hello", "Hell"));
+  ASSERT_EQ(cbr::ci_string_hash{}("Hello"), cbr::ci_string_hash{}("HELLO"));
+}
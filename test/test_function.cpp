@@ -0,0 +1,111 @@
+// Copyright Yamaha 2021
+// MIT License
+// https://github.com/yamaha-bps/cbr_utils/blob/master/LICENSE
+
+#include <gtest/gtest.h>
+
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "cbr_utils/function.hpp"
+
+namespace {
+
+int twice(int i) { return 2 * i; }
+
+int apply(cbr::function_ref<int(int)> f, int i) { return f(i); }
+
+}  // namespace
+
+TEST(FunctionRef, Basic)
+{
+  static_assert(sizeof(cbr::function_ref<void()>) == 2 * sizeof(void *));
+  static_assert(std::is_trivially_copyable_v<cbr::function_ref<void()>>);
+
+  ASSERT_EQ(apply(twice, 3), 6);
+  ASSERT_EQ(apply(&twice, 4), 8);
+
+  int offset = 10;
+  auto add   = [&offset](int i) { return i + offset; };
+  ASSERT_EQ(apply(add, 1), 11);
+  offset = 20;
+  ASSERT_EQ(apply(add, 1), 21);  // references, does not copy
+
+  // mutable state is shared
+  int count   = 0;
+  auto inc    = [&count](int i) mutable { return count += i; };
+  cbr::function_ref<int(int)> r = inc;
+  r(2);
+  r(3);
+  ASSERT_EQ(count, 5);
+
+  // conversions
+  cbr::function_ref<double(int)> d = add;
+  ASSERT_EQ(d(2), 22.);
+
+  // deduction
+  cbr::function_ref g = add;
+  static_assert(std::is_same_v<decltype(g), cbr::function_ref<int(int)>>);
+  cbr::function_ref h = &twice;
+  static_assert(std::is_same_v<decltype(h), cbr::function_ref<int(int)>>);
+}
+
+TEST(InplaceFunction, Basic)
+{
+  cbr::inplace_function<int(int)> f;
+  ASSERT_FALSE(f);
+  ASSERT_TRUE(f == nullptr);
+  ASSERT_THROW(f(1), std::bad_function_call);
+
+  f = twice;
+  ASSERT_TRUE(f);
+  ASSERT_EQ(f(3), 6);
+
+  f = [k = 3](int i) { return k * i; };
+  ASSERT_EQ(f(3), 9);
+
+  auto g = std::move(f);
+  ASSERT_FALSE(f);
+  ASSERT_EQ(g(2), 6);
+
+  g = nullptr;
+  ASSERT_FALSE(g);
+
+  // arguments are forwarded
+  cbr::inplace_function<std::size_t(std::string &&)> s = [](std::string && str) {
+    const std::string moved = std::move(str);
+    return moved.size();
+  };
+  std::string str = "abc";
+  ASSERT_EQ(s(std::move(str)), 3LU);
+}
+
+TEST(InplaceFunction, MoveOnly)
+{
+  auto p = std::make_shared<int>(3);
+  {
+    cbr::inplace_function<int()> f = [u = std::make_unique<int>(2), p]() { return *u * *p; };
+    ASSERT_EQ(f(), 6);
+    ASSERT_EQ(p.use_count(), 2);
+
+    std::vector<cbr::inplace_function<int()>> v;
+    v.push_back(std::move(f));
+    v.emplace_back([] { return 1; });
+    v.resize(10);  // reallocation moves the callables
+    ASSERT_EQ(v[0](), 6);
+    ASSERT_EQ(v[1](), 1);
+    ASSERT_EQ(p.use_count(), 2);
+  }
+  ASSERT_EQ(p.use_count(), 1);  // callable destroyed
+
+  std::packaged_task<int()> task([] { return 4; });
+  auto fut = task.get_future();
+  cbr::inplace_function<void()> t = std::move(task);
+  t();
+  ASSERT_EQ(fut.get(), 4);
+}
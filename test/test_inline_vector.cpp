@@ -0,0 +1,146 @@
+// Copyright Yamaha 2021
+// MIT License
+// https://github.com/yamaha-bps/cbr_utils/blob/master/LICENSE
+
+#include <gtest/gtest.h>
+
+#include <list>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "cbr_utils/inline_vector.hpp"
+#include "cbr_utils/type_traits.hpp"
+
+namespace {
+
+constexpr cbr::static_vector<int, 8> make_constexpr()
+{
+  cbr::static_vector<int, 8> v{4, 1, 3};
+  v.push_back(5);
+  v.insert(v.begin(), 0);
+  v.erase(v.begin() + 2);
+  v.resize(6, 7);
+  return v;
+}
+
+}  // namespace
+
+TEST(StaticVector, Constexpr)
+{
+  constexpr auto v = make_constexpr();
+  static_assert(v.size() == 6);
+  static_assert(v[0] == 0 && v[1] == 4 && v[2] == 3 && v[3] == 5 && v[4] == 7 && v[5] == 7);
+  static_assert(v == cbr::static_vector<int, 8>{0, 4, 3, 5, 7, 7});
+  static_assert(v < cbr::static_vector<int, 8>{0, 5});
+
+  static_assert(cbr::is_static_vector_v<cbr::static_vector<int, 8>>);
+  static_assert(!cbr::is_static_vector_v<std::vector<int>>);
+  static_assert(cbr::is_vector_like_v<cbr::small_vector<int, 8>>);
+  static_assert(cbr::is_vector_like_v<std::vector<int>>);
+  static_assert(!cbr::is_vector_like_v<std::list<int>>);
+}
+
+TEST(StaticVector, Basic)
+{
+  cbr::static_vector<std::string, 4> v;
+  ASSERT_TRUE(v.empty());
+  ASSERT_EQ(v.capacity(), 4LU);
+
+  v.emplace_back(3, 'a');
+  v.push_back("b");
+  v.insert(v.begin() + 1, {"c", "d"});
+  ASSERT_EQ(v, (cbr::static_vector<std::string, 4>{"aaa", "c", "d", "b"}));
+  ASSERT_THROW(v.push_back("e"), std::length_error);
+  ASSERT_THROW(v.at(4), std::out_of_range);
+  ASSERT_EQ(v.size(), 4LU);
+
+  v.erase(v.begin(), v.begin() + 2);
+  ASSERT_EQ(v.front(), "d");
+  ASSERT_EQ(v.back(), "b");
+
+  // copies and moves
+  auto w = v;
+  ASSERT_EQ(w, v);
+  auto x = std::move(w);
+  ASSERT_EQ(x, v);
+  ASSERT_TRUE(w.empty());
+
+  x.pop_back();
+  ASSERT_EQ(x.size(), 1LU);
+  x = v;
+  ASSERT_EQ(x.size(), 2LU);
+
+  std::vector<std::string> out(x.rbegin(), x.rend());
+  ASSERT_EQ(out, (std::vector<std::string>{"b", "d"}));
+
+  // elements are destroyed
+  const auto p = std::make_shared<int>(0);
+  {
+    cbr::static_vector<std::shared_ptr<int>, 3> s(3, p);
+    ASSERT_EQ(p.use_count(), 4);
+    s.resize(1);
+    ASSERT_EQ(p.use_count(), 2);
+  }
+  ASSERT_EQ(p.use_count(), 1);
+}
+
+TEST(SmallVector, Basic)
+{
+  cbr::small_vector<int, 4> v{1, 2, 3};
+  ASSERT_TRUE(v.is_inline());
+  ASSERT_EQ(v.capacity(), 4LU);
+
+  v.push_back(4);
+  ASSERT_TRUE(v.is_inline());
+  v.push_back(v[0]);  // argument refers to an element moved by the growth
+  ASSERT_FALSE(v.is_inline());
+  ASSERT_GE(v.capacity(), 5LU);
+  ASSERT_EQ(v, (cbr::small_vector<int, 4>{1, 2, 3, 4, 1}));
+
+  v.insert(v.begin(), 3, v.back());
+  ASSERT_EQ(v, (cbr::small_vector<int, 4>{1, 1, 1, 1, 2, 3, 4, 1}));
+
+  v.erase(v.begin() + 1, v.end());
+  v.shrink_to_fit();
+  ASSERT_TRUE(v.is_inline());
+  ASSERT_EQ(v.size(), 1LU);
+  ASSERT_EQ(v[0], 1);
+
+  const std::list<int> l{5, 6, 7, 8, 9};
+  v.assign(l.begin(), l.end());
+  ASSERT_EQ(v.size(), 5LU);
+  ASSERT_EQ(v.at(4), 9);
+}
+
+TEST(SmallVector, Moves)
+{
+  using vec_t = cbr::small_vector<std::unique_ptr<int>, 2>;
+
+  // inline, elements are moved
+  vec_t a;
+  a.push_back(std::make_unique<int>(1));
+  vec_t b(std::move(a));
+  ASSERT_TRUE(a.empty());
+  ASSERT_EQ(*b[0], 1);
+
+  // heap, buffer is stolen
+  for (int i = 2; i < 5; ++i) { b.push_back(std::make_unique<int>(i)); }
+  const int * p = b[0].get();
+  ASSERT_FALSE(b.is_inline());
+  vec_t c;
+  c = std::move(b);
+  ASSERT_TRUE(b.empty());
+  ASSERT_TRUE(b.is_inline());
+  ASSERT_EQ(c.size(), 4LU);
+  ASSERT_EQ(c[0].get(), p);
+
+  cbr::small_vector<std::string, 2> s{"a", "b", "c"};
+  auto t = s;
+  ASSERT_EQ(t, s);
+  t.resize(1);
+  s = t;
+  ASSERT_EQ(s.size(), 1LU);
+}
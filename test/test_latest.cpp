@@ -0,0 +1,127 @@
+// Copyright Yamaha 2021
+// MIT License
+// https://github.com/yamaha-bps/cbr_utils/blob/master/LICENSE
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cbr_utils/latest.hpp"
+
+namespace {
+
+struct State
+{
+  int64_t a;
+  double b;
+  int64_t c;
+  std::array<char, 13> d;  // not a multiple of 8 bytes
+};
+
+State make_state(const int64_t i)
+{
+  State s{i, 2. * static_cast<double>(i), -i, {}};
+  s.d.fill(static_cast<char>(i % 128));
+  return s;
+}
+
+bool consistent(const State & s)
+{
+  if (s.b != 2. * static_cast<double>(s.a) || s.c != -s.a) { return false; }
+  for (const char c : s.d) {
+    if (c != static_cast<char>(s.a % 128)) { return false; }
+  }
+  return true;
+}
+
+}  // namespace
+
+TEST(Latest, Basic)
+{
+  cbr::Latest<State> latest(make_state(3));
+  ASSERT_EQ(latest.version(), 0LU);
+  ASSERT_EQ(latest.read().a, 3);
+
+  latest.write(make_state(5));
+  ASSERT_EQ(latest.version(), 1LU);
+
+  State s{};
+  uint64_t version = 0;
+  ASSERT_TRUE(latest.try_read(s, version));
+  ASSERT_EQ(version, 1LU);
+  ASSERT_TRUE(consistent(s));
+  ASSERT_EQ(s.a, 5);
+
+  cbr::Latest<int> i;
+  ASSERT_EQ(i.read(), 0);
+}
+
+TEST(Latest, Threads)
+{
+  static constexpr int64_t n = 100000;
+  cbr::Latest<State> latest(make_state(0));
+
+  std::thread writer([&latest] {
+    for (int64_t i = 1; i <= n; ++i) { latest.write(make_state(i)); }
+  });
+
+  int64_t last = 0;
+  while (last < n) {
+    const State s = latest.read();
+    ASSERT_TRUE(consistent(s));
+    ASSERT_GE(s.a, last);  // values are never older than a previous read
+    last = s.a;
+  }
+  writer.join();
+  ASSERT_EQ(latest.version(), static_cast<uint64_t>(n));
+}
+
+TEST(TripleBuffer, Basic)
+{
+  cbr::TripleBuffer<std::string> buffer("init");
+  ASSERT_FALSE(buffer.update());
+  ASSERT_EQ(buffer.read(), "init");
+
+  buffer.write("a");
+  buffer.write(std::string("b"));
+  ASSERT_TRUE(buffer.update());
+  ASSERT_EQ(buffer.read_buffer(), "b");
+  ASSERT_FALSE(buffer.update());
+  ASSERT_EQ(buffer.read(), "b");
+
+  buffer.write_buffer() = "c";
+  buffer.publish();
+  ASSERT_EQ(buffer.read(), "c");
+}
+
+TEST(TripleBuffer, Threads)
+{
+  static constexpr int n = 20000;
+  cbr::TripleBuffer<std::vector<int>> buffer(std::vector<int>(1000, 0));
+
+  std::thread writer([&buffer] {
+    for (int i = 1; i <= n; ++i) {
+      auto & v = buffer.write_buffer();
+      std::fill(v.begin(), v.end(), i);
+      buffer.publish();
+    }
+  });
+
+  int last = 0;
+  while (last < n) {
+    if (!buffer.update()) {
+      std::this_thread::yield();
+      continue;
+    }
+    const auto & v = buffer.read_buffer();
+    ASSERT_GT(v.front(), last);
+    ASSERT_EQ(std::count(v.begin(), v.end(), v.front()), 1000);
+    last = v.front();
+  }
+  writer.join();
+}
@@ -0,0 +1,162 @@
+// Copyright Yamaha 2021
+// MIT License
+// https://github.com/yamaha-bps/cbr_utils/blob/master/LICENSE
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cbr_utils/metrics.hpp"
+#include "cbr_utils/thread_pool.hpp"
+
+TEST(Metrics, ShardedCounter)
+{
+  cbr::ShardedCounter counter(3);
+  ASSERT_EQ(counter.shards(), 4LU);
+  ASSERT_EQ(counter.value(), 0);
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 8; ++t) {
+    threads.emplace_back([&counter] {
+      for (int i = 0; i < 10000; ++i) { counter.inc(); }
+    });
+  }
+  for (auto & th : threads) { th.join(); }
+  ASSERT_EQ(counter.value(), 80000);
+
+  counter.inc(-80001);
+  ASSERT_EQ(counter.value(), -1);
+
+  counter.reset();
+  ASSERT_EQ(counter.value(), 0);
+}
+
+TEST(Metrics, ShardedCounterThreadPool)
+{
+  cbr::ShardedCounter counter;
+  {
+    cbr::ThreadPool pool(4);
+    for (int i = 0; i < 1000; ++i) {
+      pool.enqueue([&counter] { counter.inc(2); });
+    }
+  }
+  ASSERT_EQ(counter.value(), 2000);
+}
+
+TEST(Metrics, Gauge)
+{
+  cbr::Gauge gauge;
+  ASSERT_EQ(gauge.value(), 0.);
+  gauge.set(1.5);
+  ASSERT_EQ(gauge.value(), 1.5);
+  gauge.add(-2.);
+  ASSERT_EQ(gauge.value(), -0.5);
+}
+
+TEST(Metrics, Histogram)
+{
+  ASSERT_THROW(cbr::Histogram({1., 1.}), std::invalid_argument);
+  ASSERT_THROW(cbr::Histogram({2., 1.}), std::invalid_argument);
+
+  cbr::Histogram histogram({1., 2., 5.}, 2);
+  ASSERT_EQ(histogram.bounds().size(), 3LU);
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&histogram] {
+      for (const double v : {0.5, 1., 1.5, 4., 10.}) { histogram.observe(v); }
+    });
+  }
+  for (auto & th : threads) { th.join(); }
+
+  const auto snap = histogram.snapshot();
+  ASSERT_EQ(snap.count, 20LU);
+  ASSERT_DOUBLE_EQ(snap.sum, 4. * 17.);
+  ASSERT_EQ(snap.counts, (std::vector<uint64_t>{8, 4, 4, 4}));
+
+  // +Inf bound is implicit
+  cbr::Histogram h2({1., std::numeric_limits<double>::infinity()});
+  ASSERT_EQ(h2.bounds().size(), 1LU);
+
+  ASSERT_EQ(cbr::Histogram::linear_buckets(1., 2., 3), (std::vector<double>{1., 3., 5.}));
+  ASSERT_EQ(cbr::Histogram::exponential_buckets(1., 2., 3), (std::vector<double>{1., 2., 4.}));
+}
+
+TEST(Metrics, Registry)
+{
+  cbr::MetricsRegistry registry;
+
+  auto & c = registry.counter("requests_total", "Number of requests.");
+  ASSERT_EQ(&c, &registry.counter("requests_total"));
+  c.inc(3);
+
+  registry.gauge("temperature", "Multi\nline").set(21.5);
+  registry.gauge_callback("queue_size", "", [] { return 2.; });
+
+  auto & h = registry.histogram("latency_seconds", "Latency.", {0.1, 1.});
+  h.observe(0.05);
+  h.observe(0.5);
+  h.observe(2.);
+
+  ASSERT_THROW(registry.gauge("requests_total"), std::invalid_argument);
+  ASSERT_THROW(registry.gauge_callback("temperature", "", [] { return 0.; }),
+    std::invalid_argument);
+  ASSERT_THROW(registry.counter("0abc"), std::invalid_argument);
+  ASSERT_THROW(registry.counter("a-b"), std::invalid_argument);
+  ASSERT_THROW(registry.counter(""), std::invalid_argument);
+
+  const std::string expected =
+    "# HELP latency_seconds Latency.\n"
+    "# TYPE latency_seconds histogram\n"
+    "latency_seconds_bucket{le=\"0.1\"} 1\n"
+    "latency_seconds_bucket{le=\"1\"} 2\n"
+    "latency_seconds_bucket{le=\"+Inf\"} 3\n"
+    "latency_seconds_sum 2.55\n"
+    "latency_seconds_count 3\n"
+    "# TYPE queue_size gauge\n"
+    "queue_size 2\n"
+    "# HELP requests_total Number of requests.\n"
+    "# TYPE requests_total counter\n"
+    "requests_total 3\n"
+    "# HELP temperature Multi\\nline\n"
+    "# TYPE temperature gauge\n"
+    "temperature 21.5\n";
+  ASSERT_EQ(registry.to_string(), expected);
+
+  const std::string path = "test_metrics.prom";
+  registry.write_file(path);
+  {
+    std::ifstream ifs(path);
+    std::stringstream ss;
+    ss << ifs.rdbuf();
+    ASSERT_EQ(ss.str(), expected);
+  }
+  std::remove(path.c_str());
+
+  ASSERT_THROW(registry.write_file("/nonexistent/dir/file.prom"), std::runtime_error);
+
+  registry.remove("queue_size");
+  ASSERT_EQ(registry.to_string().find("queue_size"), std::string::npos);
+}
+
+TEST(Metrics, RegistryReentrantCallback)
+{
+  // callbacks run without the registry lock and may access the registry
+  cbr::MetricsRegistry registry;
+  registry.gauge("temperature").set(20.);
+  registry.gauge_callback("temperature_offset", "", [&registry] {
+    registry.counter("exports_total").inc();
+    return registry.gauge("temperature").value() - 10.;
+  });
+
+  const auto out = registry.to_string();
+  ASSERT_NE(out.find("temperature_offset 10\n"), std::string::npos);
+  ASSERT_EQ(registry.counter("exports_total").value(), 1);
+}
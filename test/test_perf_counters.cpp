@@ -0,0 +1,63 @@
+// Copyright Yamaha 2021
+// MIT License
+// https://github.com/yamaha-bps/cbr_utils/blob/master/LICENSE
+
+#include <gtest/gtest.h>
+
+#include <utility>
+
+#include "cbr_utils/perf_counters.hpp"
+
+namespace {
+
+uint64_t work(uint64_t n)
+{
+  volatile uint64_t x = 0;
+  for (uint64_t i = 0; i < n; ++i) { x = x + i * i; }
+  return x;
+}
+
+}  // namespace
+
+TEST(PerfCounters, Basic)
+{
+  cbr::PerfCounters counters;
+  ASSERT_FALSE(counters.is_running());
+
+  counters.tic();
+  work(100000);
+  const auto v = counters.toc();
+  ASSERT_FALSE(counters.is_running());
+
+  if (!counters.available()) {
+    // graceful fallback, e.g. in containers
+    ASSERT_FALSE(v.cycles_valid);
+    ASSERT_FALSE(v.instructions_valid);
+    ASSERT_EQ(v.instructions, 0LU);
+    ASSERT_EQ(v.ipc(), 0.);
+    ASSERT_EQ(counters.get_count(), 0LU);
+    GTEST_SKIP() << "perf events unavailable";
+  }
+
+  ASSERT_EQ(counters.get_count(), 1LU);
+  if (v.instructions_valid) { ASSERT_GT(v.instructions, 100000LU); }
+
+  // toc when stopped returns latest values
+  ASSERT_EQ(counters.toc().instructions, v.instructions);
+  ASSERT_EQ(counters.get_count(), 1LU);
+
+  counters.tic();
+  work(100000);
+  counters.toc();
+  ASSERT_EQ(counters.get_count(), 2LU);
+  ASSERT_EQ(
+    counters.get_total().instructions, v.instructions + counters.get_latest().instructions);
+
+  cbr::PerfCounters moved(std::move(counters));
+  ASSERT_TRUE(moved.available());
+  ASSERT_FALSE(counters.available());  // NOLINT
+
+  moved.restart();
+  ASSERT_EQ(moved.get_count(), 0LU);
+  ASSERT_TRUE(moved.is_running());
+}
@@ -0,0 +1,146 @@
+// Copyright Yamaha 2021
+// MIT License
+// https://github.com/yamaha-bps/cbr_utils/blob/master/LICENSE
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "cbr_utils/rate_limiter.hpp"
+
+#include "cyber_clock.hpp"
+
+using namespace std::chrono_literals;
+
+using cbr::LeakyBucket;
+using cbr::TokenBucket;
+
+TEST(RateLimiter, TokenBucket)
+{
+  auto clock = std::make_shared<CyberClock>();  // milliseconds
+
+  TokenBucket<CyberClock> limiter(100., 3., clock);  // one token every 10ms
+  ASSERT_DOUBLE_EQ(limiter.available(), 3.);
+
+  // initial burst
+  ASSERT_TRUE(limiter.try_acquire());
+  ASSERT_TRUE(limiter.try_acquire(2));
+  ASSERT_FALSE(limiter.try_acquire());
+  ASSERT_DOUBLE_EQ(limiter.available(), 0.);
+
+  *clock += 9;
+  ASSERT_FALSE(limiter.try_acquire());
+  *clock += 1;
+  ASSERT_TRUE(limiter.try_acquire());
+  ASSERT_FALSE(limiter.try_acquire());
+
+  // refills up to burst
+  *clock += 1000;
+  ASSERT_DOUBLE_EQ(limiter.available(), 3.);
+  ASSERT_FALSE(limiter.try_acquire(4));
+  ASSERT_TRUE(limiter.try_acquire(3));
+
+  // acquire reserves tokens in advance
+  ASSERT_EQ(limiter.acquire(), 10ms);
+  ASSERT_DOUBLE_EQ(limiter.available(), -1.);
+  ASSERT_FALSE(limiter.try_acquire());
+
+  limiter.reset();
+  ASSERT_DOUBLE_EQ(limiter.available(), 3.);
+
+  ASSERT_THROW(TokenBucket<>(0.), std::invalid_argument);
+  ASSERT_THROW(TokenBucket<>(1., 0.5), std::invalid_argument);
+}
+
+TEST(RateLimiter, LeakyBucket)
+{
+  auto clock = std::make_shared<CyberClock>();
+
+  LeakyBucket<CyberClock> limiter(1000., 2., clock);  // one unit every ms
+
+  // acquire spaces requests even when the bucket is empty
+  ASSERT_EQ(limiter.acquire(), 0ms);
+  ASSERT_EQ(limiter.acquire(), 1ms);
+  ASSERT_FALSE(limiter.try_acquire());
+  *clock += 1;
+  ASSERT_TRUE(limiter.try_acquire());
+}
+
+namespace {
+
+// simulated clock advanced by the limiter instead of sleeping
+struct SleepingClock
+{
+  using duration   = std::chrono::nanoseconds;
+  using time_point = std::chrono::time_point<SleepingClock, duration>;
+
+  time_point t{};
+
+  time_point now() const { return t; }
+
+  void sleep_for(const duration & d) { t += d; }
+};
+
+}  // namespace
+
+TEST(RateLimiter, ClockSleep)
+{
+  auto clock = std::make_shared<SleepingClock>();
+  LeakyBucket<SleepingClock> limiter(1., 1., clock);  // one unit every second
+
+  const auto t0 = std::chrono::steady_clock::now();
+  ASSERT_EQ(limiter.acquire(), 0s);
+  ASSERT_EQ(limiter.acquire(), 1s);
+  ASSERT_EQ(limiter.acquire(), 1s);
+  ASSERT_LT(std::chrono::steady_clock::now() - t0, 500ms);
+  ASSERT_EQ(clock->t.time_since_epoch(), 2s);
+}
+
+TEST(RateLimiter, InvalidRequest)
+{
+  auto clock = std::make_shared<CyberClock>();
+  TokenBucket<CyberClock> limiter(100., 3., clock);
+  ASSERT_TRUE(limiter.try_acquire(3));
+
+  // non positive requests would otherwise refund tokens
+  ASSERT_FALSE(limiter.try_acquire(0));
+  ASSERT_FALSE(limiter.try_acquire(-3));
+  ASSERT_DOUBLE_EQ(limiter.available(), 0.);
+  ASSERT_THROW(limiter.acquire(0), std::invalid_argument);
+  ASSERT_THROW(limiter.acquire(-1), std::invalid_argument);
+  ASSERT_DOUBLE_EQ(limiter.available(), 0.);
+}
+
+TEST(RateLimiter, Concurrent)
+{
+  TokenBucket<> limiter(1., 100.);  // 100 tokens, negligible refill
+
+  std::atomic<int> granted = 0;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; i++) {
+    threads.emplace_back([&] {
+      for (int j = 0; j < 50; j++) {
+        if (limiter.try_acquire()) { ++granted; }
+      }
+    });
+  }
+  for (auto & t : threads) { t.join(); }
+
+  ASSERT_EQ(granted, 100);
+}
+
+TEST(RateLimiter, Pacing)
+{
+  LeakyBucket<> limiter(200.);  // 5ms period
+
+  const auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < 11; i++) { limiter.acquire(); }
+  const auto dt = std::chrono::steady_clock::now() - t0;
+
+  ASSERT_GE(dt, 50ms);
+}
@@ -0,0 +1,109 @@
+// Copyright Yamaha 2021
+// MIT License
+// https://github.com/yamaha-bps/cbr_utils/blob/master/LICENSE
+
+#include <gtest/gtest.h>
+
+#include <boost/hana/adapt_struct.hpp>
+
+#include <array>
+#include <chrono>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "cbr_utils/inline_vector.hpp"
+#include "cbr_utils/serialization.hpp"
+
+namespace {
+
+enum class Color : uint8_t { red, green, blue };
+
+struct Inner
+{
+  BOOST_HANA_DEFINE_STRUCT(Inner, (std::string, name), (std::array<float, 3>, xyz));
+};
+
+struct Outer
+{
+  BOOST_HANA_DEFINE_STRUCT(Outer,
+    (int64_t, t),
+    (Color, color),
+    (std::vector<Inner>, inners),
+    (std::optional<double>, opt),
+    (std::pair<int, std::string>, pair),
+    (std::chrono::milliseconds, dt));
+};
+
+}  // namespace
+
+TEST(Serialization, Arithmetic)
+{
+  const double d = 3.14;
+  const auto buf = cbr::serialize(d);
+  ASSERT_EQ(buf.size(), sizeof(double));
+  ASSERT_EQ(cbr::deserialize<double>(buf.data(), buf.size()), d);
+  ASSERT_THROW(cbr::deserialize<double>(buf.data(), buf.size() - 1), std::out_of_range);
+}
+
+TEST(Serialization, Containers)
+{
+  using T = std::tuple<std::string, std::vector<int>, std::optional<int>>;
+
+  const T v{"hello", {1, 2, 3}, {}};
+  const auto buf = cbr::serialize(v);
+  ASSERT_EQ(buf.size(), cbr::serialized_size(v));
+  ASSERT_EQ(buf.size(), 8 + 5 + 8 + 3 * sizeof(int) + 1);
+
+  const auto v2 = cbr::deserialize<T>(buf.data(), buf.size());
+  ASSERT_EQ(v, v2);
+}
+
+TEST(Serialization, InlineVectors)
+{
+  using T = std::pair<cbr::static_vector<int, 4>, cbr::small_vector<std::string, 1>>;
+
+  const T v{{1, 2, 3}, {"a", "bc"}};
+  const auto buf = cbr::serialize(v);
+  ASSERT_EQ(buf.size(), cbr::serialized_size(v));
+
+  const auto v2 = cbr::deserialize<T>(buf.data(), buf.size());
+  ASSERT_EQ(v, v2);
+
+  const auto buf2 = cbr::serialize(std::vector<int>{1, 2, 3, 4, 5});
+  using S         = cbr::static_vector<int, 4>;
+  ASSERT_THROW(cbr::deserialize<S>(buf2.data(), buf2.size()), std::out_of_range);
+}
+
+TEST(Serialization, HanaStruct)
+{
+  const Outer o{123,
+    Color::blue,
+    {Inner{"a", {1.f, 2.f, 3.f}}, Inner{"bc", {4.f, 5.f, 6.f}}},
+    2.5,
+    {7, "seven"},
+    std::chrono::milliseconds(42)};
+
+  const auto buf = cbr::serialize(o);
+  ASSERT_EQ(buf.size(), cbr::serialized_size(o));
+
+  Outer o2{};
+  const auto * end = cbr::deserialize(buf.data(), buf.data() + buf.size(), o2);
+  ASSERT_EQ(end, buf.data() + buf.size());
+
+  ASSERT_EQ(o2.t, 123);
+  ASSERT_EQ(o2.color, Color::blue);
+  ASSERT_EQ(o2.inners.size(), 2LU);
+  ASSERT_EQ(o2.inners[1].name, "bc");
+  ASSERT_EQ(o2.inners[1].xyz[2], 6.f);
+  ASSERT_EQ(o2.opt, 2.5);
+  ASSERT_EQ(o2.pair.second, "seven");
+  ASSERT_EQ(o2.dt.count(), 42);
+
+  for (std::size_t i = 0; i < buf.size(); i++) {
+    Outer o3{};
+    ASSERT_THROW(cbr::deserialize(buf.data(), buf.data() + i, o3), std::out_of_range);
+  }
+}
@@ -0,0 +1,241 @@
+// Copyright Yamaha 2021
+// MIT License
+// https://github.com/yamaha-bps/cbr_utils/blob/master/LICENSE
+
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "cbr_utils/shm_transport.hpp"
+#include "cbr_utils/synchronizer.hpp"
+
+using cbr::ShmChannel;
+using cbr::ShmConsumer;
+using cbr::ShmMessage;
+using cbr::ShmProducer;
+
+namespace {
+
+std::string channel_name(const std::string & suffix)
+{
+  return "/cbr_utils_test_" + std::to_string(getpid()) + "_" + suffix;
+}
+
+struct Frame
+{
+  int64_t t;
+  std::array<double, 4> data;
+};
+
+}  // namespace
+
+TEST(ShmTransport, Basic)
+{
+  const auto name = channel_name("basic");
+  auto channel    = ShmChannel::create(name, 2, sizeof(Frame));
+  ASSERT_EQ(channel->slot_count(), 2LU);
+  ASSERT_EQ(channel->slot_size(), sizeof(Frame));
+  ASSERT_THROW(ShmChannel::create(name, 2, 16), std::system_error);
+
+  ShmProducer producer(channel);
+  ShmConsumer consumer(ShmChannel::open(name));
+
+  ASSERT_FALSE(consumer.try_receive().has_value());
+
+  const Frame f1{1, {1., 2., 3., 4.}};
+  ASSERT_TRUE(producer.try_send(&f1, sizeof(f1), f1.t));
+
+  void * buf = producer.try_reserve();
+  ASSERT_NE(buf, nullptr);
+  ASSERT_EQ(buf, producer.try_reserve());
+  new (buf) Frame{2, {5., 6., 7., 8.}};
+  producer.commit(sizeof(Frame), 2);
+
+  // all slots are in use
+  ASSERT_EQ(producer.try_reserve(), nullptr);
+  ASSERT_FALSE(producer.try_send(&f1, sizeof(f1), f1.t));
+
+  auto m1 = consumer.try_receive();
+  ASSERT_TRUE(m1.has_value());
+  ASSERT_EQ(m1->stamp(), 1);
+  ASSERT_EQ(m1->size(), sizeof(Frame));
+  ASSERT_EQ(m1->as<Frame>().data[2], 3.);
+
+  {
+    auto m2 = consumer.try_receive();
+    ASSERT_TRUE(m2.has_value());
+    ASSERT_EQ(m2->as<Frame>().t, 2);
+    ASSERT_EQ(producer.try_reserve(), nullptr);
+  }
+
+  // m2 gave its slot back
+  ASSERT_NE(producer.try_reserve(), nullptr);
+  ASSERT_THROW(producer.commit(sizeof(Frame) + 1, 3), std::length_error);
+  producer.commit(0, 3);
+
+  auto m3 = consumer.try_receive();
+  ASSERT_EQ(m3->size(), 0LU);
+  ASSERT_THROW(m3->as<Frame>(), std::length_error);
+  ASSERT_FALSE(consumer.try_receive().has_value());
+}
+
+TEST(ShmTransport, Open)
+{
+  ASSERT_THROW(ShmChannel::open(channel_name("missing")), std::system_error);
+  ASSERT_THROW(ShmChannel::create(channel_name("empty"), 0, 16), std::invalid_argument);
+}
+
+TEST(ShmTransport, ConcurrentRelease)
+{
+  constexpr std::size_t n = 8;
+  auto channel            = ShmChannel::create(channel_name("release"), n, sizeof(int));
+  ShmProducer producer(channel);
+  ShmConsumer consumer(channel);
+
+  for (int round = 0; round < 100; ++round) {
+    std::vector<ShmMessage> msgs;
+    for (std::size_t i = 0; i < n; ++i) {
+      const int v = static_cast<int>(i);
+      ASSERT_TRUE(producer.try_send(&v, sizeof(v), round));
+      msgs.push_back(std::move(*consumer.try_receive()));
+    }
+    ASSERT_EQ(producer.try_reserve(), nullptr);
+
+    // messages destroyed by several threads at once
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < 4; ++t) {
+      threads.emplace_back([&msgs, t] {
+        for (std::size_t i = t; i < msgs.size(); i += 4) { msgs[i] = ShmMessage(); }
+      });
+    }
+    for (auto & t : threads) { t.join(); }
+
+    // all slots are given back, each one once
+    std::set<const void *> slots;
+    for (std::size_t i = 0; i < n; ++i) {
+      void * buf = producer.try_reserve();
+      ASSERT_NE(buf, nullptr);
+      slots.insert(buf);
+      producer.commit(0, 0);
+      consumer.try_receive();
+    }
+    ASSERT_EQ(slots.size(), n);
+  }
+}
+
+TEST(ShmTransport, Corrupted)
+{
+  const auto name = channel_name("corrupt");
+  auto channel    = ShmChannel::create(name, 2, sizeof(int));
+  ShmProducer producer(channel);
+  ShmConsumer consumer(channel);
+
+  // second mapping to corrupt the rings as a faulty peer would
+  const cbr::detail::ShmLayout layout(2, sizeof(int));
+  const int fd = shm_open(name.c_str(), O_RDWR, 0600);
+  ASSERT_GE(fd, 0);
+  void * base = mmap(nullptr, layout.total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  ASSERT_NE(base, MAP_FAILED);
+  auto * bytes = static_cast<std::byte *>(base);
+  auto * full  = reinterpret_cast<cbr::detail::ShmSlotDesc *>(bytes + layout.full_offset);
+  auto * free  = reinterpret_cast<uint64_t *>(bytes + layout.free_offset);
+
+  // invalid size: the slot goes back to the producer
+  const int v = 1;
+  ASSERT_TRUE(producer.try_send(&v, sizeof(v), 0));
+  full[0].size = 1000;
+  ASSERT_THROW(consumer.try_receive(), std::runtime_error);
+  ASSERT_FALSE(consumer.try_receive().has_value());
+  ASSERT_TRUE(producer.try_send(&v, sizeof(v), 1));
+  ASSERT_TRUE(producer.try_send(&v, sizeof(v), 2));
+  ASSERT_EQ(consumer.try_receive()->stamp(), 1);
+  ASSERT_EQ(consumer.try_receive()->stamp(), 2);
+
+  // invalid slot given back to the producer
+  free[0] = 1000;
+  free[1] = 1000;
+  ASSERT_THROW(producer.try_reserve(), std::runtime_error);
+
+  munmap(base, layout.total);
+}
+
+TEST(ShmTransport, Synchronizer)
+{
+  auto channel0 = ShmChannel::create(channel_name("sync0"), 4, 64);
+  auto channel1 = ShmChannel::create(channel_name("sync1"), 4, 64);
+
+  ShmProducer p0(channel0), p1(channel1);
+  ShmConsumer c0(channel0), c1(channel1);
+
+  cbr::Synchronizer<ShmMessage, ShmMessage> sync;
+  sync.set_time_fcn<0>([](const ShmMessage & m) { return m.stamp(); });
+  sync.set_time_fcn<1>([](const ShmMessage & m) { return m.stamp(); });
+
+  std::vector<std::pair<int, int>> res;
+  sync.register_callback([&res](ShmMessage && m0, ShmMessage && m1) {
+    res.emplace_back(m0.as<int>(), m1.as<int>());
+  });
+
+  for (int i = 0; i < 20; i++) {
+    const int v0 = 10 * i, v1 = 10 * i + 1;
+    ASSERT_TRUE(p0.try_send(&v0, sizeof(int), i));
+    ASSERT_TRUE(p1.try_send(&v1, sizeof(int), i));
+    ASSERT_EQ(c0.drain<0>(sync), 1LU);
+    ASSERT_EQ(c1.drain<1>(sync), 1LU);
+  }
+
+  ASSERT_EQ(res.size(), 20LU);
+  for (std::size_t i = 0; i < res.size(); i++) {
+    ASSERT_EQ(res[i].first, 10 * static_cast<int>(i));
+    ASSERT_EQ(res[i].second, 10 * static_cast<int>(i) + 1);
+  }
+}
+
+TEST(ShmTransport, CrossProcess)
+{
+  constexpr int N = 1000;
+
+  const auto name = channel_name("fork");
+  auto channel    = ShmChannel::create(name, 8, sizeof(Frame));
+  ShmConsumer consumer(channel);
+
+  const pid_t pid = fork();
+  ASSERT_GE(pid, 0);
+  if (pid == 0) {
+    ShmProducer producer(ShmChannel::open(name));
+    for (int i = 0; i < N;) {
+      if (void * buf = producer.try_reserve()) {
+        new (buf) Frame{i, {static_cast<double>(i), 0., 0., 0.}};
+        producer.commit(sizeof(Frame), i);
+        ++i;
+      }
+    }
+    _exit(0);
+  }
+
+  for (int i = 0; i < N;) {
+    if (auto msg = consumer.try_receive()) {
+      ASSERT_EQ(msg->stamp(), i);
+      ASSERT_EQ(msg->as<Frame>().data[0], static_cast<double>(i));
+      ++i;
+    }
+  }
+
+  int status = 0;
+  waitpid(pid, &status, 0);
+  ASSERT_TRUE(WIFEXITED(status));
+  ASSERT_EQ(WEXITSTATUS(status), 0);
+}
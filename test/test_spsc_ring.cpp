@@ -0,0 +1,143 @@
+// Copyright Yamaha 2021
+// MIT License
+// https://github.com/yamaha-bps/cbr_utils/blob/master/LICENSE
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cbr_utils/spsc_ring.hpp"
+
+TEST(SpscRing, Basic)
+{
+  ASSERT_THROW(cbr::SpscRing<int>(0), std::invalid_argument);
+
+  cbr::SpscRing<int> ring(3);
+  ASSERT_EQ(ring.capacity(), 4LU);
+  ASSERT_TRUE(ring.empty());
+  ASSERT_EQ(ring.front(), nullptr);
+  ASSERT_FALSE(ring.try_pop().has_value());
+
+  for (int i = 0; i < 4; ++i) { ASSERT_TRUE(ring.try_push(i)); }
+  ASSERT_FALSE(ring.try_push(4));
+  ASSERT_EQ(ring.size(), 4LU);
+  ASSERT_EQ(ring.write_available(), 0LU);
+
+  ASSERT_EQ(*ring.front(), 0);
+  ASSERT_EQ(ring.try_pop(), 0);
+  int v = 0;
+  ASSERT_TRUE(ring.try_pop(v));
+  ASSERT_EQ(v, 1);
+
+  // wrap around
+  ASSERT_TRUE(ring.try_push(4));
+  ASSERT_TRUE(ring.try_push(5));
+  ASSERT_EQ(ring.read_available(), 4LU);
+  for (int i = 2; i < 6; ++i) { ASSERT_EQ(ring.try_pop(), i); }
+  ASSERT_TRUE(ring.empty());
+}
+
+TEST(SpscRing, Batch)
+{
+  cbr::SpscRing<int> ring(8);
+
+  const std::vector<int> in{0, 1, 2, 3, 4, 5};
+  ASSERT_EQ(ring.try_push(in.begin(), in.end()), 6LU);
+  ASSERT_EQ(ring.try_push(in.begin(), in.end()), 2LU);
+
+  std::vector<int> out;
+  ASSERT_EQ(ring.try_pop(std::back_inserter(out), 5), 5LU);
+  ASSERT_EQ(out, (std::vector<int>{0, 1, 2, 3, 4}));
+
+  // the ring now wraps around
+  ASSERT_EQ(ring.try_push(in.begin(), in.end()), 5LU);
+
+  const auto spans = ring.read_spans();
+  ASSERT_EQ(spans.size(), 8LU);
+  ASSERT_EQ(spans.first_size, 3LU);
+  ASSERT_EQ(spans.second_size, 5LU);
+  ASSERT_EQ(spans.first[0], 5);
+  ASSERT_EQ(spans.first[1], 0);
+  ASSERT_EQ(spans.first[2], 1);
+  ASSERT_EQ(spans.second[0], 0);
+  ASSERT_EQ(spans.second[4], 4);
+
+  ring.consume(4);
+  ASSERT_EQ(ring.size(), 4LU);
+  out.clear();
+  ASSERT_EQ(ring.try_pop(std::back_inserter(out), 10), 4LU);
+  ASSERT_EQ(out, (std::vector<int>{1, 2, 3, 4}));
+}
+
+TEST(SpscRing, NonTrivial)
+{
+  const auto tracker = std::make_shared<int>(0);
+  {
+    cbr::SpscRing<std::shared_ptr<int>> ring(4);
+    ASSERT_TRUE(ring.try_push(tracker));
+    ASSERT_TRUE(ring.try_emplace(tracker));
+    ASSERT_EQ(tracker.use_count(), 3);
+
+    auto p = ring.try_pop();
+    ASSERT_TRUE(p.has_value());
+    ASSERT_EQ(tracker.use_count(), 3);
+    p.reset();
+    ASSERT_EQ(tracker.use_count(), 2);
+  }
+  // remaining elements destroyed with the ring
+  ASSERT_EQ(tracker.use_count(), 1);
+
+  cbr::SpscRing<std::string> ring(2);
+  ASSERT_TRUE(ring.try_emplace(3, 'a'));
+  ASSERT_EQ(*ring.front(), "aaa");
+  ring.pop();
+
+  // move only
+  cbr::SpscRing<std::unique_ptr<int>> ring2(2);
+  ASSERT_TRUE(ring2.try_push(std::make_unique<int>(3)));
+  ASSERT_EQ(**ring2.try_pop(), 3);
+}
+
+TEST(SpscRing, Threads)
+{
+  static constexpr uint64_t n = 200000;
+  cbr::SpscRing<uint64_t> ring(64);
+
+  std::thread producer([&ring] {
+    std::vector<uint64_t> batch;
+    for (uint64_t i = 0; i < n;) {
+      if (i % 3 == 0) {
+        batch.clear();
+        for (uint64_t j = i; j < std::min(n, i + 5); ++j) { batch.push_back(j); }
+        i += ring.try_push(batch.begin(), batch.end());
+      } else if (ring.try_push(i)) {
+        ++i;
+      }
+      if (ring.write_available() == 0) { std::this_thread::yield(); }
+    }
+  });
+
+  uint64_t expected = 0;
+  while (expected < n) {
+    if (expected % 2 == 0) {
+      const auto spans = ring.read_spans();
+      for (std::size_t i = 0; i < spans.first_size; ++i) { ASSERT_EQ(spans.first[i], expected++); }
+      for (std::size_t i = 0; i < spans.second_size; ++i) {
+        ASSERT_EQ(spans.second[i], expected++);
+      }
+      ring.consume(spans.size());
+    } else if (auto v = ring.try_pop()) {
+      ASSERT_EQ(*v, expected++);
+    }
+    if (ring.empty()) { std::this_thread::yield(); }
+  }
+  producer.join();
+  ASSERT_TRUE(ring.empty());
+}
@@ -4,8 +4,13 @@
 
 #include <gtest/gtest.h>
 
+#include <atomic>
+#include <chrono>
 #include <memory>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
@@ -588,3 +593,181 @@ TEST(SynchronizerTest, fallOut2)
   ASSERT_EQ(missed_0.size(), size_t(10));
   for (size_t i = 0; i < 10; i++) { ASSERT_EQ(missed_0[i], static_cast<int>(i)); }
 }
+
+TEST(SynchronizerTest, Parallel)
+{
+  auto pool = std::make_shared<cbr::ThreadPool>(4);
+
+  cbr::Synchronizer<int, int> sync;
+
+  sync.set_time_fcn<0>([](const int & i) { return i; });
+  sync.set_time_fcn<1>([](const int & i) { return i; });
+
+  std::vector<int> res;
+
+  sync.register_parallel_callback(
+    pool,
+    [](int && i0, int && i1) {
+      // later sets finish first
+      std::this_thread::sleep_for(std::chrono::milliseconds(20 - i0));
+      return i0 + i1;
+    },
+    [&res](int && r) { res.push_back(r); });
+
+  for (int i = 0; i < 20; i++) {
+    sync.add_and_search<0>(i);
+    sync.add_and_search<1>(i);
+  }
+
+  sync.wait_dispatched();
+  ASSERT_EQ(sync.get_dispatched_count(), 0LU);
+
+  ASSERT_EQ(res.size(), 20LU);
+  for (std::size_t i = 0; i < res.size(); i++) { ASSERT_EQ(res[i], 2 * static_cast<int>(i)); }
+}
+
+TEST(SynchronizerTest, ParallelVoid)
+{
+  auto pool = std::make_shared<cbr::ThreadPool>(2);
+
+  cbr::Synchronizer<std::unique_ptr<int>, std::unique_ptr<int>> sync;
+
+  sync.set_time_fcn<0>([](const std::unique_ptr<int> & i) { return *i; });
+  sync.set_time_fcn<1>([](const std::unique_ptr<int> & i) { return *i; });
+
+  std::atomic<int> n_work = 0;
+  int n_complete          = 0;
+
+  sync.register_parallel_callback(
+    pool,
+    [&n_work](std::unique_ptr<int> && i0, std::unique_ptr<int> && i1) {
+      if (*i0 == 3) { throw std::runtime_error("failed"); }
+      n_work += *i0 + *i1;
+    },
+    [&n_complete]() { ++n_complete; });
+
+  for (int i = 0; i < 10; i++) {
+    sync.add_and_search<0>(std::make_unique<int>(i));
+    sync.add_and_search<1>(std::make_unique<int>(i));
+  }
+
+  ASSERT_THROW(sync.wait_dispatched(), std::runtime_error);
+  ASSERT_NO_THROW(sync.wait_dispatched());  // reported once
+
+  // failed set is not completed
+  ASSERT_EQ(n_work, 2 * (45 - 3));
+  ASSERT_EQ(n_complete, 9);
+}
+
+TEST(SynchronizerTest, ParallelWaitFromCallback)
+{
+  auto pool = std::make_shared<cbr::ThreadPool>(2);
+
+  cbr::Synchronizer<int, int> sync;
+  sync.set_time_fcn<0>([](const int & i) { return i; });
+  sync.set_time_fcn<1>([](const int & i) { return i; });
+
+  // would deadlock, detected instead
+  sync.register_parallel_callback(
+    pool, [](int &&, int &&) {}, [&sync]() { sync.wait_dispatched(); });
+
+  sync.add_and_search<0>(0);
+  sync.add_and_search<1>(0);
+  sync.add_and_search<0>(1);
+  sync.add_and_search<1>(1);
+
+  ASSERT_THROW(sync.wait_dispatched(), std::logic_error);
+  ASSERT_EQ(sync.get_dispatched_count(), 0LU);
+}
+
+TEST(SynchronizerTest, DoubleStamps)
+{
+  cbr::StampedSynchronizer<double, double, double> sync(0.15);
+
+  sync.set_time_fcn<0>([](const double & d) { return d; });
+  sync.set_time_fcn<1>([](const double & d) { return d; });
+
+  std::vector<std::pair<double, double>> res;
+  sync.register_callback([&res](double && d0, double && d1) { res.emplace_back(d0, d1); });
+
+  // sub-unit differences would be lost with integer stamps
+  sync.add_and_search<0>(0.10);
+  sync.add_and_search<1>(0.11);
+  sync.add_and_search<1>(0.19);
+  sync.add_and_search<0>(0.20);
+  sync.add_and_search<1>(0.30);
+  sync.add_and_search<0>(0.31);
+  sync.add_and_search<1>(0.50);
+  sync.add_and_search<0>(0.50);
+
+  std::stringstream ss;
+  ss << sync;
+
+  ASSERT_EQ(res.size(), 3LU);
+  ASSERT_EQ(res[0], std::make_pair(0.10, 0.11));
+  ASSERT_EQ(res[1], std::make_pair(0.31, 0.30));
+  ASSERT_EQ(res[2], std::make_pair(0.50, 0.50));
+}
+
+TEST(SynchronizerTest, ChronoStamps)
+{
+  using clk_t    = std::chrono::steady_clock;
+  using policy_t = cbr::SynchronizerClockPolicy<clk_t>;
+  using msg_t    = std::pair<clk_t::time_point, int>;
+
+  cbr::BasicSynchronizer<policy_t, msg_t, msg_t> sync(std::chrono::milliseconds(15));
+
+  sync.set_time_fcn<0>([](const msg_t & m) { return m.first; });
+  sync.set_time_fcn<1>([](const msg_t & m) { return m.first; });
+
+  std::vector<std::pair<int, int>> res;
+  sync.register_callback(
+    [&res](msg_t && m0, msg_t && m1) { res.emplace_back(m0.second, m1.second); });
+
+  const auto t0 = clk_t::now();
+  const auto ms = [t0](int i) { return t0 + std::chrono::milliseconds(i); };
+
+  sync.add_and_search<0>(msg_t{ms(10), 0});
+  sync.add_and_search<1>(msg_t{ms(12), 1});
+  sync.add_and_search<0>(msg_t{ms(20), 2});  // too close
+  sync.add_and_search<0>(msg_t{ms(30), 3});
+  sync.add_and_search<1>(msg_t{ms(31), 4});
+  sync.add_and_search<0>(msg_t{ms(50), 5});
+  sync.add_and_search<1>(msg_t{ms(50), 6});
+
+  ASSERT_EQ(sync.get_time<1>(msg_t{ms(1), 0}), ms(1));
+
+  std::stringstream ss;
+  ss << sync;
+
+  ASSERT_EQ(res.size(), 3LU);
+  ASSERT_EQ(res[0], std::make_pair(0, 1));
+  ASSERT_EQ(res[1], std::make_pair(3, 4));
+  ASSERT_EQ(res[2], std::make_pair(5, 6));
+}
+
+TEST(SynchronizerTest, InplacePolicy)
+{
+  using policy_t = cbr::SynchronizerInplacePolicy<cbr::SynchronizerStampPolicy<double>>;
+  using sync_t   = cbr::BasicSynchronizer<policy_t, double, double>;
+  static_assert(!std::is_copy_constructible_v<sync_t::CallbackAll>);
+
+  sync_t sync(0.15);
+
+  sync.set_time_fcn<0>([](const double & d) { return d; });
+  sync.set_time_fcn<1>([](const double & d) { return d; });
+
+  // move-only callables can be registered
+  std::vector<std::pair<double, double>> res;
+  sync.register_callback([&res, p = std::make_unique<int>(1)](double && d0, double && d1) {
+    res.emplace_back(*p * d0, d1);
+  });
+
+  sync.add_and_search<0>(0.10);
+  sync.add_and_search<1>(0.11);
+  sync.add_and_search<1>(0.19);
+  sync.add_and_search<0>(0.20);
+
+  ASSERT_EQ(res.size(), 1LU);
+  ASSERT_EQ(res[0], std::make_pair(0.10, 0.11));
+}
@@ -0,0 +1,215 @@
+// Copyright Yamaha 2021
+// MIT License
+// https://github.com/yamaha-bps/cbr_utils/blob/master/LICENSE
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "cbr_utils/synchronizer_hub.hpp"
+
+using cbr::SynchronizerHub;
+
+using IntPtr = std::shared_ptr<const int>;
+
+TEST(SynchronizerHub, SameAsSynchronizer)
+{
+  // example 1 from https://wiki.ros.org/message_filters/ApproximateTime, see test_synchronizer
+  SynchronizerHub<int, int, int, int> hub;
+  cbr::Synchronizer<int, int, int, int> sync;
+
+  hub.set_time_fcn<0>([](const int & i) { return i; });
+  hub.set_time_fcn<1>([](const int & i) { return i; });
+  hub.set_time_fcn<2>([](const int & i) { return i; });
+  hub.set_time_fcn<3>([](const int & i) { return i; });
+  sync.set_time_fcn<0>([](const int & i) { return i; });
+  sync.set_time_fcn<1>([](const int & i) { return i; });
+  sync.set_time_fcn<2>([](const int & i) { return i; });
+  sync.set_time_fcn<3>([](const int & i) { return i; });
+
+  std::vector<std::vector<int>> res_hub, res_sync;
+  std::vector<int> missed_hub, missed_sync;
+
+  auto & matcher = hub.add_matcher();
+  matcher.register_callback([&res_hub](IntPtr && i0, IntPtr && i1, IntPtr && i2, IntPtr && i3) {
+    res_hub.push_back({*i0, *i1, *i2, *i3});
+  });
+  matcher.register_nonsync_callback<3>([&missed_hub](IntPtr && i) { missed_hub.push_back(*i); });
+
+  sync.register_callback([&res_sync](int && i0, int && i1, int && i2, int && i3) {
+    res_sync.push_back({i0, i1, i2, i3});
+  });
+  sync.register_nonsync_callback<3>([&missed_sync](int && i) { missed_sync.push_back(i); });
+
+  const std::vector<std::pair<int, int>> input{{2, 10},
+    {0, 11},
+    {1, 12},
+    {3, 13},
+    {1, 20},
+    {0, 21},
+    {2, 22},
+    {3, 23},
+    {3, 26},
+    {0, 30},
+    {1, 31},
+    {3, 32},
+    {2, 33},
+    {3, 34},
+    {3, 40},
+    {2, 41},
+    {1, 42},
+    {0, 43},
+    {1, 46},
+    {2, 46},
+    {3, 47}};
+
+  for (const auto & [k, t] : input) {
+    switch (k) {
+    case 0:
+      hub.add_and_search<0>(t);
+      sync.add_and_search<0>(t);
+      break;
+    case 1:
+      hub.add_and_search<1>(t);
+      sync.add_and_search<1>(t);
+      break;
+    case 2:
+      hub.add_and_search<2>(t);
+      sync.add_and_search<2>(t);
+      break;
+    default:
+      hub.add_and_search<3>(t);
+      sync.add_and_search<3>(t);
+      break;
+    }
+  }
+
+  ASSERT_EQ(res_hub.size(), 4LU);
+  ASSERT_EQ(res_hub, res_sync);
+  ASSERT_EQ(missed_hub, missed_sync);
+}
+
+TEST(SynchronizerHub, SeveralMatchers)
+{
+  SynchronizerHub<int, std::string> hub;
+  hub.set_time_fcn<0>([](const int & i) { return i; });
+  hub.set_time_fcn<1>([](const std::string & s) { return std::stoi(s); });
+
+  std::vector<std::pair<IntPtr, std::shared_ptr<const std::string>>> res0, res10;
+
+  auto & m0 = hub.add_matcher(0);
+  m0.register_callback([&res0](IntPtr && i, std::shared_ptr<const std::string> && s) {
+    res0.emplace_back(std::move(i), std::move(s));
+  });
+  auto & m10 = hub.add_matcher(10);
+  m10.register_callback([&res10](IntPtr && i, std::shared_ptr<const std::string> && s) {
+    res10.emplace_back(std::move(i), std::move(s));
+  });
+  ASSERT_EQ(hub.matcher_count(), 2LU);
+
+  for (int i = 0; i < 30; i++) {
+    hub.add_and_search<0>(i);
+    hub.add_and_search<1>(std::make_shared<const std::string>(std::to_string(i)));
+  }
+
+  ASSERT_EQ(res0.size(), 30LU);
+  ASSERT_EQ(res10.size(), 3LU);
+
+  // messages are shared between matchers
+  for (std::size_t i = 0; i < res10.size(); i++) {
+    ASSERT_EQ(*res10[i].first, 11 * static_cast<int>(i));
+    ASSERT_EQ(res10[i].first, res0[static_cast<std::size_t>(*res10[i].first)].first);
+    ASSERT_EQ(res10[i].second, res0[static_cast<std::size_t>(*res10[i].first)].second);
+  }
+
+  // buffers only hold what matchers still need
+  ASSERT_LE(hub.buffer_size<0>(), 1LU);
+  ASSERT_LE(hub.buffer_size<1>(), 1LU);
+
+  // out of order message is dropped
+  hub.add_and_search<0>(5);
+  ASSERT_LE(hub.buffer_size<0>(), 1LU);
+
+  hub.remove_matcher(m0);
+  hub.remove_matcher(m10);
+  ASSERT_EQ(hub.matcher_count(), 0LU);
+  ASSERT_EQ(hub.buffer_size<0>(), 0LU);
+  ASSERT_EQ(hub.buffer_size<1>(), 0LU);
+}
+
+TEST(SynchronizerHub, LateMatcher)
+{
+  SynchronizerHub<int, int> hub;
+  hub.set_time_fcn<0>([](const int & i) { return i; });
+  hub.set_time_fcn<1>([](const int & i) { return i; });
+
+  int n0 = 0, n1 = 0;
+  hub.add_matcher().register_callback([&n0](IntPtr &&, IntPtr &&) { ++n0; });
+
+  hub.add_and_search<0>(0);
+  hub.add_and_search<0>(1);
+
+  hub.add_matcher().register_callback([&n1](IntPtr &&, IntPtr &&) { ++n1; });
+
+  hub.add_and_search<1>(0);
+  hub.add_and_search<1>(1);
+  hub.add_and_search<0>(2);
+  hub.add_and_search<1>(2);
+
+  // late matcher did not see the first messages of stream 0
+  ASSERT_EQ(n0, 3);
+  ASSERT_EQ(n1, 1);
+}
+
+TEST(SynchronizerHub, ReentrantAdd)
+{
+  SynchronizerHub<int, int> hub;
+  hub.set_time_fcn<0>([](const int & i) { return i; });
+  hub.set_time_fcn<1>([](const int & i) { return i; });
+
+  // the callback feeds the hub, which would deadlock if called with the hub locked
+  std::vector<int> res;
+  hub.add_matcher().register_callback([&](IntPtr && i0, IntPtr &&) {
+    res.push_back(*i0);
+    if (*i0 < 5) {
+      hub.add_and_search<0>(*i0 + 1);
+      hub.add_and_search<1>(*i0 + 1);
+    }
+  });
+
+  hub.add_and_search<0>(0);
+  hub.add_and_search<1>(0);
+
+  ASSERT_EQ(res, (std::vector<int>{0, 1, 2, 3, 4, 5}));
+}
+
+TEST(SynchronizerHub, DoubleStamps)
+{
+  cbr::BasicSynchronizerHub<cbr::SynchronizerStampPolicy<double>, double, double> hub;
+  hub.set_time_fcn<0>([](const double & d) { return d; });
+  hub.set_time_fcn<1>([](const double & d) { return d; });
+
+  // sub-unit differences would be lost with integer stamps
+  std::vector<std::pair<double, double>> res;
+  hub.add_matcher(0.15).register_callback(
+    [&res](std::shared_ptr<const double> && d0, std::shared_ptr<const double> && d1) {
+      res.emplace_back(*d0, *d1);
+    });
+
+  for (const auto & [k, d] : std::vector<std::pair<int, double>>{
+         {0, 0.10}, {1, 0.11}, {1, 0.19}, {0, 0.20}, {1, 0.30}, {0, 0.31}, {1, 0.50}, {0, 0.50}}) {
+    if (k == 0) {
+      hub.add_and_search<0>(d);
+    } else {
+      hub.add_and_search<1>(d);
+    }
+  }
+
+  ASSERT_EQ(res.size(), 3LU);
+  ASSERT_EQ(res[0], std::make_pair(0.10, 0.11));
+  ASSERT_EQ(res[1], std::make_pair(0.31, 0.30));
+  ASSERT_EQ(res[2], std::make_pair(0.50, 0.50));
+}
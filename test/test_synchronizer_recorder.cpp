@@ -0,0 +1,245 @@
+// Copyright Yamaha 2021
+// MIT License
+// https://github.com/yamaha-bps/cbr_utils/blob/master/LICENSE
+
+#include <gtest/gtest.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <boost/hana/adapt_struct.hpp>
+
+#include <csignal>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "cbr_utils/synchronizer.hpp"
+#include "cbr_utils/synchronizer_recorder.hpp"
+
+namespace {
+
+struct Msg
+{
+  BOOST_HANA_DEFINE_STRUCT(Msg, (int64_t, t), (std::vector<double>, data));
+};
+
+std::string tmp_path(const std::string & name)
+{
+  return "/tmp/cbr_utils_test_" + std::to_string(getpid()) + "_" + name;
+}
+
+template<typename Sync>
+void setup(Sync & sync, std::vector<std::pair<int64_t, int64_t>> & res)
+{
+  sync.template set_time_fcn<0>([](const Msg & m) { return m.t; });
+  sync.template set_time_fcn<1>([](const int & i) { return static_cast<int64_t>(i); });
+  sync.register_callback([&res](Msg && m, int && i) {
+    ASSERT_EQ(m.data.size(), static_cast<std::size_t>(m.t));
+    res.emplace_back(m.t, i);
+  });
+}
+
+}  // namespace
+
+TEST(SynchronizerRecorder, RecordReplay)
+{
+  const auto path = tmp_path("sync.rec");
+
+  std::vector<std::pair<int64_t, int64_t>> res_rec, res_replay;
+
+  {
+    cbr::Synchronizer<Msg, int> sync;
+    setup(sync, res_rec);
+
+    // small grow size to exercise remapping
+    cbr::SynchronizerRecorder<Msg, int> recorder(path, 64);
+    for (int i = 0; i < 50; i++) {
+      const auto n = static_cast<std::size_t>(2 * i);
+      recorder.add_and_search<0>(sync, Msg{2 * i, std::vector<double>(n, 1.)});
+      recorder.add_and_search<1>(sync, 2 * i + 1);
+      if (i % 10 == 0) { recorder.add_and_search<1>(sync, 2 * i + 1); }
+    }
+    recorder.record<1>(1000, 1000);
+    ASSERT_EQ(recorder.count(), 106LU);
+  }
+
+  cbr::SynchronizerReplayer<Msg, int> replayer(path);
+
+  std::vector<int64_t> stamps;
+  ASSERT_EQ(replayer.for_each([&stamps](auto, int64_t t, auto &&) { stamps.push_back(t); }), 106LU);
+  ASSERT_EQ(stamps[0], 0);
+  ASSERT_EQ(stamps[1], 1);
+  ASSERT_EQ(stamps.back(), 1000);
+
+  cbr::Synchronizer<Msg, int> sync;
+  setup(sync, res_replay);
+  ASSERT_EQ(replayer.replay(sync), 106LU);
+
+  ASSERT_EQ(res_rec.size(), 49LU);
+  ASSERT_EQ(res_rec, res_replay);
+
+  std::remove(path.c_str());
+}
+
+TEST(SynchronizerRecorder, AddOps)
+{
+  const auto path = tmp_path("ops.rec");
+
+  std::vector<std::pair<int64_t, int64_t>> res_rec, res_replay;
+
+  {
+    cbr::Synchronizer<Msg, int> sync;
+    setup(sync, res_rec);
+    cbr::SynchronizerRecorder<Msg, int> recorder(path);
+
+    // sets are only searched on add_and_search, so the result depends on which calls are replayed
+    for (int i = 0; i < 20; i++) {
+      Msg msg{i, std::vector<double>(static_cast<std::size_t>(i))};
+      if (i % 3 == 0) {
+        recorder.add_and_search<0>(sync, std::move(msg));
+      } else {
+        recorder.add<0>(sync, std::move(msg));
+      }
+      recorder.add<1>(sync, i);
+    }
+  }
+
+  cbr::Synchronizer<Msg, int> sync;
+  setup(sync, res_replay);
+  cbr::SynchronizerReplayer<Msg, int> replayer(path);
+  ASSERT_EQ(replayer.replay(sync), 40LU);
+
+  ASSERT_EQ(res_rec, res_replay);
+
+  // replaying everything with add_and_search gives different sets
+  std::vector<std::pair<int64_t, int64_t>> res_search;
+  cbr::Synchronizer<Msg, int> sync_search;
+  setup(sync_search, res_search);
+  replayer.for_each([&sync_search](auto k, int64_t, auto && msg) {
+    sync_search.add_and_search<decltype(k)::value>(std::move(msg));
+  });
+  ASSERT_NE(res_rec, res_search);
+
+  std::remove(path.c_str());
+}
+
+TEST(SynchronizerRecorder, Reentrant)
+{
+  const auto path = tmp_path("reentrant.rec");
+  {
+    cbr::Synchronizer<int, int> sync;
+    sync.set_time_fcn<0>([](const int & i) { return static_cast<int64_t>(i); });
+    sync.set_time_fcn<1>([](const int & i) { return static_cast<int64_t>(i); });
+    cbr::SynchronizerRecorder<int, int> recorder(path);
+
+    // callbacks run after the recorder is unlocked
+    sync.register_callback([&recorder](int && i0, int &&) { recorder.record<0>(-i0, -i0); });
+    recorder.add_and_search<0>(sync, 1);
+    recorder.add_and_search<1>(sync, 1);
+    ASSERT_EQ(recorder.count(), 3LU);
+  }
+  std::remove(path.c_str());
+}
+
+TEST(SynchronizerRecorder, DoubleStamps)
+{
+  const auto path = tmp_path("double.rec");
+  using policy_t  = cbr::SynchronizerStampPolicy<double>;
+
+  {
+    cbr::BasicSynchronizer<policy_t, double, double> sync;
+    sync.set_time_fcn<0>([](const double & d) { return d; });
+    sync.set_time_fcn<1>([](const double & d) { return d; });
+    cbr::BasicSynchronizerRecorder<policy_t, double, double> recorder(path);
+    recorder.add_and_search<0>(sync, 0.25);
+    recorder.add_and_search<1>(sync, 0.75);
+  }
+
+  std::vector<double> stamps;
+  cbr::BasicSynchronizerReplayer<policy_t, double, double> replayer(path);
+  replayer.for_each([&stamps](auto, double t, auto &&) { stamps.push_back(t); });
+  ASSERT_EQ(stamps, (std::vector<double>{0.25, 0.75}));
+
+  // integer stamps can not read floating point recordings
+  ASSERT_THROW((cbr::SynchronizerReplayer<double, double>(path)), std::runtime_error);
+
+  std::remove(path.c_str());
+}
+
+TEST(SynchronizerRecorder, Crash)
+{
+  const auto path = tmp_path("crash.rec");
+
+  // record from a process that exits without closing the recording
+  const pid_t pid = fork();
+  ASSERT_GE(pid, 0);
+  if (pid == 0) {
+    cbr::Synchronizer<Msg, int> sync;
+    sync.set_time_fcn<0>([](const Msg & m) { return m.t; });
+    sync.set_time_fcn<1>([](const int & i) { return static_cast<int64_t>(i); });
+    auto * recorder = new cbr::SynchronizerRecorder<Msg, int>(path, 4096);
+    for (int i = 0; i < 100; i++) { recorder->add_and_search<1>(sync, i); }
+    _exit(0);
+  }
+  int status = 0;
+  ASSERT_EQ(waitpid(pid, &status, 0), pid);
+  ASSERT_TRUE(WIFEXITED(status));
+
+  // the file was grown past the records, the zero-filled tail is ignored
+  cbr::SynchronizerReplayer<Msg, int> replayer(path);
+  std::vector<int> values;
+  ASSERT_EQ(replayer.for_each([&values](auto k, int64_t, auto && msg) {
+    if constexpr (decltype(k)::value == 1) { values.push_back(msg); }
+  }),
+    100LU);
+  ASSERT_EQ(values.size(), 100LU);
+  ASSERT_EQ(values.back(), 99);
+
+  std::remove(path.c_str());
+}
+
+TEST(SynchronizerRecorder, Invalid)
+{
+  const auto path = tmp_path("invalid.rec");
+
+  {
+    cbr::SynchronizerRecorder<int, int, int> recorder(path);
+  }
+  ASSERT_THROW((cbr::SynchronizerReplayer<int, int>(path)), std::runtime_error);
+
+  {
+    cbr::MappedFileWriter file(path);
+    file.write("garbage", 7);
+  }
+  ASSERT_THROW((cbr::SynchronizerReplayer<int, int>(path)), std::runtime_error);
+  ASSERT_THROW((cbr::SynchronizerReplayer<int, int>(tmp_path("missing"))), std::system_error);
+
+  std::remove(path.c_str());
+}
+
+TEST(SynchronizerRecorder, FullDisk)
+{
+  const auto path = tmp_path("full.rec");
+
+  // a file size limit fails like a full disk
+  rlimit old{};
+  getrlimit(RLIMIT_FSIZE, &old);
+  rlimit lim   = old;
+  lim.rlim_cur = 10000;
+  const auto handler = std::signal(SIGXFSZ, SIG_IGN);
+  setrlimit(RLIMIT_FSIZE, &lim);
+  {
+    cbr::MappedFileWriter file(path, 4096);
+    const std::vector<char> data(4096, 'x');
+    file.write(data.data(), data.size());
+    file.write(data.data(), data.size());
+    EXPECT_THROW(file.write(data.data(), data.size()), std::system_error);
+    EXPECT_EQ(file.size(), 2 * data.size());
+  }
+  setrlimit(RLIMIT_FSIZE, &old);
+  std::signal(SIGXFSZ, handler);
+
+  std::remove(path.c_str());
+}
@@ -5,6 +5,8 @@
 #include <gtest/gtest.h>
 
 #include <array>
+#include <atomic>
+#include <cstddef>
 #include <memory>
 #include <string>
 #include <tuple>
@@ -13,8 +15,49 @@
 
 #include "cbr_utils/thread_pool.hpp"
 
+// ThreadPool can be forward declared
+namespace cbr {
+class ThreadPool;
+}  // namespace cbr
+
 TEST(ThreadPool, main)
 {
   using cbr::ThreadPool;
   ThreadPool pool(2);
 }
+
+TEST(ThreadPool, post)
+{
+  std::atomic<int> count{0};
+  {
+    cbr::ThreadPool pool(2);
+    for (int i = 0; i < 100; ++i) { pool.post([&count] { ++count; }); }
+    ASSERT_EQ(pool.enqueue([] { return 1; }).get(), 1);
+  }
+  ASSERT_EQ(count, 100);  // workers finish the queue before joining
+}
+
+TEST(ThreadPool, moveOnly)
+{
+  std::atomic<int> count{0};
+  {
+    cbr::ThreadPool pool(2);
+    pool.post([&count, p = std::make_unique<int>(1)] { count += *p; });
+  }
+  ASSERT_EQ(count, 1);
+}
+
+TEST(ThreadPool, inplaceTasks)
+{
+  using pool_t = cbr::BasicThreadPool<std::allocator<std::byte>, cbr::inplace_function<void(), 32>>;
+
+  std::atomic<int> count{0};
+  {
+    pool_t pool(2);
+    for (int i = 0; i < 100; ++i) {
+      pool.post([&count, p = std::make_unique<int>(1)] { count += *p; });
+    }
+    ASSERT_EQ(pool.enqueue([](int i) { return i; }, 2).get(), 2);
+  }
+  ASSERT_EQ(count, 100);
+}
@@ -0,0 +1,144 @@
+// Copyright Yamaha 2021
+// MIT License
+// https://github.com/yamaha-bps/cbr_utils/blob/master/LICENSE
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "cbr_utils/thread_pool.hpp"
+#include "cbr_utils/watchdog.hpp"
+
+using namespace std::chrono_literals;
+
+TEST(Watchdog, BeatingLoop)
+{
+  cbr::Watchdog watchdog(1ms);
+  std::atomic<int> fired{0};
+  auto hb = watchdog.add("loop", 100ms, [&fired](const cbr::WatchdogEvent &) { ++fired; });
+
+  for (int i = 0; i < 30; ++i) {
+    hb->beat();
+    std::this_thread::sleep_for(5ms);
+  }
+
+  ASSERT_EQ(fired.load(), 0);
+  ASSERT_EQ(hb->expired_count(), 0LU);
+  ASSERT_EQ(watchdog.expired_count(), 0LU);
+}
+
+TEST(Watchdog, StalledLoop)
+{
+  cbr::Watchdog watchdog(1ms);
+
+  std::mutex mtx;
+  std::string name;
+  std::string context;
+  std::atomic<int> fired{0};
+
+  auto hb = watchdog.add("control", 20ms, [&](const cbr::WatchdogEvent & e) {
+    std::scoped_lock lock(mtx);
+    name    = e.name;
+    context = e.context != nullptr ? e.context : "";
+    ASSERT_EQ(e.timeout, 20ms);
+    ASSERT_GE(e.overdue.count(), 0);
+    ++fired;
+  });
+
+  hb->beat("compute");
+  std::this_thread::sleep_for(200ms);
+
+  // fired once per missed deadline
+  ASSERT_EQ(fired.load(), 1);
+  ASSERT_EQ(hb->expired_count(), 1LU);
+  {
+    std::scoped_lock lock(mtx);
+    ASSERT_EQ(name, "control");
+    ASSERT_EQ(context, "compute");
+  }
+
+  // resumes and stalls again
+  hb->beat();
+  std::this_thread::sleep_for(200ms);
+  ASSERT_EQ(fired.load(), 2);
+  ASSERT_EQ(watchdog.expired_count(), 2LU);
+}
+
+TEST(Watchdog, LongTimeout)
+{
+  // timeout longer than a wheel turn
+  cbr::Watchdog watchdog(1ms, 8);
+  std::atomic<int> fired{0};
+  auto hb = watchdog.add("slow", 50ms, [&fired](const cbr::WatchdogEvent &) { ++fired; });
+
+  std::this_thread::sleep_for(25ms);
+  ASSERT_EQ(fired.load(), 0);
+  std::this_thread::sleep_for(200ms);
+  ASSERT_EQ(fired.load(), 1);
+}
+
+TEST(Watchdog, DisarmRemove)
+{
+  cbr::Watchdog watchdog(1ms);
+  std::atomic<int> fired{0};
+  const auto cb = [&fired](const cbr::WatchdogEvent &) { ++fired; };
+
+  auto hb1 = watchdog.add("disarmed", 10ms, cb);
+  auto hb2 = watchdog.add("removed", 10ms, cb);
+
+  hb1->disarm();
+  ASSERT_FALSE(hb1->is_armed());
+  watchdog.remove(hb2);
+
+  std::this_thread::sleep_for(100ms);
+  ASSERT_EQ(fired.load(), 0);
+
+  hb1->beat();
+  ASSERT_TRUE(hb1->is_armed());
+  std::this_thread::sleep_for(100ms);
+  ASSERT_EQ(fired.load(), 1);
+}
+
+TEST(Watchdog, ThrowingCallback)
+{
+  cbr::Watchdog watchdog(1ms);
+  std::atomic<int> fired{0};
+  auto hb = watchdog.add("throw", 5ms, [&fired](const cbr::WatchdogEvent &) {
+    ++fired;
+    throw std::runtime_error("callback");
+  });
+
+  std::this_thread::sleep_for(100ms);
+  ASSERT_EQ(fired.load(), 1);
+}
+
+TEST(Watchdog, ThreadPoolTask)
+{
+  cbr::Watchdog watchdog(1ms);
+  std::atomic<int> fired{0};
+  auto hb = watchdog.add("task", 20ms, [&fired](const cbr::WatchdogEvent & e) {
+    if (std::string(e.context) == "slow") { ++fired; }
+  });
+  hb->disarm();
+
+  cbr::ThreadPool pool(1);
+  auto fast = pool.enqueue([hb] {
+    cbr::WatchdogScope scope(*hb, "fast");
+    std::this_thread::sleep_for(1ms);
+  });
+  fast.wait();
+  auto slow = pool.enqueue([hb] {
+    cbr::WatchdogScope scope(*hb, "slow");
+    std::this_thread::sleep_for(100ms);
+  });
+  slow.wait();
+
+  ASSERT_FALSE(hb->is_armed());
+  std::this_thread::sleep_for(50ms);
+  ASSERT_EQ(fired.load(), 1);
+}
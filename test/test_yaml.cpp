@@ -11,6 +11,7 @@
 #include <string>
 #include <vector>
 
+#include "cbr_utils/inline_vector.hpp"
 #include "cbr_utils/yaml.hpp"
 
 namespace cbr {
@@ -80,6 +81,25 @@ TEST(Yaml, VectorType)
   ASSERT_EQ(config.vector[3], 4);
 }
 
+TEST(Yaml, InlineVectors)
+{
+  using small_t  = cbr::small_vector<int, 2>;
+  using static_t = cbr::static_vector<int, 3>;
+
+  auto yaml = YAML::Load("[1,2,3]");
+  ASSERT_EQ(yaml.as<small_t>(), (small_t{1, 2, 3}));
+  ASSERT_EQ(yaml.as<static_t>(), (static_t{1, 2, 3}));
+
+  yaml = YAML::Load("[1,2,3,4]");
+  ASSERT_THROW(yaml.as<static_t>(), YAML::BadConversion);
+
+  const cbr::static_vector<double, 4> v{1.5, 2.5};
+  YAML::Node node(v);
+  ASSERT_TRUE(node.IsSequence());
+  ASSERT_EQ(node.size(), 2LU);
+  ASSERT_DOUBLE_EQ(node[1].as<double>(), 2.5);
+}
+
 struct OptionalStruct1
 {
   std::optional<double> optional_1 = 1.;